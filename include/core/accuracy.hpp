@@ -0,0 +1,31 @@
+#pragma once
+#ifndef _ACCURACY_HPP_
+#define _ACCURACY_HPP_
+
+#include <vector>
+
+#include "simulator.hpp"
+
+// Error of an approximate transient against a reference run of the same circuit, such as a
+// switch-level run against the full device model. The approximate waveforms are interpolated
+// linearly onto the reference time points and every node voltage is compared there. RMS errors
+// are weighted by time, so the short steps around edges do not dominate them.
+class Accuracy {
+public:
+    struct Node {
+        int index;                  // unknown
+        double maxError;            // [V]
+        double time;                // [s] where the error peaks
+        double rmsError;            // [V]
+    };
+
+    struct Report {
+        std::vector<Node> nodes;    // worst first
+        double maxError;            // [V] over every node
+        double rmsError;            // [V] over every node
+    };
+
+    static Report compare(const Simulator &simulator, const Simulator::Waveforms &approximate, const Simulator::Waveforms &reference);
+};
+
+#endif
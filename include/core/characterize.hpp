@@ -0,0 +1,91 @@
+#pragma once
+#ifndef _CHARACTERIZE_HPP_
+#define _CHARACTERIZE_HPP_
+
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "measure.hpp"
+#include "netlist.hpp"
+#include "simulator.hpp"
+
+// Standard cell characterization into NLDM tables. Cells are .subckt definitions of the
+// library deck and every arc is measured for a rising and a falling input edge at every
+// (input slew, output load, corner) point:
+//
+//   .char <cell> <input> <output> [<pin>=0|1 ...]     arc, side inputs tied low or high
+//   .chartable slews=<t>,<t>,... loads=<c>,<c>,... [settle=<t>]
+//   .corner <name> vdd=<v> [dvt=<v>] [mu=<scale>]     threshold shift and mobility scale
+//
+// Ports named vdd/vcc go to the supply and gnd/vss to ground. Every point is an independent job
+// on a thread pool. A job borrows a harness (library copy with the corner applied, supply,
+// input ramp, load capacitor, Simulator and MeasureEngine) for its corner and arc, edits the
+// ramp and the load in place and reruns the transient from the operating point the harness
+// solved once, so after warm-up a point costs one transient and no setup.
+class Characterizer {
+public:
+    struct Corner {
+        std::string name;
+        double vdd;                     // [V]
+        double dVt;                     // [V] added to the threshold of every technology
+        double mobility;                // scale on MUn and MUp
+    };
+
+    struct Arc {
+        std::string cell, input, output;
+        std::vector<std::pair<std::string, bool>> ties;   // side inputs held high (true) or low
+    };
+
+    // one arc at one corner for one input edge. tables are slews x loads, row-major, and NaN
+    // where the output did not switch within the window
+    struct Timing {
+        int arc, corner;
+        bool inputRise, outputRise;
+        std::vector<double> delay;      // [s] 50% input to 50% output
+        std::vector<double> transition; // [s] 20-80% output transition
+        std::vector<double> energy;     // [J] supply energy beyond the static power
+    };
+
+    Characterizer(const Netlist &library, int threads = 0);
+    ~Characterizer();
+
+    void add(const Netlist::Analysis &card);            // .char, .chartable or .corner
+    bool empty() const { return _arcs.empty(); }
+
+    std::vector<Timing> run();
+    void writeLiberty(std::ostream &out, const std::vector<Timing> &timings) const;
+    int getTransientCount() const { return _transients; }
+
+private:
+    struct Harness {
+        int corner, arc;
+        bool rise, busy;
+        std::unique_ptr<Netlist> netlist;
+        std::unique_ptr<Simulator> sim;
+        std::unique_ptr<MeasureEngine> measures;
+        std::vector<double> initial;
+        int vin, load, output, supply;     // input source, load capacitor, v(~out), i(v~dd)
+        double outputStart;
+    };
+
+    const Netlist &_library;
+    int _threads;
+    std::vector<Arc> _arcs;
+    std::vector<Corner> _corners;
+    std::vector<double> _slews, _loads;
+    double _settle;
+    int _transients;
+
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<Harness>> _harnesses;
+
+    double _window() const;
+    Harness &_acquire(int corner, int arc, bool rise);
+    void _release(Harness &harness);
+    std::unique_ptr<Harness> _build(int corner, int arc, bool rise) const;
+};
+
+#endif
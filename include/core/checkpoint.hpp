@@ -0,0 +1,81 @@
+#pragma once
+#ifndef _CHECKPOINT_HPP_
+#define _CHECKPOINT_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "simulator.hpp"
+
+// Periodic snapshots of a running transient. The Simulator hands over its full integrator state
+// (Simulator::TransientState) after an accepted point once `interval` seconds of wall time have
+// passed. Clients (measurements, waveform writers) add their own state at that same point. The
+// snapshot is then written by a background thread, to a temporary file renamed over the
+// previous snapshot, so the solver never waits for the disk and a preempted run always leaves a
+// complete file behind. If the writer is still busy the newer snapshot simply replaces the
+// pending one.
+class Checkpoint {
+public:
+    static const uint32_t VERSION = 2;
+
+    // state of a callback consumer, as flat doubles, restored in registration order
+    struct Client {
+        std::function<std::vector<double>()> save;
+        std::function<void(const std::vector<double> &)> load;
+    };
+
+    Checkpoint(const std::filesystem::path &path, double interval);
+    ~Checkpoint();
+
+    Checkpoint(const Checkpoint &) = delete;
+    Checkpoint &operator=(const Checkpoint &) = delete;
+
+    void addClient(const Client &client) { _clients.push_back(client); }
+    void setAnalysis(int analysis) { _analysis = analysis; }   // card index, to resume at the right .tran
+
+    bool due() const;
+    void capture(const Simulator &simulator, const Simulator::TransientState &state);
+    void flush();                                           // wait until pending snapshots are on disk
+    int getWritten() const;
+
+    static int getAnalysis(const std::filesystem::path &path);  // card index a snapshot was taken in
+
+    // reads the snapshot at path, restores every client and returns the card index it was taken
+    // in. throws if the file is missing, corrupt or from another circuit.
+    int restore(const Simulator &simulator, Simulator::TransientState &state);
+
+private:
+    struct Snapshot {
+        std::vector<uint64_t> fingerprint;
+        int analysis;
+        Simulator::TransientState state;
+        std::vector<std::vector<double>> clients;
+    };
+
+    std::filesystem::path _path;
+    double _interval;
+    int _analysis;
+    std::vector<Client> _clients;
+    std::chrono::steady_clock::time_point _last;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _wake, _idle;
+    std::unique_ptr<Snapshot> _pending;
+    bool _writing, _stop;
+    int _written;
+    std::exception_ptr _error;
+    std::thread _writer;
+
+    void _run();
+    void _write(const Snapshot &snapshot) const;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef _CURVES_HPP_
+#define _CURVES_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "models.hpp"
+#include "netlist.hpp"
+#include "threadpool.hpp"
+
+// PlanarFET surfaces for model inspection and fitting QA, the engine of csim-curves: Id, Gm,
+// Cgs and Cgd over every technology, polarity, width, Vgs and Vds of a grid.
+//
+// Binary output, host byte order:
+//   "csimcurv" | u32 version | u32 quantities (4)
+//   u64 techs, types, widths, vgs, vds
+//   per tech: u32 length + name | per type: u8 'n' or 'p'
+//   f64 widths[] | f64 vgs[] | f64 vds[]
+//   f64 {id, gm, cgs, cgd} per point, vds fastest, then vgs, width, type and tech
+class CurveSweep {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t QUANTITIES = 4;
+
+    struct Grid {
+        std::vector<int> techs;                     // technologies of the netlist
+        std::vector<ModelUtils::DevType> types;
+        std::vector<double> widths, vgs, vds;
+        bool analyticGm = true;
+    };
+
+    // <start>:<stop>:<step> or a comma separated list, with spice suffixes
+    static std::vector<double> parseGrid(const std::string &text);
+
+    CurveSweep(const Netlist &netlist, const Grid &grid, int threads);     // 0 threads uses every core
+
+    size_t getPoints() const;
+    int getThreads() const;
+
+    // csv with a header line, or the binary layout above
+    void write(std::ostream &out, bool binary);
+
+private:
+    const Netlist &_netlist;
+    Grid _grid;
+    std::unique_ptr<ThreadPool> _pool;
+};
+
+#endif
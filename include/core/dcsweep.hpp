@@ -0,0 +1,68 @@
+#pragma once
+#ifndef _DCSWEEP_HPP_
+#define _DCSWEEP_HPP_
+
+#include <string>
+#include <vector>
+
+#include "netlist.hpp"
+#include "simulator.hpp"
+
+// DC transfer sweeps by natural parameter continuation:
+//
+//   .dc <vsource> <start> <stop> <step>            source value (the waveform is replaced by dc)
+//   .dc w(<fet>) <start> <stop> <step>             device width
+//   .dc <param>(<tech>) <start> <stop> <step>      l, tox, lovl, vt, mun, mup, lambda or beta
+//
+// Newton starts every point from a prediction instead of zero: the tangent dx/dp = J^-1 df/dp
+// from the factors of the last converged point for source sweeps on the direct solver, the
+// secant through the last two points otherwise. The step between points is cut when Newton
+// fails or needs many iterations and grows back when it converges quickly, always stopping on
+// every grid point. The grid is cut into segments solved in parallel, each on its own netlist
+// copy and Simulator, and only the first point of a segment is solved from scratch.
+class DCSweep {
+public:
+    struct Sweep {
+        enum class Kind { Source, Width, Tech } kind;
+        int index;                      // source, fet or technology
+        std::string param;              // technology parameter
+        std::string name;               // as written on the card
+        std::vector<double> values;
+    };
+
+    struct Options {
+        int segments = 0;               // 0 picks one per thread, with at least minSegmentPoints each
+        int minSegmentPoints = 32;
+        int targetIterations = 3;       // Newton iterations per point the step adapts to
+        double minStep = 1e-6;          // smallest step as a share of the grid spacing
+    };
+
+    struct Statistics {
+        int points = 0;
+        int substeps = 0;               // extra continuation steps between grid points
+        int newtonIterations = 0;
+        int coldStarts = 0;             // points solved from zero, one per segment unless continuation failed
+        int segments = 0;
+    };
+
+    static Sweep parse(const Netlist &netlist, const std::vector<std::string> &args);
+    static void apply(Netlist &netlist, const Sweep &sweep, double value);     // set the target to value in place
+
+    DCSweep(const Netlist &netlist, const Sweep &sweep, const Simulator::Options &options);
+    DCSweep(const Netlist &netlist, const Sweep &sweep, const Simulator::Options &options, const Options &sweepOptions);
+
+    // one solution per grid point, the swept values stored in Waveforms::time
+    Simulator::Waveforms run();
+    const Statistics &getStatistics() const { return _stats; }
+
+private:
+    const Netlist &_netlist;
+    Sweep _sweep;
+    Simulator::Options _options;
+    Options _sweepOptions;
+    Statistics _stats;
+
+    void _runSegment(size_t first, size_t last, Simulator::Waveforms &result, Statistics &stats, int threads) const;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef _DENSE_HPP_
+#define _DENSE_HPP_
+
+#include <cstddef>
+#include <vector>
+
+// LU with partial pivoting for small circuits, where the bookkeeping of the sparse factors
+// costs more than the arithmetic. The matrix is row-major and padded with identity rows up to
+// the next of 8, 16, 32 or 64 so that every size runs a kernel with the dimension fixed at
+// compile time: the loops have constant bounds and the factors (at most 32 KiB) stay in cache.
+class DenseLU {
+public:
+    static const int MAX_SIZE = 64;
+
+    explicit DenseLU(int size);
+
+    int size() const { return _size; }
+    int stride() const { return _padded; }      // row stride of the values passed to factor()
+    size_t getMemory() const;                   // [B]
+
+    // values: size x size row-major with the given stride, e.g. SparseMatrix::data() when dense
+    void factor(const std::vector<double> &values);
+    void solve(std::vector<double> &rhs) const;
+    void solveTranspose(std::vector<double> &rhs) const;
+
+    // the factored values and then the pivot rows, e.g. to carry chord factors through a checkpoint
+    std::vector<double> getFactors() const;
+    void setFactors(const std::vector<double> &factors);
+
+private:
+    int _size, _padded;
+    std::vector<double> _lu;
+    std::vector<int> _pivot;
+    mutable std::vector<double> _work;
+
+    void (*_factor)(double *lu, int *pivot);
+    void (*_solve)(const double *lu, const int *pivot, double *x);
+    void (*_solveTranspose)(const double *lu, const int *pivot, double *x);
+};
+
+#endif
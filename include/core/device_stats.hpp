@@ -0,0 +1,57 @@
+#pragma once
+#ifndef _DEVICE_STATS_HPP_
+#define _DEVICE_STATS_HPP_
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+#include "netlist.hpp"
+
+// Per-FET counters of where a run spends its Newton iterations and timesteps, to find the few
+// instances behind most timestep cuts. The Simulator only collects them in builds configured
+// with -DCSIM_DEVICE_STATS=ON; otherwise every hook is an `if constexpr (ENABLED)` that compiles
+// to nothing.
+//
+// Residuals and truncation errors belong to nodes. They are blamed on the FET at that node (any
+// terminal) with the largest drain current in the last load.
+class DeviceStats {
+public:
+#ifdef CSIM_DEVICE_STATS
+    static constexpr bool ENABLED = true;
+#else
+    static constexpr bool ENABLED = false;
+#endif
+
+    struct Counters {
+        long evaluations = 0;       // model evaluations (switch level: plane changes)
+        long bypassed = 0;          // switch-level loads that reused the device's plane
+        long limited = 0;           // Newton steps cut by maxVoltageStep that moved Vgs or Vds by more
+        long worstResidual = 0;     // Newton iterations with the largest KCL residual at the device
+        long rejections = 0;        // rejected timesteps with the largest truncation error at the device
+    };
+
+    enum class Key { Evaluations, Bypassed, Limited, WorstResidual, Rejections };
+    static const char *getName(Key key);
+
+    void attach(const Netlist &netlist);                // one counter per flat FET
+    void reset();
+    void add(const DeviceStats &other);                 // same netlist
+
+    Counters &operator[](size_t fet) { return _counters[fet]; }
+    const std::vector<Counters> &get() const { return _counters; }
+    void setCurrent(size_t fet, double Id) { _current[fet] = Id; }
+    int blame(int node) const;                          // FET to blame for node, -1 if none
+
+    // at most count FETs with a nonzero key, largest first
+    std::vector<int> top(Key key, size_t count) const;
+    // csv, one row per FET with any nonzero counter
+    void write(std::ostream &out, const Netlist &netlist) const;
+
+private:
+    std::vector<Counters> _counters;
+    std::vector<double> _current;                       // [A] |Id| in the last load
+    std::vector<int> _first, _fets;                     // FETs by node, CSR
+};
+
+#endif
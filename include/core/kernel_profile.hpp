@@ -0,0 +1,58 @@
+#pragma once
+#ifndef _KERNEL_PROFILE_HPP_
+#define _KERNEL_PROFILE_HPP_
+
+#include <array>
+#include <ostream>
+
+#include "perf_counters.hpp"
+
+// Hardware counters split by the phases of a Newton iteration, to tell compute-bound kernels
+// from memory-bound ones on real decks. The Simulator brackets each phase while a profile is
+// attached (setKernelProfile) and credits it with a unit count: FETs evaluated for Devices,
+// matrix entries (including fill) for Load, Factor and Solve. Per-unit rates are then
+// comparable across circuit sizes.
+//
+//   Devices    PlanarFET (or switch-level) evaluation and stamping
+//   Load       clearing the matrix, gmin, resistors, capacitors and sources
+//   Factor     sparse or dense LU
+//   Solve      triangular solves with refinement, or GMRES
+//
+// Counters belong to the thread that created the profile, so it only covers a Simulator run
+// on that thread; partitioned blocks solved by workers are not included. Without counters
+// (see PerfCounters) the phases still get calls and wall time.
+class KernelProfile {
+public:
+    enum class Phase { Devices, Load, Factor, Solve };
+    static constexpr size_t PHASES = 4;
+    static const char *getName(Phase phase);
+
+    struct Totals {
+        long calls = 0;
+        double units = 0.0;                     // FETs or matrix entries, summed over calls
+        double seconds = 0.0;                   // [s]
+        std::array<double, PerfCounters::EVENTS> counts = {};
+    };
+
+    bool hasCounters() const { return _counters.available(); }
+    bool hasEvent(PerfCounters::Event event) const { return _counters.has(event); }
+    const std::string &getError() const { return _counters.error(); }
+
+    void begin() { _start = _counters.read(); }
+    void end(Phase phase, double units);        // credit everything since begin() to phase
+    void reset();
+
+    const Totals &get(Phase phase) const { return _totals[size_t(phase)]; }
+    double getIpc(Phase phase) const;           // instructions per cycle, 0 without both counters
+    double getPerUnit(Phase phase, PerfCounters::Event event) const;
+
+    // csv, one row per phase that ran. counters that are not available are left empty
+    void write(std::ostream &out) const;
+
+private:
+    PerfCounters _counters;
+    PerfCounters::Sample _start;
+    std::array<Totals, PHASES> _totals;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+#ifndef _KRYLOV_HPP_
+#define _KRYLOV_HPP_
+
+#include <memory>
+#include <vector>
+
+#include "matrix.hpp"
+#include "threadpool.hpp"
+
+// Restarted GMRES for matrices too large to factor exactly. The matrix is finalized without
+// fill, so the SparseLU of it is an ILU(0) factorization that is applied as a right
+// preconditioner. Matrix-vector products are split into row ranges over a thread pool once the
+// matrix is large enough to pay for the hand-off.
+class KrylovSolver {
+public:
+    struct Options {
+        int restart = 40;               // Krylov basis size before a restart
+        int maxIterations = 400;        // total over all restarts
+        double tolerance = 1e-8;       // residual norm relative to the right hand side
+    };
+
+    KrylovSolver(const SparseMatrix &matrix, const SparseLU &preconditioner, const Options &options, int threads);
+
+    // solves A x = rhs starting from the guess in x, returns the iterations used or -1 if the
+    // residual did not drop below the tolerance
+    int solve(const std::vector<double> &rhs, std::vector<double> &x);
+
+    size_t getMemory() const;           // [B] basis, Hessenberg matrix and work vectors
+
+private:
+    const SparseMatrix &_matrix;
+    const SparseLU &_preconditioner;
+    Options _options;
+    std::unique_ptr<ThreadPool> _pool;
+
+    std::vector<std::vector<double>> _basis;
+    std::vector<std::vector<double>> _hessenberg;
+    std::vector<double> _cos, _sin, _g, _w, _z;
+
+    void _multiply(const std::vector<double> &x, std::vector<double> &y);
+    double _residual(const std::vector<double> &rhs, const std::vector<double> &x, std::vector<double> &r);
+};
+
+#endif
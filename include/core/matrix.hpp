@@ -0,0 +1,109 @@
+#pragma once
+#ifndef _MATRIX_HPP_
+#define _MATRIX_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+// Square sparse matrix with a pattern that is fixed once finalize() is called. Entries are
+// declared with reserve() while the circuit is being set up; finalize() then picks a
+// fill-reducing (minimum degree) elimination order, computes the fill pattern and records the
+// elimination schedule so that numeric factorization is a flat loop over precomputed slots.
+//
+// finalize(false) keeps the reserved pattern in natural order instead. The schedule then drops
+// every update that would create fill, so SparseLU computes an ILU(0) preconditioner with the
+// memory of the matrix itself (see KrylovSolver).
+//
+// finalizeDense() lays the values out as a plain row-major array instead, for DenseLU. It may
+// follow finalize(), e.g. once nonZeros() has shown that the factors would be nearly full.
+//
+// getPatternHash() identifies the reserved pattern before finalize(), so SymbolicCache can
+// restore the order and schedule of a circuit it has seen instead of computing them again.
+class SparseMatrix {
+private:
+    int _size;
+    bool _finalized;
+    int _stride;                            // row stride of a dense layout, 0 when sparse
+    std::vector<std::set<int>> _reserved;   // structural pattern, only valid during setup
+    std::vector<bool> _hasDiagonal;
+
+    std::vector<int> _perm, _iperm;         // elimination order and its inverse
+    std::vector<int> _rowPtr, _colIdx;      // permuted CSR pattern including fill
+    std::vector<int> _diag;                 // slot of the diagonal entry of each permuted row
+
+    std::vector<int> _pivotPtr;             // per pivot range into _lower/_upper
+    std::vector<int> _lower, _upper;        // slots of L(:,k) and U(k,:) for each pivot k
+    std::vector<int> _opPtr, _ops;          // update targets for each (i, j) pair of pivot k
+
+    std::vector<double> _values;            // one extra sink slot collects dropped fill without fill
+    size_t _symbolicPeak = 0;               // [B] heap held by finalize() at its largest
+
+    int _find(int row, int col) const;
+    int _search(int row, int col) const;
+
+public:
+    explicit SparseMatrix(int size = 0);
+
+    void reserve(int row, int col);
+    void finalize(bool fill = true);
+    void finalizeDense(int stride);
+    uint64_t getPatternHash(bool fill = true) const;    // of the reserved pattern, before finalize()
+
+    int getSlot(int row, int col) const;
+    int size() const { return _size; }
+    int nonZeros() const { return int(_colIdx.size()); }
+    bool isFinalized() const { return _finalized; }
+    bool isDense() const { return _stride > 0; }
+    const std::vector<double> &data() const { return _values; }
+    size_t getMemory() const;                           // [B] pattern, schedule and values
+    size_t getSymbolicPeak() const { return _symbolicPeak; }  // [B] including finalize()'s temporaries
+
+    // y = A x for the (permuted) rows [first, last), so row ranges can be handed to threads
+    void multiply(const std::vector<double> &x, std::vector<double> &y, int first, int last) const;
+    void multiplyTranspose(const std::vector<double> &x, std::vector<double> &y) const;   // y = A^T x
+
+    void clear();
+    void add(int slot, double value) { if (slot >= 0) _values[slot] += value; }
+    double get(int slot) const { return slot >= 0 ? _values[slot] : 0.0; }
+
+    friend class SparseLU;
+    friend class SymbolicCache;
+};
+
+// LU factors of a finalized SparseMatrix. Owns its own value storage so the matrix can be
+// reloaded while the factors are still in use. In single precision the factors are computed
+// and stored as float, which halves the memory they stream through; the triangular solves
+// still accumulate in double, and callers recover full accuracy by iterative refinement.
+class SparseLU {
+private:
+    const SparseMatrix *_matrix;
+    bool _single;
+    std::vector<double> _lu;
+    std::vector<float> _luSingle;
+    mutable std::vector<double> _work;
+
+    template <typename T> void _factor(std::vector<T> &lu);
+    template <typename T> void _solve(const std::vector<T> &lu, std::vector<double> &rhs) const;
+    template <typename T> void _solveTranspose(const std::vector<T> &lu, std::vector<double> &rhs) const;
+
+public:
+    explicit SparseLU(const SparseMatrix &matrix);
+
+    size_t getMemory() const;                           // [B] factors as allocated so far
+    size_t getProjectedMemory() const;                  // [B] once factor() has run
+
+    void setSinglePrecision(bool single);
+    bool isSinglePrecision() const { return _single; }
+
+    void factor();
+    void solve(std::vector<double> &rhs) const;
+    void solveTranspose(std::vector<double> &rhs) const;
+
+    // the factored values (widened in single precision), e.g. to carry chord factors through a checkpoint
+    std::vector<double> getFactors() const;
+    void setFactors(const std::vector<double> &factors);
+};
+
+#endif
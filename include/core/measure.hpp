@@ -0,0 +1,87 @@
+#pragma once
+#ifndef _MEASURE_HPP_
+#define _MEASURE_HPP_
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "simulator.hpp"
+
+// Online evaluation of .measure statements. Every accepted transient point is fed to accept()
+// and each statement folds the new segment into a handful of running values, so delay, slew,
+// average/peak power and energy come out of a run without the waveforms ever being stored.
+//
+//   .measure tran <name> trig <sig> val=<v> [td=<t>] [rise|fall|cross=<n>]
+//                        targ <sig> val=<v> [td=<t>] [rise|fall|cross=<n>]
+//   .measure tran <name> when <sig>=<v> [td=<t>] [rise|fall|cross=<n>]
+//   .measure tran <name> find <sig> at=<t>
+//   .measure tran <name> avg|max|min|pp|rms|integ <sig> [from=<t>] [to=<t>]
+//
+// Signals are v(node), v(node,node), i(vsource) and p(name). p() of a FET uses
+// PlanarFET::getInstantaneousPower, p() of a voltage source is the power it delivers, and any
+// other name sums every FET below that hierarchical prefix ("x1" covers "x1.m1", "x1.x2.m3").
+class MeasureEngine {
+public:
+    struct Result {
+        std::string name;
+        double value;
+        bool valid;
+    };
+
+    explicit MeasureEngine(const Simulator &simulator);
+
+    void add(const std::vector<std::string> &args);
+    bool empty() const { return _statements.empty(); }
+
+    void accept(double time, const std::vector<double> &x);
+    void reset();                       // forget every folded value, to measure another run
+    std::vector<double> getState() const;               // folded values as flat doubles, for transient snapshots
+    void setState(const std::vector<double> &state);
+    std::vector<Result> getResults() const;
+
+private:
+    struct Signal {
+        enum class Kind { Voltage, Current, Power } kind;
+        int a, b;                       // voltage: +/- unknowns, current: branch unknown
+        std::vector<int> fets, sources; // power
+    };
+
+    struct Crossing {
+        int signal = -1;                // -1 for a fixed time trigger
+        double value = 0.0;
+        int edge = 0;                   // +1 rise, -1 fall, 0 either
+        int count = 1;
+        double td = 0.0;
+        int seen = 0;
+        double time = std::numeric_limits<double>::quiet_NaN();
+    };
+
+    struct Statement {
+        enum class Kind { Delay, When, Find, Avg, Max, Min, PP, Rms, Integ } kind;
+        std::string name;
+        int signal = -1;
+        Crossing trig, targ;
+        double from = 0.0, to = std::numeric_limits<double>::infinity(), at = 0.0;
+
+        double integral = 0.0, integralSq = 0.0, span = 0.0;
+        double max = -std::numeric_limits<double>::infinity(), min = std::numeric_limits<double>::infinity();
+        double found = std::numeric_limits<double>::quiet_NaN();
+    };
+
+    const Simulator &_sim;
+    std::vector<std::string> _signalNames;
+    std::vector<Signal> _signals;
+    std::vector<Statement> _statements;
+
+    bool _started;
+    double _time;
+    std::vector<double> _values, _prevValues;
+
+    int _getSignal(const std::string &name);
+    double _evaluate(const Signal &signal, const std::vector<double> &x) const;
+    void _parseCrossing(Crossing &crossing, const std::vector<std::string> &args, size_t &pos, const std::string &name);
+    static void _updateCrossing(Crossing &crossing, double t0, double v0, double t1, double v1);
+};
+
+#endif
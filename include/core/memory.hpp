@@ -0,0 +1,71 @@
+#pragma once
+#ifndef _MEMORY_HPP_
+#define _MEMORY_HPP_
+
+#include <array>
+#include <cstddef>
+#include <ostream>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Heap bytes held per subsystem, to predict whether a run fits its memory reservation. Owners
+// measure their containers (getMemory()), nothing hooks the allocator: a measurement counts
+// capacities, not sizes, and leaves out malloc's own per-block overhead. Hash and tree nodes
+// are counted with the layout of libstdc++.
+//
+//   Elements   netlist element tables, instance and element names, model cards, control cards
+//   Nodes      node interning: node names and the name -> id maps
+//   Matrix     Jacobian pattern including fill, elimination schedule, values and stamp slots
+//   Factors    LU values (sparse, dense or ILU(0)) and GMRES work space
+//   Models     per-FET caches: charge history, switch-level tables and planes, chord regions
+//   Waveforms  transient points kept in memory
+//
+// record() takes one measurement as the current holding and raises the peaks, per subsystem
+// and of the total at that moment.
+class MemoryReport {
+public:
+    enum class Subsystem { Elements, Nodes, Matrix, Factors, Models, Waveforms };
+    static constexpr size_t SUBSYSTEMS = 6;
+    static const char *getName(Subsystem subsystem);
+
+    struct Usage {
+        std::array<size_t, SUBSYSTEMS> bytes = {};
+        size_t &operator[](Subsystem subsystem) { return bytes[size_t(subsystem)]; }
+        size_t operator[](Subsystem subsystem) const { return bytes[size_t(subsystem)]; }
+        size_t getTotal() const;
+        Usage &operator+=(const Usage &other);
+    };
+
+    void record(const Usage &usage);
+    const Usage &getCurrent() const { return _current; }
+    const Usage &getPeak() const { return _peak; }       // of each subsystem on its own
+    size_t getPeakTotal() const { return _peakTotal; }  // largest total of one record()
+    long getRecords() const { return _records; }
+
+    // "subsystem,current,peak" rows, then the totals
+    void write(std::ostream &out) const;
+    static std::string format(size_t bytes);           // e.g. "12.4 MB"
+
+    // what the heap holds for a container
+    template <typename T> static size_t bytes(const std::vector<T> &values) { return values.capacity() * sizeof(T); }
+    static size_t bytes(const std::string &text);       // 0 while it fits the small string buffer
+    static size_t bytes(const std::vector<std::string> &texts);
+    static size_t bytes(const std::unordered_map<std::string, int> &map);
+    static size_t bytes(const std::vector<std::set<int>> &sets);
+    static size_t setNodeBytes();                       // one std::set<int> entry
+
+    // rows of Simulator::Waveforms for points accepted points of width unknowns
+    static size_t waveformBytes(size_t points, size_t width);
+
+    // the process's resident set high-water mark (VmHWM), 0 where /proc does not have it
+    static size_t getProcessPeak();
+
+private:
+    Usage _current, _peak;
+    size_t _peakTotal = 0;
+    long _records = 0;
+};
+
+#endif
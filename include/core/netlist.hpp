@@ -2,6 +2,201 @@
 #ifndef _NETLIST_HPP_
 #define _NETLIST_HPP_
 
+#include <filesystem>
+#include <istream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "memory.hpp"
+#include "models.hpp"
+#include "planar_fet.hpp"
+#include "source.hpp"
+
+// Hierarchical circuit description. Every .subckt body is stored once as a definition with
+// its own local node ids (0 is ground, 1..ports are the ports) and X cards are kept as light
+// references into it. The simulator sees the flat view: node names are interned to integer ids
+// (0 is ground) and elements are kept in one table per element type so they can be stamped
+// without any string handling.
+//
+// The flat tables are built lazily the first time they are asked for. An expanded definition
+// lays out its own elements first and then the expansion of each instance in order, so every
+// instance owns one contiguous slice of each table. Hierarchical names such as "x1.x2.m3" are
+// never stored per element; they are reconstructed from the slice offsets on demand.
+class Netlist {
+public:
+    struct FetInstance {
+        int d, g, s;                    // drain, gate and source node ids
+        double W;                       // [m] channel width
+        ModelUtils::DevType devType;
+        int tech;                       // index into the netlist's technology table
+    };
+
+    struct ResistorInstance {
+        int a, b;
+        double R;                       // [ohm]
+    };
+
+    struct CapacitorInstance {
+        int a, b;
+        double C;                       // [F]
+    };
+
+    struct VSourceInstance {
+        int p, n;
+        Source::Waveform wave;
+    };
+
+    struct Analysis {
+        std::string type;               // control card without the leading dot, e.g. "tran"
+        std::vector<std::string> args;
+    };
+
+    // sizes of an expansion, also used as offsets into the flat tables (nodes count non-ground
+    // node ids minus one)
+    struct Counts {
+        int nodes = 0, fets = 0, resistors = 0, capacitors = 0, vsources = 0;
+
+        Counts operator+(const Counts &other) const;
+    };
+
+    // slice of the flat tables owned by one subcircuit instance
+    struct Block {
+        Counts first, size;
+    };
+
+    static const int GROUND = 0;
+
+    Netlist();
+
+    static double parseValue(const std::string &token);
+    static std::vector<double> parseRange(const std::string &start, const std::string &stop, const std::string &step, const std::string &where);    // start, start + step, ... up to stop
+    static Source::Waveform parseWaveform(const std::vector<std::string> &tokens, const std::string &where);    // "1.8", "pwl(...)", ...
+    static PlanarFET::Tech parseModelCard(const std::vector<std::string> &tokens, const std::string &where);
+    static Netlist read(const std::filesystem::path &path, const std::vector<std::filesystem::path> &techfiles = {});
+    void readTechfile(const std::filesystem::path &path);
+    void parse(std::istream &stream, const std::string &origin = "<stream>");
+    const std::vector<std::string> &getSources() const { return _sources; }   // techfiles, the deck and its .includes
+
+    // elements and nodes are added to the open .subckt, or to the top level outside of one
+    void beginSubckt(const std::string &name, const std::vector<std::string> &ports);
+    void endSubckt();
+    void addInstance(const std::string &name, const std::vector<std::string> &nodes, const std::string &subckt);
+
+    int addNode(const std::string &name);
+    int findNode(const std::string &name) const;        // accepts hierarchical names, -1 if unknown
+    std::string getNodeName(int node) const;
+    int getNodeCount() const;
+
+    int addTech(const std::string &name, const PlanarFET::Tech &tech);
+    int findTech(const std::string &name) const;
+    const PlanarFET::Tech &getTech(int tech) const { return _techs[tech]; }
+    const std::string &getTechName(int tech) const { return _techNames[tech]; }
+    int getTechCount() const { return int(_techs.size()); }
+
+    void addFet(const std::string &name, const std::string &d, const std::string &g, const std::string &s, double W, ModelUtils::DevType devType, int tech);
+    void addResistor(const std::string &name, const std::string &a, const std::string &b, double R);
+    void addCapacitor(const std::string &name, const std::string &a, const std::string &b, double C);
+    void addVSource(const std::string &name, const std::string &p, const std::string &n, const Source::Waveform &wave);
+    void addAnalysis(const std::string &type, const std::vector<std::string> &args);
+
+    const std::vector<FetInstance> &getFets() const { _flatten(); return _fets; }
+    const std::vector<ResistorInstance> &getResistors() const { _flatten(); return _resistors; }
+    const std::vector<CapacitorInstance> &getCapacitors() const { _flatten(); return _capacitors; }
+    const std::vector<VSourceInstance> &getVSources() const { _flatten(); return _vsources; }
+    const std::vector<Analysis> &getAnalyses() const { return _analyses; }
+
+    // hierarchical names of flat elements, and the reverse lookups (-1 if unknown)
+    std::string getFetName(int fet) const;
+    std::string getResistorName(int resistor) const;
+    std::string getCapacitorName(int capacitor) const;
+    std::string getVSourceName(int vsource) const;
+    int findFet(const std::string &name) const;
+    int findCapacitor(const std::string &name) const;
+    int findVSource(const std::string &name) const;
+    bool findInstance(const std::string &path, Block &block) const;
+
+    int getSubcktCount() const { return int(_defs.size()) - 1; }
+    std::vector<std::string> getSubcktPorts(const std::string &subckt) const;    // empty if unknown
+    int getInstanceCount() const;                       // subcircuit instances after expansion
+
+    // adds what the netlist holds to the Elements and Nodes subsystems, flat view included
+    void getMemory(MemoryReport::Usage &usage) const;
+
+    // mutable access for parameter stepping and sensitivity checks. edits to the flat view are
+    // lost if elements are added afterwards.
+    FetInstance &getFet(int fet) { _flatten(); return _fets[fet]; }
+    CapacitorInstance &getCapacitor(int capacitor) { _flatten(); return _capacitors[capacitor]; }
+    VSourceInstance &getVSource(int vsource) { _flatten(); return _vsources[vsource]; }
+    PlanarFET::Tech &getTech(int tech) { return _techs[tech]; }
+
+private:
+    struct SubcktInstance {
+        std::string name;
+        std::string subckt;
+        mutable int def;                // resolved by _elaborate
+        std::vector<int> nodes;         // local node ids in the parent definition
+    };
+
+    struct Definition {
+        std::string name;
+        int ports;
+        std::unordered_map<std::string, int> nodeIds;
+        std::vector<std::string> nodeNames;             // local ids: ground, ports, internal nodes
+
+        std::vector<FetInstance> fets;                  // with local node ids
+        std::vector<ResistorInstance> resistors;
+        std::vector<CapacitorInstance> capacitors;
+        std::vector<VSourceInstance> vsources;
+        std::vector<std::string> fetNames, resistorNames, capacitorNames, vsourceNames;
+        std::vector<SubcktInstance> instances;
+        std::unordered_map<std::string, int> instanceIds;
+
+        // filled by _elaborate: offsets[j] is where instance j starts relative to the start of
+        // this definition, offsets[0] is the definition's own size and offsets.back() the total
+        mutable std::vector<Counts> offsets;
+        mutable int expandedInstances;
+
+        Counts own() const;
+    };
+
+    std::vector<std::string> _sources;
+    std::vector<Definition> _defs;                      // 0 is the top level
+    std::unordered_map<std::string, int> _defIds;
+    int _current;
+
+    std::unordered_map<std::string, int> _techIds;
+    std::vector<std::string> _techNames;
+    std::vector<PlanarFET::Tech> _techs;
+    std::vector<Analysis> _analyses;
+
+    // flat view, built on first use
+    mutable bool _elaborated, _flat;
+    mutable std::vector<FetInstance> _fets;
+    mutable std::vector<ResistorInstance> _resistors;
+    mutable std::vector<CapacitorInstance> _capacitors;
+    mutable std::vector<VSourceInstance> _vsources;
+
+    void _include(const std::filesystem::path &path);
+    void _parseCard(const std::vector<std::string> &tokens, const std::string &where);
+    static Source::Waveform _parseWaveform(const std::vector<std::string> &tokens, size_t first, const std::string &where);
+
+    int _addDefinition(const std::string &name);
+    int _addLocalNode(Definition &def, const std::string &name);
+    void _invalidate() { _elaborated = false; _flat = false; }
+
+    void _elaborate() const;
+    void _flatten() const;
+    void _expand(int def, const Counts &base, const std::vector<int> &ports, bool recurse) const;
+    void _rebuildIndex();
+    static int _globalNode(const Definition &def, const Counts &base, const std::vector<int> &ports, int local);
+
+    std::pair<int, int> _locate(int Counts::*field, int id, std::string &path) const;
+    bool _resolve(const std::string &path, int &def, Counts &base, std::vector<int> &ports) const;
+    int _findElement(const std::string &name, std::vector<std::string> Definition::*names, int Counts::*field) const;
+
+    friend class NetlistCache;
+};
 
 #endif
@@ -0,0 +1,35 @@
+#pragma once
+#ifndef _NETLIST_CACHE_HPP_
+#define _NETLIST_CACHE_HPP_
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "netlist.hpp"
+
+// Versioned binary image of a parsed netlist: technology cards, every definition's interned
+// node table and per-type element tables, and the control cards. The image records each
+// source file (techfiles, the deck and its .includes) with its size and content hash, and is
+// only used when all of them still match. A checksum closes the image, and a damaged or
+// inconsistent image is treated like a stale one. Element tables are copied straight out of
+// the mapped image, so a warm start does no text parsing at all.
+class NetlistCache {
+public:
+    static const uint32_t VERSION = 3;
+
+    // fills netlist and returns true when the image is valid for the given techfiles and design
+    static bool load(const std::filesystem::path &image, const std::filesystem::path &design, const std::vector<std::filesystem::path> &techfiles, Netlist &netlist);
+    static void save(const std::filesystem::path &image, const Netlist &netlist);
+
+    // load the image if it is current, otherwise parse the design and refresh the image. an
+    // image that cannot be written leaves the reason in error and is not fatal
+    static Netlist read(const std::filesystem::path &design, const std::vector<std::filesystem::path> &techfiles, const std::filesystem::path &image, bool *hit = nullptr, std::string *error = nullptr);
+
+private:
+    static uint64_t _hashFile(const std::string &path, uint64_t &size);
+    static bool _validate(const Netlist &netlist);
+};
+
+#endif
@@ -0,0 +1,121 @@
+#pragma once
+#ifndef _PARTITION_HPP_
+#define _PARTITION_HPP_
+
+#include <memory>
+#include <vector>
+
+#include "netlist.hpp"
+#include "simulator.hpp"
+#include "threadpool.hpp"
+
+// Splits a flat netlist into weakly coupled blocks. Nodes joined by a resistor, capacitor,
+// voltage source or FET channel (drain-source) belong to the same block. A FET gate draws no
+// DC current in the PlanarFET model, so gates are where blocks are cut: the block driving a
+// gate is levelized ahead of the block holding the channel. Feedback loops are broken at the
+// block with the fewest unresolved inputs.
+//
+// Rails, the nodes a source or a chain of sources ties to ground, are in no block. Their
+// voltage does not depend on the rest of the circuit, so every block only sees them as inputs.
+class Partition {
+public:
+    struct Block {
+        std::vector<int> nodes;         // non-ground node ids
+        std::vector<int> vsources;      // floating sources between two of its nodes
+        int level;                      // blocks only see gate inputs from lower levels, loops aside
+        int weight;                     // nodes plus elements touching them
+    };
+
+    struct Rail {
+        int node;
+        int source;                     // the source fixing node
+        int parent;                     // rail at the source's other terminal, -1 for ground
+    };
+
+    explicit Partition(const Netlist &netlist);
+
+    const std::vector<Block> &getBlocks() const { return _blocks; }
+    const std::vector<Rail> &getRails() const { return _rails; }       // parents ahead of their children
+    int getBlockOf(int node) const { return _blockOf[node]; }   // -1 for ground and rails
+    int getLevelCount() const { return _levels; }
+
+private:
+    std::vector<Block> _blocks;
+    std::vector<Rail> _rails;
+    std::vector<int> _blockOf;
+    int _levels;
+
+    void _levelize(const Netlist &netlist);
+};
+
+// Solves one Newton problem of a Simulator block by block. Blocks of the same level are
+// packed into at most `threads` groups, and each group gets its own sub-netlist and Simulator
+// (and so its own matrix). Nodes outside the group are held by ideal sources at their latest
+// value. Levels are swept in order (Gauss-Seidel between levels, Jacobi within one) until a
+// full sweep no longer moves any unknown beyond the Newton tolerance. Rails are solved once
+// before the sweeps, and their sources' currents are summed from the groups afterwards.
+//
+// With Options::multirate every block gets its own group and latent groups are frozen: after
+// each accepted step a group whose nodes slew slower than latencySlew and whose devices'
+// getTransientCurrent changed by less than latencyCurrent for two steps in a row stops being
+// solved. It is woken as soon as one of its boundary nodes moves by latencyWake from the
+// value it was frozen at. Groups holding time-varying sources never freeze.
+class PartitionedSolver {
+public:
+    PartitionedSolver(const Simulator &simulator, const Partition &partition, int threads);
+    ~PartitionedSolver();
+
+    int getGroupCount() const { return int(_groups.size()); }
+
+    int getLatentCount() const;
+    void getMemory(MemoryReport::Usage &usage, bool projected) const;    // every group, see Simulator::getMemory
+
+    // returns false if a block diverges or the sweeps do not settle, x is then left unchanged
+    bool solve(std::vector<double> &x, const std::vector<double> *xPrev, double h, double time, Simulator::Statistics &stats);
+
+    // update block latency after the transient accepted x (previous point xPrev, step h)
+    void accept(const std::vector<double> &x, const std::vector<double> &xPrev, double h);
+    void wakeAll();
+
+    // latency bookkeeping of every group as flat values, for transient snapshots. empty wakes
+    // every group and forgets its device currents, as for a fresh transient
+    std::vector<double> getLatencyState() const;
+    void setLatencyState(const std::vector<double> &state);
+
+    // chord factors of every group's simulator, empty drops them all
+    std::vector<double> getChordState() const;
+    void setChordState(const std::vector<double> &state);
+
+private:
+    struct Group {
+        std::unique_ptr<Netlist> netlist;
+        std::unique_ptr<Simulator> sim;
+        int level;
+        std::vector<int> unknowns;                  // global unknown of every local unknown
+        std::vector<char> owned;                    // local unknown is solved by this group
+        std::vector<std::pair<int, int>> boundary;  // (local source, global unknown) holding an outside node
+        std::vector<std::pair<int, int>> draws;     // (local unknown, rail) of boundary sources on rails
+        std::vector<double> x, xPrev;
+        bool converged;
+
+        // latency state
+        bool dynamic;                               // holds a time-varying source, never frozen
+        bool latent;
+        int quietSteps;
+        std::vector<double> currents;               // device transient currents at the last accepted point
+        std::vector<double> frozenInputs;           // boundary values when the group was frozen
+    };
+
+    const Simulator &_sim;
+    std::vector<Group> _groups;
+    std::vector<std::vector<int>> _levels;          // groups per level
+    std::vector<Partition::Rail> _rails;
+    int _railGroup = -1;                            // solved once ahead of the sweeps
+    std::unique_ptr<ThreadPool> _pool;
+
+    void _solveGroup(Group &group, const std::vector<double> &snapshot, std::vector<double> &x, const std::vector<double> *xPrev, double h, double time);
+    bool _wakes(const Group &group, const std::vector<double> &snapshot) const;
+    void _sumRailCurrents(std::vector<double> &x) const;
+};
+
+#endif
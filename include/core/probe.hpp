@@ -0,0 +1,93 @@
+#pragma once
+#ifndef _PROBE_HPP_
+#define _PROBE_HPP_
+
+#include <ostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "simulator.hpp"
+
+// Selective transient output. Instead of every unknown at every accepted step, --output gets
+// only the signals picked by .probe cards, each decimated as the transient runs.
+//
+//   .probe [tol=<abs>] [step=<t>] <signal> ...
+//
+// Signals are v(pattern), v(node,node), i(pattern) and p(pattern). Patterns are hierarchical
+// names where '*' matches within one level, '**' across levels and '?' one character, so
+// v(x1.*) is every node directly in x1 and p(**) every device. i() covers voltage sources (the
+// branch current), FETs (PlanarFET::getTransientCurrent into the drain) and capacitors. p()
+// covers FETs (PlanarFET::getInstantaneousPower) and voltage sources (power delivered).
+//
+// tol= keeps a signal's stored points such that the straight lines between them stay within
+// tol of every accepted point. Each signal runs a swing door: the slopes from its last stored
+// point that fit every later sample narrow with each point, and when no slope fits the last
+// sample the segment is closed and stored. Flat stretches collapse to their two ends while
+// edges keep their corners. step= first resamples the signal onto a fixed grid, which can miss
+// pulses shorter than the step. Without either option every accepted point is stored. A signal
+// matched by several cards keeps the options of the first.
+//
+// Rows are "signal,time,value" in the order the points are stored, ascending in time per
+// signal. Only the state of the open segment is kept, one per signal.
+class ProbeWriter {
+public:
+    struct Options {
+        double tol = 0.0;               // [signal unit] piecewise-linear error bound, 0 keeps every point
+        double step = 0.0;              // [s] output grid, 0 for the accepted points themselves
+    };
+
+    // '*' within one hierarchy level, '**' across levels, '?' one character
+    static bool match(const std::string &pattern, const std::string &name);
+
+    explicit ProbeWriter(const Simulator &simulator);
+
+    void add(const std::vector<std::string> &args);     // arguments of one .probe card
+    bool empty() const { return _signals.empty(); }
+    size_t getSignalCount() const { return _signals.size(); }
+    const std::string &getName(size_t signal) const { return _names[signal]; }
+
+    static void writeHeader(std::ostream &out);
+    void accept(double time, const std::vector<double> &x, std::ostream &out);
+    void finish(std::ostream &out);                     // store the open segment of every signal
+    void reset();                                       // start over for another transient
+    std::vector<double> getState() const;               // open segments as flat doubles, for transient snapshots
+    void setState(const std::vector<double> &state);
+
+    long getSamples() const { return _samples; }        // signal values seen
+    long getStored() const { return _stored; }          // points written
+
+private:
+    struct Signal {
+        enum class Kind { Voltage, SourceCurrent, FetCurrent, CapacitorCurrent, FetPower, SourcePower } kind;
+        int element;                    // source, FET or capacitor
+        int a, b;                       // voltage: +/- unknowns
+        Options options;
+
+        long grid;                      // index of the next grid point
+        double sampleTime, sampleValue; // last accepted sample, to interpolate grid points
+        bool anchored, pending;
+        double anchorTime, anchorValue; // last stored point
+        double pendingTime, pendingValue;               // last sample, not stored yet
+        double low, high;               // slopes from the anchor within tol of every sample since
+    };
+
+    const Simulator &_sim;
+    std::vector<std::string> _names;
+    std::unordered_set<std::string> _known;
+    std::vector<Signal> _signals;
+
+    bool _started;
+    double _time;
+    std::vector<double> _x;             // previous accepted point, for device currents
+    long _samples, _stored;
+
+    void _addSignal(const std::string &name, Signal signal);
+    double _evaluate(const Signal &signal, double time, const std::vector<double> &x) const;
+    void _sample(Signal &signal, size_t index, double time, double value, std::ostream &out);
+    void _decimate(Signal &signal, size_t index, double time, double value, std::ostream &out);
+    void _close(Signal &signal, size_t index, std::ostream &out);      // store the open segment's end
+    void _store(size_t index, double time, double value, std::ostream &out);
+};
+
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+#ifndef _REDUCTION_HPP_
+#define _REDUCTION_HPP_
+
+#include <string>
+#include <vector>
+
+#include "netlist.hpp"
+
+// TICER reduction of linear RC parasitics. A node that only resistors and capacitors touch
+// (no FET terminal, no source, not probed by an analysis card) is eliminated when its time
+// constant C/G is below the accuracy bound: it settles much faster than anything the
+// simulation resolves, so it can be folded into its neighbours. Eliminating node n with
+// conductances g_i and capacitances c_i to its neighbours i adds g_i g_j / G between every
+// pair of neighbours and spreads its charge as (g_i c_j + g_j c_i) / G, which keeps the Elmore
+// delays through the network. Nodes are taken fastest first and the degree limit bounds the
+// fill of every elimination.
+class RCReduction {
+public:
+    struct Options {
+        double tau = 1e-12;                 // [s] nodes with C/G below this are eliminated
+        int maxDegree = 6;                  // neighbours (ground aside) a node may have to be eliminated
+        std::vector<std::string> keep;      // extra node names to preserve
+    };
+
+    struct Report {
+        int nodesBefore, nodesAfter;
+        int resistorsBefore, resistorsAfter;
+        int capacitorsBefore, capacitorsAfter;
+    };
+
+    // flat copy of the netlist with the quick RC nodes eliminated. elements that survive
+    // unchanged keep their names, merged and filled ones are named r~<k> and c~<k>.
+    static Netlist reduce(const Netlist &netlist, const Options &options, Report *report = nullptr);
+};
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef _SENSITIVITY_HPP_
+#define _SENSITIVITY_HPP_
+
+#include <string>
+#include <vector>
+
+#include "simulator.hpp"
+
+// Adjoint sensitivity analysis. For an objective that depends on one output of a converged dc
+// or transient solution, a single backward pass of transposed solves with the Jacobians of the
+// forward run yields the derivative with respect to every FET width and every technology
+// parameter at once, instead of one perturbed simulation per parameter. The accepted timesteps
+// are held fixed, so a crossing time is differentiated through its interpolation on the step
+// that brackets it.
+class Sensitivity {
+public:
+    enum class Measure {
+        Final,          // output value at the last point of the solution
+        Integral,       // output integrated over the transient (backward Euler consistent)
+        Crossing        // time of the output's first crossing of a threshold, either direction
+    };
+
+    struct TechGradient {
+        double L, Tox, Lovl, Vt, MUn, MUp, LAMBDA, BETA;
+    };
+
+    struct Gradient {
+        double value;                       // objective value
+        std::vector<double> W;              // d(objective)/dW for every FET, in netlist order
+        std::vector<TechGradient> tech;     // d(objective)/d(param) for every netlist technology
+    };
+
+    explicit Sensitivity(Simulator &simulator);
+
+    Gradient solveOperatingPoint(int output, const std::vector<double> &x);
+    Gradient solveTransient(int output, Measure measure, const Simulator::Waveforms &waves, double threshold = 0.0);
+
+private:
+    Simulator &_sim;
+
+    Gradient _emptyGradient() const;
+    void _accumulate(Gradient &grad, int fet, const PlanarFET::Derivatives &d, double weight) const;
+    void _accumulateParameters(Gradient &grad, const std::vector<double> &lambda, const std::vector<double> &x, const std::vector<double> *xPrev, double h) const;
+    void _historyProduct(std::vector<double> &carry, const std::vector<double> &lambda, const std::vector<double> &xPrev, double h) const;
+    void _solveAdjoint(std::vector<double> &lambda, const std::vector<double> &x, const std::vector<double> *xPrev, double h, double time);
+};
+
+#endif
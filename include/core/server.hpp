@@ -0,0 +1,73 @@
+#pragma once
+#ifndef _SERVER_HPP_
+#define _SERVER_HPP_
+
+#include <filesystem>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "netlist.hpp"
+#include "simulator.hpp"
+
+// Request handling of csim-server. Techfiles are read once at startup and every design starts
+// from them. Designs stay loaded between requests: the parsed netlist, its technologies and a
+// Simulator whose matrix pattern, stamp slots and fill-reducing ordering were worked out once,
+// so a request only pays for the numeric work. Requests are one line
+// each, case insensitive apart from paths, and any number of them may be sent back to back.
+// Each is answered by its result lines and then "ok" or "error <message>":
+//
+//   load <design> <path> [techfile ...]      read a deck, replacing a design of that name
+//   deck <design>                            the lines up to ".end" are the deck
+//   set <design> <target> <value>            <vsource>, w(<fet>), c(<capacitor>) or <param>(<tech>)
+//   source <design> <vsource> <waveform>     new stimulus, e.g. pwl(0 0 1n 1.8)
+//   corner <design> [vdd=<v>] [supply=<vsource>] [dvt=<v>] [mu=<scale>]
+//                                            technologies relative to the deck as loaded
+//   reset <design>                           undo every set, source and corner
+//   measure <design> <.measure arguments>    measured by every following tran
+//   op <design>                              "x <name> <value>" per unknown
+//   tran <design> <tstep> <tstop> [<output> ...]
+//                                            "columns time <output> ..." (every unknown by
+//                                            default), "t <time> <value> ..." per accepted
+//                                            point as it is accepted, "measure <name> <value>"
+//                                            or "measure <name> failed" per measurement
+//   stats <design>                           counters of the design's Simulator
+//   unload <design> | list | quit | shutdown
+//
+// Different designs are served concurrently, requests on one design are serialized.
+class SimulationServer {
+public:
+    SimulationServer(const Simulator::Options &options, const std::vector<std::filesystem::path> &techfiles);
+
+    // answers the requests read from in until quit, shutdown or the end of the stream. returns
+    // false after shutdown.
+    bool serve(std::istream &in, std::ostream &out);
+
+private:
+    struct Design {
+        std::mutex mutex;
+        std::unique_ptr<Netlist> netlist;
+        Netlist original;
+        std::unique_ptr<Simulator> sim;
+        std::vector<std::vector<std::string>> measures;
+        int unknowns;                                   // fixed at install, so list needs no design lock
+        size_t fets;
+    };
+
+    Simulator::Options _options;
+    Netlist _technologies;                              // empty deck with the startup techfiles read
+    std::mutex _mutex;                                  // guards _designs
+    std::map<std::string, std::shared_ptr<Design>> _designs;
+
+    void _install(const std::string &name, Netlist netlist);
+    std::shared_ptr<Design> _find(const std::string &name);
+    void _request(const std::vector<std::string> &tokens, std::istream &in, std::ostream &out);
+    static void _set(Design &design, const std::string &target, double value);
+    static void _transient(Design &design, const std::vector<std::string> &args, std::ostream &out);
+};
+
+#endif
@@ -2,6 +2,254 @@
 #ifndef _SIMULATOR_HPP_
 #define _SIMULATOR_HPP_
 
+#include <array>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
 
+#include "dense.hpp"
+#include "device_stats.hpp"
+#include "kernel_profile.hpp"
+#include "krylov.hpp"
+#include "matrix.hpp"
+#include "netlist.hpp"
+#include "pwl_fet.hpp"
+
+class Checkpoint;
+class PartitionedSolver;
+class Stimulus;
+
+// Modified nodal analysis engine. Unknowns are the non-ground node voltages followed by one
+// branch current per voltage source. Each Newton iteration loads the residual f(x) (sum of
+// currents leaving every node, source branch equations) and its Jacobian, then solves
+// J dx = -f. Transient analysis uses backward Euler with local truncation error control.
+class Simulator {
+public:
+    enum class LinearSolver {
+        Auto,           // direct below iterativeThreshold unknowns, iterative above
+        Direct,         // sparse LU with fill-reducing ordering, dense LU for small nearly full matrices
+        Iterative       // ILU(0) preconditioned GMRES, see KrylovSolver
+    };
+
+    struct Options {
+        double gmin = 1e-12;            // [S] conductance from every node to ground
+        double reltol = 1e-3;           // relative Newton convergence tolerance
+        double vntol = 1e-6;            // [V] absolute Newton tolerance on node voltages
+        double abstol = 1e-12;          // [A] absolute Newton tolerance on branch currents
+        double trtol = 7.0;             // truncation error tolerance relative to the Newton tolerance
+        double maxVoltageStep = 0.5;    // [V] largest node voltage change per Newton iteration
+        int maxIterations = 100;        // per Newton solve
+        bool partition = false;         // solve channel-connected blocks separately, see Partition
+        int threads = 0;                // workers for partitioned solves and matrix products, 0 uses every core
+        int maxSweeps = 50;             // block relaxation sweeps before falling back to one matrix
+        bool multirate = false;         // freeze latent blocks during transients, implies partition
+        double latencySlew = 1e6;       // [V/s] node slew below which a block counts as quiet
+        double latencyCurrent = 1e-9;   // [A] device transient current change below which a block counts as quiet
+        double latencyWake = 1e-3;      // [V] boundary node movement that wakes a frozen block
+        LinearSolver linearSolver = LinearSolver::Auto;
+        int iterativeThreshold = 200000;    // unknowns from which Auto switches to the iterative solver
+        int denseThreshold = DenseLU::MAX_SIZE; // unknowns up to which the direct solver may go dense
+        double denseFill = 0.5;         // share of the n x n entries the sparse factors must fill to go dense
+        KrylovSolver::Options krylov;
+        bool mixedPrecision = false;    // factor in single precision, refine each solve in double
+        int refinementSteps = 3;        // most refinement passes per direct solve in mixed precision
+        bool switchLevel = false;       // piecewise-linear FET currents and per-region gate caps, see PwlFET
+        double switchStep = 0.05;       // [V] switch-level grid spacing
+        double switchRange = 2.5;       // [V] switch-level grid extent, extrapolated beyond
+        bool chord = false;             // keep LU factors across Newton iterations and timesteps, see Refactor
+        double chordContraction = 0.1;  // correction ratio between iterations on old factors that refactors
+        std::string symbolicCache;      // directory of matrix orderings by sparsity pattern, see SymbolicCache
+    };
+
+    // why chord Newton factored the Jacobian again. in transient steps on the smooth model, factors
+    // are otherwise kept for as long as Newton keeps converging on them, also into the next
+    // timestep: the residual is always the current one, so an old Jacobian only slows convergence.
+    enum class Refactor {
+        Fresh,          // no factors yet, or the parameters changed
+        Timestep,       // h changed
+        Region,         // a FET crossed into another PlanarFET::Region
+        Contraction,    // the last correction was over chordContraction times the one before
+        Limited         // the last correction was cut to maxVoltageStep
+    };
+    static const char *getName(Refactor reason);
+
+    struct Statistics {
+        int newtonIterations = 0;
+        int factorizations = 0;
+        int acceptedSteps = 0;
+        int rejectedSteps = 0;
+        int relaxationSweeps = 0;
+        int partitionFallbacks = 0;     // partitioned solves that had to be redone on the full matrix
+        long latentSkips = 0;           // block solves skipped because the block was frozen
+        long krylovIterations = 0;
+        long refinementSteps = 0;       // mixed precision refinement passes over all direct solves
+        long regionChanges = 0;         // switch-level FETs that moved to another triangle
+        int reusedFactorizations = 0;   // switch-level and chord Newton iterations solved with the previous factors
+        std::array<long, 5> refactors = {}; // chord factorizations by Refactor reason
+    };
+
+    struct Waveforms {
+        std::vector<double> time;
+        std::vector<std::vector<double>> x;
+    };
+
+    // integrator state at an accepted transient point, enough to continue the run bit for bit
+    struct TransientState {
+        double tstep, tstop;
+        double t, tPrev, h;
+        int history;                    // accepted points since the last breakpoint
+        int nextBreak;                  // index into the breakpoint list of tstop
+        std::vector<double> x, xPrev;
+        std::vector<double> warmStart;  // see the iterative solver
+        std::vector<double> latency;    // multirate block state, see PartitionedSolver::getLatencyState
+        std::vector<double> chord;      // chord factors and their bookkeeping, see _getChordState
+        Statistics stats;
+    };
+
+    // called with every accepted transient point, including the initial operating point
+    using StepCallback = std::function<void(double time, const std::vector<double> &x)>;
+
+    explicit Simulator(const Netlist &netlist);
+    Simulator(const Netlist &netlist, const Options &options);
+    ~Simulator();
+
+    int getSize() const { return _numNodes + _numBranches; }
+    int getNodeUnknowns() const { return _numNodes; }
+    int getNodeIndex(int node) const { return _unknown(node); }
+    int getIndex(const std::string &output) const;
+    std::string getName(int index) const;
+    double getSourcePower(int vsource, const std::vector<double> &x) const;   // [W] delivered by a voltage source at solution x
+    const Options &getOptions() const { return _options; }
+    const Statistics &getStatistics() const { return _stats; }
+    int getBlockGroups() const;                         // 0 unless the partitioned solver is active
+    bool isIterative() const { return bool(_krylov); }
+    bool isDense() const { return bool(_dense); }
+    bool isSymbolicCached() const { return _symbolicCached; }    // ordering came from Options::symbolicCache
+    const std::string &getSymbolicCacheError() const { return _symbolicCacheError; }   // why the ordering was not stored, empty if it was
+    const Netlist &getNetlist() const { return _netlist; }
+    const DeviceStats &getDeviceStats() const { return _deviceStats; }   // empty unless DeviceStats::ENABLED
+
+    std::vector<double> solveOperatingPoint(double time = 0.0);
+    // initial: a converged operating point to start from instead of solving one
+    Waveforms solveTransient(double tstep, double tstop, const StepCallback &onAccept = nullptr, bool storeWaveforms = true, const std::vector<double> *initial = nullptr);
+    // continue a transient from a snapshot, the snapshot's own point is not reported again
+    Waveforms resumeTransient(const TransientState &state, const StepCallback &onAccept = nullptr, bool storeWaveforms = true);
+
+    // call after W or a technology was edited in place in the netlist, other values are read on every load
+    void updateParameters();
+
+    // chord: one csv row per Newton iteration of full-matrix solves, whether it factored and why (null: none)
+    void setChordLog(std::ostream *log);
+
+    // adds the Matrix, Factors and Models subsystems, partitioned blocks (with their netlists)
+    // included. projected counts the factors as they will be once factored, before any solve.
+    void getMemory(MemoryReport::Usage &usage, bool projected = false) const;
+    size_t getSymbolicPeak() const { return _jacobian.getSymbolicPeak(); }   // [B] matrix setup at its largest
+    // fewest points a transient can accept: one per tstep, plus the steps back up from tstep / 10
+    // after every breakpoint of the deck's sources (stimulus edges are only known while streaming)
+    size_t getMinimumPoints(double tstep, double tstop) const;
+
+    // counters by Newton phase for full-matrix solves on the profile's thread (null: none)
+    void setKernelProfile(KernelProfile *profile) { _profile = profile; }
+
+    // snapshots of the transient are offered to checkpoint after accepted points (null: none)
+    void setCheckpoint(Checkpoint *checkpoint) { _checkpoint = checkpoint; }
+
+    // a stimulus attached to this simulator's netlist. its edges and ramp ends are breakpoints of
+    // every transient, and operating points see its values at their time.
+    void addStimulus(Stimulus *stimulus);
+    const std::vector<Stimulus *> &getStimuli() const { return _stimuli; }
+
+private:
+    const Netlist &_netlist;
+    Options _options;
+    Statistics _stats;
+    int _numNodes, _numBranches;
+
+    SparseMatrix _jacobian;
+    SparseLU _lu;                                       // incomplete (ILU(0)) with the iterative solver
+    std::vector<double> _residual;
+    std::unique_ptr<DenseLU> _dense;
+    bool _symbolicCached = false;
+    std::string _symbolicCacheError;
+    std::unique_ptr<KrylovSolver> _krylov;
+    std::vector<double> _warmStart;                     // first Newton correction of the last solve
+    std::vector<double> _refineRhs, _refineCorrection;  // mixed precision work vectors
+
+    std::vector<int> _gminSlots;
+    std::vector<std::array<int, 4>> _resistorSlots;     // (a, a), (a, b), (b, a), (b, b)
+    std::vector<std::array<int, 4>> _capacitorSlots;    // (a, a), (a, b), (b, a), (b, b)
+    std::vector<std::array<int, 4>> _vsourceSlots;      // (p, br), (n, br), (br, p), (br, n)
+    std::vector<std::array<int, 9>> _fetSlots;          // rows and columns ordered (d, g, s)
+
+    // switch level: tables per technology and polarity, and the triangle every FET was last in.
+    // the Jacobian only changes with a region or the timestep, so factors are reused until then.
+    struct FetRegion {
+        int region = -1;
+        PwlFET::Plane plane;
+        std::array<double, 2> Qg, Qd;                   // [F] charge partials (Vgs, Vds) at the triangle centroid
+    };
+    bool _switchLevel;                                  // off while the smooth model finds a dc point
+    std::vector<PwlFET::Table> _pwlTables;
+    std::vector<FetRegion> _fetRegions;
+    long _regionEpoch = 0, _factoredEpoch = -1;         // region changes, loaded and in the factors
+    double _loadedH = -1.0, _factoredH = -1.0;          // timestep of the Jacobian, 0 for dc
+
+    // terminal charges at the previous point of every FET, reused while it does not move
+    struct ChargeHistory {
+        double Vgs = std::numeric_limits<double>::quiet_NaN(), Vds = std::numeric_limits<double>::quiet_NaN();
+        double Qg = 0.0, Qd = 0.0;                      // [C]
+    };
+    std::vector<ChargeHistory> _chargeHistory;
+
+    // chord: regions at the last load and at the one in the factors
+    std::vector<PlanarFET::Region> _regions, _factoredRegions;
+    bool _chordFactors = false;                         // the factors are from a chord Newton load
+    double _chordRate = 1.0;                            // last contraction measured on them, 1 for none
+    static constexpr double CHORD_ERROR = 0.1;          // share of the Newton tolerance a chord solution may be off
+    std::ostream *_chordLog = nullptr;
+
+    KernelProfile *_profile = nullptr;
+    double _entries = 0.0;                              // matrix entries with fill, the profile's unit
+
+    DeviceStats _deviceStats;
+
+    std::unique_ptr<PartitionedSolver> _partitioned;
+    Checkpoint *_checkpoint = nullptr;
+    std::vector<Stimulus *> _stimuli;
+
+    static int _unknown(int node) { return node - 1; }
+    static double _voltage(const std::vector<double> &x, int index) { return index < 0 ? 0.0 : x[index]; }
+    std::array<int, 3> _fetUnknowns(int fet) const;
+
+    void _addResidual(int index, double value) { if (index >= 0) _residual[index] += value; }
+    void _stampPair(const std::array<int, 4> &slots, int a, int b, double i, double g);
+    void _stampFetBranch(int fet, int a, int b, double i, const std::array<double, 3> &dI);
+    const ChargeHistory &_previousCharges(int fet, const std::vector<double> &xPrev);
+    void _blameResidual();                                  // device stats, worst KCL residual of the last load
+    void _blameLimiting(const std::vector<double> &dx);     // device stats, before a step is cut to maxVoltageStep
+    bool _inRegions(const std::vector<double> &x) const;    // every FET still in the triangle it was stamped in
+    bool _refactor(const std::vector<double> &x, Refactor &reason);  // chord, before solving with the factors
+    std::vector<double> _getChordState() const;             // chord, factors held for the next step, groups included
+    void _setChordState(const std::vector<double> &state);  // empty drops the factors
+    void _stampSwitchLevel(int fet, const std::vector<double> &x, const std::vector<double> *xPrev, double h);
+    void _load(const std::vector<double> &x, const std::vector<double> *xPrev, double h, double time, double sourceScale);
+    void _factor();
+    bool _linearSolve(std::vector<double> &dx, int iteration);
+    void _solveFactored(std::vector<double> &rhs);          // J^-1 rhs with the last direct factors
+    void _directSolve(std::vector<double> &rhs, bool transpose);
+    void _solveTranspose(std::vector<double> &rhs);
+    bool _newton(std::vector<double> &x, const std::vector<double> *xPrev, double h, double time, double sourceScale);
+    bool _solve(std::vector<double> &x, const std::vector<double> *xPrev, double h, double time, double sourceScale);
+    std::vector<double> _getBreakpoints(double tstop) const;
+    Waveforms _transient(TransientState &state, const StepCallback &onAccept, bool storeWaveforms, Waveforms waves);
+
+    friend class DCSweep;
+    friend class Sensitivity;
+    friend class PartitionedSolver;
+};
 
 #endif
@@ -0,0 +1,99 @@
+#pragma once
+#ifndef _STIMULUS_HPP_
+#define _STIMULUS_HPP_
+
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "netlist.hpp"
+
+// Digital input vectors streamed from a memory mapped file into ramped voltage sources.
+//
+//   .stimulus <path> [vlow=0] [vhigh=1.8] [rise=50p] [fall=50p] [format=vcd|table]
+//
+// VCD files (format from the .vcd extension by default) drive the node named after each $var,
+// "<name>[<bit>]" per bit of a vector. Scopes are flattened and real variables are ignored.
+// Tables have a header line "time <signal> ..." and a row per time point with one 0/1/x/z
+// column per signal. 0 and 1 ramp the source to vlow and vhigh, x and z hold the last level.
+// Signals without a node of that name are skipped.
+//
+// The file is read front to back as the transient advances and never held in memory. Only the
+// next time point that changes a driven source is parsed ahead; it and the ends of running
+// ramps form a min-heap of breakpoints the timestep controller lands on. A source is a DC value
+// or one ramp segment, so evaluating it costs the same whatever the length of the file.
+class Stimulus {
+public:
+    struct Options {
+        double vlow = 0.0;              // [V] level of 0
+        double vhigh = 1.8;             // [V] level of 1
+        double rise = 50e-12;           // [s] full swing ramp times, partial swings are shorter
+        double fall = 50e-12;
+        enum class Format { Auto, Vcd, Table } format = Format::Auto;
+    };
+
+    // key=value arguments of a .stimulus card after the path
+    static Options parse(const std::vector<std::string> &args);
+
+    Stimulus(const std::filesystem::path &path, const Options &options);
+
+    Stimulus(const Stimulus &) = delete;
+    Stimulus &operator=(const Stimulus &) = delete;
+
+    // adds a source "vstim_<node>" per signal bit with a node of that name, set to the values at
+    // time 0, and returns how many were added. the stimulus edits them in the netlist from then on.
+    int attach(Netlist &netlist);
+
+    void seek(double time);             // sources take their values at time, reading from the start
+    void advance(double time);          // apply every edge at or before time
+    double nextBreakpoint() const;      // next edge or ramp end, infinity if there is none
+
+    const std::vector<int> &getSources() const { return _sources; }   // driven voltage sources
+    int getSignals() const { return int(_signals.size()); }
+    long getEdges() const { return _edges; }            // source changes applied so far
+
+private:
+    struct Signal {
+        std::string name;
+        int width;
+        bool ranged;                    // nodes are "<name>[<bit>]"
+        int msb, lsb;                   // declared bit range
+        std::vector<int> driven;        // per bit (lsb first): index into _sources, -1 if unbound
+    };
+
+    MappedFile _file;
+    std::filesystem::path _path;
+    Options _options;
+    bool _vcd;
+    double _timescale;                  // [s] per vcd time unit
+    std::vector<Signal> _signals;
+    std::unordered_map<std::string, std::vector<int>> _codes;   // vcd identifier code -> signals
+
+    Netlist *_netlist;
+    std::vector<int> _sources;          // voltage source per driven bit
+    std::vector<double> _levels;        // [V] level each driven source is heading to
+    std::priority_queue<double, std::vector<double>, std::greater<double>> _rampEnds;
+
+    size_t _body;                       // offset of the first time point
+    size_t _pos;                        // read position
+    double _nextTime;                   // [s] time of _changes
+    double _lastTime;                   // [s] of the time point read before it
+    std::vector<std::pair<int, double>> _changes;       // (driven source, level) of the next time point
+    std::vector<std::pair<const char *, const char *>> _columns;   // of the last table row
+    long _edges;
+
+    void _readHeader();
+    bool _token(const char *&begin, const char *&end);
+    bool _line();                       // next table row into _columns
+    void _change(const Signal &signal, const char *value, const char *end);
+    bool _parseTime();                  // next time point into _nextTime and _changes
+    void _readAhead();
+    void _drive(int source, double level, double time);
+};
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+#ifndef _SYMBOLIC_CACHE_HPP_
+#define _SYMBOLIC_CACHE_HPP_
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#include "matrix.hpp"
+
+// On-disk store of what SparseMatrix::finalize() computes from a pattern: the minimum degree
+// order, the permuted pattern with its fill and the elimination schedule. Entries live in a
+// directory as <pattern hash>.sym, so every circuit with the same MNA structure shares one
+// however its values change, and a rerun of a large design skips the ordering entirely.
+//
+// An entry is only used after validation. The header must match and a checksum of the image
+// must hold, then every index has to be in range for the schedule SparseLU walks, the order has
+// to be a permutation and every reserved entry has to be in the stored pattern. Anything else
+// counts as a miss and the entry is computed and written again.
+class SymbolicCache {
+public:
+    static const uint32_t VERSION = 1;
+
+    static std::filesystem::path getPath(const std::filesystem::path &directory, uint64_t hash);
+
+    // finalizes matrix from an entry for its pattern and returns true when one is valid
+    static bool load(const std::filesystem::path &entry, uint64_t hash, SparseMatrix &matrix, bool fill);
+    static void save(const std::filesystem::path &entry, uint64_t hash, const SparseMatrix &matrix);
+
+    // matrix.finalize(fill) through the cache in directory, which is created if needed. an entry
+    // that cannot be written leaves the matrix finalized and says why in error
+    static void finalize(const std::filesystem::path &directory, SparseMatrix &matrix, bool fill, bool *hit = nullptr, std::string *error = nullptr);
+
+private:
+    static bool _validate(const SparseMatrix &result, const SparseMatrix &matrix, bool fill);
+};
+
+#endif
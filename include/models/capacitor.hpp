@@ -0,0 +1,13 @@
+#pragma once
+#ifndef _CAPACITOR_HPP_
+#define _CAPACITOR_HPP_
+
+#include "models.hpp"
+
+class Capacitor {
+public:
+    static double getCharge(double C, double V);
+    static double getTransientCurrent(double C, double dV_dt);
+};
+
+#endif
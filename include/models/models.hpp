@@ -6,6 +6,7 @@
 #define VAL static const double
 
 #include <cmath>
+#include <utility>
 
 class SiConstants {
 public:
@@ -18,7 +19,10 @@ class ModelUtils {
 public:
     enum class DevType { N, P };
 
+    EXP GAMMA_OFFSET = 0.04;   // [V] shift applied to gamma before the sigmoid is evaluated
+
     static double sigmoid(double beta, double gamma);
+    static std::pair<double, double> sigmoid_partials(double beta, double gamma);
     static double fx_smooth(double beta, double gamma, double fx1, double fx2);
 };
 
@@ -18,10 +18,44 @@ public:
         double Covl;        // [F]
         double BETA;        // [V^-1] linear->saturation smoothing constant
 
+        // derived from the inputs above by update(), so the model never recomputes them per call
+        double KPn;         // [A/V^2] MUn*Cox/L, drive per unit width for n-type devices
+        double KPp;         // [A/V^2] MUp*Cox/L, drive per unit width for p-type devices
+        double CoxL;        // [F/m] Cox*L, channel capacitance per unit width
+        double BETAoffset;  // [const] BETA*GAMMA_OFFSET, constant part of the sigmoid exponent
+
         Tech(double L, double Tox, double Lovl, double Vt, double MUn, double MUp, double LAMBDA, double BETA)
-            : L(L), Tox(Tox), Lovl(Lovl), Vt(Vt), MUn(MUn), MUp(MUp), LAMBDA(LAMBDA), Cox(SiConstants::EPSox / Tox), Covl(SiConstants::EPSox * Lovl / Tox), BETA(BETA) {}
+            : L(L), Tox(Tox), Lovl(Lovl), Vt(Vt), MUn(MUn), MUp(MUp), LAMBDA(LAMBDA), BETA(BETA) { update(); }
+
+        // recompute the derived fields after editing an input in place
+        void update();
+    };
+
+    // value of a model quantity together with its partial derivatives with respect to the
+    // terminal voltages and to every instance/technology parameter that feeds it
+    struct Derivatives {
+        double value;
+        double dVgs;        // [x/V]
+        double dVds;        // [x/V]
+        double dW;          // [x/m]
+        double dL;          // [x/m]
+        double dTox;        // [x/m]
+        double dLovl;       // [x/m]
+        double dVt;         // [x/V]
+        double dMU;         // [x/(m^2/V*s)] w.r.t. MUn for n-type and MUp for p-type devices
+        double dLAMBDA;     // [x*V]
+        double dBETA;       // [x*V]
     };
 
+    // terminal charges of the gate, drain and source, Qg + Qd + Qs = 0, with the same partials
+    // as Derivatives. currents are their time derivatives, so charge is conserved.
+    struct Charges {
+        Derivatives Qg, Qd, Qs;
+    };
+
+    // operating region of the unsmoothed model, the smooth one blends across its boundaries
+    enum class Region { Off, Linear, Saturation };
+
     static const Tech t180nm;
     static const Tech t065nm;
 
@@ -31,6 +65,11 @@ public:
     static double getCgd(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType);
     static double getTransientCurrent(const Tech &tech, double W, double Vgs, double Vds, double dVgs_dt, double dVds_dt, ModelUtils::DevType devType);
     static double getInstantaneousPower(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType);
+    static Derivatives getIdDerivatives(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType);
+    static Derivatives getCgsDerivatives(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType);
+    static Derivatives getCgdDerivatives(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType);
+    static Charges getCharges(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType);
+    static Region getRegion(const Tech &tech, double Vgs, double Vds, ModelUtils::DevType devType);
 
 private:
     static double _getGamma(const Tech &tech, double Vgs, double Vds, ModelUtils::DevType devType);
@@ -45,6 +84,10 @@ private:
     static double _getCgs_sat(const Tech &tech, double W);
     static double _getCgd_lin(const Tech &tech, double W);
     static double _getCgd_sat(const Tech &tech, double W);
+    static double _getKP(const Tech &tech, ModelUtils::DevType devType) { return devType == ModelUtils::DevType::N ? tech.KPn : tech.KPp; }
+    static double _getAlpha(const Tech &tech, double gamma);
+    static double _smooth(const Tech &tech, double gamma, double fx1, double fx2);
+    static Derivatives _getCapDerivatives(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType, double linFactor, double satFactor);
 
     friend class PlanarFET_ut_friend;
 };
@@ -0,0 +1,40 @@
+#pragma once
+#ifndef _PWL_FET_HPP_
+#define _PWL_FET_HPP_
+
+#include <vector>
+
+#include "planar_fet.hpp"
+
+// Piecewise-linear drain current of a PlanarFET, for switch-level simulation. Id per unit width
+// is sampled from PlanarFET::getIdDerivatives on a (Vgs, Vds) grid with a Vgs grid line on the
+// threshold, and every grid cell is cut into two triangles. Inside a triangle the current is one
+// plane Id = W * (i0 + gm * Vgs + gds * Vds), so a device only changes its stamp when its
+// terminal voltages cross into another triangle. Outside the grid the border triangles are
+// extended.
+class PwlFET {
+public:
+    struct Table {
+        ModelUtils::DevType devType;
+        double step;                // [V] grid spacing on both axes
+        double vgs0, vds0;          // [V] first grid line
+        int gsLines, dsLines;       // grid lines per axis
+        std::vector<double> id;     // [A/m] Id per unit width on the grid, Vds fastest
+    };
+
+    struct Plane {
+        double i0;                  // [A/m]
+        double gm;                  // [S/m] dId/dVgs
+        double gds;                 // [S/m] dId/dVds
+        double vgs, vds;            // [V] centroid of the triangle
+    };
+
+    // range: grid covers [-range, range] volts on both axes
+    static Table build(const PlanarFET::Tech &tech, ModelUtils::DevType devType, double step, double range);
+
+    // triangle index of (Vgs, Vds) and the plane through it
+    static int locate(const Table &table, double Vgs, double Vds);
+    static Plane getPlane(const Table &table, int region);
+};
+
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+#ifndef _RESISTOR_HPP_
+#define _RESISTOR_HPP_
+
+#include "models.hpp"
+
+class Resistor {
+public:
+    static double getConductance(double R);
+    static double getCurrent(double R, double V);
+    static double getInstantaneousPower(double R, double V);
+};
+
+#endif
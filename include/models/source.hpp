@@ -0,0 +1,22 @@
+#pragma once
+#ifndef _SOURCE_HPP_
+#define _SOURCE_HPP_
+
+#include <vector>
+
+#include "models.hpp"
+
+class Source {
+public:
+    enum class Shape { DC, PULSE, PWL };
+
+    struct Waveform {
+        Shape shape;
+        std::vector<double> params;   // DC: {V}, PULSE: {V1, V2, TD, TR, TF, PW, PER}, PWL: {t0, V0, t1, V1, ...}
+    };
+
+    static double getValue(const Waveform &wave, double time);
+    static std::vector<double> getBreakpoints(const Waveform &wave, double tstop);
+};
+
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+#ifndef _MAPPED_FILE_HPP_
+#define _MAPPED_FILE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+// Read-only memory mapping of a whole file. Empty files map to a null pointer with size 0.
+class MappedFile {
+private:
+    const char *data_;
+    size_t size_;
+
+public:
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+};
+
+// 64-bit FNV-1a, chainable through `seed`
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+
+#endif
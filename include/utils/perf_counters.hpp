@@ -0,0 +1,46 @@
+#pragma once
+#ifndef _PERF_COUNTERS_HPP_
+#define _PERF_COUNTERS_HPP_
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+
+// Hardware counters of the calling thread, user space only, read together as one perf_event
+// group. Events the machine or kernel refuses (containers, VMs, perf_event_paranoid > 2) are
+// simply missing; with none left available() is false and error() says why. Counts are scaled
+// up when the kernel had to multiplex the group.
+class PerfCounters {
+public:
+    enum Event { Cycles, Instructions, CacheMisses, BranchMisses, EVENTS };
+
+    struct Sample {
+        std::array<double, EVENTS> counts;  // since the group was opened
+        double seconds;                     // [s] steady clock
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    bool available() const { return leader_ >= 0; }
+    bool has(Event event) const { return slot_[event] >= 0; }
+    const std::string &error() const { return error_; }
+
+    // missing events read as 0
+    Sample read() const;
+
+    static const char *event_name(Event event);
+
+private:
+    int leader_;
+    std::array<int, EVENTS> fds_;
+    std::array<int, EVENTS> slot_;          // position in the group read, -1 when missing
+    int members_;
+    std::string error_;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+#ifndef _THREADPOOL_HPP_
+#define _THREADPOOL_HPP_
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+
+// Fixed set of worker threads fed from a single queue. wait() blocks until every submitted job
+// has finished and rethrows the first exception a job raised.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> jobs_;
+    std::mutex mutex_;
+    std::condition_variable wake_, idle_;
+    size_t pending_;
+    bool stop_;
+    std::exception_ptr error_;
+
+    void worker_loop_();
+
+public:
+    explicit ThreadPool(unsigned threads = 0);     // 0 uses the hardware concurrency
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned size() const { return unsigned(workers_.size()); }
+    void submit(std::function<void()> job);
+    void wait();
+
+    // run body(i) for i in [0, count), handing out indices in chunks of `grain`
+    void parallel_for(size_t count, const std::function<void(size_t)> &body, size_t grain = 1);
+
+    static unsigned default_threads();
+};
+
+#endif
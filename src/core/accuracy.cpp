@@ -0,0 +1,44 @@
+#include "accuracy.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+Accuracy::Report Accuracy::compare(const Simulator &simulator, const Simulator::Waveforms &approximate, const Simulator::Waveforms &reference) {
+    if (approximate.time.empty() || reference.time.empty()) throw std::runtime_error("accuracy needs both waveforms in memory");
+    auto nodes = simulator.getNodeUnknowns();
+    Report report = {std::vector<Node>(size_t(nodes)), 0.0, 0.0};
+    for (int i = 0; i < nodes; i++) report.nodes[i] = {i, 0.0, reference.time.front(), 0.0};
+
+    auto &ta = approximate.time, &tr = reference.time;
+    size_t k = 0;
+    double span = 0.0, total = 0.0;
+    for (size_t n = 0; n < tr.size(); n++) {
+        auto t = tr[n];
+        while (k + 2 < ta.size() && ta[k + 1] < t) k++;
+        // linear between the approximate points around t, held flat past either end
+        auto next = std::min(k + 1, ta.size() - 1);
+        auto s = ta[next] > ta[k] ? std::clamp((t - ta[k]) / (ta[next] - ta[k]), 0.0, 1.0) : 0.0;
+        auto weight = (tr[std::min(n + 1, tr.size() - 1)] - tr[n > 0 ? n - 1 : 0]) / 2;
+        span += weight;
+        for (int i = 0; i < nodes; i++) {
+            auto value = approximate.x[k][i] + s * (approximate.x[next][i] - approximate.x[k][i]);
+            auto error = std::abs(value - reference.x[n][i]);
+            auto &node = report.nodes[i];
+            if (error > node.maxError) {
+                node.maxError = error;
+                node.time = t;
+            }
+            node.rmsError += weight * error * error;
+        }
+    }
+
+    for (auto &node : report.nodes) {
+        total += node.rmsError;
+        node.rmsError = span > 0.0 ? std::sqrt(node.rmsError / span) : 0.0;
+        report.maxError = std::max(report.maxError, node.maxError);
+    }
+    report.rmsError = span > 0.0 && nodes > 0 ? std::sqrt(total / (span * nodes)) : 0.0;
+    std::stable_sort(report.nodes.begin(), report.nodes.end(), [](const Node &a, const Node &b) { return a.maxError > b.maxError; });
+    return report;
+}
@@ -0,0 +1,332 @@
+#include "characterize.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include "threadpool.hpp"
+
+namespace {
+    const double RAMP_START = 10e-12;       // [s] quiet time ahead of the input edge
+    const double SLEW_SPAN = 0.6;           // 20-80% of a linear ramp
+    const double NaN = std::numeric_limits<double>::quiet_NaN();
+
+    std::string format(double value) {
+        std::ostringstream out;
+        out << std::setprecision(12) << value;
+        return out.str();
+    }
+
+    std::vector<double> parseList(const std::string &text) {
+        std::vector<double> values;
+        size_t first = 0;
+        while (first < text.size()) {
+            auto comma = std::min(text.find(',', first), text.size());
+            values.push_back(Netlist::parseValue(text.substr(first, comma - first)));
+            first = comma + 1;
+        }
+        if (values.empty()) throw std::runtime_error("empty list [ " + text + " ]");
+        return values;
+    }
+
+    // key=value arguments after the positional ones
+    std::map<std::string, std::string> parseOptions(const std::vector<std::string> &args, size_t first, const std::string &card) {
+        std::map<std::string, std::string> options;
+        for (size_t i = first; i < args.size(); i++) {
+            auto eq = args[i].find('=');
+            if (eq == std::string::npos || eq == 0) throw std::runtime_error("." + card + ": expected key=value [ " + args[i] + " ]");
+            options[args[i].substr(0, eq)] = args[i].substr(eq + 1);
+        }
+        return options;
+    }
+}
+
+Characterizer::Characterizer(const Netlist &library, int threads)
+    : _library(library), _threads(threads), _settle(2e-9), _transients(0) {}
+
+Characterizer::~Characterizer() = default;
+
+void Characterizer::add(const Netlist::Analysis &card) {
+    auto &args = card.args;
+    if (card.type == "char") {
+        // .char <cell> <input> <output> [<pin>=0|1 ...]
+        if (args.size() < 3) throw std::runtime_error(".char expects <cell> <input> <output>");
+        if (_library.getSubcktPorts(args[0]).empty()) throw std::runtime_error(".char: unknown subckt [ " + args[0] + " ]");
+        Arc arc = {args[0], args[1], args[2], {}};
+        for (auto &tie : parseOptions(args, 3, card.type)) {
+            if (tie.second != "0" && tie.second != "1") throw std::runtime_error(".char: side inputs are tied to 0 or 1 [ " + tie.first + " ]");
+            arc.ties.push_back({tie.first, tie.second == "1"});
+        }
+        _arcs.push_back(arc);
+    } else if (card.type == "chartable") {
+        // .chartable slews=<list> loads=<list> [settle=<t>]
+        auto options = parseOptions(args, 0, card.type);
+        if (!options.count("slews") || !options.count("loads")) throw std::runtime_error(".chartable expects slews= and loads=");
+        _slews = parseList(options["slews"]);
+        _loads = parseList(options["loads"]);
+        if (options.count("settle")) _settle = Netlist::parseValue(options["settle"]);
+        for (auto slew : _slews) if (slew <= 0.0) throw std::runtime_error(".chartable: slews must be positive");
+    } else if (card.type == "corner") {
+        // .corner <name> vdd=<v> [dvt=<v>] [mu=<scale>]
+        if (args.empty()) throw std::runtime_error(".corner expects a name");
+        auto options = parseOptions(args, 1, card.type);
+        if (!options.count("vdd")) throw std::runtime_error(".corner expects vdd=");
+        Corner corner = {args[0], Netlist::parseValue(options["vdd"]), 0.0, 1.0};
+        if (options.count("dvt")) corner.dVt = Netlist::parseValue(options["dvt"]);
+        if (options.count("mu")) corner.mobility = Netlist::parseValue(options["mu"]);
+        _corners.push_back(corner);
+    } else {
+        throw std::runtime_error("not a characterization card [ " + card.type + " ]");
+    }
+}
+
+double Characterizer::_window() const {
+    return RAMP_START + *std::max_element(_slews.begin(), _slews.end()) / SLEW_SPAN + _settle;
+}
+
+std::unique_ptr<Characterizer::Harness> Characterizer::_build(int corner, int arc, bool rise) const {
+    auto &c = _corners[corner];
+    auto &a = _arcs[arc];
+    auto harness = std::make_unique<Harness>();
+    harness->corner = corner;
+    harness->arc = arc;
+    harness->rise = rise;
+    harness->busy = true;
+    harness->netlist = std::make_unique<Netlist>(_library);
+    auto &netlist = *harness->netlist;
+
+    for (int t = 0; t < netlist.getTechCount(); t++) {
+        auto &tech = netlist.getTech(t);
+        tech.Vt += c.dVt;
+        tech.MUn *= c.mobility;
+        tech.MUp *= c.mobility;
+        tech.update();
+    }
+
+    // harness names carry a '~' so they cannot clash with anything in the library deck
+    std::vector<std::string> nodes;
+    bool input = false, output = false;
+    for (auto &port : netlist.getSubcktPorts(a.cell)) {
+        auto tie = std::find_if(a.ties.begin(), a.ties.end(), [&](const std::pair<std::string, bool> &t) { return t.first == port; });
+        if (port == a.input) {
+            nodes.push_back("~in");
+            input = true;
+        } else if (port == a.output) {
+            nodes.push_back("~out");
+            output = true;
+        } else if (port == "vdd" || port == "vcc" || (tie != a.ties.end() && tie->second)) {
+            nodes.push_back("~vdd");
+        } else if (port == "gnd" || port == "vss" || port == "0" || tie != a.ties.end()) {
+            nodes.push_back("0");
+        } else {
+            nodes.push_back("~" + port);
+        }
+    }
+    if (!input || !output) throw std::runtime_error(".char: cell " + a.cell + " has no pin " + (input ? a.output : a.input));
+
+    auto low = rise ? 0.0 : c.vdd, high = rise ? c.vdd : 0.0;
+    netlist.addVSource("v~dd", "~vdd", "0", {Source::Shape::DC, {c.vdd}});
+    netlist.addVSource("v~in", "~in", "0", {Source::Shape::PWL, {0.0, low, RAMP_START, low, RAMP_START + _slews[0] / SLEW_SPAN, high}});
+    netlist.addInstance("x~dut", nodes, a.cell);
+    netlist.addCapacitor("c~load", "~out", "0", _loads[0]);
+    harness->vin = netlist.findVSource("v~in");
+    harness->load = netlist.findCapacitor("c~load");
+
+    harness->sim = std::make_unique<Simulator>(netlist);
+    auto &sim = *harness->sim;
+    harness->output = sim.getIndex("v(~out)");
+    harness->supply = sim.getIndex("i(v~dd)");
+    harness->measures = std::make_unique<MeasureEngine>(sim);
+    auto &measures = *harness->measures;
+    auto half = format(0.5 * c.vdd);
+    measures.add({"delay", "trig", "v(~in)", "val=" + half, "cross=1", "targ", "v(~out)", "val=" + half, "cross=1"});
+    measures.add({"transition", "trig", "v(~out)", "val=" + format(0.2 * c.vdd), "cross=1", "targ", "v(~out)", "val=" + format(0.8 * c.vdd), "cross=1"});
+    measures.add({"energy", "integ", "p(v~dd)"});
+
+    // the operating point only depends on the corner and the input level
+    harness->initial = sim.solveOperatingPoint(0.0);
+    harness->outputStart = harness->initial[harness->output];
+    return harness;
+}
+
+Characterizer::Harness &Characterizer::_acquire(int corner, int arc, bool rise) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &harness : _harnesses) {
+            if (harness->busy || harness->corner != corner || harness->arc != arc || harness->rise != rise) continue;
+            harness->busy = true;
+            return *harness;
+        }
+    }
+    auto harness = _build(corner, arc, rise);
+    std::lock_guard<std::mutex> lock(_mutex);
+    _harnesses.push_back(std::move(harness));
+    return *_harnesses.back();
+}
+
+void Characterizer::_release(Harness &harness) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    harness.busy = false;
+}
+
+std::vector<Characterizer::Timing> Characterizer::run() {
+    if (_arcs.empty()) throw std::runtime_error("nothing to characterize, see .char");
+    if (_slews.empty() || _loads.empty()) throw std::runtime_error("characterization requires a .chartable card");
+    if (_corners.empty()) _corners.push_back({"typical", 1.8, 0.0, 1.0});
+
+    auto points = _slews.size() * _loads.size();
+    std::vector<Timing> timings;
+    for (size_t c = 0; c < _corners.size(); c++) {
+        for (size_t a = 0; a < _arcs.size(); a++) {
+            for (auto rise : {true, false}) {
+                timings.push_back({int(a), int(c), rise, false, std::vector<double>(points, NaN), std::vector<double>(points, NaN), std::vector<double>(points, NaN)});
+            }
+        }
+    }
+
+    // +1 when the output ended above where it started, -1 below, 0 if the point failed
+    std::vector<int> direction(timings.size() * points, 0);
+    auto window = _window();
+    auto job = [&](size_t index) {
+        auto &timing = timings[index / points];
+        auto point = index % points;
+        auto slew = _slews[point / _loads.size()], load = _loads[point % _loads.size()];
+        auto &harness = _acquire(timing.corner, timing.arc, timing.inputRise);
+
+        auto ramp = slew / SLEW_SPAN;
+        harness.netlist->getVSource(harness.vin).wave.params[4] = RAMP_START + ramp;
+        harness.netlist->getCapacitor(harness.load).C = load;
+        harness.measures->reset();
+        double final = NaN, supply = NaN;
+        try {
+            harness.sim->solveTransient(window / 100, window, [&](double time, const std::vector<double> &x) {
+                harness.measures->accept(time, x);
+                final = x[harness.output];
+                supply = x[harness.supply];
+            }, false, &harness.initial);
+        } catch (std::runtime_error &) {
+            _release(harness);
+            return;
+        }
+
+        auto results = harness.measures->getResults();
+        auto &vdd = _corners[timing.corner].vdd;
+        // switching energy is what the supply delivers beyond its static draw, which is taken
+        // as the initial power up to the middle of the input edge and the final power after it
+        auto middle = RAMP_START + 0.5 * ramp;
+        auto before = -vdd * harness.initial[harness.supply], after = -vdd * supply;
+        timing.delay[point] = results[0].value;
+        timing.transition[point] = std::abs(results[1].value);
+        timing.energy[point] = results[2].value - before * middle - after * (window - middle);
+        direction[index] = final > harness.outputStart ? 1 : -1;
+        _release(harness);
+    };
+
+    ThreadPool pool(unsigned(std::max(_threads, 0)));
+    pool.parallel_for(timings.size() * points, job);
+    _transients += int(timings.size() * points);
+
+    for (size_t t = 0; t < timings.size(); t++) {
+        int sum = 0;
+        for (size_t p = 0; p < points; p++) sum += direction[t * points + p];
+        timings[t].outputRise = sum > 0;
+    }
+    return timings;
+}
+
+void Characterizer::writeLiberty(std::ostream &out, const std::vector<Timing> &timings) const {
+    // times in ns, loads in pF and energies in pJ (V * pF)
+    auto list = [&](const std::vector<double> &values, double scale) {
+        std::ostringstream text;
+        for (size_t i = 0; i < values.size(); i++) text << (i ? ", " : "") << values[i] * scale;
+        return "\"" + text.str() + "\"";
+    };
+    auto size = std::to_string(_slews.size()) + "x" + std::to_string(_loads.size());
+    auto table = [&](const std::string &indent, const std::string &group, const std::string &templ, const std::vector<double> &values, double scale) {
+        out << indent << group << " (" << templ << "_" << size << ") {\n";
+        out << indent << "  index_1 (" << list(_slews, 1e9) << ");\n";
+        out << indent << "  index_2 (" << list(_loads, 1e12) << ");\n";
+        out << indent << "  values (";
+        for (size_t i = 0; i < _slews.size(); i++) {
+            std::vector<double> row(values.begin() + i * _loads.size(), values.begin() + (i + 1) * _loads.size());
+            out << (i ? ", \\\n" + indent + "          " : "") << list(row, scale);
+        }
+        out << ");\n" << indent << "}\n";
+    };
+
+    for (size_t c = 0; c < _corners.size(); c++) {
+        auto &corner = _corners[c];
+        out << "library (" << corner.name << ") {\n";
+        out << "  delay_model : table_lookup;\n";
+        out << "  time_unit : \"1ns\";\n";
+        out << "  voltage_unit : \"1V\";\n";
+        out << "  capacitive_load_unit (1, pf);\n";
+        out << "  nom_voltage : " << corner.vdd << ";\n";
+        for (auto edge : {"rise", "fall"}) {
+            out << "  input_threshold_pct_" << edge << " : 50;\n";
+            out << "  output_threshold_pct_" << edge << " : 50;\n";
+            out << "  slew_lower_threshold_pct_" << edge << " : 20;\n";
+            out << "  slew_upper_threshold_pct_" << edge << " : 80;\n";
+        }
+        for (auto templ : {"lu_table_template (delay_template_", "power_lut_template (energy_template_"}) {
+            out << "  " << templ << size << ") {\n";
+            out << "    variable_1 : input_net_transition;\n";
+            out << "    variable_2 : total_output_net_capacitance;\n";
+            out << "    index_1 (" << list(_slews, 1e9) << ");\n";
+            out << "    index_2 (" << list(_loads, 1e12) << ");\n";
+            out << "  }\n";
+        }
+
+        std::vector<std::string> cells;
+        for (auto &arc : _arcs) if (std::find(cells.begin(), cells.end(), arc.cell) == cells.end()) cells.push_back(arc.cell);
+        for (auto &cell : cells) {
+            out << "  cell (" << cell << ") {\n";
+            std::vector<std::string> inputs, outputs;
+            for (auto &arc : _arcs) {
+                if (arc.cell != cell) continue;
+                if (std::find(inputs.begin(), inputs.end(), arc.input) == inputs.end()) inputs.push_back(arc.input);
+                if (std::find(outputs.begin(), outputs.end(), arc.output) == outputs.end()) outputs.push_back(arc.output);
+            }
+            for (auto &pin : inputs) out << "    pin (" << pin << ") {\n      direction : input;\n    }\n";
+            for (auto &pin : outputs) {
+                out << "    pin (" << pin << ") {\n      direction : output;\n";
+                for (size_t a = 0; a < _arcs.size(); a++) {
+                    auto &arc = _arcs[a];
+                    if (arc.cell != cell || arc.output != pin) continue;
+                    const Timing *rising = nullptr, *falling = nullptr;
+                    bool positive = false, negative = false;
+                    for (auto &timing : timings) {
+                        if (timing.arc != int(a) || timing.corner != int(c)) continue;
+                        (timing.outputRise ? rising : falling) = &timing;
+                        (timing.inputRise == timing.outputRise ? positive : negative) = true;
+                    }
+                    auto sense = positive && negative ? "non_unate" : positive ? "positive_unate" : "negative_unate";
+                    out << "      timing () {\n";
+                    out << "        related_pin : \"" << arc.input << "\";\n";
+                    out << "        timing_sense : " << sense << ";\n";
+                    if (rising) {
+                        table("        ", "cell_rise", "delay_template", rising->delay, 1e9);
+                        table("        ", "rise_transition", "delay_template", rising->transition, 1e9);
+                    }
+                    if (falling) {
+                        table("        ", "cell_fall", "delay_template", falling->delay, 1e9);
+                        table("        ", "fall_transition", "delay_template", falling->transition, 1e9);
+                    }
+                    out << "      }\n";
+                    out << "      internal_power () {\n";
+                    out << "        related_pin : \"" << arc.input << "\";\n";
+                    if (rising) table("        ", "rise_power", "energy_template", rising->energy, 1e12);
+                    if (falling) table("        ", "fall_power", "energy_template", falling->energy, 1e12);
+                    out << "      }\n";
+                }
+                out << "    }\n";
+            }
+            out << "  }\n";
+        }
+        out << "}\n";
+    }
+}
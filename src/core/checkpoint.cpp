@@ -0,0 +1,176 @@
+#include "checkpoint.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+const uint32_t Checkpoint::VERSION;
+
+namespace {
+    const char MAGIC[8] = {'c', 's', 'i', 'm', 'c', 'k', 'p', 't'};
+    const int FINGERPRINT = 5;
+
+    // element counts the snapshot was taken with, a resume on another circuit is refused
+    std::vector<uint64_t> fingerprint(const Simulator &simulator) {
+        auto &netlist = simulator.getNetlist();
+        return {uint64_t(simulator.getSize()), uint64_t(netlist.getFets().size()), uint64_t(netlist.getResistors().size()),
+                uint64_t(netlist.getCapacitors().size()), uint64_t(netlist.getVSources().size())};
+    }
+
+    template <typename T> void put(std::ofstream &file, const T &value) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain data can be written raw");
+        file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    void putArray(std::ofstream &file, const std::vector<double> &values) {
+        put(file, uint64_t(values.size()));
+        file.write(reinterpret_cast<const char *>(values.data()), std::streamsize(values.size() * sizeof(double)));
+    }
+
+    template <typename T> T get(std::ifstream &file) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain data can be read raw");
+        T value;
+        if (!file.read(reinterpret_cast<char *>(&value), sizeof(T))) throw std::runtime_error("truncated checkpoint");
+        return value;
+    }
+
+    std::vector<double> getArray(std::ifstream &file, uint64_t remaining) {
+        auto count = get<uint64_t>(file);
+        if (count > remaining / sizeof(double)) throw std::runtime_error("truncated checkpoint");
+        std::vector<double> values(count);
+        if (!file.read(reinterpret_cast<char *>(values.data()), std::streamsize(count * sizeof(double)))) throw std::runtime_error("truncated checkpoint");
+        return values;
+    }
+}
+
+Checkpoint::Checkpoint(const std::filesystem::path &path, double interval)
+    : _path(path), _interval(interval), _analysis(0), _last(std::chrono::steady_clock::now()),
+      _writing(false), _stop(false), _written(0)
+{
+    _writer = std::thread(&Checkpoint::_run, this);
+}
+
+Checkpoint::~Checkpoint() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    _writer.join();
+}
+
+bool Checkpoint::due() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - _last).count() >= _interval;
+}
+
+int Checkpoint::getWritten() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _written;
+}
+
+void Checkpoint::capture(const Simulator &simulator, const Simulator::TransientState &state) {
+    // copied on the solver thread, which is the only part of a snapshot the solver waits for
+    auto snapshot = std::make_unique<Snapshot>();
+    snapshot->fingerprint = fingerprint(simulator);
+    snapshot->analysis = _analysis;
+    snapshot->state = state;
+    for (auto &client : _clients) snapshot->clients.push_back(client.save());
+    _last = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending = std::move(snapshot);
+    }
+    _wake.notify_all();
+}
+
+void Checkpoint::flush() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle.wait(lock, [&]() { return !_pending && !_writing; });
+    if (_error) std::rethrow_exception(std::exchange(_error, nullptr));
+}
+
+void Checkpoint::_run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _wake.wait(lock, [&]() { return _pending || _stop; });
+        if (!_pending) break;
+        auto snapshot = std::move(_pending);
+        _writing = true;
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            _write(*snapshot);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+        _writing = false;
+        if (error) _error = error;
+        else _written++;
+        _idle.notify_all();
+    }
+}
+
+void Checkpoint::_write(const Snapshot &snapshot) const {
+    // written next to the target and renamed, so a run killed mid-write keeps the last snapshot
+    auto temp = _path;
+    temp += ".tmp";
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) throw std::runtime_error("Failed to open file [ " + temp.string() + " ]");
+
+    auto &state = snapshot.state;
+    file.write(MAGIC, sizeof(MAGIC));
+    put(file, VERSION);
+    put(file, uint32_t(sizeof(Simulator::Statistics)));
+    for (auto count : snapshot.fingerprint) put(file, count);
+    put(file, int32_t(snapshot.analysis));
+    for (auto value : {state.tstep, state.tstop, state.t, state.tPrev, state.h}) put(file, value);
+    put(file, int32_t(state.history));
+    put(file, int32_t(state.nextBreak));
+    put(file, state.stats);
+    for (auto values : {&state.x, &state.xPrev, &state.warmStart, &state.latency, &state.chord}) putArray(file, *values);
+    put(file, uint64_t(snapshot.clients.size()));
+    for (auto &client : snapshot.clients) putArray(file, client);
+
+    file.close();
+    if (!file) throw std::runtime_error("Failed to write file [ " + temp.string() + " ]");
+    std::filesystem::rename(temp, _path);
+}
+
+int Checkpoint::getAnalysis(const std::filesystem::path &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("Failed to open file [ " + path.string() + " ]");
+    char magic[sizeof(MAGIC)];
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) throw std::runtime_error("not a checkpoint [ " + path.string() + " ]");
+    if (get<uint32_t>(file) != VERSION || get<uint32_t>(file) != sizeof(Simulator::Statistics)) throw std::runtime_error("checkpoint from another csim version [ " + path.string() + " ]");
+    for (int i = 0; i < FINGERPRINT; i++) get<uint64_t>(file);
+    return get<int32_t>(file);
+}
+
+int Checkpoint::restore(const Simulator &simulator, Simulator::TransientState &state) {
+    std::ifstream file(_path, std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("Failed to open file [ " + _path.string() + " ]");
+    auto size = std::filesystem::file_size(_path);
+
+    char magic[sizeof(MAGIC)];
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) throw std::runtime_error("not a checkpoint [ " + _path.string() + " ]");
+    if (get<uint32_t>(file) != VERSION || get<uint32_t>(file) != sizeof(Simulator::Statistics)) throw std::runtime_error("checkpoint from another csim version [ " + _path.string() + " ]");
+    for (auto count : fingerprint(simulator)) {
+        if (get<uint64_t>(file) != count) throw std::runtime_error("checkpoint was taken on another circuit [ " + _path.string() + " ]");
+    }
+
+    auto analysis = get<int32_t>(file);
+    for (auto value : {&state.tstep, &state.tstop, &state.t, &state.tPrev, &state.h}) *value = get<double>(file);
+    state.history = get<int32_t>(file);
+    state.nextBreak = get<int32_t>(file);
+    state.stats = get<Simulator::Statistics>(file);
+    for (auto values : {&state.x, &state.xPrev, &state.warmStart, &state.latency, &state.chord}) *values = getArray(file, size);
+
+    auto clients = get<uint64_t>(file);
+    if (clients != _clients.size()) throw std::runtime_error("checkpoint has state for " + std::to_string(clients) + " clients, expected " + std::to_string(_clients.size()));
+    for (auto &client : _clients) client.load(getArray(file, size));
+    if (file.peek() != std::ifstream::traits_type::eof()) throw std::runtime_error("trailing data in checkpoint [ " + _path.string() + " ]");
+    return analysis;
+}
@@ -0,0 +1,135 @@
+#include "curves.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    const char MAGIC[8] = {'c', 's', 'i', 'm', 'c', 'u', 'r', 'v'};
+
+    // shortest round-trip text of a double
+    void appendNumber(std::string &out, double value) {
+        char buffer[32];
+        auto end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+        out.append(buffer, end);
+    }
+}
+
+std::vector<double> CurveSweep::parseGrid(const std::string &text) {
+    std::vector<double> values;
+    auto colon = text.find(':');
+    if (colon != std::string::npos) {
+        auto second = text.find(':', colon + 1);
+        if (second == std::string::npos) throw std::runtime_error("range grid expects <start>:<stop>:<step> [ " + text + " ]");
+        values = Netlist::parseRange(text.substr(0, colon), text.substr(colon + 1, second - colon - 1), text.substr(second + 1), "range grid [ " + text + " ]");
+    } else {
+        std::istringstream stream(text);
+        std::string token;
+        while (std::getline(stream, token, ',')) values.push_back(Netlist::parseValue(token));
+    }
+    if (values.empty()) throw std::runtime_error("empty grid [ " + text + " ]");
+    return values;
+}
+
+CurveSweep::CurveSweep(const Netlist &netlist, const Grid &grid, int threads)
+    : _netlist(netlist), _grid(grid), _pool(std::make_unique<ThreadPool>(unsigned(std::max(threads, 0))))
+{
+    for (auto t : grid.techs) {
+        if (t < 0 || t >= netlist.getTechCount()) throw std::runtime_error("technology index out of range");
+    }
+    if (grid.widths.empty() || grid.vgs.empty() || grid.vds.empty()) throw std::runtime_error("curve sweep needs every grid");
+}
+
+int CurveSweep::getThreads() const {
+    return int(_pool->size());
+}
+
+size_t CurveSweep::getPoints() const {
+    return _grid.techs.size() * _grid.types.size() * _grid.widths.size() * _grid.vgs.size() * _grid.vds.size();
+}
+
+void CurveSweep::write(std::ostream &out, bool binary) {
+    auto &techs = _grid.techs;
+    auto &types = _grid.types;
+    auto &widths = _grid.widths, &vgs = _grid.vgs, &vds = _grid.vds;
+    auto put = [&](const void *data, size_t size) { out.write(static_cast<const char *>(data), std::streamsize(size)); };
+
+    if (binary) {
+        put(MAGIC, sizeof(MAGIC));
+        put(&VERSION, sizeof(VERSION));
+        put(&QUANTITIES, sizeof(QUANTITIES));
+        for (auto count : {techs.size(), types.size(), widths.size(), vgs.size(), vds.size()}) {
+            auto n = uint64_t(count);
+            put(&n, sizeof(n));
+        }
+        for (auto t : techs) {
+            auto &name = _netlist.getTechName(t);
+            auto length = uint32_t(name.size());
+            put(&length, sizeof(length));
+            put(name.data(), name.size());
+        }
+        for (auto type : types) {
+            char c = type == ModelUtils::DevType::N ? 'n' : 'p';
+            put(&c, 1);
+        }
+        for (auto grid : {&widths, &vgs, &vds}) put(grid->data(), grid->size() * sizeof(double));
+    } else {
+        out << "tech,type,w,vgs,vds,id,gm,cgs,cgd\n";
+    }
+
+    // a row is one Vds sweep. rows are evaluated in parallel a batch at a time into buffers that
+    // are reused for every batch, and each batch is written in order before the next one starts.
+    auto &pool = *_pool;
+    auto rows = techs.size() * types.size() * widths.size() * vgs.size();
+    auto batch = std::max<size_t>(pool.size() * 4, (size_t(1) << 20) / vds.size());
+    std::vector<std::vector<double>> values(std::min(batch, rows));
+    std::vector<std::string> text(binary ? 0 : values.size());
+
+    for (size_t first = 0; first < rows; first += batch) {
+        auto count = std::min(batch, rows - first);
+        pool.parallel_for(count, [&](size_t i) {
+            auto row = first + i;
+            auto g = row % vgs.size();
+            auto w = row / vgs.size() % widths.size();
+            auto d = row / vgs.size() / widths.size() % types.size();
+            auto t = row / vgs.size() / widths.size() / types.size();
+            auto &tech = _netlist.getTech(techs[t]);
+            auto type = types[d];
+
+            auto &v = values[i];
+            v.resize(vds.size() * QUANTITIES);
+            for (size_t k = 0; k < vds.size(); k++) {
+                v[k * QUANTITIES + 0] = PlanarFET::getId(tech, widths[w], vgs[g], vds[k], type);
+                v[k * QUANTITIES + 1] = PlanarFET::getGm(tech, widths[w], vgs[g], vds[k], type, _grid.analyticGm);
+                v[k * QUANTITIES + 2] = PlanarFET::getCgs(tech, widths[w], vgs[g], vds[k], type);
+                v[k * QUANTITIES + 3] = PlanarFET::getCgd(tech, widths[w], vgs[g], vds[k], type);
+            }
+            if (binary) return;
+
+            auto &line = text[i];
+            line.clear();
+            std::string prefix = _netlist.getTechName(techs[t]) + (type == ModelUtils::DevType::N ? ",n," : ",p,");
+            appendNumber(prefix, widths[w]);
+            prefix += ',';
+            appendNumber(prefix, vgs[g]);
+            for (size_t k = 0; k < vds.size(); k++) {
+                line += prefix;
+                line += ',';
+                appendNumber(line, vds[k]);
+                for (uint32_t q = 0; q < QUANTITIES; q++) {
+                    line += ',';
+                    appendNumber(line, v[k * QUANTITIES + q]);
+                }
+                line += '\n';
+            }
+        }, std::max<size_t>(1, count / (pool.size() * 8)));
+
+        for (size_t i = 0; i < count; i++) {
+            if (binary) put(values[i].data(), values[i].size() * sizeof(double));
+            else put(text[i].data(), text[i].size());
+        }
+    }
+    out.flush();
+    if (!out) throw std::runtime_error("Failed to write the curves");
+}
@@ -0,0 +1,182 @@
+#include "dcsweep.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "threadpool.hpp"
+
+namespace {
+    double &techParam(PlanarFET::Tech &tech, const std::string &param) {
+        if (param == "l") return tech.L;
+        if (param == "tox") return tech.Tox;
+        if (param == "lovl") return tech.Lovl;
+        if (param == "vt") return tech.Vt;
+        if (param == "mun") return tech.MUn;
+        if (param == "mup") return tech.MUp;
+        if (param == "lambda") return tech.LAMBDA;
+        if (param == "beta") return tech.BETA;
+        throw std::runtime_error(".dc: unknown technology parameter [ " + param + " ]");
+    }
+}
+
+DCSweep::Sweep DCSweep::parse(const Netlist &netlist, const std::vector<std::string> &args) {
+    if (args.size() != 4) throw std::runtime_error(".dc expects <target> <start> <stop> <step>");
+    Sweep sweep;
+    sweep.name = args[0];
+    auto open = sweep.name.find('(');
+    if (open == std::string::npos) {
+        sweep.kind = Sweep::Kind::Source;
+        sweep.index = netlist.findVSource(sweep.name);
+        if (sweep.index < 0) throw std::runtime_error(".dc: unknown source [ " + sweep.name + " ]");
+    } else {
+        if (sweep.name.back() != ')') throw std::runtime_error(".dc: malformed target [ " + sweep.name + " ]");
+        auto head = sweep.name.substr(0, open), inner = sweep.name.substr(open + 1, sweep.name.size() - open - 2);
+        if (head == "w") {
+            sweep.kind = Sweep::Kind::Width;
+            sweep.index = netlist.findFet(inner);
+            if (sweep.index < 0) throw std::runtime_error(".dc: unknown fet [ " + inner + " ]");
+        } else {
+            sweep.kind = Sweep::Kind::Tech;
+            sweep.index = netlist.findTech(inner);
+            if (sweep.index < 0) throw std::runtime_error(".dc: unknown technology [ " + inner + " ]");
+            PlanarFET::Tech probe = netlist.getTech(sweep.index);
+            techParam(probe, head);
+            sweep.param = head;
+        }
+    }
+
+    sweep.values = Netlist::parseRange(args[1], args[2], args[3], ".dc");
+    return sweep;
+}
+
+DCSweep::DCSweep(const Netlist &netlist, const Sweep &sweep, const Simulator::Options &options)
+    : DCSweep(netlist, sweep, options, Options()) {}
+
+DCSweep::DCSweep(const Netlist &netlist, const Sweep &sweep, const Simulator::Options &options, const Options &sweepOptions)
+    : _netlist(netlist), _sweep(sweep), _options(options), _sweepOptions(sweepOptions) {}
+
+void DCSweep::apply(Netlist &netlist, const Sweep &sweep, double value) {
+    switch (sweep.kind) {
+    case Sweep::Kind::Source:
+        netlist.getVSource(sweep.index).wave = {Source::Shape::DC, {value}};
+        break;
+    case Sweep::Kind::Width:
+        netlist.getFet(sweep.index).W = value;
+        break;
+    case Sweep::Kind::Tech: {
+        auto &tech = netlist.getTech(sweep.index);
+        techParam(tech, sweep.param) = value;
+        tech.update();
+        break;
+    }
+    }
+}
+
+Simulator::Waveforms DCSweep::run() {
+    auto count = _sweep.values.size();
+    Simulator::Waveforms result;
+    result.time = _sweep.values;
+    result.x.resize(count);
+
+    ThreadPool pool(unsigned(std::max(_options.threads, 0)));
+    size_t segments = _sweepOptions.segments > 0 ? size_t(_sweepOptions.segments)
+                    : std::min<size_t>(pool.size(), std::max<size_t>(1, count / std::max(_sweepOptions.minSegmentPoints, 1)));
+    segments = std::min(segments, count);
+
+    // segments share the cores, so a segment's own Simulator only gets threads when it is alone
+    std::vector<Statistics> stats(segments);
+    auto threads = segments > 1 ? 1 : _options.threads;
+    pool.parallel_for(segments, [&](size_t s) {
+        _runSegment(s * count / segments, (s + 1) * count / segments, result, stats[s], threads);
+    });
+
+    _stats = Statistics();
+    _stats.segments = int(segments);
+    for (auto &s : stats) {
+        _stats.points += s.points;
+        _stats.substeps += s.substeps;
+        _stats.newtonIterations += s.newtonIterations;
+        _stats.coldStarts += s.coldStarts;
+    }
+    return result;
+}
+
+void DCSweep::_runSegment(size_t first, size_t last, Simulator::Waveforms &result, Statistics &stats, int threads) const {
+    auto &values = _sweep.values;
+    Netlist netlist(_netlist);
+    auto options = _options;
+    options.threads = threads;
+    apply(netlist, _sweep, values[first]);
+    Simulator sim(netlist, options);
+    // sources only enter the residual, anything else changes the device stamps
+    auto apply = [&](double value) {
+        DCSweep::apply(netlist, _sweep, value);
+        if (_sweep.kind != Sweep::Kind::Source) sim.updateParameters();
+    };
+
+    auto iterations = [&]() { return sim.getStatistics().newtonIterations; };
+    auto x = sim.solveOperatingPoint();
+    stats.coldStarts++;
+    stats.points++;
+    result.x[first] = x;
+    if (last - first < 2) {
+        stats.newtonIterations += iterations();
+        return;
+    }
+
+    // the source branch row is the only place a source value enters f, with df/dp = -1
+    auto tangential = _sweep.kind == Sweep::Kind::Source && !sim.isIterative() && sim.getBlockGroups() == 0;
+    std::vector<double> tangent(x.size()), previous, predicted(x.size());
+    auto updateTangent = [&]() {
+        std::fill(tangent.begin(), tangent.end(), 0.0);
+        tangent[sim.getNodeUnknowns() + _sweep.index] = 1.0;
+        sim._solveFactored(tangent);
+    };
+    if (tangential) updateTangent();
+
+    auto grid = values[first + 1] - values[first];
+    auto h = grid, p = values[first], pPrevious = p;
+    for (size_t i = first + 1; i < last; i++) {
+        while (p != values[i]) {
+            auto target = values[i];
+            auto next = std::abs(target - p) <= std::abs(h) * (1.0 + 1e-9) ? target : p + h;
+
+            // zero order at the segment start without a tangent, else linear extrapolation
+            for (size_t k = 0; k < x.size(); k++) {
+                if (tangential) predicted[k] = x[k] + tangent[k] * (next - p);
+                else if (!previous.empty()) predicted[k] = x[k] + (x[k] - previous[k]) * (next - p) / (p - pPrevious);
+                else predicted[k] = x[k];
+            }
+            apply(next);
+            auto before = iterations();
+            auto converged = sim._solve(predicted, nullptr, 0.0, 0.0, 1.0);
+            auto used = iterations() - before;
+
+            if (!converged) {
+                h /= 4;
+                if (std::abs(h) >= _sweepOptions.minStep * std::abs(grid)) continue;
+                // continuation is stuck, likely a fold. restart from zero at the grid point.
+                apply(target);
+                predicted = sim.solveOperatingPoint();
+                stats.coldStarts++;
+                next = target;
+                h = grid;
+            } else if (used <= _sweepOptions.targetIterations) {
+                h = std::abs(2 * h) > std::abs(grid) ? grid : 2 * h;
+            } else if (used > 2 * _sweepOptions.targetIterations) {
+                h /= 2;
+            }
+
+            if (next != target) stats.substeps++;
+            previous = x;
+            x = predicted;
+            pPrevious = p;
+            p = next;
+            if (tangential) updateTangent();
+        }
+        result.x[i] = x;
+        stats.points++;
+    }
+    stats.newtonIterations += iterations();
+}
@@ -0,0 +1,128 @@
+#include "dense.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "memory.hpp"
+
+const int DenseLU::MAX_SIZE;
+
+namespace {
+    template <int N> void factorKernel(double *a, int *pivot) {
+        for (int k = 0; k < N; k++) {
+            int p = k;
+            double best = std::abs(a[k * N + k]);
+            for (int i = k + 1; i < N; i++) {
+                if (std::abs(a[i * N + k]) > best) {
+                    best = std::abs(a[i * N + k]);
+                    p = i;
+                }
+            }
+            if (best < 1e-300) throw std::runtime_error("zero pivot encountered at row " + std::to_string(k));
+            pivot[k] = p;
+            if (p != k) for (int j = 0; j < N; j++) std::swap(a[k * N + j], a[p * N + j]);
+
+            auto inverse = 1.0 / a[k * N + k];
+            for (int i = k + 1; i < N; i++) {
+                auto l = a[i * N + k] *= inverse;
+                if (l == 0.0) continue;
+                for (int j = k + 1; j < N; j++) a[i * N + j] -= l * a[k * N + j];
+            }
+        }
+    }
+
+    template <int N> void solveKernel(const double *a, const int *pivot, double *x) {
+        // P A = L U: permute, then unit lower and upper triangular sweeps
+        for (int k = 0; k < N; k++) if (pivot[k] != k) std::swap(x[k], x[pivot[k]]);
+        for (int i = 1; i < N; i++) {
+            auto sum = x[i];
+            for (int j = 0; j < i; j++) sum -= a[i * N + j] * x[j];
+            x[i] = sum;
+        }
+        for (int i = N - 1; i >= 0; i--) {
+            auto sum = x[i];
+            for (int j = i + 1; j < N; j++) sum -= a[i * N + j] * x[j];
+            x[i] = sum / a[i * N + i];
+        }
+    }
+
+    template <int N> void solveTransposeKernel(const double *a, const int *pivot, double *x) {
+        // A^T = U^T L^T P: U^T then L^T, then undo the row swaps in reverse order
+        for (int i = 0; i < N; i++) {
+            auto sum = x[i];
+            for (int j = 0; j < i; j++) sum -= a[j * N + i] * x[j];
+            x[i] = sum / a[i * N + i];
+        }
+        for (int i = N - 1; i >= 0; i--) {
+            auto sum = x[i];
+            for (int j = i + 1; j < N; j++) sum -= a[j * N + i] * x[j];
+            x[i] = sum;
+        }
+        for (int k = N - 1; k >= 0; k--) if (pivot[k] != k) std::swap(x[k], x[pivot[k]]);
+    }
+
+    template <int N> void bind(void (*&factor)(double *, int *), void (*&solve)(const double *, const int *, double *),
+                               void (*&solveTranspose)(const double *, const int *, double *)) {
+        factor = factorKernel<N>;
+        solve = solveKernel<N>;
+        solveTranspose = solveTransposeKernel<N>;
+    }
+}
+
+DenseLU::DenseLU(int size) : _size(size) {
+    if (size > MAX_SIZE) throw std::runtime_error("dense LU is limited to " + std::to_string(MAX_SIZE) + " unknowns");
+    if (size <= 8) {
+        _padded = 8;
+        bind<8>(_factor, _solve, _solveTranspose);
+    } else if (size <= 16) {
+        _padded = 16;
+        bind<16>(_factor, _solve, _solveTranspose);
+    } else if (size <= 32) {
+        _padded = 32;
+        bind<32>(_factor, _solve, _solveTranspose);
+    } else {
+        _padded = 64;
+        bind<64>(_factor, _solve, _solveTranspose);
+    }
+    _lu.assign(_padded * _padded, 0.0);
+    _pivot.assign(_padded, 0);
+    _work.assign(_padded, 0.0);
+}
+
+void DenseLU::factor(const std::vector<double> &values) {
+    // the padding rows are identity and stay untouched by the pivot search of real rows
+    _lu = values;
+    for (int i = _size; i < _padded; i++) _lu[i * _padded + i] = 1.0;
+    _factor(_lu.data(), _pivot.data());
+}
+
+void DenseLU::solve(std::vector<double> &rhs) const {
+    std::copy(rhs.begin(), rhs.begin() + _size, _work.begin());
+    _solve(_lu.data(), _pivot.data(), _work.data());
+    std::copy(_work.begin(), _work.begin() + _size, rhs.begin());
+}
+
+void DenseLU::solveTranspose(std::vector<double> &rhs) const {
+    std::copy(rhs.begin(), rhs.begin() + _size, _work.begin());
+    _solveTranspose(_lu.data(), _pivot.data(), _work.data());
+    std::copy(_work.begin(), _work.begin() + _size, rhs.begin());
+}
+
+std::vector<double> DenseLU::getFactors() const {
+    auto factors = _lu;
+    factors.insert(factors.end(), _pivot.begin(), _pivot.end());
+    return factors;
+}
+
+void DenseLU::setFactors(const std::vector<double> &factors) {
+    if (factors.size() != _lu.size() + _pivot.size()) throw std::runtime_error("factors do not match the dense matrix");
+    std::copy(factors.begin(), factors.begin() + _lu.size(), _lu.begin());
+    for (size_t i = 0; i < _pivot.size(); i++) _pivot[i] = int(factors[_lu.size() + i]);
+}
+
+size_t DenseLU::getMemory() const {
+    return MemoryReport::bytes(_lu) + MemoryReport::bytes(_pivot) + MemoryReport::bytes(_work);
+}
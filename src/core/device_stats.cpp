@@ -0,0 +1,104 @@
+#include "device_stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+    using Field = long DeviceStats::Counters::*;
+
+    Field field(DeviceStats::Key key) {
+        switch (key) {
+        case DeviceStats::Key::Evaluations: return &DeviceStats::Counters::evaluations;
+        case DeviceStats::Key::Bypassed: return &DeviceStats::Counters::bypassed;
+        case DeviceStats::Key::Limited: return &DeviceStats::Counters::limited;
+        case DeviceStats::Key::WorstResidual: return &DeviceStats::Counters::worstResidual;
+        case DeviceStats::Key::Rejections: return &DeviceStats::Counters::rejections;
+        }
+        return &DeviceStats::Counters::evaluations;
+    }
+}
+
+const char *DeviceStats::getName(Key key) {
+    switch (key) {
+    case Key::Evaluations: return "evaluations";
+    case Key::Bypassed: return "bypassed";
+    case Key::Limited: return "limited";
+    case Key::WorstResidual: return "worst_residual";
+    case Key::Rejections: return "rejections";
+    }
+    return "";
+}
+
+void DeviceStats::attach(const Netlist &netlist) {
+    auto &fets = netlist.getFets();
+    _counters.assign(fets.size(), Counters());
+    _current.assign(fets.size(), 0.0);
+
+    // node -> FETs touching it, a terminal shared by d, g and s counts once
+    _first.assign(size_t(netlist.getNodeCount()) + 1, 0);
+    auto terminals = [](const Netlist::FetInstance &f, std::vector<int> &nodes) {
+        nodes = {f.d, f.g, f.s};
+        std::sort(nodes.begin(), nodes.end());
+        nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+    };
+    std::vector<int> nodes;
+    for (auto &f : fets) {
+        terminals(f, nodes);
+        for (auto node : nodes) _first[size_t(node) + 1]++;
+    }
+    for (size_t i = 1; i < _first.size(); i++) _first[i] += _first[i - 1];
+    _fets.resize(size_t(_first.back()));
+    auto fill = _first;
+    for (size_t k = 0; k < fets.size(); k++) {
+        terminals(fets[k], nodes);
+        for (auto node : nodes) _fets[size_t(fill[size_t(node)]++)] = int(k);
+    }
+}
+
+void DeviceStats::reset() {
+    std::fill(_counters.begin(), _counters.end(), Counters());
+}
+
+void DeviceStats::add(const DeviceStats &other) {
+    if (other._counters.size() != _counters.size()) throw std::runtime_error("device statistics of different circuits");
+    for (size_t k = 0; k < _counters.size(); k++) {
+        for (auto key : {Key::Evaluations, Key::Bypassed, Key::Limited, Key::WorstResidual, Key::Rejections}) {
+            _counters[k].*field(key) += other._counters[k].*field(key);
+        }
+    }
+}
+
+int DeviceStats::blame(int node) const {
+    if (node < 0 || size_t(node) + 1 >= _first.size()) return -1;
+    int worst = -1;
+    for (auto i = _first[size_t(node)]; i < _first[size_t(node) + 1]; i++) {
+        auto fet = _fets[size_t(i)];
+        if (worst < 0 || _current[size_t(fet)] > _current[size_t(worst)]) worst = fet;
+    }
+    return worst;
+}
+
+std::vector<int> DeviceStats::top(Key key, size_t count) const {
+    auto member = field(key);
+    std::vector<int> order;
+    for (size_t k = 0; k < _counters.size(); k++) {
+        if (_counters[k].*member > 0) order.push_back(int(k));
+    }
+    auto last = order.begin() + long(std::min(count, order.size()));
+    std::partial_sort(order.begin(), last, order.end(), [&](int a, int b) {
+        auto ca = _counters[size_t(a)].*member, cb = _counters[size_t(b)].*member;
+        return ca != cb ? ca > cb : a < b;
+    });
+    order.erase(last, order.end());
+    return order;
+}
+
+void DeviceStats::write(std::ostream &out, const Netlist &netlist) const {
+    out << "fet,evaluations,bypassed,limited,worst_residual,rejections\n";
+    for (size_t k = 0; k < _counters.size(); k++) {
+        auto &c = _counters[k];
+        if (!c.evaluations && !c.bypassed && !c.limited && !c.worstResidual && !c.rejections) continue;
+        out << netlist.getFetName(int(k)) << "," << c.evaluations << "," << c.bypassed << "," << c.limited << "," << c.worstResidual << "," << c.rejections << "\n";
+    }
+}
@@ -0,0 +1,58 @@
+#include "kernel_profile.hpp"
+
+const char *KernelProfile::getName(Phase phase) {
+    switch (phase) {
+    case Phase::Devices: return "devices";
+    case Phase::Load: return "load";
+    case Phase::Factor: return "factor";
+    case Phase::Solve: return "solve";
+    }
+    return "";
+}
+
+void KernelProfile::end(Phase phase, double units) {
+    auto now = _counters.read();
+    auto &totals = _totals[size_t(phase)];
+    totals.calls++;
+    totals.units += units;
+    totals.seconds += now.seconds - _start.seconds;
+    for (size_t e = 0; e < totals.counts.size(); e++) totals.counts[e] += now.counts[e] - _start.counts[e];
+}
+
+void KernelProfile::reset() {
+    _totals.fill(Totals());
+}
+
+double KernelProfile::getIpc(Phase phase) const {
+    auto &totals = get(phase);
+    if (!hasEvent(PerfCounters::Cycles) || !hasEvent(PerfCounters::Instructions) || totals.counts[PerfCounters::Cycles] <= 0.0) return 0.0;
+    return totals.counts[PerfCounters::Instructions] / totals.counts[PerfCounters::Cycles];
+}
+
+double KernelProfile::getPerUnit(Phase phase, PerfCounters::Event event) const {
+    auto &totals = get(phase);
+    return totals.units > 0.0 ? totals.counts[event] / totals.units : 0.0;
+}
+
+void KernelProfile::write(std::ostream &out) const {
+    out << "phase,calls,units,seconds,ns_per_unit";
+    for (int e = 0; e < PerfCounters::EVENTS; e++) out << "," << PerfCounters::event_name(PerfCounters::Event(e));
+    out << ",ipc,cache_misses_per_unit,branch_misses_per_unit\n";
+    for (auto phase : {Phase::Devices, Phase::Load, Phase::Factor, Phase::Solve}) {
+        auto &totals = get(phase);
+        if (!totals.calls) continue;
+        out << getName(phase) << "," << totals.calls << "," << totals.units << "," << totals.seconds << ",";
+        out << (totals.units > 0.0 ? totals.seconds / totals.units * 1e9 : 0.0);
+        for (int e = 0; e < PerfCounters::EVENTS; e++) {
+            out << ",";
+            if (hasEvent(PerfCounters::Event(e))) out << totals.counts[e];
+        }
+        out << ",";
+        if (hasEvent(PerfCounters::Cycles) && hasEvent(PerfCounters::Instructions)) out << getIpc(phase);
+        for (auto event : {PerfCounters::CacheMisses, PerfCounters::BranchMisses}) {
+            out << ",";
+            if (hasEvent(event)) out << getPerUnit(phase, event);
+        }
+        out << "\n";
+    }
+}
@@ -0,0 +1,125 @@
+#include "krylov.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "memory.hpp"
+
+namespace {
+    const int ROWS_PER_TASK = 16384;
+
+    double dot(const std::vector<double> &a, const std::vector<double> &b) {
+        double sum = 0.0;
+        for (size_t i = 0; i < a.size(); i++) sum += a[i] * b[i];
+        return sum;
+    }
+}
+
+KrylovSolver::KrylovSolver(const SparseMatrix &matrix, const SparseLU &preconditioner, const Options &options, int threads)
+    : _matrix(matrix), _preconditioner(preconditioner), _options(options)
+{
+    if (threads != 1 && matrix.size() >= 4 * ROWS_PER_TASK) _pool = std::make_unique<ThreadPool>(unsigned(std::max(threads, 0)));
+    auto m = std::max(_options.restart, 1);
+    _basis.assign(m + 1, std::vector<double>(matrix.size()));
+    _hessenberg.assign(m + 1, std::vector<double>(m, 0.0));
+    _cos.assign(m, 0.0);
+    _sin.assign(m, 0.0);
+    _g.assign(m + 1, 0.0);
+    _w.assign(matrix.size(), 0.0);
+    _z.assign(matrix.size(), 0.0);
+}
+
+void KrylovSolver::_multiply(const std::vector<double> &x, std::vector<double> &y) {
+    auto size = _matrix.size();
+    if (!_pool) {
+        _matrix.multiply(x, y, 0, size);
+        return;
+    }
+    auto tasks = (size + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+    _pool->parallel_for(size_t(tasks), [&](size_t t) {
+        auto first = int(t) * ROWS_PER_TASK;
+        _matrix.multiply(x, y, first, std::min(size, first + ROWS_PER_TASK));
+    });
+}
+
+double KrylovSolver::_residual(const std::vector<double> &rhs, const std::vector<double> &x, std::vector<double> &r) {
+    _multiply(x, r);
+    for (size_t i = 0; i < r.size(); i++) r[i] = rhs[i] - r[i];
+    return std::sqrt(dot(r, r));
+}
+
+int KrylovSolver::solve(const std::vector<double> &rhs, std::vector<double> &x) {
+    // right preconditioned GMRES(m): minimizes |rhs - A M^-1 u| over the Krylov space and
+    // updates x += M^-1 u, so the residual that is monitored is the true one
+    auto m = int(_cos.size());
+    auto target = _options.tolerance * std::sqrt(dot(rhs, rhs));
+    auto beta = _residual(rhs, x, _basis[0]);
+    if (beta <= target) return 0;
+
+    int iterations = 0;
+    while (iterations < _options.maxIterations) {
+        for (auto &v : _basis[0]) v /= beta;
+        std::fill(_g.begin(), _g.end(), 0.0);
+        _g[0] = beta;
+
+        int k = 0;
+        while (k < m && iterations < _options.maxIterations) {
+            _z = _basis[k];
+            _preconditioner.solve(_z);
+            _multiply(_z, _w);
+            iterations++;
+
+            // modified Gram-Schmidt against the basis so far
+            for (int i = 0; i <= k; i++) {
+                auto h = dot(_w, _basis[i]);
+                _hessenberg[i][k] = h;
+                for (size_t r = 0; r < _w.size(); r++) _w[r] -= h * _basis[i][r];
+            }
+            auto norm = std::sqrt(dot(_w, _w));
+            _hessenberg[k + 1][k] = norm;
+            if (norm > 0.0) for (size_t r = 0; r < _w.size(); r++) _basis[k + 1][r] = _w[r] / norm;
+
+            // reduce the new column with the previous rotations, then eliminate its subdiagonal
+            for (int i = 0; i < k; i++) {
+                auto a = _hessenberg[i][k], b = _hessenberg[i + 1][k];
+                _hessenberg[i][k] = _cos[i] * a + _sin[i] * b;
+                _hessenberg[i + 1][k] = -_sin[i] * a + _cos[i] * b;
+            }
+            auto a = _hessenberg[k][k], b = _hessenberg[k + 1][k];
+            auto r = std::hypot(a, b);
+            _cos[k] = r > 0.0 ? a / r : 1.0;
+            _sin[k] = r > 0.0 ? b / r : 0.0;
+            _hessenberg[k][k] = r;
+            _hessenberg[k + 1][k] = 0.0;
+            _g[k + 1] = -_sin[k] * _g[k];
+            _g[k] = _cos[k] * _g[k];
+            k++;
+            if (std::abs(_g[k]) <= target || norm == 0.0) break;
+        }
+
+        // back substitution for the basis weights, then x += M^-1 (V y)
+        std::vector<double> y(k);
+        for (int i = k - 1; i >= 0; i--) {
+            auto sum = _g[i];
+            for (int j = i + 1; j < k; j++) sum -= _hessenberg[i][j] * y[j];
+            y[i] = _hessenberg[i][i] != 0.0 ? sum / _hessenberg[i][i] : 0.0;
+        }
+        std::fill(_z.begin(), _z.end(), 0.0);
+        for (int i = 0; i < k; i++) for (size_t r = 0; r < _z.size(); r++) _z[r] += y[i] * _basis[i][r];
+        _preconditioner.solve(_z);
+        for (size_t r = 0; r < x.size(); r++) x[r] += _z[r];
+
+        beta = _residual(rhs, x, _basis[0]);
+        if (!std::isfinite(beta)) return -1;
+        if (beta <= target) return iterations;
+    }
+    return -1;
+}
+
+size_t KrylovSolver::getMemory() const {
+    auto total = MemoryReport::bytes(_basis) + MemoryReport::bytes(_hessenberg);
+    for (auto &v : _basis) total += MemoryReport::bytes(v);
+    for (auto &row : _hessenberg) total += MemoryReport::bytes(row);
+    for (auto v : {&_cos, &_sin, &_g, &_w, &_z}) total += MemoryReport::bytes(*v);
+    return total;
+}
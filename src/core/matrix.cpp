@@ -0,0 +1,320 @@
+#include "matrix.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "mapped_file.hpp"
+#include "memory.hpp"
+
+SparseMatrix::SparseMatrix(int size)
+    : _size(size), _finalized(false), _stride(0), _reserved(size), _hasDiagonal(size, false) {}
+
+void SparseMatrix::reserve(int row, int col) {
+    // ground connections are passed in as negative indices and never stored
+    if (row < 0 || col < 0) return;
+    if (_finalized) throw std::runtime_error("cannot reserve entries in a finalized matrix");
+    if (row == col) {
+        _hasDiagonal[row] = true;
+    } else {
+        _reserved[row].insert(col);
+        _reserved[col].insert(row);
+    }
+}
+
+void SparseMatrix::finalize(bool fill) {
+    // minimum degree ordering on the symmetrized pattern; eliminating a variable turns its
+    // remaining neighbours into a clique, which is exactly the fill it causes. variables with a
+    // structurally zero diagonal (e.g. voltage source branch currents) are only eligible once a
+    // neighbour has been eliminated and has filled in their diagonal.
+    auto &adj = _reserved;
+    // heap of the adjacency sets and pivot lists as they grow, for getSymbolicPeak()
+    auto node = MemoryReport::setNodeBytes();
+    size_t entries = 0, pivotEntries = 0;
+    for (auto &row : adj) entries += row.size();
+    auto base = MemoryReport::bytes(adj) - entries * node + size_t(_size) * (sizeof(std::vector<int>) + 2 * sizeof(int));
+    if (fill) base += size_t(_size) * node;             // the degree queue
+    _symbolicPeak = base + entries * node;
+    std::vector<int> degree(_size);
+    std::vector<bool> eligible(_hasDiagonal);
+    std::set<std::pair<int, int>> queue;
+    for (int i = 0; i < _size && fill; i++) {
+        degree[i] = int(adj[i].size());
+        if (eligible[i]) queue.insert({degree[i], i});
+    }
+
+    std::vector<std::vector<int>> pivotNeighbours(_size);
+    _perm.assign(_size, -1);
+    for (int k = 0; k < _size && !fill; k++) {
+        // natural order, which puts branch currents after the nodes that fill their diagonal
+        _perm[k] = k;
+        pivotNeighbours[k].assign(adj[k].upper_bound(k), adj[k].end());
+        for (auto j : pivotNeighbours[k]) entries -= adj[j].erase(k);
+        entries -= adj[k].size();
+        pivotEntries += pivotNeighbours[k].size();
+        adj[k].clear();
+    }
+    for (int k = 0; k < _size && fill; k++) {
+        if (queue.empty()) throw std::runtime_error("matrix is structurally singular");
+        auto p = queue.begin()->second;
+        queue.erase(queue.begin());
+        _perm[k] = p;
+
+        std::vector<int> nbrs(adj[p].begin(), adj[p].end());
+        for (auto u : nbrs) entries -= adj[u].erase(p);
+        for (auto u : nbrs) {
+            for (auto v : nbrs) if (u != v) entries += adj[u].insert(v).second;
+            if (eligible[u]) queue.erase({degree[u], u});
+            eligible[u] = true;
+            degree[u] = int(adj[u].size());
+            queue.insert({degree[u], u});
+        }
+        pivotEntries += nbrs.size();
+        _symbolicPeak = std::max(_symbolicPeak, base + entries * node + pivotEntries * sizeof(int));
+        pivotNeighbours[k] = std::move(nbrs);
+        entries -= adj[p].size();
+        adj[p].clear();
+    }
+    _reserved.clear();
+    _reserved.shrink_to_fit();
+
+    _iperm.assign(_size, -1);
+    for (int k = 0; k < _size; k++) _iperm[_perm[k]] = k;
+
+    // permuted pattern: pivot k owns U(k, j) and L(j, k) for every neighbour j at elimination
+    std::vector<std::vector<int>> rows(_size);
+    for (int k = 0; k < _size; k++) {
+        rows[k].push_back(k);
+        for (auto &j : pivotNeighbours[k]) {
+            j = _iperm[j];
+            rows[k].push_back(j);
+            rows[j].push_back(k);
+        }
+        std::sort(pivotNeighbours[k].begin(), pivotNeighbours[k].end());
+    }
+    _rowPtr.assign(_size + 1, 0);
+    _colIdx.clear();
+    _diag.assign(_size, -1);
+    for (int i = 0; i < _size; i++) {
+        std::sort(rows[i].begin(), rows[i].end());
+        for (auto j : rows[i]) {
+            if (j == i) _diag[i] = int(_colIdx.size());
+            _colIdx.push_back(j);
+        }
+        _rowPtr[i + 1] = int(_colIdx.size());
+    }
+
+    // elimination schedule in terms of value slots
+    _pivotPtr.assign(1, 0);
+    _opPtr.assign(1, 0);
+    _lower.clear();
+    _upper.clear();
+    _ops.clear();
+    for (int k = 0; k < _size; k++) {
+        auto &nbrs = pivotNeighbours[k];
+        for (auto i : nbrs) {
+            _lower.push_back(_find(i, k));
+            _upper.push_back(_find(k, i));
+        }
+        for (auto i : nbrs) for (auto j : nbrs) _ops.push_back(fill ? _find(i, j) : _search(i, j));
+        _pivotPtr.push_back(int(_lower.size()));
+        _opPtr.push_back(int(_ops.size()));
+    }
+
+    _values.assign(_colIdx.size() + (fill ? 0 : 1), 0.0);
+    _finalized = true;
+    // the pivot lists and the permuted rows are alive until the schedule is complete
+    auto rowBytes = size_t(_size) * sizeof(std::vector<int>) + (size_t(_size) + 2 * pivotEntries) * sizeof(int);
+    _symbolicPeak = std::max(_symbolicPeak, base + pivotEntries * sizeof(int) + rowBytes + getMemory());
+}
+
+void SparseMatrix::finalizeDense(int stride) {
+    // every entry gets a slot, so neither the reserved pattern nor a sparse layout from an
+    // earlier finalize() is needed
+    if (stride < _size) throw std::runtime_error("dense stride is smaller than the matrix");
+    _reserved.clear();
+    _reserved.shrink_to_fit();
+    for (auto table : {&_perm, &_iperm, &_rowPtr, &_colIdx, &_diag, &_pivotPtr, &_lower, &_upper, &_opPtr, &_ops}) table->clear();
+    _stride = stride;
+    _values.assign(size_t(stride) * stride, 0.0);
+    _finalized = true;
+}
+
+uint64_t SparseMatrix::getPatternHash(bool fill) const {
+    // every input of finalize(fill): the size, the diagonals and the symmetrized off-diagonal rows
+    if (_finalized) throw std::runtime_error("the pattern of a finalized matrix is gone");
+    int32_t header[2] = {_size, fill ? 1 : 0};
+    auto hash = hash_bytes(header, sizeof(header));
+    std::vector<int32_t> row;
+    for (int i = 0; i < _size; i++) {
+        row.assign(1, _hasDiagonal[i] ? -1 : -2);
+        row.insert(row.end(), _reserved[i].begin(), _reserved[i].end());
+        row.push_back(-3);
+        hash = hash_bytes(row.data(), row.size() * sizeof(int32_t), hash);
+    }
+    return hash;
+}
+
+size_t SparseMatrix::getMemory() const {
+    auto total = MemoryReport::bytes(_reserved) + _hasDiagonal.capacity() / 8 + MemoryReport::bytes(_values);
+    for (auto table : {&_perm, &_iperm, &_rowPtr, &_colIdx, &_diag, &_pivotPtr, &_lower, &_upper, &_opPtr, &_ops}) total += MemoryReport::bytes(*table);
+    return total;
+}
+
+int SparseMatrix::_find(int row, int col) const {
+    // slot of a permuted (row, col) entry, which must be part of the pattern
+    auto first = _colIdx.begin() + _rowPtr[row];
+    auto last = _colIdx.begin() + _rowPtr[row + 1];
+    auto it = std::lower_bound(first, last, col);
+    if (it == last || *it != col) throw std::runtime_error("entry is not part of the matrix pattern");
+    return int(it - _colIdx.begin());
+}
+
+int SparseMatrix::_search(int row, int col) const {
+    // like _find, but entries outside the pattern map to the sink slot past the last entry
+    auto first = _colIdx.begin() + _rowPtr[row];
+    auto last = _colIdx.begin() + _rowPtr[row + 1];
+    auto it = std::lower_bound(first, last, col);
+    if (it == last || *it != col) return int(_colIdx.size());
+    return int(it - _colIdx.begin());
+}
+
+int SparseMatrix::getSlot(int row, int col) const {
+    // value slot of an unpermuted entry, -1 for ground connections
+    if (row < 0 || col < 0) return -1;
+    if (_stride) return row * _stride + col;
+    return _find(_iperm[row], _iperm[col]);
+}
+
+void SparseMatrix::clear() {
+    std::fill(_values.begin(), _values.end(), 0.0);
+}
+
+void SparseMatrix::multiply(const std::vector<double> &x, std::vector<double> &y, int first, int last) const {
+    for (int i = first; i < last; i++) {
+        double sum = 0.0;
+        for (int p = _rowPtr[i]; p < _rowPtr[i + 1]; p++) sum += _values[p] * x[_perm[_colIdx[p]]];
+        y[_perm[i]] = sum;
+    }
+}
+
+
+void SparseMatrix::multiplyTranspose(const std::vector<double> &x, std::vector<double> &y) const {
+    std::fill(y.begin(), y.end(), 0.0);
+    for (int i = 0; i < _size; i++) {
+        auto xi = x[_perm[i]];
+        for (int p = _rowPtr[i]; p < _rowPtr[i + 1]; p++) y[_perm[_colIdx[p]]] += _values[p] * xi;
+    }
+}
+
+
+SparseLU::SparseLU(const SparseMatrix &matrix)
+    : _matrix(&matrix), _single(false), _lu(matrix._values.size(), 0.0), _work(matrix.size(), 0.0) {}
+
+size_t SparseLU::getMemory() const {
+    return MemoryReport::bytes(_lu) + MemoryReport::bytes(_luSingle) + MemoryReport::bytes(_work);
+}
+
+size_t SparseLU::getProjectedMemory() const {
+    auto values = _matrix->_values.size() * (_single ? sizeof(float) : sizeof(double));
+    return std::max(getMemory(), values + size_t(_matrix->size()) * sizeof(double));
+}
+
+void SparseLU::setSinglePrecision(bool single) {
+    _single = single;
+    std::vector<double>().swap(_lu);
+    std::vector<float>().swap(_luSingle);
+}
+
+void SparseLU::factor() {
+    auto &m = *_matrix;
+    if (_single) {
+        _luSingle.assign(m._values.begin(), m._values.end());
+        _factor(_luSingle);
+    } else {
+        _lu = m._values;
+        _factor(_lu);
+    }
+}
+
+void SparseLU::solve(std::vector<double> &rhs) const {
+    if (_single) _solve(_luSingle, rhs);
+    else _solve(_lu, rhs);
+}
+
+void SparseLU::solveTranspose(std::vector<double> &rhs) const {
+    if (_single) _solveTranspose(_luSingle, rhs);
+    else _solveTranspose(_lu, rhs);
+}
+
+std::vector<double> SparseLU::getFactors() const {
+    if (_single) return std::vector<double>(_luSingle.begin(), _luSingle.end());
+    return _lu;
+}
+
+void SparseLU::setFactors(const std::vector<double> &factors) {
+    if (factors.size() != _matrix->_values.size()) throw std::runtime_error("factors do not match the matrix");
+    if (_single) _luSingle.assign(factors.begin(), factors.end());
+    else _lu = factors;
+}
+
+template <typename T>
+void SparseLU::_factor(std::vector<T> &lu) {
+    // right-looking LU without pivoting, following the schedule built by finalize()
+    auto &m = *_matrix;
+    const T tiny = std::is_same<T, float>::value ? std::numeric_limits<float>::min() : T(1e-300);
+    for (int k = 0; k < m._size; k++) {
+        auto pivot = lu[m._diag[k]];
+        if (std::abs(pivot) < tiny) throw std::runtime_error("zero pivot encountered at row " + std::to_string(m._perm[k]));
+
+        auto first = m._pivotPtr[k], last = m._pivotPtr[k + 1];
+        for (int i = first; i < last; i++) lu[m._lower[i]] /= pivot;
+
+        auto op = m._opPtr[k];
+        auto width = last - first;
+        for (int i = first; i < last; i++) {
+            auto l = lu[m._lower[i]];
+            if (l == T(0)) {
+                op += width;
+                continue;
+            }
+            for (int j = first; j < last; j++) lu[m._ops[op++]] -= l * lu[m._upper[j]];
+        }
+    }
+}
+
+template <typename T>
+void SparseLU::_solve(const std::vector<T> &lu, std::vector<double> &rhs) const {
+    // solves A x = rhs in place
+    auto &m = *_matrix;
+    auto &y = _work;
+    for (int k = 0; k < m._size; k++) y[k] = rhs[m._perm[k]];
+    for (int i = 0; i < m._size; i++) {
+        for (int p = m._rowPtr[i]; p < m._diag[i]; p++) y[i] -= double(lu[p]) * y[m._colIdx[p]];
+    }
+    for (int i = m._size - 1; i >= 0; i--) {
+        for (int p = m._diag[i] + 1; p < m._rowPtr[i + 1]; p++) y[i] -= double(lu[p]) * y[m._colIdx[p]];
+        y[i] /= double(lu[m._diag[i]]);
+    }
+    for (int k = 0; k < m._size; k++) rhs[m._perm[k]] = y[k];
+}
+
+template <typename T>
+void SparseLU::_solveTranspose(const std::vector<T> &lu, std::vector<double> &rhs) const {
+    // solves A^T x = rhs in place using the same factors (U^T then L^T)
+    auto &m = *_matrix;
+    auto &y = _work;
+    for (int k = 0; k < m._size; k++) y[k] = rhs[m._perm[k]];
+    for (int i = 0; i < m._size; i++) {
+        y[i] /= double(lu[m._diag[i]]);
+        for (int p = m._diag[i] + 1; p < m._rowPtr[i + 1]; p++) y[m._colIdx[p]] -= double(lu[p]) * y[i];
+    }
+    for (int i = m._size - 1; i >= 0; i--) {
+        for (int p = m._rowPtr[i]; p < m._diag[i]; p++) y[m._colIdx[p]] -= double(lu[p]) * y[i];
+    }
+    for (int k = 0; k < m._size; k++) rhs[m._perm[k]] = y[k];
+}
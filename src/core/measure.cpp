@@ -0,0 +1,295 @@
+#include "measure.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+MeasureEngine::MeasureEngine(const Simulator &simulator)
+    : _sim(simulator), _started(false), _time(0.0) {}
+
+int MeasureEngine::_getSignal(const std::string &name) {
+    // intern a signal so every statement sharing it evaluates it once per point
+    auto it = std::find(_signalNames.begin(), _signalNames.end(), name);
+    if (it != _signalNames.end()) return int(it - _signalNames.begin());
+
+    auto fail = [&]() -> int { throw std::runtime_error("invalid measure signal [ " + name + " ]"); };
+    if (name.size() < 4 || name[1] != '(' || name.back() != ')') return fail();
+    auto inner = name.substr(2, name.size() - 3);
+    auto &netlist = _sim.getNetlist();
+
+    Signal signal = {Signal::Kind::Voltage, -1, -1, {}, {}};
+    switch (name[0]) {
+    case 'v': {
+        auto comma = inner.find(',');
+        auto pos = netlist.findNode(inner.substr(0, comma));
+        auto neg = comma == std::string::npos ? Netlist::GROUND : netlist.findNode(inner.substr(comma + 1));
+        if (pos < 0 || neg < 0) return fail();
+        signal.a = _sim.getNodeIndex(pos);
+        signal.b = _sim.getNodeIndex(neg);
+        break;
+    }
+    case 'i':
+        signal.kind = Signal::Kind::Current;
+        signal.a = _sim.getIndex(name);
+        break;
+    case 'p': {
+        signal.kind = Signal::Kind::Power;
+        // a subcircuit instance owns a contiguous range of the flat FET table
+        Netlist::Block block;
+        auto fet = netlist.findFet(inner), source = netlist.findVSource(inner);
+        if (fet >= 0) signal.fets.push_back(fet);
+        if (source >= 0) signal.sources.push_back(source);
+        if (netlist.findInstance(inner, block)) {
+            for (int k = 0; k < block.size.fets; k++) signal.fets.push_back(block.first.fets + k);
+        } else if (fet < 0 && source < 0) {
+            // flattened copies (e.g. after RCReduction) have no instances left, only the dotted
+            // names of the FETs that were under them
+            auto prefix = inner + ".";
+            for (int k = 0; k < int(netlist.getFets().size()); k++) {
+                if (netlist.getFetName(k).compare(0, prefix.size(), prefix) == 0) signal.fets.push_back(k);
+            }
+        }
+        if (signal.fets.empty() && signal.sources.empty()) return fail();
+        break;
+    }
+    default:
+        return fail();
+    }
+
+    _signalNames.push_back(name);
+    _signals.push_back(signal);
+    return int(_signals.size()) - 1;
+}
+
+double MeasureEngine::_evaluate(const Signal &signal, const std::vector<double> &x) const {
+    auto at = [&](int index) { return index < 0 ? 0.0 : x[index]; };
+    switch (signal.kind) {
+    case Signal::Kind::Voltage:
+        return at(signal.a) - at(signal.b);
+    case Signal::Kind::Current:
+        return at(signal.a);
+    case Signal::Kind::Power: {
+        auto &netlist = _sim.getNetlist();
+        double power = 0.0;
+        for (auto k : signal.fets) {
+            auto &fet = netlist.getFets()[k];
+            auto Vd = at(_sim.getNodeIndex(fet.d)), Vg = at(_sim.getNodeIndex(fet.g)), Vs = at(_sim.getNodeIndex(fet.s));
+            power += PlanarFET::getInstantaneousPower(netlist.getTech(fet.tech), fet.W, Vg - Vs, Vd - Vs, fet.devType);
+        }
+        for (auto k : signal.sources) power += _sim.getSourcePower(k, x);
+        return power;
+    }
+    }
+    return 0.0;
+}
+
+void MeasureEngine::_parseCrossing(Crossing &crossing, const std::vector<std::string> &args, size_t &pos, const std::string &name) {
+    // <sig> val=<v> [td=<t>] [rise|fall|cross=<n>], <sig>=<v> ..., or at=<t>
+    auto fail = [&](const std::string &message) { throw std::runtime_error("measure " + name + ": " + message); };
+    if (pos >= args.size()) fail("missing signal");
+
+    auto &first = args[pos++];
+    if (first.rfind("at=", 0) == 0) {
+        crossing.time = Netlist::parseValue(first.substr(3));
+        return;
+    }
+    auto close = first.find(')');
+    if (close == std::string::npos) fail("invalid signal '" + first + "'");
+    crossing.signal = _getSignal(first.substr(0, close + 1));
+    bool hasValue = false;
+    if (close + 1 < first.size()) {
+        if (first[close + 1] != '=') fail("invalid signal '" + first + "'");
+        crossing.value = Netlist::parseValue(first.substr(close + 2));
+        hasValue = true;
+    }
+
+    while (pos < args.size() && args[pos].find('=') != std::string::npos) {
+        auto eq = args[pos].find('=');
+        auto key = args[pos].substr(0, eq);
+        auto value = args[pos].substr(eq + 1);
+        if (key == "val") {
+            crossing.value = Netlist::parseValue(value);
+            hasValue = true;
+        } else if (key == "td") {
+            crossing.td = Netlist::parseValue(value);
+        } else if (key == "rise" || key == "fall" || key == "cross") {
+            crossing.edge = key == "rise" ? 1 : key == "fall" ? -1 : 0;
+            crossing.count = std::stoi(value);
+            if (crossing.count < 1) fail("edge count must be positive");
+        } else {
+            break;
+        }
+        pos++;
+    }
+    if (!hasValue) fail("missing val= for '" + first + "'");
+}
+
+void MeasureEngine::add(const std::vector<std::string> &args) {
+    size_t pos = 0;
+    if (pos < args.size() && args[pos] == "tran") pos++;
+    if (pos + 2 > args.size()) throw std::runtime_error(".measure expects a name and a measurement");
+
+    Statement statement;
+    statement.name = args[pos++];
+    auto keyword = args[pos++];
+    auto fail = [&](const std::string &message) { throw std::runtime_error("measure " + statement.name + ": " + message); };
+
+    if (keyword == "trig") {
+        statement.kind = Statement::Kind::Delay;
+        _parseCrossing(statement.trig, args, pos, statement.name);
+        if (pos >= args.size() || args[pos] != "targ") fail("trig requires a matching targ");
+        pos++;
+        _parseCrossing(statement.targ, args, pos, statement.name);
+    } else if (keyword == "when") {
+        statement.kind = Statement::Kind::When;
+        _parseCrossing(statement.trig, args, pos, statement.name);
+    } else {
+        using Kind = Statement::Kind;
+        if (keyword == "find") statement.kind = Kind::Find;
+        else if (keyword == "avg") statement.kind = Kind::Avg;
+        else if (keyword == "max") statement.kind = Kind::Max;
+        else if (keyword == "min") statement.kind = Kind::Min;
+        else if (keyword == "pp") statement.kind = Kind::PP;
+        else if (keyword == "rms") statement.kind = Kind::Rms;
+        else if (keyword == "integ") statement.kind = Kind::Integ;
+        else fail("unsupported measurement '" + keyword + "'");
+
+        if (pos >= args.size()) fail("missing signal");
+        statement.signal = _getSignal(args[pos++]);
+        bool hasAt = false;
+        for (; pos < args.size(); pos++) {
+            auto eq = args[pos].find('=');
+            if (eq == std::string::npos) fail("unexpected token '" + args[pos] + "'");
+            auto key = args[pos].substr(0, eq);
+            auto value = Netlist::parseValue(args[pos].substr(eq + 1));
+            if (key == "from") statement.from = value;
+            else if (key == "to") statement.to = value;
+            else if (key == "at") { statement.at = value; hasAt = true; }
+            else fail("unsupported parameter '" + key + "'");
+        }
+        if (statement.kind == Kind::Find && !hasAt) fail("find requires at=");
+        if (statement.to <= statement.from) fail("to= must be after from=");
+    }
+    if (pos != args.size()) fail("unexpected token '" + args[pos] + "'");
+
+    _statements.push_back(statement);
+    _values.resize(_signals.size());
+    _prevValues.resize(_signals.size());
+}
+
+void MeasureEngine::_updateCrossing(Crossing &crossing, double t0, double v0, double t1, double v1) {
+    if (crossing.signal < 0 || !std::isnan(crossing.time)) return;
+    bool rise = v0 < crossing.value && v1 >= crossing.value;
+    bool fall = v0 > crossing.value && v1 <= crossing.value;
+    if (!(crossing.edge >= 0 && rise) && !(crossing.edge <= 0 && fall)) return;
+
+    auto tc = t0 + (crossing.value - v0) / (v1 - v0) * (t1 - t0);
+    if (tc < crossing.td) return;
+    if (++crossing.seen == crossing.count) crossing.time = tc;
+}
+
+void MeasureEngine::accept(double time, const std::vector<double> &x) {
+    // fold the segment from the previous accepted point to this one into every statement
+    _prevValues.swap(_values);
+    for (size_t i = 0; i < _signals.size(); i++) _values[i] = _evaluate(_signals[i], x);
+    auto t0 = _time;
+    _time = time;
+    if (!_started) {
+        _started = true;
+        return;
+    }
+
+    for (auto &s : _statements) {
+        if (s.kind == Statement::Kind::Delay || s.kind == Statement::Kind::When) {
+            for (auto crossing : {&s.trig, &s.targ}) {
+                if (crossing->signal < 0) continue;
+                _updateCrossing(*crossing, t0, _prevValues[crossing->signal], time, _values[crossing->signal]);
+            }
+            continue;
+        }
+
+        auto v0 = _prevValues[s.signal], v1 = _values[s.signal];
+        auto interpolate = [&](double t) { return time > t0 ? v0 + (v1 - v0) * (t - t0) / (time - t0) : v1; };
+        if (s.kind == Statement::Kind::Find) {
+            if (std::isnan(s.found) && s.at >= t0 && s.at <= time) s.found = interpolate(s.at);
+            continue;
+        }
+
+        auto lo = std::max(t0, s.from), hi = std::min(time, s.to);
+        if (lo > hi) continue;
+        auto a = interpolate(lo), b = interpolate(hi);
+        auto dt = hi - lo;
+        s.integral += 0.5 * (a + b) * dt;
+        s.integralSq += (a * a + a * b + b * b) / 3.0 * dt;
+        s.span += dt;
+        s.max = std::max({s.max, a, b});
+        s.min = std::min({s.min, a, b});
+    }
+}
+
+void MeasureEngine::reset() {
+    for (auto &s : _statements) {
+        for (auto crossing : {&s.trig, &s.targ}) {
+            crossing->seen = 0;
+            if (crossing->signal >= 0) crossing->time = std::numeric_limits<double>::quiet_NaN();  // at= stays
+        }
+        s.integral = s.integralSq = s.span = 0.0;
+        s.max = -std::numeric_limits<double>::infinity();
+        s.min = std::numeric_limits<double>::infinity();
+        s.found = std::numeric_limits<double>::quiet_NaN();
+    }
+    _started = false;
+    _time = 0.0;
+}
+
+std::vector<double> MeasureEngine::getState() const {
+    std::vector<double> state = {_started ? 1.0 : 0.0, _time};
+    state.insert(state.end(), _values.begin(), _values.end());
+    state.insert(state.end(), _prevValues.begin(), _prevValues.end());
+    for (auto &s : _statements) {
+        for (auto crossing : {&s.trig, &s.targ}) {
+            state.push_back(crossing->seen);
+            state.push_back(crossing->time);
+        }
+        state.insert(state.end(), {s.integral, s.integralSq, s.span, s.max, s.min, s.found});
+    }
+    return state;
+}
+
+void MeasureEngine::setState(const std::vector<double> &state) {
+    auto expected = 2 + 2 * _values.size() + 10 * _statements.size();
+    if (state.size() != expected || _prevValues.size() != _values.size()) throw std::runtime_error("measure state does not match the .measure statements");
+    auto pos = state.begin();
+    _started = *pos++ != 0.0;
+    _time = *pos++;
+    for (auto &v : _values) v = *pos++;
+    for (auto &v : _prevValues) v = *pos++;
+    for (auto &s : _statements) {
+        for (auto crossing : {&s.trig, &s.targ}) {
+            crossing->seen = int(*pos++);
+            crossing->time = *pos++;
+        }
+        for (auto field : {&s.integral, &s.integralSq, &s.span, &s.max, &s.min, &s.found}) *field = *pos++;
+    }
+}
+
+std::vector<MeasureEngine::Result> MeasureEngine::getResults() const {
+    std::vector<Result> results;
+    for (auto &s : _statements) {
+        double value = std::numeric_limits<double>::quiet_NaN();
+        auto folded = s.max >= s.min;
+        switch (s.kind) {
+        case Statement::Kind::Delay: value = s.targ.time - s.trig.time; break;
+        case Statement::Kind::When: value = s.trig.time; break;
+        case Statement::Kind::Find: value = s.found; break;
+        case Statement::Kind::Avg: if (s.span > 0) value = s.integral / s.span; break;
+        case Statement::Kind::Max: if (folded) value = s.max; break;
+        case Statement::Kind::Min: if (folded) value = s.min; break;
+        case Statement::Kind::PP: if (folded) value = s.max - s.min; break;
+        case Statement::Kind::Rms: if (s.span > 0) value = std::sqrt(s.integralSq / s.span); break;
+        case Statement::Kind::Integ: if (folded) value = s.integral; break;
+        }
+        results.push_back({s.name, value, !std::isnan(value)});
+    }
+    return results;
+}
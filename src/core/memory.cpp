@@ -0,0 +1,106 @@
+#include "memory.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+const char *MemoryReport::getName(Subsystem subsystem) {
+    switch (subsystem) {
+    case Subsystem::Elements: return "elements";
+    case Subsystem::Nodes: return "nodes";
+    case Subsystem::Matrix: return "matrix";
+    case Subsystem::Factors: return "factors";
+    case Subsystem::Models: return "models";
+    case Subsystem::Waveforms: return "waveforms";
+    }
+    return "";
+}
+
+size_t MemoryReport::Usage::getTotal() const {
+    size_t total = 0;
+    for (auto b : bytes) total += b;
+    return total;
+}
+
+MemoryReport::Usage &MemoryReport::Usage::operator+=(const Usage &other) {
+    for (size_t s = 0; s < SUBSYSTEMS; s++) bytes[s] += other.bytes[s];
+    return *this;
+}
+
+void MemoryReport::record(const Usage &usage) {
+    _current = usage;
+    for (size_t s = 0; s < SUBSYSTEMS; s++) _peak.bytes[s] = std::max(_peak.bytes[s], usage.bytes[s]);
+    _peakTotal = std::max(_peakTotal, usage.getTotal());
+    _records++;
+}
+
+void MemoryReport::write(std::ostream &out) const {
+    out << "subsystem,current,peak\n";
+    for (size_t s = 0; s < SUBSYSTEMS; s++) out << getName(Subsystem(s)) << "," << _current.bytes[s] << "," << _peak.bytes[s] << "\n";
+    out << "total," << _current.getTotal() << "," << _peakTotal << "\n";
+}
+
+std::string MemoryReport::format(size_t bytes) {
+    const char *units[] = {"B", "KB", "MB", "GB", "TB"};
+    auto value = double(bytes);
+    size_t unit = 0;
+    while (value >= 1024.0 && unit + 1 < sizeof(units) / sizeof(units[0])) {
+        value /= 1024.0;
+        unit++;
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), unit ? "%.1f %s" : "%.0f %s", value, units[unit]);
+    return text;
+}
+
+size_t MemoryReport::bytes(const std::string &text) {
+    // short strings live in the object itself
+    auto data = text.data();
+    auto object = reinterpret_cast<const char *>(&text);
+    if (data >= object && data < object + sizeof(text)) return 0;
+    return text.capacity() + 1;
+}
+
+size_t MemoryReport::bytes(const std::vector<std::string> &texts) {
+    auto total = bytes<std::string>(texts);
+    for (auto &text : texts) total += bytes(text);
+    return total;
+}
+
+size_t MemoryReport::bytes(const std::unordered_map<std::string, int> &map) {
+    // bucket array, then per entry a node with its next pointer, the pair and the cached hash
+    auto node = sizeof(void *) + sizeof(std::pair<const std::string, int>) + sizeof(size_t);
+    auto total = map.bucket_count() * sizeof(void *) + map.size() * node;
+    for (auto &entry : map) total += bytes(entry.first);
+    return total;
+}
+
+size_t MemoryReport::setNodeBytes() {
+    // colour, parent, left and right, then the value padded to pointer alignment
+    auto value = (sizeof(int) + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+    return 4 * sizeof(void *) + value;
+}
+
+size_t MemoryReport::bytes(const std::vector<std::set<int>> &sets) {
+    auto total = bytes<std::set<int>>(sets);
+    for (auto &set : sets) total += set.size() * setNodeBytes();
+    return total;
+}
+
+size_t MemoryReport::waveformBytes(size_t points, size_t width) {
+    return points * (sizeof(double) + sizeof(std::vector<double>) + width * sizeof(double));
+}
+
+size_t MemoryReport::getProcessPeak() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) != 0) continue;
+        std::istringstream fields(line.substr(6));
+        size_t kilobytes = 0;
+        fields >> kilobytes;
+        return kilobytes * 1024;
+    }
+    return 0;
+}
@@ -1 +1,729 @@
 #include "netlist.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+
+#include "threadpool.hpp"
+
+namespace {
+    std::string toLower(std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+        return text;
+    }
+
+    std::vector<std::string> split(const std::string &line) {
+        std::vector<std::string> tokens;
+        std::istringstream stream(line);
+        std::string token;
+        while (stream >> token) tokens.push_back(token);
+        return tokens;
+    }
+}
+
+const int Netlist::GROUND;
+
+Netlist::Counts Netlist::Counts::operator+(const Counts &other) const {
+    return {nodes + other.nodes, fets + other.fets, resistors + other.resistors, capacitors + other.capacitors, vsources + other.vsources};
+}
+
+Netlist::Counts Netlist::Definition::own() const {
+    return {int(nodeNames.size()) - 1 - ports, int(fets.size()), int(resistors.size()), int(capacitors.size()), int(vsources.size())};
+}
+
+Netlist::Netlist() : _current(0), _elaborated(false), _flat(false) {
+    _addDefinition("");
+    addTech("t180nm", PlanarFET::t180nm);
+    addTech("t065nm", PlanarFET::t065nm);
+}
+
+double Netlist::parseValue(const std::string &token) {
+    // parse a spice number with an optional scale suffix (1.8, 10k, 2.5meg, 1e-9, 100fF, ...)
+    size_t idx = 0;
+    double value;
+    try {
+        value = std::stod(token, &idx);
+    } catch (std::exception &e) {
+        throw std::runtime_error("invalid numeric value [ " + token + " ]");
+    }
+    auto suffix = toLower(token.substr(idx));
+    if (suffix.empty()) return value;
+    if (suffix.rfind("meg", 0) == 0) return value * 1e6;
+    switch (suffix[0]) {
+    case 't': return value * 1e12;
+    case 'g': return value * 1e9;
+    case 'k': return value * 1e3;
+    case 'm': return value * 1e-3;
+    case 'u': return value * 1e-6;
+    case 'n': return value * 1e-9;
+    case 'p': return value * 1e-12;
+    case 'f': return value * 1e-15;
+    default: return value;   // trailing units such as "v" or "s" are ignored
+    }
+}
+
+std::vector<double> Netlist::parseRange(const std::string &start, const std::string &stop, const std::string &step, const std::string &where) {
+    auto first = parseValue(start), last = parseValue(stop), increment = parseValue(step);
+    if (increment == 0.0 || (last - first) / increment < 0.0) throw std::runtime_error(where + ": step does not lead from start to stop");
+    // indices rather than accumulation, so the last point lands on stop
+    auto count = size_t(std::floor((last - first) / increment + 1e-9)) + 1;
+    std::vector<double> values;
+    for (size_t i = 0; i < count; i++) values.push_back(first + double(i) * increment);
+    return values;
+}
+
+Netlist Netlist::read(const std::filesystem::path &path, const std::vector<std::filesystem::path> &techfiles) {
+    Netlist netlist;
+    for (auto &techfile : techfiles) netlist.readTechfile(techfile);
+    netlist._include(path);
+    return netlist;
+}
+
+void Netlist::_include(const std::filesystem::path &path) {
+    std::ifstream file(path);
+    if (!file.is_open()) throw std::runtime_error("Failed to open file [ " + path.string() + " ]");
+    _sources.push_back(path.string());
+    parse(file, path.string());
+}
+
+void Netlist::parse(std::istream &stream, const std::string &origin) {
+    // spice style deck: '*' starts a comment line, ';' an inline comment and '+' continues the
+    // previous card. everything is case insensitive.
+    std::vector<std::string> card;
+    std::string where;
+    std::string line;
+    int lineNumber = 0;
+    auto flush = [&]() {
+        if (!card.empty()) _parseCard(card, where);
+        card.clear();
+    };
+
+    while (std::getline(stream, line)) {
+        lineNumber++;
+        auto comment = line.find(';');
+        if (comment != std::string::npos) line.erase(comment);
+        auto tokens = split(line);
+        if (tokens.empty() || tokens[0][0] == '*') continue;
+
+        // .include "<file>" is resolved relative to the including file. the path keeps its case.
+        auto keyword = toLower(tokens[0]);
+        if (keyword == ".include" || keyword == ".inc") {
+            where = origin + ":" + std::to_string(lineNumber);
+            if (tokens.size() != 2) throw std::runtime_error(where + ": include expects one file name");
+            flush();
+            std::filesystem::path path = tokens[1].size() > 1 && (tokens[1][0] == '"' || tokens[1][0] == '\'') ? tokens[1].substr(1, tokens[1].size() - 2) : tokens[1];
+            if (path.is_relative()) path = std::filesystem::path(origin).parent_path() / path;
+            if (std::find(_sources.begin(), _sources.end(), path.string()) != _sources.end()) throw std::runtime_error(where + ": file is already included [ " + path.string() + " ]");
+            _include(path);
+            continue;
+        }
+        for (auto &token : tokens) token = toLower(token);
+
+        // .stimulus <file> [key=value ...] keeps the path as written, resolved like an include
+        if (keyword == ".stimulus") {
+            where = origin + ":" + std::to_string(lineNumber);
+            flush();
+            if (tokens.size() < 2) throw std::runtime_error(where + ": stimulus expects a file name");
+            if (_current != 0) throw std::runtime_error(where + ": control card inside a subckt [ .stimulus ]");
+            std::filesystem::path path = split(line)[1];
+            if (path.is_relative()) path = std::filesystem::path(origin).parent_path() / path;
+            tokens[1] = path.string();
+            addAnalysis("stimulus", std::vector<std::string>(tokens.begin() + 1, tokens.end()));
+            continue;
+        }
+
+        if (tokens[0][0] == '+') {
+            if (card.empty()) throw std::runtime_error(origin + ":" + std::to_string(lineNumber) + ": continuation without a card");
+            tokens[0].erase(0, 1);
+            if (tokens[0].empty()) tokens.erase(tokens.begin());
+            card.insert(card.end(), tokens.begin(), tokens.end());
+            continue;
+        }
+        flush();
+        card = tokens;
+        where = origin + ":" + std::to_string(lineNumber);
+    }
+    flush();
+    if (_current != 0) throw std::runtime_error(origin + ": missing .ends for subckt [ " + _defs[_current].name + " ]");
+}
+
+void Netlist::_parseCard(const std::vector<std::string> &tokens, const std::string &where) {
+    auto &name = tokens[0];
+    auto fail = [&](const std::string &message) { throw std::runtime_error(where + ": " + message + " [ " + name + " ]"); };
+
+    if (name[0] == '.') {
+        auto type = name.substr(1);
+        if (type == "end") return;
+        if (type == "subckt") {
+            // .subckt <name> <port> ...
+            if (tokens.size() < 2) fail("subckt expects a name");
+            if (_current != 0) fail("nested subckt definitions are not supported");
+            beginSubckt(tokens[1], std::vector<std::string>(tokens.begin() + 2, tokens.end()));
+            return;
+        }
+        if (type == "ends") {
+            if (_current == 0) fail("ends without a subckt");
+            endSubckt();
+            return;
+        }
+        if (type == "model") {
+            auto tech = parseModelCard(tokens, where);
+            addTech(tokens[1], tech);
+            return;
+        }
+        if (_current != 0) fail("control card inside a subckt");
+        if (type == "meas") type = "measure";
+        if (type != "op" && type != "dc" && type != "tran" && type != "sens" && type != "measure" && type != "char" && type != "chartable" && type != "corner" && type != "probe") fail("unsupported control card");
+        addAnalysis(type, std::vector<std::string>(tokens.begin() + 1, tokens.end()));
+        return;
+    }
+
+    switch (name[0]) {
+    case 'm': {
+        // Mname d g s [b] nmos|pmos W=<width> [tech=<name>]
+        std::vector<std::string> positional;
+        double W = 0.0;
+        int tech = findTech("t180nm");
+        for (size_t i = 1; i < tokens.size(); i++) {
+            auto eq = tokens[i].find('=');
+            if (eq == std::string::npos) {
+                positional.push_back(tokens[i]);
+                continue;
+            }
+            auto key = tokens[i].substr(0, eq), value = tokens[i].substr(eq + 1);
+            if (key == "w") W = parseValue(value);
+            else if (key == "tech") tech = findTech(value);
+            else fail("unsupported FET parameter '" + key + "'");
+            if (tech < 0) fail("unknown technology '" + value + "'");
+        }
+        if (positional.size() != 4 && positional.size() != 5) fail("FET expects 3 or 4 terminals and a model");
+        auto model = positional.back();
+        if (model != "nmos" && model != "pmos") fail("unknown FET model '" + model + "'");
+        if (W <= 0.0) fail("FET requires a positive W");
+        auto devType = (model == "nmos") ? ModelUtils::DevType::N : ModelUtils::DevType::P;
+        addFet(name, positional[0], positional[1], positional[2], W, devType, tech);
+        break;
+    }
+
+    case 'r':
+        if (tokens.size() != 4) fail("resistor expects two nodes and a value");
+        addResistor(name, tokens[1], tokens[2], parseValue(tokens[3]));
+        break;
+
+    case 'c':
+        if (tokens.size() != 4) fail("capacitor expects two nodes and a value");
+        addCapacitor(name, tokens[1], tokens[2], parseValue(tokens[3]));
+        break;
+
+    case 'v':
+        if (tokens.size() < 4) fail("voltage source expects two nodes and a value");
+        addVSource(name, tokens[1], tokens[2], _parseWaveform(tokens, 3, where));
+        break;
+
+    case 'x':
+        // Xname <node> ... <subckt>, the subckt may be defined later in the deck
+        if (tokens.size() < 2) fail("instance expects a subckt name");
+        for (size_t i = 1; i < tokens.size(); i++) {
+            if (tokens[i].find('=') != std::string::npos) fail("subckt parameters are not supported");
+        }
+        addInstance(name, std::vector<std::string>(tokens.begin() + 1, tokens.end() - 1), tokens.back());
+        break;
+
+    default:
+        fail("unsupported element");
+    }
+}
+
+PlanarFET::Tech Netlist::parseModelCard(const std::vector<std::string> &tokens, const std::string &where) {
+    // .model <name> planar L=<m> Tox=<m> Lovl=<m> Vt=<V> MUn=<m^2/Vs> MUp=<m^2/Vs> LAMBDA=<1/V> BETA=<1/V>
+    auto fail = [&](const std::string &message) { throw std::runtime_error(where + ": " + message); };
+    if (tokens.size() < 3) fail("model card expects a name and a device type");
+    if (toLower(tokens[2]) != "planar") fail("unsupported model type '" + tokens[2] + "' [ " + tokens[1] + " ]");
+
+    const std::vector<std::string> keys = {"l", "tox", "lovl", "vt", "mun", "mup", "lambda", "beta"};
+    std::vector<double> values(keys.size());
+    std::vector<bool> seen(keys.size(), false);
+    for (size_t i = 3; i < tokens.size(); i++) {
+        auto eq = tokens[i].find('=');
+        if (eq == std::string::npos) fail("expected <param>=<value> but got '" + tokens[i] + "'");
+        auto key = std::find(keys.begin(), keys.end(), toLower(tokens[i].substr(0, eq)));
+        if (key == keys.end()) fail("unsupported model parameter '" + tokens[i].substr(0, eq) + "'");
+        auto k = size_t(key - keys.begin());
+        values[k] = parseValue(tokens[i].substr(eq + 1));
+        seen[k] = true;
+    }
+    for (size_t k = 0; k < keys.size(); k++) {
+        if (!seen[k]) fail("missing model parameter '" + keys[k] + "' [ " + tokens[1] + " ]");
+    }
+    if (values[0] <= 0.0 || values[1] <= 0.0) fail("L and Tox must be positive [ " + tokens[1] + " ]");
+    return PlanarFET::Tech(values[0], values[1], values[2], values[3], values[4], values[5], values[6], values[7]);
+}
+
+void Netlist::readTechfile(const std::filesystem::path &path) {
+    // a techfile is a deck holding only .model cards (and comments)
+    std::ifstream file(path);
+    if (!file.is_open()) throw std::runtime_error("Failed to open file [ " + path.string() + " ]");
+    std::stringstream text;
+    text << file.rdbuf();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(text, line)) {
+        lineNumber++;
+        auto tokens = split(line);
+        if (tokens.empty() || tokens[0][0] == '*' || tokens[0][0] == '+' || tokens[0][0] == ';') continue;
+        if (toLower(tokens[0]) != ".model" && toLower(tokens[0]) != ".end") {
+            throw std::runtime_error(path.string() + ":" + std::to_string(lineNumber) + ": only .model cards are allowed in a techfile");
+        }
+    }
+    _sources.push_back(path.string());
+    text.clear();
+    text.seekg(0);
+    parse(text, path.string());
+}
+
+Source::Waveform Netlist::parseWaveform(const std::vector<std::string> &tokens, const std::string &where) {
+    if (tokens.empty()) throw std::runtime_error(where + ": missing source value");
+    return _parseWaveform(tokens, 0, where);
+}
+
+Source::Waveform Netlist::_parseWaveform(const std::vector<std::string> &tokens, size_t first, const std::string &where) {
+    // value portion of a source card: "1.8", "dc 1.8", "pulse(v1 v2 td tr tf pw per)" or
+    // "pwl(t0 v0 t1 v1 ...)"
+    std::string text;
+    for (size_t i = first; i < tokens.size(); i++) text += tokens[i] + " ";
+    std::replace_if(text.begin(), text.end(), [](char c) { return c == '(' || c == ')' || c == ','; }, ' ');
+    auto words = split(text);
+
+    Source::Waveform wave = {Source::Shape::DC, {}};
+    size_t start = 1;
+    if (words[0] == "pulse") wave.shape = Source::Shape::PULSE;
+    else if (words[0] == "pwl") wave.shape = Source::Shape::PWL;
+    else if (words[0] != "dc") start = 0;
+    for (size_t i = start; i < words.size(); i++) wave.params.push_back(parseValue(words[i]));
+
+    auto &p = wave.params;
+    switch (wave.shape) {
+    case Source::Shape::DC:
+        if (p.size() != 1) throw std::runtime_error(where + ": DC source expects one value");
+        break;
+    case Source::Shape::PULSE:
+        if (p.size() < 2 || p.size() > 7) throw std::runtime_error(where + ": PULSE source expects 2 to 7 values");
+        p.resize(7, 0.0);
+        break;
+    case Source::Shape::PWL:
+        if (p.size() < 2 || p.size() % 2) throw std::runtime_error(where + ": PWL source expects time/value pairs");
+        for (size_t i = 2; i < p.size(); i += 2) {
+            if (p[i] < p[i - 2]) throw std::runtime_error(where + ": PWL times must be non-decreasing");
+        }
+        break;
+    }
+    return wave;
+}
+
+int Netlist::_addDefinition(const std::string &name) {
+    Definition def;
+    def.name = name;
+    def.ports = 0;
+    def.nodeIds["0"] = GROUND;
+    def.nodeIds["gnd"] = GROUND;
+    def.nodeNames.push_back("0");
+    def.expandedInstances = 0;
+    _defIds[name] = int(_defs.size());
+    _defs.push_back(std::move(def));
+    return int(_defs.size()) - 1;
+}
+
+int Netlist::_addLocalNode(Definition &def, const std::string &name) {
+    auto key = toLower(name);
+    auto it = def.nodeIds.find(key);
+    if (it != def.nodeIds.end()) return it->second;
+    auto id = int(def.nodeNames.size());
+    def.nodeIds[key] = id;
+    def.nodeNames.push_back(key);
+    _invalidate();
+    return id;
+}
+
+void Netlist::_rebuildIndex() {
+    // recreate the lookup maps from the name tables, e.g. after loading a cached image
+    _defIds.clear();
+    for (size_t d = 0; d < _defs.size(); d++) {
+        auto &def = _defs[d];
+        _defIds[def.name] = int(d);
+        def.nodeIds.clear();
+        def.nodeIds["gnd"] = GROUND;
+        for (size_t n = 0; n < def.nodeNames.size(); n++) def.nodeIds[def.nodeNames[n]] = int(n);
+        def.instanceIds.clear();
+        for (size_t i = 0; i < def.instances.size(); i++) def.instanceIds[def.instances[i].name] = int(i);
+    }
+    _techIds.clear();
+    for (size_t t = 0; t < _techNames.size(); t++) _techIds[_techNames[t]] = int(t);
+    _current = 0;
+    _invalidate();
+}
+
+void Netlist::beginSubckt(const std::string &name, const std::vector<std::string> &ports) {
+    auto key = toLower(name);
+    if (_current != 0) throw std::runtime_error("subckt definitions cannot be nested [ " + key + " ]");
+    if (key.empty() || _defIds.count(key)) throw std::runtime_error("duplicate subckt definition [ " + key + " ]");
+    _current = _addDefinition(key);
+    auto &def = _defs[_current];
+    for (auto &port : ports) {
+        auto id = _addLocalNode(def, port);
+        if (id != int(def.nodeNames.size()) - 1) throw std::runtime_error("invalid or repeated port '" + port + "' [ " + key + " ]");
+    }
+    def.ports = int(ports.size());
+}
+
+void Netlist::endSubckt() {
+    _current = 0;
+}
+
+void Netlist::addInstance(const std::string &name, const std::vector<std::string> &nodes, const std::string &subckt) {
+    auto &def = _defs[_current];
+    auto key = toLower(name);
+    if (!def.instanceIds.emplace(key, int(def.instances.size())).second) throw std::runtime_error("duplicate instance [ " + key + " ]");
+    SubcktInstance instance = {key, toLower(subckt), -1, {}};
+    for (auto &node : nodes) instance.nodes.push_back(_addLocalNode(def, node));
+    def.instances.push_back(std::move(instance));
+    _invalidate();
+}
+
+int Netlist::addNode(const std::string &name) {
+    return _addLocalNode(_defs[_current], name);
+}
+
+int Netlist::findNode(const std::string &name) const {
+    auto key = toLower(name);
+    auto &top = _defs[0].nodeIds;
+    auto it = top.find(key);
+    if (it != top.end()) return it->second;
+
+    auto dot = key.rfind('.');
+    int def;
+    Counts base;
+    std::vector<int> ports;
+    if (dot == std::string::npos || !_resolve(key.substr(0, dot), def, base, ports)) return -1;
+    auto &nodes = _defs[def].nodeIds;
+    it = nodes.find(key.substr(dot + 1));
+    return it == nodes.end() ? -1 : _globalNode(_defs[def], base, ports, it->second);
+}
+
+std::string Netlist::getNodeName(int node) const {
+    if (node == GROUND) return "0";
+    std::string path;
+    auto [def, local] = _locate(&Counts::nodes, node - 1, path);
+    return path + _defs[def].nodeNames[_defs[def].ports + 1 + local];
+}
+
+int Netlist::getNodeCount() const {
+    _elaborate();
+    return 1 + _defs[0].offsets.back().nodes;
+}
+
+std::vector<std::string> Netlist::getSubcktPorts(const std::string &subckt) const {
+    auto it = _defIds.find(toLower(subckt));
+    if (it == _defIds.end() || it->second == 0) return {};
+    auto &def = _defs[it->second];
+    return std::vector<std::string>(def.nodeNames.begin() + 1, def.nodeNames.begin() + 1 + def.ports);
+}
+
+int Netlist::getInstanceCount() const {
+    _elaborate();
+    return _defs[0].expandedInstances;
+}
+
+void Netlist::getMemory(MemoryReport::Usage &usage) const {
+    using M = MemoryReport;
+    auto vsources = [](const std::vector<VSourceInstance> &table) {
+        auto total = M::bytes(table);
+        for (auto &v : table) total += M::bytes(v.wave.params);
+        return total;
+    };
+    auto &elements = usage[M::Subsystem::Elements];
+    auto &nodes = usage[M::Subsystem::Nodes];
+    elements += M::bytes(_sources) + M::bytes(_defs) + M::bytes(_techIds) + M::bytes(_techNames) + M::bytes(_techs) + M::bytes(_analyses);
+    for (auto &analysis : _analyses) elements += M::bytes(analysis.type) + M::bytes(analysis.args);
+    nodes += M::bytes(_defIds);
+    for (auto &def : _defs) {
+        elements += M::bytes(def.name) + M::bytes(def.fets) + M::bytes(def.resistors) + M::bytes(def.capacitors) + vsources(def.vsources);
+        elements += M::bytes(def.fetNames) + M::bytes(def.resistorNames) + M::bytes(def.capacitorNames) + M::bytes(def.vsourceNames);
+        elements += M::bytes(def.instances) + M::bytes(def.instanceIds) + M::bytes(def.offsets);
+        for (auto &instance : def.instances) elements += M::bytes(instance.name) + M::bytes(instance.subckt) + M::bytes(instance.nodes);
+        nodes += M::bytes(def.nodeIds) + M::bytes(def.nodeNames);
+    }
+    elements += M::bytes(_fets) + M::bytes(_resistors) + M::bytes(_capacitors) + vsources(_vsources);
+}
+
+int Netlist::addTech(const std::string &name, const PlanarFET::Tech &tech) {
+    auto key = toLower(name);
+    auto it = _techIds.find(key);
+    if (it != _techIds.end()) {
+        _techs[it->second] = tech;
+        return it->second;
+    }
+    auto id = int(_techs.size());
+    _techIds[key] = id;
+    _techNames.push_back(key);
+    _techs.push_back(tech);
+    return id;
+}
+
+int Netlist::findTech(const std::string &name) const {
+    auto it = _techIds.find(toLower(name));
+    return it == _techIds.end() ? -1 : it->second;
+}
+
+void Netlist::addFet(const std::string &name, const std::string &d, const std::string &g, const std::string &s, double W, ModelUtils::DevType devType, int tech) {
+    auto &def = _defs[_current];
+    def.fets.push_back({_addLocalNode(def, d), _addLocalNode(def, g), _addLocalNode(def, s), W, devType, tech});
+    def.fetNames.push_back(toLower(name));
+    _invalidate();
+}
+
+void Netlist::addResistor(const std::string &name, const std::string &a, const std::string &b, double R) {
+    if (R == 0.0) throw std::runtime_error("resistor must have a non-zero value [ " + name + " ]");
+    auto &def = _defs[_current];
+    def.resistors.push_back({_addLocalNode(def, a), _addLocalNode(def, b), R});
+    def.resistorNames.push_back(toLower(name));
+    _invalidate();
+}
+
+void Netlist::addCapacitor(const std::string &name, const std::string &a, const std::string &b, double C) {
+    auto &def = _defs[_current];
+    def.capacitors.push_back({_addLocalNode(def, a), _addLocalNode(def, b), C});
+    def.capacitorNames.push_back(toLower(name));
+    _invalidate();
+}
+
+void Netlist::addVSource(const std::string &name, const std::string &p, const std::string &n, const Source::Waveform &wave) {
+    auto &def = _defs[_current];
+    def.vsources.push_back({_addLocalNode(def, p), _addLocalNode(def, n), wave});
+    def.vsourceNames.push_back(toLower(name));
+    _invalidate();
+}
+
+void Netlist::addAnalysis(const std::string &type, const std::vector<std::string> &args) {
+    _analyses.push_back({toLower(type), args});
+}
+
+std::string Netlist::getFetName(int fet) const {
+    std::string path;
+    auto [def, local] = _locate(&Counts::fets, fet, path);
+    return path + _defs[def].fetNames[local];
+}
+
+std::string Netlist::getResistorName(int resistor) const {
+    std::string path;
+    auto [def, local] = _locate(&Counts::resistors, resistor, path);
+    return path + _defs[def].resistorNames[local];
+}
+
+std::string Netlist::getCapacitorName(int capacitor) const {
+    std::string path;
+    auto [def, local] = _locate(&Counts::capacitors, capacitor, path);
+    return path + _defs[def].capacitorNames[local];
+}
+
+std::string Netlist::getVSourceName(int vsource) const {
+    std::string path;
+    auto [def, local] = _locate(&Counts::vsources, vsource, path);
+    return path + _defs[def].vsourceNames[local];
+}
+
+int Netlist::findFet(const std::string &name) const {
+    return _findElement(name, &Definition::fetNames, &Counts::fets);
+}
+
+int Netlist::findCapacitor(const std::string &name) const {
+    return _findElement(name, &Definition::capacitorNames, &Counts::capacitors);
+}
+
+int Netlist::findVSource(const std::string &name) const {
+    return _findElement(name, &Definition::vsourceNames, &Counts::vsources);
+}
+
+bool Netlist::findInstance(const std::string &path, Block &block) const {
+    int def;
+    std::vector<int> ports;
+    if (!_resolve(toLower(path), def, block.first, ports)) return false;
+    block.size = _defs[def].offsets.back();
+    return true;
+}
+
+int Netlist::_findElement(const std::string &name, std::vector<std::string> Definition::*names, int Counts::*field) const {
+    auto key = toLower(name);
+    auto dot = key.rfind('.');
+    int def = 0;
+    Counts base;
+    std::vector<int> ports;
+    if (dot != std::string::npos && !_resolve(key.substr(0, dot), def, base, ports)) {
+        // flattened copies (e.g. after RCReduction) keep dotted names at the top level
+        def = 0;
+        base = Counts();
+        dot = std::string::npos;
+    }
+    auto &local = _defs[def].*names;
+    auto it = std::find(local.begin(), local.end(), dot == std::string::npos ? key : key.substr(dot + 1));
+    return it == local.end() ? -1 : base.*field + int(it - local.begin());
+}
+
+void Netlist::_elaborate() const {
+    // resolve instance references and size every definition's expansion, children first
+    if (_elaborated) return;
+    std::vector<int> state(_defs.size(), 0);    // 0 unvisited, 1 on the stack, 2 done
+
+    std::function<void(int)> visit = [&](int d) {
+        auto &def = _defs[d];
+        state[d] = 1;
+        def.offsets.assign(1, def.own());
+        def.expandedInstances = 0;
+        for (auto &instance : def.instances) {
+            auto it = _defIds.find(instance.subckt);
+            if (it == _defIds.end() || it->second == 0) throw std::runtime_error("unknown subckt '" + instance.subckt + "' [ " + instance.name + " ]");
+            auto &child = _defs[it->second];
+            if (int(instance.nodes.size()) != child.ports) {
+                throw std::runtime_error("instance connects " + std::to_string(instance.nodes.size()) + " nodes to " + std::to_string(child.ports) + " ports [ " + instance.name + " ]");
+            }
+            if (state[it->second] == 1) throw std::runtime_error("recursive subckt '" + child.name + "' [ " + instance.name + " ]");
+            if (state[it->second] == 0) visit(it->second);
+            instance.def = it->second;
+            def.offsets.push_back(def.offsets.back() + child.offsets.back());
+            def.expandedInstances += 1 + child.expandedInstances;
+        }
+        state[d] = 2;
+    };
+    visit(0);
+    _elaborated = true;
+}
+
+void Netlist::_flatten() const {
+    if (_flat) return;
+    _elaborate();
+    auto &total = _defs[0].offsets.back();
+    _fets.resize(total.fets);
+    _resistors.resize(total.resistors);
+    _capacitors.resize(total.capacitors);
+    _vsources.resize(total.vsources);
+
+    // instances own disjoint slices of the flat tables, so whole subtrees can be expanded in
+    // parallel. split the hierarchy breadth first until there is enough work to go around.
+    auto elements = total.fets + total.resistors + total.capacitors + total.vsources;
+    unsigned threads = elements < 20000 ? 1 : ThreadPool::default_threads();
+    struct Job {
+        int def;
+        Counts base;
+        std::vector<int> ports;
+        bool recurse;
+    };
+    std::vector<Job> jobs = {{0, {}, {}, true}};
+    for (size_t i = 0; i < jobs.size() && jobs.size() < 8 * threads && threads > 1; i++) {
+        auto &def = _defs[jobs[i].def];
+        if (def.instances.empty()) continue;
+        jobs[i].recurse = false;
+        auto base = jobs[i].base;
+        auto ports = jobs[i].ports;
+        for (size_t j = 0; j < def.instances.size(); j++) {
+            auto &instance = def.instances[j];
+            std::vector<int> childPorts;
+            for (auto node : instance.nodes) childPorts.push_back(_globalNode(def, base, ports, node));
+            jobs.push_back({instance.def, base + def.offsets[j], childPorts, true});
+        }
+    }
+
+    if (jobs.size() == 1) {
+        _expand(0, {}, {}, true);
+    } else {
+        ThreadPool pool(threads);
+        pool.parallel_for(jobs.size(), [&](size_t i) { _expand(jobs[i].def, jobs[i].base, jobs[i].ports, jobs[i].recurse); });
+    }
+    _flat = true;
+}
+
+void Netlist::_expand(int d, const Counts &base, const std::vector<int> &ports, bool recurse) const {
+    // copy one definition into its slice of the flat tables, mapping local node ids to global ones
+    auto &def = _defs[d];
+    auto node = [&](int local) { return _globalNode(def, base, ports, local); };
+    for (size_t k = 0; k < def.fets.size(); k++) {
+        auto fet = def.fets[k];
+        fet.d = node(fet.d);
+        fet.g = node(fet.g);
+        fet.s = node(fet.s);
+        _fets[base.fets + k] = fet;
+    }
+    for (size_t k = 0; k < def.resistors.size(); k++) {
+        auto &r = def.resistors[k];
+        _resistors[base.resistors + k] = {node(r.a), node(r.b), r.R};
+    }
+    for (size_t k = 0; k < def.capacitors.size(); k++) {
+        auto &c = def.capacitors[k];
+        _capacitors[base.capacitors + k] = {node(c.a), node(c.b), c.C};
+    }
+    for (size_t k = 0; k < def.vsources.size(); k++) {
+        auto &v = def.vsources[k];
+        _vsources[base.vsources + k] = {node(v.p), node(v.n), v.wave};
+    }
+    if (!recurse) return;
+
+    for (size_t j = 0; j < def.instances.size(); j++) {
+        auto &instance = def.instances[j];
+        std::vector<int> childPorts;
+        childPorts.reserve(instance.nodes.size());
+        for (auto local : instance.nodes) childPorts.push_back(node(local));
+        _expand(instance.def, base + def.offsets[j], childPorts, true);
+    }
+}
+
+int Netlist::_globalNode(const Definition &def, const Counts &base, const std::vector<int> &ports, int local) {
+    if (local == GROUND) return GROUND;
+    if (local <= def.ports) return ports[local - 1];
+    return base.nodes + local - def.ports;
+}
+
+std::pair<int, int> Netlist::_locate(int Counts::*field, int id, std::string &path) const {
+    // walk down from the top level to the definition whose own elements contain flat index id,
+    // collecting the instance names on the way. returns (definition, local index).
+    _elaborate();
+    int d = 0;
+    while (true) {
+        auto &def = _defs[d];
+        if (id < def.offsets[0].*field) return {d, id};
+        auto it = std::upper_bound(def.offsets.begin() + 1, def.offsets.end() - 1, id, [&](int value, const Counts &offset) { return value < offset.*field; });
+        auto j = int(it - def.offsets.begin()) - 1;
+        id -= def.offsets[j].*field;
+        path += def.instances[j].name + ".";
+        d = def.instances[j].def;
+    }
+}
+
+bool Netlist::_resolve(const std::string &path, int &def, Counts &base, std::vector<int> &ports) const {
+    // follow a dotted instance path ("x1.x2") from the top level, tracking where its expansion
+    // starts and which global nodes its ports are tied to
+    _elaborate();
+    def = 0;
+    base = Counts();
+    ports.clear();
+    if (path.empty()) return true;
+
+    size_t start = 0;
+    while (start <= path.size()) {
+        auto dot = path.find('.', start);
+        if (dot == std::string::npos) dot = path.size();
+        auto &parent = _defs[def];
+        auto it = parent.instanceIds.find(path.substr(start, dot - start));
+        if (it == parent.instanceIds.end()) return false;
+
+        auto &instance = parent.instances[it->second];
+        std::vector<int> childPorts;
+        for (auto local : instance.nodes) childPorts.push_back(_globalNode(parent, base, ports, local));
+        base = base + parent.offsets[it->second];
+        ports.swap(childPorts);
+        def = instance.def;
+        start = dot + 1;
+    }
+    return true;
+}
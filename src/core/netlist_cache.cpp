@@ -0,0 +1,338 @@
+#include "netlist_cache.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+#include "mapped_file.hpp"
+
+const uint32_t NetlistCache::VERSION;
+
+namespace {
+    const char MAGIC[8] = {'c', 's', 'i', 'm', 'n', 'e', 't', '\0'};
+    const uint32_t ENDIAN_MARK = 0x01020304;
+
+    // hashes everything it writes, the hash closes the image
+    class Writer {
+    public:
+        explicit Writer(std::ofstream &file) : _file(file), _hash(hash_bytes(nullptr, 0)) {}
+
+        void write(const void *data, size_t size) {
+            _file.write(static_cast<const char *>(data), std::streamsize(size));
+            _hash = hash_bytes(data, size, _hash);
+        }
+
+        template <typename T> void put(const T &value) {
+            static_assert(std::is_trivially_copyable<T>::value, "only plain data can be written raw");
+            write(&value, sizeof(T));
+        }
+
+        template <typename T> void putArray(const std::vector<T> &values) {
+            static_assert(std::is_trivially_copyable<T>::value, "only plain data can be written raw");
+            put(uint64_t(values.size()));
+            write(values.data(), values.size() * sizeof(T));
+        }
+
+        void putString(const std::string &text) {
+            put(uint32_t(text.size()));
+            write(text.data(), text.size());
+        }
+
+        void putStrings(const std::vector<std::string> &texts) {
+            put(uint64_t(texts.size()));
+            for (auto &text : texts) putString(text);
+        }
+
+        uint64_t hash() const { return _hash; }
+
+    private:
+        std::ofstream &_file;
+        uint64_t _hash;
+    };
+
+    // bounds checked cursor over the mapped image, any overrun means a truncated or corrupt file
+    class Reader {
+    public:
+        Reader(const char *data, size_t size) : _pos(data), _end(data + size) {}
+
+        template <typename T> T get() {
+            static_assert(std::is_trivially_copyable<T>::value, "only plain data can be read raw");
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+            _take(&storage, sizeof(T));
+            return *reinterpret_cast<T *>(&storage);
+        }
+
+        template <typename T> void getArray(std::vector<T> &values) {
+            auto count = get<uint64_t>();
+            if (count > size_t(_end - _pos) / sizeof(T)) throw std::runtime_error("truncated netlist image");
+            values.clear();
+            if constexpr (std::is_default_constructible<T>::value) {
+                values.resize(count);
+                _take(values.data(), count * sizeof(T));
+            } else {
+                values.reserve(count);
+                for (size_t i = 0; i < count; i++) values.push_back(get<T>());
+            }
+        }
+
+        std::string getString() {
+            auto length = get<uint32_t>();
+            if (length > size_t(_end - _pos)) throw std::runtime_error("truncated netlist image");
+            std::string text(_pos, length);
+            _pos += length;
+            return text;
+        }
+
+        void getStrings(std::vector<std::string> &texts) {
+            texts.resize(getCount(sizeof(uint32_t)));
+            for (auto &text : texts) text = getString();
+        }
+
+        // a record count, each record taking at least minimum bytes of what is left
+        size_t getCount(size_t minimum) {
+            auto count = get<uint64_t>();
+            if (count > size_t(_end - _pos) / minimum) throw std::runtime_error("truncated netlist image");
+            return size_t(count);
+        }
+
+        bool done() const { return _pos == _end; }
+
+    private:
+        const char *_pos, *_end;
+
+        void _take(void *out, size_t size) {
+            if (size > size_t(_end - _pos)) throw std::runtime_error("truncated netlist image");
+            if (size) std::memcpy(out, _pos, size);
+            _pos += size;
+        }
+    };
+
+    bool isNode(int id, size_t nodes) {
+        return id >= 0 && size_t(id) < nodes;
+    }
+}
+
+uint64_t NetlistCache::_hashFile(const std::string &path, uint64_t &size) {
+    MappedFile file(path);
+    size = file.size();
+    return hash_bytes(file.data(), file.size());
+}
+
+void NetlistCache::save(const std::filesystem::path &image, const Netlist &netlist) {
+    if (netlist.getSources().empty()) throw std::runtime_error("only netlists read from a file can be cached");
+
+    // write next to the target and rename, so a crashed or concurrent run never sees half an image
+    auto temp = image;
+    temp += ".tmp";
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) throw std::runtime_error("Failed to open file [ " + temp.string() + " ]");
+    Writer out(file);
+
+    out.write(MAGIC, sizeof(MAGIC));
+    out.put(VERSION);
+    out.put(ENDIAN_MARK);
+    out.put(uint32_t(sizeof(Netlist::FetInstance)));
+    out.put(uint32_t(sizeof(Netlist::ResistorInstance)));
+    out.put(uint32_t(sizeof(Netlist::CapacitorInstance)));
+    out.put(uint32_t(sizeof(PlanarFET::Tech)));
+
+    out.put(uint64_t(netlist._sources.size()));
+    for (auto &source : netlist._sources) {
+        uint64_t size;
+        auto hash = _hashFile(source, size);
+        out.putString(source);
+        out.put(size);
+        out.put(hash);
+    }
+
+    out.putStrings(netlist._techNames);
+    out.putArray(netlist._techs);
+
+    out.put(uint64_t(netlist._defs.size()));
+    for (auto &def : netlist._defs) {
+        out.putString(def.name);
+        out.put(int32_t(def.ports));
+        out.putStrings(def.nodeNames);
+        out.putArray(def.fets);
+        out.putArray(def.resistors);
+        out.putArray(def.capacitors);
+        out.put(uint64_t(def.vsources.size()));
+        for (auto &v : def.vsources) {
+            out.put(int32_t(v.p));
+            out.put(int32_t(v.n));
+            out.put(int32_t(v.wave.shape));
+            out.putArray(v.wave.params);
+        }
+        out.putStrings(def.fetNames);
+        out.putStrings(def.resistorNames);
+        out.putStrings(def.capacitorNames);
+        out.putStrings(def.vsourceNames);
+        out.put(uint64_t(def.instances.size()));
+        for (auto &instance : def.instances) {
+            out.putString(instance.name);
+            out.putString(instance.subckt);
+            out.putArray(instance.nodes);
+        }
+    }
+
+    out.put(uint64_t(netlist._analyses.size()));
+    for (auto &analysis : netlist._analyses) {
+        out.putString(analysis.type);
+        out.putStrings(analysis.args);
+    }
+    auto checksum = out.hash();
+    file.write(reinterpret_cast<const char *>(&checksum), sizeof(checksum));
+
+    file.close();
+    if (!file) throw std::runtime_error("Failed to write file [ " + temp.string() + " ]");
+    std::filesystem::rename(temp, image);
+}
+
+bool NetlistCache::load(const std::filesystem::path &image, const std::filesystem::path &design, const std::vector<std::filesystem::path> &techfiles, Netlist &netlist) {
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(image, error)) return false;
+
+    try {
+        MappedFile file(image.string());
+        uint64_t checksum;
+        if (file.size() < sizeof(checksum)) return false;
+        auto body = file.size() - sizeof(checksum);
+        std::memcpy(&checksum, file.data() + body, sizeof(checksum));
+        if (hash_bytes(file.data(), body) != checksum) return false;
+
+        Reader in(file.data(), body);
+        char magic[sizeof(MAGIC)];
+        for (auto &c : magic) c = in.get<char>();
+        if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) return false;
+        if (in.get<uint32_t>() != VERSION || in.get<uint32_t>() != ENDIAN_MARK) return false;
+        if (in.get<uint32_t>() != sizeof(Netlist::FetInstance) || in.get<uint32_t>() != sizeof(Netlist::ResistorInstance)) return false;
+        if (in.get<uint32_t>() != sizeof(Netlist::CapacitorInstance) || in.get<uint32_t>() != sizeof(PlanarFET::Tech)) return false;
+
+        // the image is keyed by the contents of every file that went into it. techfiles and the
+        // deck lead the list in the order they were read.
+        std::vector<std::string> roots;
+        for (auto &techfile : techfiles) roots.push_back(techfile.string());
+        roots.push_back(design.string());
+        Netlist result;
+        result._sources.resize(in.getCount(sizeof(uint32_t) + 2 * sizeof(uint64_t)));
+        if (result._sources.size() < roots.size()) return false;
+        for (size_t i = 0; i < result._sources.size(); i++) {
+            auto source = in.getString();
+            auto size = in.get<uint64_t>();
+            auto hash = in.get<uint64_t>();
+            if (i < roots.size() && source != roots[i]) return false;
+            uint64_t currentSize = 0;
+            if (std::filesystem::file_size(source, error) != size || error) return false;
+            if (_hashFile(source, currentSize) != hash || currentSize != size) return false;
+            result._sources[i] = source;
+        }
+
+        in.getStrings(result._techNames);
+        in.getArray(result._techs);
+        if (result._techNames.size() != result._techs.size()) return false;
+
+        result._defs.resize(in.getCount(sizeof(uint32_t)));
+        for (auto &def : result._defs) {
+            def.name = in.getString();
+            def.ports = in.get<int32_t>();
+            in.getStrings(def.nodeNames);
+            in.getArray(def.fets);
+            in.getArray(def.resistors);
+            in.getArray(def.capacitors);
+            def.vsources.resize(in.getCount(3 * sizeof(int32_t) + sizeof(uint64_t)));
+            for (auto &v : def.vsources) {
+                v.p = in.get<int32_t>();
+                v.n = in.get<int32_t>();
+                v.wave.shape = Source::Shape(in.get<int32_t>());
+                in.getArray(v.wave.params);
+            }
+            in.getStrings(def.fetNames);
+            in.getStrings(def.resistorNames);
+            in.getStrings(def.capacitorNames);
+            in.getStrings(def.vsourceNames);
+            def.instances.resize(in.getCount(2 * sizeof(uint32_t) + sizeof(uint64_t)));
+            for (auto &instance : def.instances) {
+                instance.name = in.getString();
+                instance.subckt = in.getString();
+                instance.def = -1;
+                in.getArray(instance.nodes);
+            }
+            def.expandedInstances = 0;
+        }
+        if (result._defs.empty()) return false;
+
+        result._analyses.resize(in.getCount(sizeof(uint32_t) + sizeof(uint64_t)));
+        for (auto &analysis : result._analyses) {
+            analysis.type = in.getString();
+            in.getStrings(analysis.args);
+        }
+        if (!in.done()) return false;
+
+        result._rebuildIndex();
+        if (!_validate(result)) return false;
+        netlist = std::move(result);
+        return true;
+    } catch (std::exception &) {
+        return false;
+    }
+}
+
+bool NetlistCache::_validate(const Netlist &netlist) {
+    // everything _flatten() and the simulator index with must stay in bounds, whatever the file holds
+    if (netlist._defs.empty() || netlist._defIds.size() != netlist._defs.size()) return false;
+    auto techs = netlist._techs.size();
+    for (size_t d = 0; d < netlist._defs.size(); d++) {
+        auto &def = netlist._defs[d];
+        auto nodes = def.nodeNames.size();
+        if (nodes == 0 || def.ports < 0 || size_t(def.ports) >= nodes || (d == 0 && def.ports != 0)) return false;
+        if (def.fetNames.size() != def.fets.size() || def.resistorNames.size() != def.resistors.size()) return false;
+        if (def.capacitorNames.size() != def.capacitors.size() || def.vsourceNames.size() != def.vsources.size()) return false;
+
+        for (auto &f : def.fets) {
+            if (!isNode(f.d, nodes) || !isNode(f.g, nodes) || !isNode(f.s, nodes)) return false;
+            if (f.tech < 0 || size_t(f.tech) >= techs) return false;
+            if (f.devType != ModelUtils::DevType::N && f.devType != ModelUtils::DevType::P) return false;
+        }
+        for (auto &r : def.resistors) if (!isNode(r.a, nodes) || !isNode(r.b, nodes)) return false;
+        for (auto &c : def.capacitors) if (!isNode(c.a, nodes) || !isNode(c.b, nodes)) return false;
+        for (auto &v : def.vsources) {
+            if (!isNode(v.p, nodes) || !isNode(v.n, nodes)) return false;
+            auto count = v.wave.params.size();
+            switch (v.wave.shape) {
+            case Source::Shape::DC: if (count != 1) return false; break;
+            case Source::Shape::PULSE: if (count != 7) return false; break;
+            case Source::Shape::PWL: if (count < 2 || count % 2) return false; break;
+            default: return false;
+            }
+        }
+        for (auto &instance : def.instances) {
+            auto it = netlist._defIds.find(instance.subckt);
+            if (it == netlist._defIds.end() || it->second == 0) return false;
+            if (instance.nodes.size() != size_t(netlist._defs[it->second].ports)) return false;
+            for (auto node : instance.nodes) if (!isNode(node, nodes)) return false;
+        }
+    }
+    return true;
+}
+
+Netlist NetlistCache::read(const std::filesystem::path &design, const std::vector<std::filesystem::path> &techfiles, const std::filesystem::path &image, bool *hit, std::string *error) {
+    Netlist netlist;
+    auto loaded = load(image, design, techfiles, netlist);
+    if (hit) *hit = loaded;
+    if (error) error->clear();
+    if (loaded) return netlist;
+    netlist = Netlist::read(design, techfiles);
+
+    // a directory that is read-only or full only costs the next run its parse
+    try {
+        save(image, netlist);
+    } catch (std::exception &e) {
+        if (error) *error = e.what();
+        auto temp = image;
+        temp += ".tmp";
+        std::error_code ignored;
+        std::filesystem::remove(temp, ignored);
+    }
+    return netlist;
+}
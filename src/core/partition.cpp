@@ -0,0 +1,555 @@
+#include "partition.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+
+namespace {
+    int findRoot(std::vector<int> &parent, int node) {
+        while (parent[node] != node) {
+            parent[node] = parent[parent[node]];
+            node = parent[node];
+        }
+        return node;
+    }
+}
+
+Partition::Partition(const Netlist &netlist) : _levels(0) {
+    // nodes a chain of sources ties to ground are fixed by the sources alone. they are found
+    // before anything is joined, so they join nothing whatever order the netlist lists them in
+    auto count = netlist.getNodeCount();
+    auto &sources = netlist.getVSources();
+    std::vector<int> railOf(count, -1);
+    std::vector<char> fixing(sources.size(), 0);
+    auto fixed = [&](int node) { return node == Netlist::GROUND || railOf[node] >= 0; };
+    for (bool grown = true; grown;) {
+        grown = false;
+        for (size_t k = 0; k < sources.size(); k++) {
+            auto &v = sources[k];
+            if (fixing[k] || fixed(v.p) == fixed(v.n)) continue;
+            auto node = fixed(v.p) ? v.n : v.p, from = node == v.p ? v.n : v.p;
+            railOf[node] = int(_rails.size());
+            _rails.push_back({node, int(k), from == Netlist::GROUND ? -1 : railOf[from]});
+            fixing[k] = 1;
+            grown = true;
+        }
+    }
+
+    // union every pair of free nodes joined by a conducting or capacitive path
+    std::vector<int> parent(count);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto join = [&](int a, int b) {
+        if (fixed(a) || fixed(b)) return;
+        a = findRoot(parent, a);
+        b = findRoot(parent, b);
+        if (a != b) parent[std::max(a, b)] = std::min(a, b);
+    };
+    for (auto &r : netlist.getResistors()) join(r.a, r.b);
+    for (auto &c : netlist.getCapacitors()) join(c.a, c.b);
+    for (auto &f : netlist.getFets()) join(f.d, f.s);
+    for (auto &v : sources) join(v.p, v.n);
+
+    _blockOf.assign(count, -1);
+    std::vector<int> rootBlock(count, -1);
+    for (int node = 1; node < count; node++) {
+        if (fixed(node)) continue;
+        auto root = findRoot(parent, node);
+        if (rootBlock[root] < 0) {
+            rootBlock[root] = int(_blocks.size());
+            _blocks.push_back({{}, {}, 0, 0});
+        }
+        _blockOf[node] = rootBlock[root];
+        _blocks[rootBlock[root]].nodes.push_back(node);
+        _blocks[rootBlock[root]].weight++;
+    }
+
+    // floating sources belong to the block they join, fixing ones to none
+    for (size_t k = 0; k < sources.size(); k++) {
+        if (fixed(sources[k].p) || fixed(sources[k].n)) continue;
+        _blocks[_blockOf[sources[k].p]].vsources.push_back(int(k));
+        _blocks[_blockOf[sources[k].p]].weight++;
+    }
+    auto weigh = [&](int a, int b) {
+        auto node = !fixed(a) ? a : b;
+        if (!fixed(node)) _blocks[_blockOf[node]].weight++;
+    };
+    for (auto &r : netlist.getResistors()) weigh(r.a, r.b);
+    for (auto &c : netlist.getCapacitors()) weigh(c.a, c.b);
+    for (auto &f : netlist.getFets()) weigh(f.d, f.s);
+
+    _levelize(netlist);
+}
+
+void Partition::_levelize(const Netlist &netlist) {
+    // Kahn's algorithm on the gate -> channel block graph. when only loops are left, the block
+    // with the fewest unresolved inputs is released at the level reached so far.
+    auto count = _blocks.size();
+    std::vector<std::vector<int>> fanout(count);
+    for (auto &f : netlist.getFets()) {
+        auto channel = _blockOf[f.d] >= 0 ? _blockOf[f.d] : _blockOf[f.s];
+        auto gate = _blockOf[f.g];
+        if (gate < 0 || channel < 0) continue;
+        if (gate != channel) fanout[gate].push_back(channel);
+    }
+    std::vector<int> fanin(count, 0);
+    for (auto &targets : fanout) {
+        std::sort(targets.begin(), targets.end());
+        targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+        for (auto b : targets) fanin[b]++;
+    }
+
+    std::vector<int> level(count, 0), ready;
+    std::vector<char> done(count, 0);
+    for (size_t b = 0; b < count; b++) {
+        if (fanin[b] == 0) ready.push_back(int(b));
+    }
+    size_t released = 0;
+    while (released < count) {
+        if (ready.empty()) {
+            int pick = -1;
+            for (size_t b = 0; b < count; b++) {
+                if (!done[b] && (pick < 0 || fanin[b] < fanin[pick])) pick = int(b);
+            }
+            ready.push_back(pick);
+        }
+        auto b = ready.back();
+        ready.pop_back();
+        if (done[b]) continue;
+        done[b] = 1;
+        released++;
+        for (auto next : fanout[b]) {
+            if (done[next]) continue;
+            level[next] = std::max(level[next], level[b] + 1);
+            if (--fanin[next] == 0) ready.push_back(next);
+        }
+    }
+
+    for (size_t b = 0; b < count; b++) {
+        _blocks[b].level = level[b];
+        _levels = std::max(_levels, level[b] + 1);
+    }
+}
+
+PartitionedSolver::PartitionedSolver(const Simulator &simulator, const Partition &partition, int threads) : _sim(simulator) {
+    auto &netlist = simulator.getNetlist();
+    auto &blocks = partition.getBlocks();
+    if (threads <= 0) threads = int(ThreadPool::default_threads());
+
+    // pack the blocks of each level into at most `threads` groups of similar weight. multirate
+    // keeps every block on its own so latency is tracked per block.
+    _levels.resize(partition.getLevelCount());
+    std::vector<std::vector<int>> byLevel(partition.getLevelCount());
+    for (size_t b = 0; b < blocks.size(); b++) byLevel[blocks[b].level].push_back(int(b));
+    std::vector<int> groupOfBlock(blocks.size());
+    for (int level = 0; level < int(byLevel.size()); level++) {
+        auto &members = byLevel[level];
+        std::sort(members.begin(), members.end(), [&](int a, int b) { return blocks[a].weight > blocks[b].weight; });
+        auto bins = simulator.getOptions().multirate ? int(members.size()) : std::min(int(members.size()), threads);
+        std::vector<int> load(bins, 0);
+        for (int i = 0; i < bins; i++) {
+            _levels[level].push_back(int(_groups.size()) + i);
+        }
+        for (auto b : members) {
+            auto bin = int(std::min_element(load.begin(), load.end()) - load.begin());
+            load[bin] += blocks[b].weight;
+            groupOfBlock[b] = _levels[level][bin];
+        }
+        _groups.resize(_groups.size() + bins);
+        for (auto g : _levels[level]) _groups[g].level = level;
+    }
+
+    // the rails get one more group outside the levels: their sources and the elements that
+    // touch nothing but rails. everything else only sees a rail as a boundary node.
+    _rails = partition.getRails();
+    std::vector<int> railOf(netlist.getNodeCount(), -1);
+    for (size_t r = 0; r < _rails.size(); r++) railOf[_rails[r].node] = int(r);
+    if (!_rails.empty()) {
+        _railGroup = int(_groups.size());
+        _groups.emplace_back();
+        _groups.back().level = -1;
+    }
+
+    auto groupOf = [&](int node) {
+        auto block = partition.getBlockOf(node);
+        return block < 0 ? -1 : groupOfBlock[block];
+    };
+    auto ownerOf = [&](int node) { return railOf[node] >= 0 ? _railGroup : groupOf(node); };
+    std::vector<std::vector<int>> fets(_groups.size()), resistors(_groups.size()), capacitors(_groups.size());
+    auto assign = [&](std::vector<std::vector<int>> &lists, int element, std::initializer_list<int> nodes) {
+        int seen[3] = {-1, -1, -1}, n = 0;
+        for (auto node : nodes) {
+            auto g = groupOf(node);
+            if (g < 0 || std::find(seen, seen + n, g) != seen + n) continue;
+            seen[n++] = g;
+            lists[g].push_back(element);
+        }
+        if (n == 0 && std::any_of(nodes.begin(), nodes.end(), [&](int node) { return railOf[node] >= 0; })) lists[_railGroup].push_back(element);
+    };
+    for (size_t k = 0; k < netlist.getFets().size(); k++) {
+        auto &f = netlist.getFets()[k];
+        assign(fets, int(k), {f.d, f.g, f.s});
+    }
+    for (size_t k = 0; k < netlist.getResistors().size(); k++) {
+        auto &r = netlist.getResistors()[k];
+        assign(resistors, int(k), {r.a, r.b});
+    }
+    for (size_t k = 0; k < netlist.getCapacitors().size(); k++) {
+        auto &c = netlist.getCapacitors()[k];
+        assign(capacitors, int(k), {c.a, c.b});
+    }
+
+    // one sub-netlist per group: every element touching its nodes, and an ideal source on each
+    // outside node those elements reach
+    auto options = simulator.getOptions();
+    options.partition = false;
+    options.multirate = false;
+    auto numNodes = simulator.getNodeUnknowns();
+    for (size_t g = 0; g < _groups.size(); g++) {
+        auto &group = _groups[g];
+        group.netlist = std::make_unique<Netlist>();
+        auto &sub = *group.netlist;
+        for (int t = 0; t < netlist.getTechCount(); t++) sub.addTech(netlist.getTechName(t), netlist.getTech(t));
+
+        // an element in several groups draws from a rail through the first of them only. the
+        // others tie it to a second source on the rail, whose current is not summed.
+        std::unordered_map<int, int> local, shared;
+        std::vector<std::pair<int, bool>> outside;  // global node, shared rail
+        auto node = [&](int global, bool counted = true) {
+            if (global == Netlist::GROUND) return std::string("0");
+            if (!counted && railOf[global] >= 0) {
+                auto name = "s" + std::to_string(global);
+                if (shared.emplace(global, sub.addNode(name)).second) outside.push_back({global, true});
+                return name;
+            }
+            auto name = "n" + std::to_string(global);
+            if (local.emplace(global, sub.addNode(name)).second && ownerOf(global) != int(g)) outside.push_back({global, false});
+            return name;
+        };
+        auto counts = [&](std::initializer_list<int> nodes) {
+            for (auto n : nodes) {
+                if (groupOf(n) >= 0) return groupOf(n) == int(g);
+            }
+            return true;
+        };
+        for (auto k : fets[g]) {
+            auto &f = netlist.getFets()[k];
+            auto counted = counts({f.d, f.g, f.s});
+            sub.addFet("m" + std::to_string(k), node(f.d, counted), node(f.g, counted), node(f.s, counted), f.W, f.devType, f.tech);
+        }
+        for (auto k : resistors[g]) {
+            auto &r = netlist.getResistors()[k];
+            auto counted = counts({r.a, r.b});
+            sub.addResistor("r" + std::to_string(k), node(r.a, counted), node(r.b, counted), r.R);
+        }
+        for (auto k : capacitors[g]) {
+            auto &c = netlist.getCapacitors()[k];
+            auto counted = counts({c.a, c.b});
+            sub.addCapacitor("c" + std::to_string(k), node(c.a, counted), node(c.b, counted), c.C);
+        }
+        std::vector<int> branches;
+        group.dynamic = false;
+        for (size_t b = 0; b < blocks.size(); b++) {
+            if (groupOfBlock[b] != int(g)) continue;
+            for (auto n : blocks[b].nodes) node(n);
+            for (auto k : blocks[b].vsources) {
+                auto &v = netlist.getVSources()[k];
+                if (v.wave.shape != Source::Shape::DC) group.dynamic = true;
+                sub.addVSource("v" + std::to_string(k), node(v.p), node(v.n), v.wave);
+                branches.push_back(numNodes + k);
+            }
+        }
+        if (int(g) == _railGroup) {
+            group.dynamic = true;
+            for (auto &rail : _rails) {
+                auto &v = netlist.getVSources()[rail.source];
+                sub.addVSource("v" + std::to_string(rail.source), node(v.p), node(v.n), v.wave);
+                branches.push_back(numNodes + rail.source);
+            }
+        }
+        for (auto &[global, isShared] : outside) {
+            auto name = (isShared ? "s" : "n") + std::to_string(global);
+            sub.addVSource("b" + name, name, "0", {Source::Shape::DC, {0.0}});
+            branches.push_back(-1);
+        }
+
+        group.sim = std::make_unique<Simulator>(sub, options);
+        auto size = group.sim->getSize();
+        auto subNodes = group.sim->getNodeUnknowns();
+        group.unknowns.assign(size, -1);
+        group.owned.assign(size, 0);
+        for (auto &[global, id] : local) {
+            group.unknowns[id - 1] = global - 1;
+            group.owned[id - 1] = ownerOf(global) == int(g);
+        }
+        for (auto &[global, id] : shared) group.unknowns[id - 1] = global - 1;
+        for (size_t k = 0; k < branches.size(); k++) {
+            group.unknowns[subNodes + k] = branches[k];
+            group.owned[subNodes + k] = branches[k] >= 0;
+        }
+        auto firstBoundary = int(branches.size() - outside.size());
+        for (size_t k = 0; k < outside.size(); k++) {
+            auto [global, isShared] = outside[k];
+            group.boundary.push_back({firstBoundary + int(k), global - 1});
+            if (railOf[global] >= 0 && !isShared) group.draws.push_back({subNodes + firstBoundary + int(k), railOf[global]});
+        }
+        group.x.assign(size, 0.0);
+        group.xPrev.assign(size, 0.0);
+        group.converged = false;
+        group.latent = false;
+        group.quietSteps = 0;
+        group.currents.assign(sub.getFets().size(), 0.0);
+    }
+
+    if (threads > 1) _pool = std::make_unique<ThreadPool>(unsigned(threads));
+}
+
+PartitionedSolver::~PartitionedSolver() = default;
+
+void PartitionedSolver::getMemory(MemoryReport::Usage &usage, bool projected) const {
+    using M = MemoryReport;
+    for (auto &group : _groups) {
+        group.netlist->getMemory(usage);
+        group.sim->getMemory(usage, projected);
+        usage[M::Subsystem::Matrix] += M::bytes(group.unknowns) + M::bytes(group.owned) + M::bytes(group.boundary) + M::bytes(group.draws) + M::bytes(group.x) + M::bytes(group.xPrev);
+        usage[M::Subsystem::Models] += M::bytes(group.currents) + M::bytes(group.frozenInputs);
+    }
+}
+
+int PartitionedSolver::getLatentCount() const {
+    return int(std::count_if(_groups.begin(), _groups.end(), [](const Group &group) { return group.latent; }));
+}
+
+bool PartitionedSolver::_wakes(const Group &group, const std::vector<double> &snapshot) const {
+    auto &options = _sim.getOptions();
+    for (size_t k = 0; k < group.boundary.size(); k++) {
+        if (std::abs(snapshot[group.boundary[k].second] - group.frozenInputs[k]) > options.latencyWake) return true;
+    }
+    return false;
+}
+
+void PartitionedSolver::wakeAll() {
+    for (auto &group : _groups) {
+        group.latent = false;
+        group.quietSteps = 0;
+    }
+}
+
+std::vector<double> PartitionedSolver::getLatencyState() const {
+    // per group: latent, quietSteps, the device currents and the frozen inputs (count first)
+    std::vector<double> state;
+    for (auto &group : _groups) {
+        state.push_back(group.latent ? 1.0 : 0.0);
+        state.push_back(group.quietSteps);
+        state.insert(state.end(), group.currents.begin(), group.currents.end());
+        state.push_back(double(group.frozenInputs.size()));
+        state.insert(state.end(), group.frozenInputs.begin(), group.frozenInputs.end());
+    }
+    return state;
+}
+
+void PartitionedSolver::setLatencyState(const std::vector<double> &state) {
+    if (state.empty()) {
+        wakeAll();
+        for (auto &group : _groups) {
+            std::fill(group.currents.begin(), group.currents.end(), 0.0);
+            group.frozenInputs.clear();
+        }
+        return;
+    }
+    size_t pos = 0;
+    auto take = [&]() {
+        if (pos >= state.size()) throw std::runtime_error("latency state does not match the partition");
+        return state[pos++];
+    };
+    for (auto &group : _groups) {
+        group.latent = take() != 0.0;
+        group.quietSteps = int(take());
+        for (auto &current : group.currents) current = take();
+        group.frozenInputs.resize(size_t(take()));
+        for (auto &input : group.frozenInputs) input = take();
+    }
+    if (pos != state.size()) throw std::runtime_error("latency state does not match the partition");
+}
+
+std::vector<double> PartitionedSolver::getChordState() const {
+    // per group: the length of its simulator's state, then the state
+    std::vector<double> state;
+    for (auto &group : _groups) {
+        auto own = group.sim->_getChordState();
+        state.push_back(double(own.size()));
+        state.insert(state.end(), own.begin(), own.end());
+    }
+    return state;
+}
+
+void PartitionedSolver::setChordState(const std::vector<double> &state) {
+    size_t pos = 0;
+    for (auto &group : _groups) {
+        if (state.empty()) {
+            group.sim->_setChordState({});
+            continue;
+        }
+        if (pos >= state.size() || size_t(state[pos]) > state.size() - pos - 1) throw std::runtime_error("chord state does not match the partition");
+        auto length = size_t(state[pos++]);
+        group.sim->_setChordState(std::vector<double>(state.begin() + pos, state.begin() + pos + length));
+        pos += length;
+    }
+    if (pos != state.size()) throw std::runtime_error("chord state does not match the partition");
+}
+
+void PartitionedSolver::accept(const std::vector<double> &x, const std::vector<double> &xPrev, double h) {
+    // a group is quiet when its own nodes barely slew and no device it holds changed its
+    // transient current (channel plus capacitive) since the previous accepted point
+    auto &options = _sim.getOptions();
+    auto voltage = [](const std::vector<double> &v, const Group &group, int node) {
+        return node == Netlist::GROUND ? 0.0 : v[group.unknowns[node - 1]];
+    };
+    for (auto &group : _groups) {
+        if (group.latent) continue;
+
+        double slew = 0.0;
+        for (size_t i = 0; i < group.unknowns.size(); i++) {
+            if (group.owned[i] && i < size_t(group.sim->getNodeUnknowns())) slew = std::max(slew, std::abs(x[group.unknowns[i]] - xPrev[group.unknowns[i]]) / h);
+        }
+
+        double change = 0.0;
+        auto &sub = *group.netlist;
+        auto &fets = sub.getFets();
+        for (size_t k = 0; k < fets.size(); k++) {
+            auto &f = fets[k];
+            auto Vd = voltage(x, group, f.d), Vg = voltage(x, group, f.g), Vs = voltage(x, group, f.s);
+            auto dVg = Vg - voltage(xPrev, group, f.g), dVd = Vd - voltage(xPrev, group, f.d), dVs = Vs - voltage(xPrev, group, f.s);
+            auto current = PlanarFET::getTransientCurrent(sub.getTech(f.tech), f.W, Vg - Vs, Vd - Vs, (dVg - dVs) / h, (dVd - dVs) / h, f.devType);
+            change = std::max(change, std::abs(current - group.currents[k]));
+            group.currents[k] = current;
+        }
+
+        auto quiet = !group.dynamic && slew <= options.latencySlew && change <= options.latencyCurrent;
+        group.quietSteps = quiet ? group.quietSteps + 1 : 0;
+        if (group.quietSteps >= 2) {
+            group.latent = true;
+            group.frozenInputs.clear();
+            for (auto &entry : group.boundary) group.frozenInputs.push_back(x[entry.second]);
+        }
+    }
+}
+
+void PartitionedSolver::_solveGroup(Group &group, const std::vector<double> &snapshot, std::vector<double> &x, const std::vector<double> *xPrev, double h, double time) {
+    for (auto &[source, unknown] : group.boundary) group.netlist->getVSource(source).wave.params[0] = snapshot[unknown];
+    for (size_t i = 0; i < group.unknowns.size(); i++) {
+        auto u = group.unknowns[i];
+        if (u < 0) continue;
+        group.x[i] = snapshot[u];
+        if (xPrev) group.xPrev[i] = (*xPrev)[u];
+    }
+
+    group.converged = group.sim->_newton(group.x, xPrev ? &group.xPrev : nullptr, h, time, 1.0);
+    if (!group.converged) return;
+    for (size_t i = 0; i < group.unknowns.size(); i++) {
+        if (group.owned[i]) x[group.unknowns[i]] = group.x[i];
+    }
+}
+
+void PartitionedSolver::_sumRailCurrents(std::vector<double> &x) const {
+    // the rail group solved the fixing sources against the rail-only elements. what every other
+    // group draws from a rail is the current of its boundary source there, and reaches ground
+    // through the chain of sources above the rail, children first.
+    if (_railGroup < 0) return;
+    auto &railGroup = _groups[_railGroup];
+    auto first = railGroup.sim->getNodeUnknowns();
+    std::vector<double> draw(_rails.size(), 0.0);
+    for (auto &group : _groups) {
+        for (auto &[local, rail] : group.draws) draw[rail] += group.x[local];
+    }
+    auto numNodes = _sim.getNodeUnknowns();
+    auto &sources = _sim.getNetlist().getVSources();
+    for (size_t r = _rails.size(); r-- > 0;) {
+        auto &rail = _rails[r];
+        auto own = railGroup.x[first + r];
+        x[numNodes + rail.source] = own + (sources[rail.source].p == rail.node ? draw[r] : -draw[r]);
+        if (rail.parent >= 0) draw[rail.parent] += draw[r];
+    }
+}
+
+bool PartitionedSolver::solve(std::vector<double> &x, const std::vector<double> *xPrev, double h, double time, Simulator::Statistics &stats) {
+    auto &options = _sim.getOptions();
+    auto numNodes = _sim.getNodeUnknowns();
+    auto initial = x;
+    std::vector<Simulator::Statistics> previous(_groups.size());
+    for (size_t g = 0; g < _groups.size(); g++) previous[g] = _groups[g].sim->getStatistics();
+    auto account = [&]() {
+        for (size_t g = 0; g < _groups.size(); g++) {
+            auto &now = _groups[g].sim->getStatistics();
+            stats.newtonIterations += now.newtonIterations - previous[g].newtonIterations;
+            stats.factorizations += now.factorizations - previous[g].factorizations;
+            stats.regionChanges += now.regionChanges - previous[g].regionChanges;
+            stats.reusedFactorizations += now.reusedFactorizations - previous[g].reusedFactorizations;
+            for (size_t r = 0; r < stats.refactors.size(); r++) stats.refactors[r] += now.refactors[r] - previous[g].refactors[r];
+        }
+    };
+
+    // rails only follow their sources, one solve ahead of the sweeps settles them
+    if (_railGroup >= 0) {
+        auto &rails = _groups[_railGroup];
+        _solveGroup(rails, x, x, xPrev, h, time);
+        if (!rails.converged) {
+            account();
+            x = initial;
+            return false;
+        }
+    }
+
+    std::vector<double> snapshot, before;
+    for (int sweep = 0; sweep < options.maxSweeps; sweep++) {
+        stats.relaxationSweeps++;
+        before = x;
+        for (auto &members : _levels) {
+            // groups of one level only read the snapshot and write disjoint unknowns
+            snapshot = x;
+            auto run = [&](size_t i) {
+                auto &group = _groups[members[i]];
+                if (group.latent && xPrev) {
+                    if (!_wakes(group, snapshot)) {
+                        group.converged = true;
+                        return;
+                    }
+                    group.latent = false;
+                    group.quietSteps = 0;
+                }
+                _solveGroup(group, snapshot, x, xPrev, h, time);
+            };
+            if (_pool && members.size() > 1) {
+                _pool->parallel_for(members.size(), run);
+            } else {
+                for (size_t i = 0; i < members.size(); i++) run(i);
+            }
+            for (auto g : members) {
+                if (_groups[g].converged) continue;
+                account();
+                x = initial;
+                return false;
+            }
+        }
+
+        if (xPrev) stats.latentSkips += getLatentCount();
+        _sumRailCurrents(x);
+
+        // settle on a quarter of the Newton tolerance so the error left by stopping the sweeps
+        // stays below what the block solves themselves leave. the rail currents sum every
+        // group's draw, and settle last.
+        bool settled = true;
+        for (size_t i = 0; i < x.size() && settled; i++) {
+            auto tol = 0.25 * (options.reltol * std::max(std::abs(x[i]), std::abs(before[i])) + (int(i) < numNodes ? options.vntol : options.abstol));
+            if (std::abs(x[i] - before[i]) > tol) settled = false;
+        }
+        if (settled) {
+            account();
+            return true;
+        }
+    }
+    account();
+    x = initial;
+    return false;
+}
@@ -0,0 +1,291 @@
+#include "probe.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "capacitor.hpp"
+
+namespace {
+    bool matchFrom(const char *pattern, const char *name) {
+        for (; *pattern; pattern++, name++) {
+            if (*pattern == '*') {
+                auto deep = pattern[1] == '*';
+                pattern += deep ? 2 : 1;
+                for (;; name++) {
+                    if (matchFrom(pattern, name)) return true;
+                    if (!*name || (!deep && *name == '.')) return false;
+                }
+            }
+            if (!*name) return false;
+            if (*pattern == '?' ? *name == '.' : *pattern != *name) return false;
+        }
+        return !*name;
+    }
+
+    const size_t SIGNAL_STATE = 11;     // doubles per signal in getState
+}
+
+bool ProbeWriter::match(const std::string &pattern, const std::string &name) {
+    return matchFrom(pattern.c_str(), name.c_str());
+}
+
+ProbeWriter::ProbeWriter(const Simulator &simulator)
+    : _sim(simulator), _started(false), _time(0.0), _samples(0), _stored(0) {}
+
+void ProbeWriter::_addSignal(const std::string &name, Signal signal) {
+    if (!_known.insert(name).second) return;
+    signal.low = -std::numeric_limits<double>::infinity();
+    signal.high = std::numeric_limits<double>::infinity();
+    _names.push_back(name);
+    _signals.push_back(signal);
+}
+
+void ProbeWriter::add(const std::vector<std::string> &args) {
+    Options options;
+    std::vector<std::string> patterns;
+    for (auto &arg : args) {
+        auto eq = arg.find('=');
+        if (eq == std::string::npos) {
+            patterns.push_back(arg);
+            continue;
+        }
+        auto key = arg.substr(0, eq);
+        auto value = Netlist::parseValue(arg.substr(eq + 1));
+        if (key == "tol") options.tol = value;
+        else if (key == "step") options.step = value;
+        else throw std::runtime_error("unknown probe option [ " + arg + " ]");
+        if (value < 0.0) throw std::runtime_error("probe option must not be negative [ " + arg + " ]");
+    }
+    if (patterns.empty()) throw std::runtime_error(".probe expects at least one signal");
+
+    auto &netlist = _sim.getNetlist();
+    for (auto &pattern : patterns) {
+        if (pattern.size() < 4 || pattern[1] != '(' || pattern.back() != ')') throw std::runtime_error("invalid probe [ " + pattern + " ]");
+        auto inner = pattern.substr(2, pattern.size() - 3);
+        // names without wildcards are looked up instead of matched against every element
+        auto literal = inner.find_first_of("*?") == std::string::npos;
+        auto matches = [&](const std::string &name) { return literal ? name == inner : match(inner, name); };
+        size_t matched = 0;
+        auto add = [&](const std::string &name, Signal::Kind kind, int element, int a = -1, int b = -1) {
+            Signal signal{};
+            signal.kind = kind;
+            signal.element = element;
+            signal.a = a;
+            signal.b = b;
+            signal.options = options;
+            _addSignal(name, signal);
+            matched++;
+        };
+
+        switch (pattern[0]) {
+        case 'v': {
+            auto comma = inner.find(',');
+            if (comma != std::string::npos) {
+                auto pos = netlist.findNode(inner.substr(0, comma)), neg = netlist.findNode(inner.substr(comma + 1));
+                if (pos < 0 || neg < 0) throw std::runtime_error("unknown probe node [ " + pattern + " ]");
+                // quoted, the name has a comma
+                add("\"" + pattern + "\"", Signal::Kind::Voltage, -1, _sim.getNodeIndex(pos), _sim.getNodeIndex(neg));
+            } else if (literal) {
+                auto node = netlist.findNode(inner);
+                if (node > Netlist::GROUND) add("v(" + netlist.getNodeName(node) + ")", Signal::Kind::Voltage, -1, _sim.getNodeIndex(node));
+            } else {
+                for (int node = Netlist::GROUND + 1; node < netlist.getNodeCount(); node++) {
+                    auto name = netlist.getNodeName(node);
+                    if (match(inner, name)) add("v(" + name + ")", Signal::Kind::Voltage, -1, _sim.getNodeIndex(node));
+                }
+            }
+            break;
+        }
+        case 'i':
+            for (size_t k = 0; k < netlist.getVSources().size(); k++) {
+                auto name = netlist.getVSourceName(int(k));
+                if (matches(name)) add("i(" + name + ")", Signal::Kind::SourceCurrent, int(k));
+            }
+            for (size_t k = 0; k < netlist.getFets().size(); k++) {
+                auto name = netlist.getFetName(int(k));
+                if (matches(name)) add("i(" + name + ")", Signal::Kind::FetCurrent, int(k));
+            }
+            for (size_t k = 0; k < netlist.getCapacitors().size(); k++) {
+                auto name = netlist.getCapacitorName(int(k));
+                if (matches(name)) add("i(" + name + ")", Signal::Kind::CapacitorCurrent, int(k));
+            }
+            break;
+        case 'p':
+            for (size_t k = 0; k < netlist.getFets().size(); k++) {
+                auto name = netlist.getFetName(int(k));
+                if (matches(name)) add("p(" + name + ")", Signal::Kind::FetPower, int(k));
+            }
+            for (size_t k = 0; k < netlist.getVSources().size(); k++) {
+                auto name = netlist.getVSourceName(int(k));
+                if (matches(name)) add("p(" + name + ")", Signal::Kind::SourcePower, int(k));
+            }
+            break;
+        default:
+            throw std::runtime_error("invalid probe [ " + pattern + " ]");
+        }
+        if (matched == 0) throw std::runtime_error("probe matches nothing [ " + pattern + " ]");
+    }
+}
+
+double ProbeWriter::_evaluate(const Signal &signal, double time, const std::vector<double> &x) const {
+    auto &netlist = _sim.getNetlist();
+    auto at = [&](const std::vector<double> &v, int node) {
+        auto index = _sim.getNodeIndex(node);
+        return index < 0 ? 0.0 : v[index];
+    };
+    // device currents differentiate the terminal voltages since the previous accepted point
+    auto h = _started ? time - _time : 0.0;
+    auto slope = [&](int node) { return h > 0.0 ? (at(x, node) - at(_x, node)) / h : 0.0; };
+
+    switch (signal.kind) {
+    case Signal::Kind::Voltage:
+        return (signal.a < 0 ? 0.0 : x[signal.a]) - (signal.b < 0 ? 0.0 : x[signal.b]);
+    case Signal::Kind::SourceCurrent:
+        return x[_sim.getNodeUnknowns() + signal.element];
+    case Signal::Kind::FetCurrent: {
+        auto &f = netlist.getFets()[signal.element];
+        auto Vs = at(x, f.s), dVs = slope(f.s);
+        return PlanarFET::getTransientCurrent(netlist.getTech(f.tech), f.W, at(x, f.g) - Vs, at(x, f.d) - Vs, slope(f.g) - dVs, slope(f.d) - dVs, f.devType);
+    }
+    case Signal::Kind::CapacitorCurrent: {
+        auto &c = netlist.getCapacitors()[signal.element];
+        return Capacitor::getTransientCurrent(c.C, slope(c.a) - slope(c.b));
+    }
+    case Signal::Kind::FetPower: {
+        auto &f = netlist.getFets()[signal.element];
+        auto Vs = at(x, f.s);
+        return PlanarFET::getInstantaneousPower(netlist.getTech(f.tech), f.W, at(x, f.g) - Vs, at(x, f.d) - Vs, f.devType);
+    }
+    case Signal::Kind::SourcePower:
+        return _sim.getSourcePower(signal.element, x);
+    }
+    return 0.0;
+}
+
+void ProbeWriter::writeHeader(std::ostream &out) {
+    out << "signal,time,value\n";
+}
+
+void ProbeWriter::accept(double time, const std::vector<double> &x, std::ostream &out) {
+    for (size_t i = 0; i < _signals.size(); i++) _sample(_signals[i], i, time, _evaluate(_signals[i], time, x), out);
+    _samples += long(_signals.size());
+    _x = x;
+    _time = time;
+    _started = true;
+}
+
+void ProbeWriter::_sample(Signal &signal, size_t index, double time, double value, std::ostream &out) {
+    auto step = signal.options.step;
+    if (step <= 0.0) {
+        _decimate(signal, index, time, value, out);
+        return;
+    }
+    // every grid point up to this sample, on the line from the previous one
+    for (double t; (t = double(signal.grid) * step) <= time + 1e-9 * step; signal.grid++) {
+        auto span = time - signal.sampleTime;
+        auto v = _started && span > 0.0 ? signal.sampleValue + (value - signal.sampleValue) * std::min(1.0, (t - signal.sampleTime) / span) : value;
+        _decimate(signal, index, t, v, out);
+    }
+    signal.sampleTime = time;
+    signal.sampleValue = value;
+}
+
+void ProbeWriter::_decimate(Signal &signal, size_t index, double time, double value, std::ostream &out) {
+    auto tol = signal.options.tol;
+    if (tol <= 0.0) {
+        _store(index, time, value, out);
+        return;
+    }
+    if (!signal.anchored) {
+        signal.anchored = true;
+        signal.anchorTime = time;
+        signal.anchorValue = value;
+        _store(index, time, value, out);
+        return;
+    }
+    auto span = time - signal.anchorTime;
+    if (span <= 0.0) return;
+    auto low = std::max(signal.low, (value - tol - signal.anchorValue) / span);
+    auto high = std::min(signal.high, (value + tol - signal.anchorValue) / span);
+    if (low > high && signal.pending) {
+        // no line from the anchor fits this sample as well, the segment ends at the previous one
+        _close(signal, index, out);
+        span = time - signal.anchorTime;
+        low = (value - tol - signal.anchorValue) / span;
+        high = (value + tol - signal.anchorValue) / span;
+    }
+    signal.low = low;
+    signal.high = high;
+    signal.pending = true;
+    signal.pendingTime = time;
+    signal.pendingValue = value;
+}
+
+void ProbeWriter::_close(Signal &signal, size_t index, std::ostream &out) {
+    // the end point is on a line within tol of every sample since the anchor, and within tol of
+    // the last sample itself
+    auto span = signal.pendingTime - signal.anchorTime;
+    auto slope = std::clamp((signal.pendingValue - signal.anchorValue) / span, signal.low, signal.high);
+    signal.anchorTime = signal.pendingTime;
+    signal.anchorValue += slope * span;
+    signal.pending = false;
+    signal.low = -std::numeric_limits<double>::infinity();
+    signal.high = std::numeric_limits<double>::infinity();
+    _store(index, signal.anchorTime, signal.anchorValue, out);
+}
+
+void ProbeWriter::_store(size_t index, double time, double value, std::ostream &out) {
+    // enough digits that rounding stays well below any sensible tol
+    out.precision(10);
+    out << _names[index] << ',' << time << ',' << value << '\n';
+    _stored++;
+}
+
+void ProbeWriter::finish(std::ostream &out) {
+    for (size_t i = 0; i < _signals.size(); i++) {
+        if (_signals[i].pending) _close(_signals[i], i, out);
+    }
+}
+
+void ProbeWriter::reset() {
+    for (auto &signal : _signals) {
+        signal.grid = 0;
+        signal.anchored = signal.pending = false;
+        signal.low = -std::numeric_limits<double>::infinity();
+        signal.high = std::numeric_limits<double>::infinity();
+    }
+    _started = false;
+    _time = 0.0;
+    _x.clear();
+    _samples = _stored = 0;
+}
+
+std::vector<double> ProbeWriter::getState() const {
+    std::vector<double> state = {_started ? 1.0 : 0.0, _time, double(_samples), double(_stored), double(_x.size())};
+    state.insert(state.end(), _x.begin(), _x.end());
+    for (auto &s : _signals) {
+        state.insert(state.end(), {double(s.grid), s.sampleTime, s.sampleValue, s.anchored ? 1.0 : 0.0, s.pending ? 1.0 : 0.0,
+                                   s.anchorTime, s.anchorValue, s.pendingTime, s.pendingValue, s.low, s.high});
+    }
+    return state;
+}
+
+void ProbeWriter::setState(const std::vector<double> &state) {
+    if (state.size() < 5 || state.size() != 5 + size_t(state[4]) + SIGNAL_STATE * _signals.size()) throw std::runtime_error("probe state does not match the .probe cards");
+    auto pos = state.begin();
+    _started = *pos++ != 0.0;
+    _time = *pos++;
+    _samples = long(*pos++);
+    _stored = long(*pos++);
+    _x.assign(pos + 1, pos + 1 + long(*pos));
+    pos += 1 + long(*pos);
+    for (auto &s : _signals) {
+        s.grid = long(*pos++);
+        s.sampleTime = *pos++;
+        s.sampleValue = *pos++;
+        s.anchored = *pos++ != 0.0;
+        s.pending = *pos++ != 0.0;
+        for (auto field : {&s.anchorTime, &s.anchorValue, &s.pendingTime, &s.pendingValue, &s.low, &s.high}) *field = *pos++;
+    }
+}
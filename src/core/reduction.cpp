@@ -0,0 +1,214 @@
+#include "reduction.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "probe.hpp"
+
+namespace {
+    const int MERGED = -2;      // edge element that no longer matches a single netlist element
+
+    // lumped coupling between two nodes, remembering which original elements it came from
+    struct Edge {
+        double g = 0.0, c = 0.0;
+        int resistor = -1, capacitor = -1;
+    };
+
+    void protectProbes(const Netlist &netlist, const std::string &token, std::vector<char> &keep) {
+        // nodes named in v(a) or v(a,b) anywhere in an analysis card
+        for (size_t at = token.find("v("); at != std::string::npos; at = token.find("v(", at + 2)) {
+            if (at > 0 && std::isalnum(static_cast<unsigned char>(token[at - 1]))) continue;
+            auto close = token.find(')', at);
+            if (close == std::string::npos) return;
+            auto inside = token.substr(at + 2, close - at - 2);
+            size_t first = 0;
+            while (first <= inside.size()) {
+                auto comma = std::min(inside.find(',', first), inside.size());
+                auto node = netlist.findNode(inside.substr(first, comma - first));
+                if (node > Netlist::GROUND) keep[node] = 1;
+                first = comma + 1;
+            }
+        }
+    }
+
+    void protectPatterns(const Netlist &netlist, const std::vector<std::string> &args, std::vector<char> &keep) {
+        // nodes matched by a wildcard v(pattern) of a .probe card
+        std::vector<std::string> patterns;
+        for (auto &arg : args) {
+            if (arg.rfind("v(", 0) == 0 && arg.back() == ')' && arg.find_first_of("*?") != std::string::npos) patterns.push_back(arg.substr(2, arg.size() - 3));
+        }
+        if (patterns.empty()) return;
+        for (int node = Netlist::GROUND + 1; node < netlist.getNodeCount(); node++) {
+            auto name = netlist.getNodeName(node);
+            for (auto &pattern : patterns) {
+                if (ProbeWriter::match(pattern, name)) keep[node] = 1;
+            }
+        }
+    }
+}
+
+Netlist RCReduction::reduce(const Netlist &netlist, const Options &options, Report *report) {
+    if (options.tau <= 0.0) throw std::runtime_error("reduction needs a positive time constant bound");
+    auto count = netlist.getNodeCount();
+    auto &resistors = netlist.getResistors();
+    auto &capacitors = netlist.getCapacitors();
+
+    // nodes that must survive: device and source terminals, probes and the keep list
+    std::vector<char> keep(count, 0);
+    for (auto &f : netlist.getFets()) keep[f.d] = keep[f.g] = keep[f.s] = 1;
+    for (auto &v : netlist.getVSources()) keep[v.p] = keep[v.n] = 1;
+    for (auto &analysis : netlist.getAnalyses()) {
+        for (auto &arg : analysis.args) protectProbes(netlist, arg, keep);
+        if (analysis.type == "probe") protectPatterns(netlist, analysis.args, keep);
+    }
+    for (auto &name : options.keep) {
+        auto node = netlist.findNode(name);
+        if (node < 0) throw std::runtime_error("unknown node to keep [ " + name + " ]");
+        keep[node] = 1;
+    }
+
+    // adjacency of every non-ground node, ground (0) only appears as a neighbour. negative
+    // resistors are not passive, so they are passed through and pin their nodes.
+    std::vector<std::unordered_map<int, Edge>> adj(count);
+    std::vector<int> passthrough;
+    auto connect = [&](int a, int b, double g, double c) -> std::pair<Edge *, Edge *> {
+        Edge *ea = a != Netlist::GROUND ? &adj[a][b] : nullptr;
+        Edge *eb = b != Netlist::GROUND ? &adj[b][a] : nullptr;
+        for (auto e : {ea, eb}) {
+            if (!e) continue;
+            e->g += g;
+            e->c += c;
+        }
+        return {ea, eb};
+    };
+    auto track = [](int Edge::*field, int element, Edge *e) {
+        if (e) e->*field = e->*field == -1 ? element : MERGED;
+    };
+    for (size_t k = 0; k < resistors.size(); k++) {
+        auto &r = resistors[k];
+        if (r.a == r.b) continue;
+        if (r.R < 0.0) {
+            keep[r.a] = keep[r.b] = 1;
+            passthrough.push_back(int(k));
+            continue;
+        }
+        auto edges = connect(r.a, r.b, 1.0 / r.R, 0.0);
+        track(&Edge::resistor, int(k), edges.first);
+        track(&Edge::resistor, int(k), edges.second);
+    }
+    for (size_t k = 0; k < capacitors.size(); k++) {
+        auto &c = capacitors[k];
+        if (c.a == c.b) continue;
+        auto edges = connect(c.a, c.b, 0.0, c.C);
+        track(&Edge::capacitor, int(k), edges.first);
+        track(&Edge::capacitor, int(k), edges.second);
+    }
+
+    // quick nodes, fastest first. the key of a node changes whenever a neighbour is eliminated.
+    const double NONE = std::numeric_limits<double>::infinity();
+    std::vector<double> key(count, NONE);
+    std::set<std::pair<double, int>> queue;
+    auto update = [&](int n) {
+        if (key[n] != NONE) queue.erase({key[n], n});
+        key[n] = NONE;
+        if (keep[n] || n == Netlist::GROUND) return;
+        double G = 0.0, C = 0.0;
+        int degree = 0;
+        for (auto &entry : adj[n]) {
+            G += entry.second.g;
+            C += entry.second.c;
+            if (entry.first != Netlist::GROUND) degree++;
+        }
+        if (G <= 0.0 || degree > options.maxDegree || C / G >= options.tau) return;
+        key[n] = C / G;
+        queue.insert({key[n], n});
+    };
+    for (int n = 1; n < count; n++) update(n);
+
+    std::vector<char> eliminated(count, 0);
+    while (!queue.empty()) {
+        auto n = queue.begin()->second;
+        queue.erase(queue.begin());
+        key[n] = NONE;
+        eliminated[n] = 1;
+
+        std::vector<std::pair<int, Edge>> nbrs(adj[n].begin(), adj[n].end());
+        adj[n].clear();
+        double G = 0.0;
+        for (auto &entry : nbrs) {
+            G += entry.second.g;
+            if (entry.first != Netlist::GROUND) adj[entry.first].erase(n);
+        }
+        for (size_t i = 0; i < nbrs.size(); i++) {
+            for (size_t j = i + 1; j < nbrs.size(); j++) {
+                auto &a = nbrs[i].second, &b = nbrs[j].second;
+                auto g = a.g * b.g / G, c = (a.g * b.c + b.g * a.c) / G;
+                if (g == 0.0 && c == 0.0) continue;
+                auto edges = connect(nbrs[i].first, nbrs[j].first, g, c);
+                for (auto e : {edges.first, edges.second}) {
+                    if (!e) continue;
+                    if (g != 0.0) e->resistor = MERGED;
+                    if (c != 0.0) e->capacitor = MERGED;
+                }
+            }
+        }
+        for (auto &entry : nbrs) {
+            if (entry.first != Netlist::GROUND) update(entry.first);
+        }
+    }
+
+    // rebuild a flat netlist over the surviving nodes
+    Netlist reduced;
+    std::vector<int> techs;
+    for (int t = 0; t < netlist.getTechCount(); t++) techs.push_back(reduced.addTech(netlist.getTechName(t), netlist.getTech(t)));
+    std::vector<std::string> names(count);
+    for (int n = 0; n < count; n++) {
+        if (eliminated[n]) continue;
+        names[n] = netlist.getNodeName(n);
+        if (n != Netlist::GROUND) reduced.addNode(names[n]);
+    }
+
+    auto &fets = netlist.getFets();
+    for (size_t k = 0; k < fets.size(); k++) {
+        auto &f = fets[k];
+        reduced.addFet(netlist.getFetName(int(k)), names[f.d], names[f.g], names[f.s], f.W, f.devType, techs[f.tech]);
+    }
+    auto &sources = netlist.getVSources();
+    for (size_t k = 0; k < sources.size(); k++) reduced.addVSource(netlist.getVSourceName(int(k)), names[sources[k].p], names[sources[k].n], sources[k].wave);
+    for (auto k : passthrough) reduced.addResistor(netlist.getResistorName(k), names[resistors[k].a], names[resistors[k].b], resistors[k].R);
+
+    int merged = 0;
+    for (int a = 1; a < count; a++) {
+        // every edge is stored on both non-ground ends, emit it from the higher one
+        std::vector<std::pair<int, Edge>> edges(adj[a].begin(), adj[a].end());
+        std::sort(edges.begin(), edges.end(), [](const std::pair<int, Edge> &x, const std::pair<int, Edge> &y) { return x.first < y.first; });
+        for (auto &entry : edges) {
+            auto b = entry.first;
+            auto &e = entry.second;
+            if (b > a) break;
+            if (e.g > 0.0) {
+                auto name = e.resistor >= 0 ? netlist.getResistorName(e.resistor) : "r~" + std::to_string(merged++);
+                reduced.addResistor(name, names[a], names[b], 1.0 / e.g);
+            }
+            if (e.c != 0.0) {
+                auto name = e.capacitor >= 0 ? netlist.getCapacitorName(e.capacitor) : "c~" + std::to_string(merged++);
+                reduced.addCapacitor(name, names[a], names[b], e.c);
+            }
+        }
+    }
+    for (auto &analysis : netlist.getAnalyses()) reduced.addAnalysis(analysis.type, analysis.args);
+
+    if (report) {
+        report->nodesBefore = count - 1;
+        report->nodesAfter = reduced.getNodeCount() - 1;
+        report->resistorsBefore = int(resistors.size());
+        report->resistorsAfter = int(reduced.getResistors().size());
+        report->capacitorsBefore = int(capacitors.size());
+        report->capacitorsAfter = int(reduced.getCapacitors().size());
+    }
+    return reduced;
+}
@@ -0,0 +1,167 @@
+#include "sensitivity.hpp"
+
+#include <stdexcept>
+
+Sensitivity::Sensitivity(Simulator &simulator)
+    : _sim(simulator)
+{
+    if (simulator.getOptions().switchLevel) throw std::runtime_error("sensitivity analysis requires the full device model, not switch level");
+}
+
+Sensitivity::Gradient Sensitivity::_emptyGradient() const {
+    auto &netlist = _sim.getNetlist();
+    Gradient grad = {0.0, std::vector<double>(netlist.getFets().size(), 0.0), std::vector<TechGradient>(netlist.getTechCount(), TechGradient{})};
+    return grad;
+}
+
+void Sensitivity::_accumulate(Gradient &grad, int fet, const PlanarFET::Derivatives &d, double weight) const {
+    // add weight * d(quantity)/d(param) for one device quantity to the gradient
+    auto &instance = _sim.getNetlist().getFets()[fet];
+    auto &tech = grad.tech[instance.tech];
+    grad.W[fet] += weight * d.dW;
+    tech.L += weight * d.dL;
+    tech.Tox += weight * d.dTox;
+    tech.Lovl += weight * d.dLovl;
+    tech.Vt += weight * d.dVt;
+    tech.LAMBDA += weight * d.dLAMBDA;
+    tech.BETA += weight * d.dBETA;
+    if (instance.devType == ModelUtils::DevType::N) {
+        tech.MUn += weight * d.dMU;
+    } else {
+        tech.MUp += weight * d.dMU;
+    }
+}
+
+void Sensitivity::_accumulateParameters(Gradient &grad, const std::vector<double> &lambda, const std::vector<double> &x, const std::vector<double> *xPrev, double h) const {
+    // grad -= lambda^T * dF/dp at one solution point. only FETs carry parameters, and each one
+    // only touches the residual rows of its own terminals
+    auto &fets = _sim.getNetlist().getFets();
+    for (size_t k = 0; k < fets.size(); k++) {
+        auto &fet = fets[k];
+        auto &tech = _sim.getNetlist().getTech(fet.tech);
+        auto idx = _sim._fetUnknowns(int(k));
+        auto Ld = Simulator::_voltage(lambda, idx[0]), Lg = Simulator::_voltage(lambda, idx[1]), Ls = Simulator::_voltage(lambda, idx[2]);
+        auto Vd = Simulator::_voltage(x, idx[0]), Vg = Simulator::_voltage(x, idx[1]), Vs = Simulator::_voltage(x, idx[2]);
+        auto Vgs = Vg - Vs, Vds = Vd - Vs;
+
+        _accumulate(grad, int(k), PlanarFET::getIdDerivatives(tech, fet.W, Vgs, Vds, fet.devType), -(Ld - Ls));
+        if (!xPrev) continue;
+
+        // charge currents (Q(x) - Q(xPrev)) / h into the gate and drain, returned by the source
+        auto Ps = Simulator::_voltage(*xPrev, idx[2]);
+        auto Q = PlanarFET::getCharges(tech, fet.W, Vgs, Vds, fet.devType);
+        auto P = PlanarFET::getCharges(tech, fet.W, Simulator::_voltage(*xPrev, idx[1]) - Ps, Simulator::_voltage(*xPrev, idx[0]) - Ps, fet.devType);
+        _accumulate(grad, int(k), Q.Qg, -(Lg - Ls) / h);
+        _accumulate(grad, int(k), Q.Qd, -(Ld - Ls) / h);
+        _accumulate(grad, int(k), P.Qg, (Lg - Ls) / h);
+        _accumulate(grad, int(k), P.Qd, (Ld - Ls) / h);
+    }
+}
+
+void Sensitivity::_historyProduct(std::vector<double> &carry, const std::vector<double> &lambda, const std::vector<double> &xPrev, double h) const {
+    // carry = -(dF_n/dx_{n-1})^T * lambda_n. only capacitive currents depend on the previous
+    // point: -C/h on the voltage across a capacitor, -dQ/dV(xPrev)/h for FET terminal charges
+    std::fill(carry.begin(), carry.end(), 0.0);
+    auto add = [&](int index, double value) { if (index >= 0) carry[index] += value; };
+    auto couple = [&](int a, int b, double C) {
+        auto w = (Simulator::_voltage(lambda, a) - Simulator::_voltage(lambda, b)) * C / h;
+        add(a, w);
+        add(b, -w);
+    };
+
+    auto &netlist = _sim.getNetlist();
+    for (auto &c : netlist.getCapacitors()) couple(Simulator::_unknown(c.a), Simulator::_unknown(c.b), c.C);
+
+    auto &fets = netlist.getFets();
+    for (size_t k = 0; k < fets.size(); k++) {
+        auto &fet = fets[k];
+        auto &tech = netlist.getTech(fet.tech);
+        auto idx = _sim._fetUnknowns(int(k));
+        auto Vs = Simulator::_voltage(xPrev, idx[2]);
+        auto Q = PlanarFET::getCharges(tech, fet.W, Simulator::_voltage(xPrev, idx[1]) - Vs, Simulator::_voltage(xPrev, idx[0]) - Vs, fet.devType);
+        // gate and drain charge rows weighted by their multiplier relative to the source's
+        auto Lg = Simulator::_voltage(lambda, idx[1]) - Simulator::_voltage(lambda, idx[2]);
+        auto Ld = Simulator::_voltage(lambda, idx[0]) - Simulator::_voltage(lambda, idx[2]);
+        auto dVgs = (Lg * Q.Qg.dVgs + Ld * Q.Qd.dVgs) / h, dVds = (Lg * Q.Qg.dVds + Ld * Q.Qd.dVds) / h;
+        add(idx[0], dVds);
+        add(idx[1], dVgs);
+        add(idx[2], -(dVgs + dVds));
+    }
+}
+
+void Sensitivity::_solveAdjoint(std::vector<double> &lambda, const std::vector<double> &x, const std::vector<double> *xPrev, double h, double time) {
+    // J^T lambda = rhs with the Jacobian the forward run converged with at this point
+    if (_sim.isIterative()) throw std::runtime_error("sensitivity analysis requires the direct linear solver");
+    _sim._load(x, xPrev, h, time, 1.0);
+    _sim._factor();
+    _sim._solveTranspose(lambda);
+}
+
+Sensitivity::Gradient Sensitivity::solveOperatingPoint(int output, const std::vector<double> &x) {
+    // d(x[output])/dp = -lambda^T dF/dp with J^T lambda = e_output
+    if (output < 0 || output >= _sim.getSize()) throw std::runtime_error("sensitivity output index out of range");
+    auto grad = _emptyGradient();
+    grad.value = x[output];
+
+    std::vector<double> lambda(_sim.getSize(), 0.0);
+    lambda[output] = 1.0;
+    _solveAdjoint(lambda, x, nullptr, 0.0, 0.0);
+    _accumulateParameters(grad, lambda, x, nullptr, 0.0);
+    return grad;
+}
+
+Sensitivity::Gradient Sensitivity::solveTransient(int output, Measure measure, const Simulator::Waveforms &waves, double threshold) {
+    // walk the accepted backward Euler steps in reverse:
+    //   J_n^T lambda_n = dPhi/dx_n - (dF_{n+1}/dx_n)^T lambda_{n+1}
+    // and finish with the dc operating point the transient started from
+    if (output < 0 || output >= _sim.getSize()) throw std::runtime_error("sensitivity output index out of range");
+    if (waves.time.empty()) throw std::runtime_error("transient sensitivity requires a transient solution");
+    auto grad = _emptyGradient();
+    auto last = waves.time.size() - 1;
+
+    // dPhi/dx_n[output] for every accepted point. nothing after the last nonzero one reaches
+    // the objective, so the backward pass starts there
+    std::vector<double> seed(waves.time.size(), 0.0);
+    auto top = last;
+    if (measure == Measure::Final) {
+        seed[last] = 1.0;
+        grad.value = waves.x[last][output];
+    } else if (measure == Measure::Integral) {
+        for (size_t n = 1; n <= last; n++) {
+            auto h = waves.time[n] - waves.time[n - 1];
+            seed[n] = h;
+            grad.value += h * waves.x[n][output];
+        }
+    } else {
+        // first crossing interpolated on the step that brackets it,
+        //   t = t_{k-1} + h * a,  a = (threshold - v_{k-1}) / (v_k - v_{k-1})
+        // moving either end point shifts it by -h * (1 - a) / dv or -h * a / dv, the discrete
+        // form of dt/dp = -(dv/dp) / (dv/dt)
+        size_t k = 1;
+        while (k <= last && (waves.x[k - 1][output] < threshold) == (waves.x[k][output] < threshold)) k++;
+        if (k > last) throw std::runtime_error("sensitivity output never crosses [ " + std::to_string(threshold) + " ]");
+        auto h = waves.time[k] - waves.time[k - 1];
+        auto dv = waves.x[k][output] - waves.x[k - 1][output];
+        auto a = (threshold - waves.x[k - 1][output]) / dv;
+        grad.value = waves.time[k - 1] + h * a;
+        seed[k - 1] = -h * (1.0 - a) / dv;
+        seed[k] = -h * a / dv;
+        top = k;
+    }
+
+    std::vector<double> lambda(_sim.getSize()), carry(_sim.getSize(), 0.0);
+    for (auto n = top; n > 0; n--) {
+        auto h = waves.time[n] - waves.time[n - 1];
+        lambda = carry;
+        lambda[output] += seed[n];
+        _solveAdjoint(lambda, waves.x[n], &waves.x[n - 1], h, waves.time[n]);
+        _accumulateParameters(grad, lambda, waves.x[n], &waves.x[n - 1], h);
+        _historyProduct(carry, lambda, waves.x[n - 1], h);
+    }
+
+    lambda = carry;
+    lambda[output] += seed[0];
+    _solveAdjoint(lambda, waves.x[0], nullptr, 0.0, waves.time[0]);
+    _accumulateParameters(grad, lambda, waves.x[0], nullptr, 0.0);
+    return grad;
+}
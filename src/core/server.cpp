@@ -0,0 +1,240 @@
+#include "server.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include "dcsweep.hpp"
+#include "measure.hpp"
+
+namespace {
+    std::vector<std::string> split(const std::string &line) {
+        std::vector<std::string> tokens;
+        std::istringstream stream(line);
+        std::string token;
+        while (stream >> token) tokens.push_back(token);
+        return tokens;
+    }
+
+    std::string lower(std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+        return text;
+    }
+
+    void expect(const std::vector<std::string> &tokens, size_t count, const std::string &usage) {
+        if (tokens.size() < count) throw std::runtime_error("usage: " + usage);
+    }
+}
+
+SimulationServer::SimulationServer(const Simulator::Options &options, const std::vector<std::filesystem::path> &techfiles)
+    : _options(options)
+{
+    for (auto &techfile : techfiles) _technologies.readTechfile(techfile);
+}
+
+bool SimulationServer::serve(std::istream &in, std::ostream &out) {
+    out << std::setprecision(17);
+    std::string line;
+    while (std::getline(in, line)) {
+        auto tokens = split(line);
+        if (tokens.empty() || tokens[0][0] == '*') continue;
+        auto command = lower(tokens[0]);
+        if (command == "quit" || command == "shutdown") {
+            out << "ok" << std::endl;
+            return command == "quit";
+        }
+        try {
+            _request(tokens, in, out);
+            out << "ok\n";
+        } catch (std::exception &e) {
+            // a result may be half written, the error line still ends the response
+            std::string message = e.what();
+            std::replace(message.begin(), message.end(), '\n', ' ');
+            out << "error " << message << "\n";
+        }
+        out.flush();
+    }
+    return true;
+}
+
+void SimulationServer::_install(const std::string &name, Netlist netlist) {
+    auto design = std::make_shared<Design>();
+    design->netlist = std::make_unique<Netlist>(std::move(netlist));
+    design->original = *design->netlist;
+    design->sim = std::make_unique<Simulator>(*design->netlist, _options);
+    design->unknowns = design->sim->getSize();
+    design->fets = design->netlist->getFets().size();
+    for (auto &card : design->netlist->getAnalyses()) {
+        if (card.type == "measure") design->measures.push_back(card.args);
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    _designs[name] = design;
+}
+
+std::shared_ptr<SimulationServer::Design> SimulationServer::_find(const std::string &name) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto design = _designs.find(name);
+    if (design == _designs.end()) throw std::runtime_error("unknown design [ " + name + " ]");
+    return design->second;
+}
+
+void SimulationServer::_request(const std::vector<std::string> &raw, std::istream &in, std::ostream &out) {
+    // paths keep their case, everything else is matched like a deck
+    auto command = lower(raw[0]);
+    if (command == "load") {
+        expect(raw, 3, "load <design> <path> [techfile ...]");
+        auto netlist = _technologies;
+        for (size_t i = 3; i < raw.size(); i++) netlist.readTechfile(raw[i]);
+        std::ifstream file(raw[2]);
+        if (!file.is_open()) throw std::runtime_error("Failed to open file [ " + raw[2] + " ]");
+        netlist.parse(file, raw[2]);
+        _install(lower(raw[1]), std::move(netlist));
+        return;
+    }
+
+    std::vector<std::string> tokens;
+    for (auto &token : raw) tokens.push_back(lower(token));
+    if (command == "list") {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &entry : _designs) {
+            out << "design " << entry.first << " " << entry.second->unknowns << " unknowns " << entry.second->fets << " fets\n";
+        }
+        return;
+    }
+    expect(tokens, 2, command + " <design> ...");
+    auto &name = tokens[1];
+
+    if (command == "deck") {
+        std::ostringstream text;
+        std::string line;
+        bool closed = false;
+        while (std::getline(in, line)) {
+            auto words = split(line);
+            if (!words.empty() && lower(words[0]) == ".end") {
+                closed = true;
+                break;
+            }
+            text << line << "\n";
+        }
+        if (!closed) throw std::runtime_error("deck without .end [ " + name + " ]");
+        auto netlist = _technologies;
+        std::istringstream stream(text.str());
+        netlist.parse(stream, "<" + name + ">");
+        _install(name, std::move(netlist));
+        return;
+    }
+    if (command == "unload") {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_designs.erase(name)) throw std::runtime_error("unknown design [ " + name + " ]");
+        return;
+    }
+
+    auto design = _find(name);
+    std::lock_guard<std::mutex> lock(design->mutex);
+    auto &netlist = *design->netlist;
+    auto &sim = *design->sim;
+    if (command == "set") {
+        expect(tokens, 4, "set <design> <target> <value>");
+        _set(*design, tokens[2], Netlist::parseValue(tokens[3]));
+    } else if (command == "source") {
+        expect(tokens, 4, "source <design> <vsource> <waveform>");
+        auto source = netlist.findVSource(tokens[2]);
+        if (source < 0) throw std::runtime_error("unknown source [ " + tokens[2] + " ]");
+        netlist.getVSource(source).wave = Netlist::parseWaveform(std::vector<std::string>(tokens.begin() + 3, tokens.end()), "source");
+    } else if (command == "corner") {
+        std::string supply = "vdd";
+        double vdd = 0.0, dVt = 0.0, mobility = 1.0;
+        bool setVdd = false;
+        for (size_t i = 2; i < tokens.size(); i++) {
+            auto eq = tokens[i].find('=');
+            if (eq == std::string::npos) throw std::runtime_error("corner: expected key=value [ " + tokens[i] + " ]");
+            auto key = tokens[i].substr(0, eq), value = tokens[i].substr(eq + 1);
+            if (key == "supply") supply = value;
+            else if (key == "vdd") vdd = Netlist::parseValue(value), setVdd = true;
+            else if (key == "dvt") dVt = Netlist::parseValue(value);
+            else if (key == "mu") mobility = Netlist::parseValue(value);
+            else throw std::runtime_error("corner: unknown key [ " + key + " ]");
+        }
+        for (int t = 0; t < netlist.getTechCount(); t++) {
+            auto &tech = netlist.getTech(t);
+            tech = design->original.getTech(t);
+            tech.Vt += dVt;
+            tech.MUn *= mobility;
+            tech.MUp *= mobility;
+            tech.update();
+        }
+        if (setVdd) {
+            auto source = netlist.findVSource(supply);
+            if (source < 0) throw std::runtime_error("corner: unknown supply [ " + supply + " ]");
+            netlist.getVSource(source).wave = {Source::Shape::DC, {vdd}};
+        }
+        sim.updateParameters();
+    } else if (command == "reset") {
+        netlist = design->original;
+        sim.updateParameters();
+    } else if (command == "measure") {
+        std::vector<std::string> statement(tokens.begin() + 2, tokens.end());
+        MeasureEngine check(sim);
+        check.add(statement);
+        design->measures.push_back(statement);
+    } else if (command == "op") {
+        auto x = sim.solveOperatingPoint();
+        for (int i = 0; i < sim.getSize(); i++) out << "x " << sim.getName(i) << " " << x[i] << "\n";
+    } else if (command == "tran") {
+        expect(tokens, 4, "tran <design> <tstep> <tstop> [<output> ...]");
+        _transient(*design, std::vector<std::string>(tokens.begin() + 2, tokens.end()), out);
+    } else if (command == "stats") {
+        auto &stats = sim.getStatistics();
+        out << "stat newtonIterations " << stats.newtonIterations << "\n";
+        out << "stat factorizations " << stats.factorizations << "\n";
+        out << "stat acceptedSteps " << stats.acceptedSteps << "\n";
+        out << "stat rejectedSteps " << stats.rejectedSteps << "\n";
+    } else {
+        throw std::runtime_error("unknown request [ " + command + " ]");
+    }
+}
+
+void SimulationServer::_set(Design &design, const std::string &target, double value) {
+    auto &netlist = *design.netlist;
+    if (target.size() > 3 && target.compare(0, 2, "c(") == 0 && target.back() == ')') {
+        auto name = target.substr(2, target.size() - 3);
+        auto capacitor = netlist.findCapacitor(name);
+        if (capacitor < 0) throw std::runtime_error("unknown capacitor [ " + name + " ]");
+        netlist.getCapacitor(capacitor).C = value;
+    } else {
+        // sources, widths and technology parameters are addressed like .dc targets
+        auto sweep = DCSweep::parse(netlist, {target, "0", "0", "1"});
+        DCSweep::apply(netlist, sweep, value);
+    }
+    design.sim->updateParameters();
+}
+
+void SimulationServer::_transient(Design &design, const std::vector<std::string> &args, std::ostream &out) {
+    auto &sim = *design.sim;
+    auto tstep = Netlist::parseValue(args[0]), tstop = Netlist::parseValue(args[1]);
+    std::vector<int> columns;
+    for (size_t i = 2; i < args.size(); i++) columns.push_back(sim.getIndex(args[i]));
+    if (columns.empty()) {
+        for (int i = 0; i < sim.getSize(); i++) columns.push_back(i);
+    }
+    MeasureEngine measures(sim);
+    for (auto &statement : design.measures) measures.add(statement);
+
+    out << "columns time";
+    for (auto column : columns) out << " " << sim.getName(column);
+    out << "\n";
+    sim.solveTransient(tstep, tstop, [&](double time, const std::vector<double> &x) {
+        measures.accept(time, x);
+        out << "t " << time;
+        for (auto column : columns) out << " " << x[column];
+        out << "\n";
+    }, false);
+    for (auto &result : measures.getResults()) {
+        out << "measure " << result.name << " ";
+        if (result.valid) out << result.value << "\n";
+        else out << "failed\n";
+    }
+}
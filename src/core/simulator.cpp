@@ -1 +1,828 @@
 #include "simulator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "capacitor.hpp"
+#include "checkpoint.hpp"
+#include "partition.hpp"
+#include "resistor.hpp"
+#include "stimulus.hpp"
+#include "symbolic_cache.hpp"
+
+Simulator::Simulator(const Netlist &netlist)
+    : Simulator(netlist, Options()) {}
+
+Simulator::Simulator(const Netlist &netlist, const Options &options)
+    : _netlist(netlist), _options(options),
+      _numNodes(netlist.getNodeCount() - 1), _numBranches(int(netlist.getVSources().size())),
+      _jacobian(_numNodes + _numBranches), _lu(_jacobian), _residual(_numNodes + _numBranches, 0.0),
+      _switchLevel(options.switchLevel)
+{
+    // declare the structure of every stamp, then fix the pattern and look up value slots
+    for (int i = 0; i < _numNodes; i++) _jacobian.reserve(i, i);
+    auto reservePair = [&](int a, int b) {
+        for (auto r : {a, b}) for (auto c : {a, b}) _jacobian.reserve(r, c);
+    };
+    for (auto &r : netlist.getResistors()) reservePair(_unknown(r.a), _unknown(r.b));
+    for (auto &c : netlist.getCapacitors()) reservePair(_unknown(c.a), _unknown(c.b));
+    for (size_t k = 0; k < netlist.getVSources().size(); k++) {
+        auto &v = netlist.getVSources()[k];
+        int br = _numNodes + int(k);
+        for (auto node : {_unknown(v.p), _unknown(v.n)}) {
+            _jacobian.reserve(node, br);
+            _jacobian.reserve(br, node);
+        }
+    }
+    for (size_t k = 0; k < netlist.getFets().size(); k++) {
+        auto idx = _fetUnknowns(int(k));
+        for (auto r : idx) for (auto c : idx) _jacobian.reserve(r, c);
+    }
+    auto iterative = _options.linearSolver == LinearSolver::Iterative ||
+                     (_options.linearSolver == LinearSolver::Auto && getSize() >= _options.iterativeThreshold);
+    if (_options.symbolicCache.empty()) _jacobian.finalize(!iterative);
+    else SymbolicCache::finalize(_options.symbolicCache, _jacobian, !iterative, &_symbolicCached, &_symbolicCacheError);
+    // the sparse schedule only touches the fill pattern, which beats the fixed-size dense
+    // kernels unless the factors are close to full anyway
+    auto size = double(getSize());
+    if (!iterative && getSize() <= std::min(_options.denseThreshold, int(DenseLU::MAX_SIZE)) && _jacobian.nonZeros() >= _options.denseFill * size * size) {
+        _dense = std::make_unique<DenseLU>(getSize());
+        _jacobian.finalizeDense(_dense->stride());
+    }
+    // single precision factors also serve as the ILU(0) preconditioner, which GMRES corrects anyway
+    if (_options.mixedPrecision && !_dense) _lu.setSinglePrecision(true);
+    _entries = _dense ? size * size : double(_jacobian.nonZeros());
+    if (iterative) _krylov = std::make_unique<KrylovSolver>(_jacobian, _lu, _options.krylov, _options.threads);
+
+    auto pairSlots = [&](int a, int b) {
+        return std::array<int, 4>{_jacobian.getSlot(a, a), _jacobian.getSlot(a, b), _jacobian.getSlot(b, a), _jacobian.getSlot(b, b)};
+    };
+    for (int i = 0; i < _numNodes; i++) _gminSlots.push_back(_jacobian.getSlot(i, i));
+    for (auto &r : netlist.getResistors()) _resistorSlots.push_back(pairSlots(_unknown(r.a), _unknown(r.b)));
+    for (auto &c : netlist.getCapacitors()) _capacitorSlots.push_back(pairSlots(_unknown(c.a), _unknown(c.b)));
+    for (size_t k = 0; k < netlist.getVSources().size(); k++) {
+        auto &v = netlist.getVSources()[k];
+        int br = _numNodes + int(k);
+        _vsourceSlots.push_back({_jacobian.getSlot(_unknown(v.p), br), _jacobian.getSlot(_unknown(v.n), br),
+                                 _jacobian.getSlot(br, _unknown(v.p)), _jacobian.getSlot(br, _unknown(v.n))});
+    }
+    for (size_t k = 0; k < netlist.getFets().size(); k++) {
+        auto idx = _fetUnknowns(int(k));
+        std::array<int, 9> slots;
+        for (int r = 0; r < 3; r++) for (int c = 0; c < 3; c++) slots[r * 3 + c] = _jacobian.getSlot(idx[r], idx[c]);
+        _fetSlots.push_back(slots);
+    }
+    _chargeHistory.resize(netlist.getFets().size());
+
+    if (_options.switchLevel) {
+        _pwlTables.resize(size_t(netlist.getTechCount()) * 2);
+        for (auto &fet : netlist.getFets()) {
+            auto &table = _pwlTables[size_t(fet.tech) * 2 + (fet.devType == ModelUtils::DevType::P)];
+            if (table.id.empty()) table = PwlFET::build(netlist.getTech(fet.tech), fet.devType, _options.switchStep, _options.switchRange);
+        }
+        _fetRegions.resize(netlist.getFets().size());
+    }
+    if constexpr (DeviceStats::ENABLED) _deviceStats.attach(netlist);
+
+    if (_options.partition || _options.multirate) {
+        Partition partition(netlist);
+        if (partition.getBlocks().size() > 1) _partitioned = std::make_unique<PartitionedSolver>(*this, partition, _options.threads);
+    }
+}
+
+Simulator::~Simulator() = default;
+
+int Simulator::getBlockGroups() const {
+    return _partitioned ? _partitioned->getGroupCount() : 0;
+}
+
+void Simulator::getMemory(MemoryReport::Usage &usage, bool projected) const {
+    using M = MemoryReport;
+    auto &matrix = usage[M::Subsystem::Matrix];
+    matrix += _jacobian.getMemory() + M::bytes(_residual) + M::bytes(_gminSlots) + M::bytes(_resistorSlots) + M::bytes(_capacitorSlots);
+    matrix += M::bytes(_vsourceSlots) + M::bytes(_fetSlots) + M::bytes(_warmStart) + M::bytes(_refineRhs) + M::bytes(_refineCorrection);
+
+    auto &factors = usage[M::Subsystem::Factors];
+    factors += _dense ? _dense->getMemory() : projected ? _lu.getProjectedMemory() : _lu.getMemory();
+    if (_krylov) factors += _krylov->getMemory();
+
+    auto &models = usage[M::Subsystem::Models];
+    models += M::bytes(_pwlTables) + M::bytes(_fetRegions) + M::bytes(_chargeHistory) + M::bytes(_regions) + M::bytes(_factoredRegions);
+    for (auto &table : _pwlTables) models += M::bytes(table.id);
+
+    if (_partitioned) _partitioned->getMemory(usage, projected);
+}
+
+const char *Simulator::getName(Refactor reason) {
+    switch (reason) {
+    case Refactor::Fresh: return "fresh";
+    case Refactor::Timestep: return "timestep";
+    case Refactor::Region: return "region";
+    case Refactor::Contraction: return "contraction";
+    case Refactor::Limited: return "limited";
+    }
+    return "";
+}
+
+void Simulator::setChordLog(std::ostream *log) {
+    _chordLog = log;
+    if (_chordLog) *_chordLog << "time,h,iteration,factored,reason,contraction\n";
+}
+
+void Simulator::addStimulus(Stimulus *stimulus) {
+    // blocks hold copies of their sources, which the stimulus would not reach
+    if (_partitioned) throw std::runtime_error("stimulus files cannot drive a partitioned simulator");
+    _stimuli.push_back(stimulus);
+}
+
+int Simulator::getIndex(const std::string &output) const {
+    // resolve "v(node)" or "i(vsource)" to an unknown index
+    auto fail = [&]() -> int { throw std::runtime_error("unknown output [ " + output + " ]"); };
+    if (output.size() < 4 || output[1] != '(' || output.back() != ')') return fail();
+    auto name = output.substr(2, output.size() - 3);
+    switch (std::tolower(output[0])) {
+    case 'v': {
+        auto node = _netlist.findNode(name);
+        if (node <= Netlist::GROUND) return fail();
+        return _unknown(node);
+    }
+    case 'i': {
+        auto source = _netlist.findVSource(name);
+        if (source < 0) return fail();
+        return _numNodes + source;
+    }
+    default:
+        return fail();
+    }
+}
+
+std::string Simulator::getName(int index) const {
+    if (index < _numNodes) return "v(" + _netlist.getNodeName(index + 1) + ")";
+    return "i(" + _netlist.getVSourceName(index - _numNodes) + ")";
+}
+
+double Simulator::getSourcePower(int vsource, const std::vector<double> &x) const {
+    // branch current flows into the positive terminal, so delivered power is -V * I
+    auto &source = _netlist.getVSources()[vsource];
+    auto V = _voltage(x, _unknown(source.p)) - _voltage(x, _unknown(source.n));
+    return -V * x[_numNodes + vsource];
+}
+
+std::array<int, 3> Simulator::_fetUnknowns(int fet) const {
+    auto &f = _netlist.getFets()[fet];
+    return {_unknown(f.d), _unknown(f.g), _unknown(f.s)};
+}
+
+void Simulator::_stampPair(const std::array<int, 4> &slots, int a, int b, double i, double g) {
+    // current i flowing from a to b with conductance g = di/d(Va - Vb)
+    _addResidual(a, i);
+    _addResidual(b, -i);
+    _jacobian.add(slots[0], g);
+    _jacobian.add(slots[1], -g);
+    _jacobian.add(slots[2], -g);
+    _jacobian.add(slots[3], g);
+}
+
+void Simulator::_stampFetBranch(int fet, int a, int b, double i, const std::array<double, 3> &dI) {
+    // current i flowing from local terminal a to b (0 = d, 1 = g, 2 = s), dI w.r.t. (Vd, Vg, Vs)
+    auto idx = _fetUnknowns(fet);
+    auto &slots = _fetSlots[fet];
+    _addResidual(idx[a], i);
+    _addResidual(idx[b], -i);
+    for (int c = 0; c < 3; c++) {
+        _jacobian.add(slots[a * 3 + c], dI[c]);
+        _jacobian.add(slots[b * 3 + c], -dI[c]);
+    }
+}
+
+void Simulator::updateParameters() {
+    for (size_t t = 0; t < _pwlTables.size(); t++) {
+        auto devType = t % 2 ? ModelUtils::DevType::P : ModelUtils::DevType::N;
+        if (!_pwlTables[t].id.empty()) _pwlTables[t] = PwlFET::build(_netlist.getTech(int(t / 2)), devType, _options.switchStep, _options.switchRange);
+    }
+    for (auto &state : _fetRegions) state.region = -1;
+    std::fill(_chargeHistory.begin(), _chargeHistory.end(), ChargeHistory());
+    _factoredEpoch = -1;
+    _chordFactors = false;
+}
+
+void Simulator::_stampSwitchLevel(int fet, const std::vector<double> &x, const std::vector<double> *xPrev, double h) {
+    // the plane of the triangle (Vgs, Vds) falls in, and the terminal charge slopes held at its centroid
+    auto &f = _netlist.getFets()[fet];
+    auto idx = _fetUnknowns(fet);
+    auto Vd = _voltage(x, idx[0]), Vg = _voltage(x, idx[1]), Vs = _voltage(x, idx[2]);
+    auto Vgs = Vg - Vs, Vds = Vd - Vs;
+
+    auto &table = _pwlTables[size_t(f.tech) * 2 + (f.devType == ModelUtils::DevType::P)];
+    auto &state = _fetRegions[fet];
+    auto region = PwlFET::locate(table, Vgs, Vds);
+    if (region != state.region) {
+        auto &tech = _netlist.getTech(f.tech);
+        state.region = region;
+        state.plane = PwlFET::getPlane(table, region);
+        auto Q = PlanarFET::getCharges(tech, f.W, state.plane.vgs, state.plane.vds, f.devType);
+        state.Qg = {Q.Qg.dVgs, Q.Qg.dVds};
+        state.Qd = {Q.Qd.dVgs, Q.Qd.dVds};
+        _regionEpoch++;
+        _stats.regionChanges++;
+        if constexpr (DeviceStats::ENABLED) _deviceStats[size_t(fet)].evaluations++;
+    } else if constexpr (DeviceStats::ENABLED) {
+        _deviceStats[size_t(fet)].bypassed++;
+    }
+
+    auto &plane = state.plane;
+    auto gm = f.W * plane.gm, gds = f.W * plane.gds;
+    auto Id = f.W * plane.i0 + gm * Vgs + gds * Vds;
+    if constexpr (DeviceStats::ENABLED) _deviceStats.setCurrent(size_t(fet), std::abs(Id));
+    _stampFetBranch(fet, 0, 2, Id, {gds, gm, -(gm + gds)});
+    if (!xPrev) return;
+
+    auto dVgs = Vgs - (_voltage(*xPrev, idx[1]) - _voltage(*xPrev, idx[2]));
+    auto dVds = Vds - (_voltage(*xPrev, idx[0]) - _voltage(*xPrev, idx[2]));
+    for (auto [terminal, dQ] : {std::make_pair(1, state.Qg), std::make_pair(0, state.Qd)}) {
+        _stampFetBranch(fet, terminal, 2, (dQ[0] * dVgs + dQ[1] * dVds) / h, {dQ[1] / h, dQ[0] / h, -(dQ[0] + dQ[1]) / h});
+    }
+}
+
+void Simulator::_load(const std::vector<double> &x, const std::vector<double> *xPrev, double h, double time, double sourceScale) {
+    // assemble residual and Jacobian at x. xPrev/h describe the previous backward Euler point,
+    // without them capacitors are open circuits (dc)
+    if (_profile) _profile->begin();
+    _loadedH = xPrev ? h : 0.0;
+    _jacobian.clear();
+    std::fill(_residual.begin(), _residual.end(), 0.0);
+
+    for (int i = 0; i < _numNodes; i++) {
+        _residual[i] += _options.gmin * x[i];
+        _jacobian.add(_gminSlots[i], _options.gmin);
+    }
+
+    auto &resistors = _netlist.getResistors();
+    for (size_t k = 0; k < resistors.size(); k++) {
+        auto a = _unknown(resistors[k].a), b = _unknown(resistors[k].b);
+        auto V = _voltage(x, a) - _voltage(x, b);
+        _stampPair(_resistorSlots[k], a, b, Resistor::getCurrent(resistors[k].R, V), Resistor::getConductance(resistors[k].R));
+    }
+
+    if (xPrev) {
+        auto &capacitors = _netlist.getCapacitors();
+        for (size_t k = 0; k < capacitors.size(); k++) {
+            auto a = _unknown(capacitors[k].a), b = _unknown(capacitors[k].b);
+            auto dV = (_voltage(x, a) - _voltage(x, b)) - (_voltage(*xPrev, a) - _voltage(*xPrev, b));
+            _stampPair(_capacitorSlots[k], a, b, Capacitor::getTransientCurrent(capacitors[k].C, dV / h), capacitors[k].C / h);
+        }
+    }
+
+    auto &sources = _netlist.getVSources();
+    for (size_t k = 0; k < sources.size(); k++) {
+        auto p = _unknown(sources[k].p), n = _unknown(sources[k].n);
+        auto br = _numNodes + int(k);
+        auto &slots = _vsourceSlots[k];
+        _addResidual(p, x[br]);
+        _addResidual(n, -x[br]);
+        _residual[br] = _voltage(x, p) - _voltage(x, n) - sourceScale * Source::getValue(sources[k].wave, time);
+        _jacobian.add(slots[0], 1.0);
+        _jacobian.add(slots[1], -1.0);
+        _jacobian.add(slots[2], 1.0);
+        _jacobian.add(slots[3], -1.0);
+    }
+
+    if (_profile) {
+        _profile->end(KernelProfile::Phase::Load, _entries);
+        _profile->begin();
+    }
+
+    auto &fets = _netlist.getFets();
+    for (size_t k = 0; k < fets.size(); k++) {
+        if (_switchLevel) {
+            _stampSwitchLevel(int(k), x, xPrev, h);
+            continue;
+        }
+        auto &fet = fets[k];
+        auto &tech = _netlist.getTech(fet.tech);
+        auto idx = _fetUnknowns(int(k));
+        auto Vd = _voltage(x, idx[0]), Vg = _voltage(x, idx[1]), Vs = _voltage(x, idx[2]);
+        auto Vgs = Vg - Vs, Vds = Vd - Vs;
+
+        auto Id = PlanarFET::getIdDerivatives(tech, fet.W, Vgs, Vds, fet.devType);
+        if constexpr (DeviceStats::ENABLED) {
+            _deviceStats[k].evaluations++;
+            _deviceStats.setCurrent(k, std::abs(Id.value));
+        }
+        _stampFetBranch(int(k), 0, 2, Id.value, {Id.dVds, Id.dVgs, -(Id.dVgs + Id.dVds)});
+        if (!xPrev) continue;
+
+        // terminal charge currents (Q(x) - Q(xPrev)) / h. the source returns what gate and drain
+        // take, so no charge is created or lost whatever the step
+        auto Q = PlanarFET::getCharges(tech, fet.W, Vgs, Vds, fet.devType);
+        auto &previous = _previousCharges(int(k), *xPrev);
+        auto charge = [&](int terminal, const PlanarFET::Derivatives &q, double before) {
+            _stampFetBranch(int(k), terminal, 2, (q.value - before) / h, {q.dVds / h, q.dVgs / h, -(q.dVgs + q.dVds) / h});
+        };
+        charge(1, Q.Qg, previous.Qg);
+        charge(0, Q.Qd, previous.Qd);
+    }
+    if (_profile) _profile->end(KernelProfile::Phase::Devices, double(fets.size()));
+}
+
+const Simulator::ChargeHistory &Simulator::_previousCharges(int fet, const std::vector<double> &xPrev) {
+    // xPrev stays the same through every Newton iteration of a step, so its charges are only
+    // evaluated again once the terminal voltages change
+    auto &f = _netlist.getFets()[fet];
+    auto idx = _fetUnknowns(fet);
+    auto Vs = _voltage(xPrev, idx[2]);
+    auto Vgs = _voltage(xPrev, idx[1]) - Vs, Vds = _voltage(xPrev, idx[0]) - Vs;
+    auto &history = _chargeHistory[fet];
+    if (Vgs != history.Vgs || Vds != history.Vds) {
+        auto Q = PlanarFET::getCharges(_netlist.getTech(f.tech), f.W, Vgs, Vds, f.devType);
+        history = {Vgs, Vds, Q.Qg.value, Q.Qd.value};
+    }
+    return history;
+}
+
+void Simulator::_factor() {
+    if (_profile) _profile->begin();
+    if (_dense) _dense->factor(_jacobian.data());
+    else _lu.factor();
+    if (_profile) _profile->end(KernelProfile::Phase::Factor, _entries);
+    _stats.factorizations++;
+    _factoredEpoch = _switchLevel ? _regionEpoch : -1;
+    _factoredH = _loadedH;
+    _chordFactors = false;
+}
+
+void Simulator::_solveTranspose(std::vector<double> &rhs) {
+    if (_krylov) throw std::runtime_error("sensitivity analysis requires the direct linear solver");
+    _directSolve(rhs, true);
+}
+
+void Simulator::_solveFactored(std::vector<double> &rhs) {
+    if (_krylov) throw std::runtime_error("no factors to solve with on the iterative solver");
+    _directSolve(rhs, false);
+}
+
+void Simulator::_directSolve(std::vector<double> &rhs, bool transpose) {
+    if (_dense) {
+        if (transpose) _dense->solveTranspose(rhs);
+        else _dense->solve(rhs);
+        return;
+    }
+    auto solve = [&](std::vector<double> &b) {
+        if (transpose) _lu.solveTranspose(b);
+        else _lu.solve(b);
+    };
+    if (!_lu.isSinglePrecision()) {
+        solve(rhs);
+        return;
+    }
+
+    // iterative refinement: the residual of the single precision solution is formed with the
+    // double precision Jacobian and solved for a correction, until it stops changing anything
+    _refineRhs = rhs;
+    solve(rhs);
+    _refineCorrection.resize(rhs.size());
+    for (int step = 0; step < _options.refinementSteps; step++) {
+        if (transpose) _jacobian.multiplyTranspose(rhs, _refineCorrection);
+        else _jacobian.multiply(rhs, _refineCorrection, 0, getSize());
+        for (size_t i = 0; i < rhs.size(); i++) _refineCorrection[i] = _refineRhs[i] - _refineCorrection[i];
+        solve(_refineCorrection);
+        _stats.refinementSteps++;
+
+        double largest = 0.0, change = 0.0;
+        for (size_t i = 0; i < rhs.size(); i++) {
+            rhs[i] += _refineCorrection[i];
+            largest = std::max(largest, std::abs(rhs[i]));
+            change = std::max(change, std::abs(_refineCorrection[i]));
+        }
+        if (change <= 1e-14 * largest) break;
+    }
+}
+
+bool Simulator::_linearSolve(std::vector<double> &dx, int iteration) {
+    // dx = -J^-1 f with the factors of the current Jacobian. the iterative solver starts the
+    // first Newton correction from the previous solve's, which tracks the last step's motion.
+    if (!_krylov) {
+        for (size_t i = 0; i < dx.size(); i++) dx[i] = -_residual[i];
+        _solveFactored(dx);
+        return true;
+    }
+    for (auto &r : _residual) r = -r;
+    if (iteration == 0 && _warmStart.size() == dx.size()) dx = _warmStart;
+    else std::fill(dx.begin(), dx.end(), 0.0);
+    auto iterations = _krylov->solve(_residual, dx);
+    if (iterations < 0) return false;
+    _stats.krylovIterations += iterations;
+    if (iteration == 0) _warmStart = dx;
+    return true;
+}
+
+bool Simulator::_newton(std::vector<double> &x, const std::vector<double> *xPrev, double h, double time, double sourceScale) {
+    // damped Newton-Raphson, returns false if it did not converge within maxIterations
+    std::vector<double> dx(x.size());
+    // chord only for transient steps, which start close to the solution. dc Newton from a cold
+    // start needs every fresh Jacobian it can get.
+    auto chord = _options.chord && xPrev && !_switchLevel && !_krylov;
+    double previous = 0.0;                  // largest node correction of the last iteration
+    bool forced = false;
+    auto pending = Refactor::Fresh;
+    for (int iter = 0; iter < _options.maxIterations; iter++) {
+        _load(x, xPrev, h, time, sourceScale);
+        bool reused = false;
+        auto reason = Refactor::Fresh;
+        if (_switchLevel) reused = _factoredEpoch == _regionEpoch && _factoredH == _loadedH;
+        else if (chord) {
+            reused = !_refactor(x, reason);
+            if (reused && forced) reused = false, reason = pending;
+        }
+        if (reused) _stats.reusedFactorizations++;
+        else {
+            _factor();
+            if (chord) {
+                _factoredRegions = _regions;
+                _chordFactors = true;
+                _chordRate = 1.0;
+                _stats.refactors[size_t(reason)]++;
+            }
+        }
+        _stats.newtonIterations++;
+        if constexpr (DeviceStats::ENABLED) _blameResidual();
+        if (_profile) _profile->begin();
+        auto solved = _linearSolve(dx, iter);
+        if (_profile) _profile->end(KernelProfile::Phase::Solve, _entries);
+        if (!solved) return false;
+
+        double largest = 0.0;
+        for (int i = 0; i < _numNodes; i++) largest = std::max(largest, std::abs(dx[i]));
+        auto limited = largest > _options.maxVoltageStep;
+        auto scale = limited ? _options.maxVoltageStep / largest : 1.0;
+        if constexpr (DeviceStats::ENABLED) {
+            if (limited) _blameLimiting(dx);
+        }
+
+        // chord: old factors converge linearly, and a correction shrinking by contraction leaves
+        // about contraction / (1 - contraction) of itself as error. a reused iteration only passes
+        // the test below once that is a small part of the tolerance, judged by the last contraction
+        // measured on these factors, possibly in an earlier step. none measured yet does not pass.
+        auto contraction = (chord && reused && iter > 0 && previous > 0.0) ? largest / previous : 0.0;
+        auto margin = 1.0;
+        if (chord && reused) {
+            if (contraction > 0.0) _chordRate = contraction;
+            margin = _chordRate < 1.0 ? std::max(1.0, _chordRate / (1.0 - _chordRate) / CHORD_ERROR) : 0.0;
+        }
+        if (chord && _chordLog) {
+            *_chordLog << time << "," << h << "," << iter << "," << !reused << "," << (reused ? "" : getName(reason)) << "," << contraction << "\n";
+        }
+        forced = chord && (limited || contraction > _options.chordContraction);
+        pending = limited ? Refactor::Limited : Refactor::Contraction;
+        previous = largest;
+
+        bool converged = !limited && margin > 0.0;
+        for (size_t i = 0; i < x.size(); i++) {
+            auto next = x[i] + scale * dx[i];
+            if (!std::isfinite(next)) return false;
+            auto tol = _options.reltol * std::max(std::abs(next), std::abs(x[i])) + (int(i) < _numNodes ? _options.vntol : _options.abstol);
+            if (std::abs(next - x[i]) * margin > tol) converged = false;
+            x[i] = next;
+        }
+        if (converged) return true;
+        // switch level: the system is linear while every device stays on its plane, so a full
+        // direct step that leaves all regions unchanged has solved it exactly
+        if (_switchLevel && !limited && !_krylov && _inRegions(x)) return true;
+    }
+    return false;
+}
+
+bool Simulator::_refactor(const std::vector<double> &x, Refactor &reason) {
+    // the factors stay close to the loaded Jacobian while the timestep is the same and every FET
+    // is in the region it was factored in. a capacitor's C/h that is off by some fraction makes
+    // every correction short by about that fraction, which adds up over a slow decay.
+    // regions are kept for the next factors.
+    auto &fets = _netlist.getFets();
+    _regions.resize(fets.size());
+    for (size_t k = 0; k < fets.size(); k++) {
+        auto idx = _fetUnknowns(int(k));
+        auto Vs = _voltage(x, idx[2]);
+        _regions[k] = PlanarFET::getRegion(_netlist.getTech(fets[k].tech), _voltage(x, idx[1]) - Vs, _voltage(x, idx[0]) - Vs, fets[k].devType);
+    }
+    if (!_chordFactors) reason = Refactor::Fresh;
+    else if (_loadedH != _factoredH) reason = Refactor::Timestep;
+    else if (_regions != _factoredRegions) reason = Refactor::Region;
+    else return false;
+    return true;
+}
+
+std::vector<double> Simulator::_getChordState() const {
+    // held (0/1), then while held the contraction, the timestep and the regions of the factors
+    // (count first) and the factors themselves (count first). the groups' states follow.
+    std::vector<double> state;
+    if (!_options.chord) return state;
+    state.push_back(_chordFactors ? 1.0 : 0.0);
+    if (_chordFactors) {
+        state.push_back(_chordRate);
+        state.push_back(_factoredH);
+        state.push_back(double(_factoredRegions.size()));
+        for (auto region : _factoredRegions) state.push_back(double(int(region)));
+        auto factors = _dense ? _dense->getFactors() : _lu.getFactors();
+        state.push_back(double(factors.size()));
+        state.insert(state.end(), factors.begin(), factors.end());
+    }
+    if (_partitioned) {
+        auto groups = _partitioned->getChordState();
+        state.insert(state.end(), groups.begin(), groups.end());
+    }
+    return state;
+}
+
+void Simulator::_setChordState(const std::vector<double> &state) {
+    _chordFactors = false;
+    _chordRate = 1.0;
+    if (state.empty()) {
+        if (_partitioned) _partitioned->setChordState({});
+        return;
+    }
+    size_t pos = 0;
+    auto take = [&]() {
+        if (pos >= state.size()) throw std::runtime_error("chord state does not match the circuit");
+        return state[pos++];
+    };
+    auto count = [&]() {
+        auto n = take();
+        if (n < 0.0 || n > double(state.size() - pos)) throw std::runtime_error("chord state does not match the circuit");
+        return size_t(n);
+    };
+    if (take() != 0.0) {
+        auto rate = take();
+        auto h = take();
+        std::vector<PlanarFET::Region> regions(count());
+        if (regions.size() != _netlist.getFets().size()) throw std::runtime_error("chord state does not match the circuit");
+        for (auto &region : regions) {
+            auto value = int(take());
+            if (value < int(PlanarFET::Region::Off) || value > int(PlanarFET::Region::Saturation)) throw std::runtime_error("chord state does not match the circuit");
+            region = PlanarFET::Region(value);
+        }
+        std::vector<double> factors(count());
+        for (auto &value : factors) value = take();
+        if (_dense) _dense->setFactors(factors);
+        else _lu.setFactors(factors);
+        _factoredRegions = std::move(regions);
+        _factoredH = h;
+        _factoredEpoch = -1;
+        _chordRate = rate;
+        _chordFactors = true;
+    }
+    if (_partitioned) _partitioned->setChordState(std::vector<double>(state.begin() + pos, state.end()));
+    else if (pos != state.size()) throw std::runtime_error("chord state does not match the circuit");
+}
+
+void Simulator::_blameResidual() {
+    int worst = -1;
+    double largest = 0.0;
+    for (int i = 0; i < _numNodes; i++) {
+        if (std::abs(_residual[i]) > largest) largest = std::abs(_residual[i]), worst = i;
+    }
+    auto fet = _deviceStats.blame(worst + 1);
+    if (fet >= 0) _deviceStats[size_t(fet)].worstResidual++;
+}
+
+void Simulator::_blameLimiting(const std::vector<double> &dx) {
+    // the devices whose own terminal voltages the full step would have moved past the limit
+    auto &fets = _netlist.getFets();
+    for (size_t k = 0; k < fets.size(); k++) {
+        auto idx = _fetUnknowns(int(k));
+        auto dVs = _voltage(dx, idx[2]);
+        auto dVgs = _voltage(dx, idx[1]) - dVs, dVds = _voltage(dx, idx[0]) - dVs;
+        if (std::max(std::abs(dVgs), std::abs(dVds)) > _options.maxVoltageStep) _deviceStats[k].limited++;
+    }
+}
+
+bool Simulator::_inRegions(const std::vector<double> &x) const {
+    auto &fets = _netlist.getFets();
+    for (size_t k = 0; k < fets.size(); k++) {
+        auto idx = _fetUnknowns(int(k));
+        auto Vs = _voltage(x, idx[2]);
+        auto &table = _pwlTables[size_t(fets[k].tech) * 2 + (fets[k].devType == ModelUtils::DevType::P)];
+        if (PwlFET::locate(table, _voltage(x, idx[1]) - Vs, _voltage(x, idx[0]) - Vs) != _fetRegions[k].region) return false;
+    }
+    return true;
+}
+
+bool Simulator::_solve(std::vector<double> &x, const std::vector<double> *xPrev, double h, double time, double sourceScale) {
+    // block relaxation first when partitioned, the full matrix if it does not settle. source
+    // stepping always uses the full matrix since block boundaries must not be scaled.
+    if (_partitioned && sourceScale == 1.0 && _switchLevel == _options.switchLevel) {
+        if (_partitioned->solve(x, xPrev, h, time, _stats)) return true;
+        _stats.partitionFallbacks++;
+        _partitioned->wakeAll();
+    }
+    return _newton(x, xPrev, h, time, sourceScale);
+}
+
+std::vector<double> Simulator::solveOperatingPoint(double time) {
+    for (auto stimulus : _stimuli) stimulus->seek(time);
+    // piecewise-linear Newton tends to cycle between regions from a cold start. the smooth model
+    // finds the point instead, and switch-level Newton only has to move it onto its planes.
+    if (_switchLevel) {
+        _switchLevel = false;
+        std::vector<double> x;
+        try {
+            x = solveOperatingPoint(time);
+        } catch (...) {
+            _switchLevel = true;
+            throw;
+        }
+        _switchLevel = true;
+        if (_solve(x, nullptr, 0.0, time, 1.0)) return x;
+        throw std::runtime_error("dc operating point did not converge on the switch-level models");
+    }
+
+    // plain Newton from zero, falling back to source stepping
+    std::vector<double> x(getSize(), 0.0);
+    if (_solve(x, nullptr, 0.0, time, 1.0)) return x;
+
+    std::fill(x.begin(), x.end(), 0.0);
+    double scale = 0.0, step = 0.1;
+    while (scale < 1.0) {
+        auto trial = x;
+        auto next = std::min(1.0, scale + step);
+        if (_solve(trial, nullptr, 0.0, time, next)) {
+            x = trial;
+            scale = next;
+            step = std::min(2 * step, 0.5);
+        } else {
+            step /= 4;
+            if (step < 1e-6) throw std::runtime_error("dc operating point did not converge");
+        }
+    }
+    return x;
+}
+
+size_t Simulator::getMinimumPoints(double tstep, double tstop) const {
+    // _transient doubles h at most once per step, so from tstep / 10 it takes four
+    auto breakpoints = _getBreakpoints(tstop).size();
+    return size_t(std::ceil(tstop / tstep)) + 1 + 4 * breakpoints;
+}
+
+std::vector<double> Simulator::_getBreakpoints(double tstop) const {
+    // stimulus sources only hold their current ramp, their breakpoints come from the stimulus
+    std::vector<bool> streamed(_netlist.getVSources().size(), false);
+    for (auto stimulus : _stimuli) {
+        for (auto source : stimulus->getSources()) streamed[size_t(source)] = true;
+    }
+    std::vector<double> points = {tstop};
+    for (size_t k = 0; k < streamed.size(); k++) {
+        if (streamed[k]) continue;
+        auto wave = Source::getBreakpoints(_netlist.getVSources()[k].wave, tstop);
+        points.insert(points.end(), wave.begin(), wave.end());
+    }
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+    return points;
+}
+
+Simulator::Waveforms Simulator::solveTransient(double tstep, double tstop, const StepCallback &onAccept, bool storeWaveforms, const std::vector<double> *initial) {
+    if (tstep <= 0.0 || tstop <= 0.0) throw std::runtime_error("transient analysis requires positive tstep and tstop");
+    if (initial && int(initial->size()) != getSize()) throw std::runtime_error("initial point does not match the circuit");
+
+    TransientState state;
+    state.tstep = tstep;
+    state.tstop = tstop;
+    state.t = state.tPrev = 0.0;
+    state.h = tstep / 10;
+    state.history = 1;
+    state.nextBreak = 0;
+    // counters describe one transient, a resumed one gets them back from its snapshot
+    _stats = Statistics();
+    // chord factors of an earlier transient were loaded from other element values, e.g. a
+    // characterization point with another load
+    _setChordState({});
+    // latency of an earlier transient, e.g. blocks an abandoned run left frozen
+    if (_partitioned) _partitioned->setLatencyState({});
+    for (auto stimulus : _stimuli) stimulus->seek(0.0);
+    state.x = initial ? *initial : solveOperatingPoint(0.0);
+
+    Waveforms waves;
+    if (storeWaveforms) {
+        waves.time.push_back(0.0);
+        waves.x.push_back(state.x);
+    }
+    if (onAccept) onAccept(0.0, state.x);
+    return _transient(state, onAccept, storeWaveforms, std::move(waves));
+}
+
+Simulator::Waveforms Simulator::resumeTransient(const TransientState &state, const StepCallback &onAccept, bool storeWaveforms) {
+    if (int(state.x.size()) != getSize()) throw std::runtime_error("snapshot does not match the circuit");
+    auto resumed = state;
+    for (auto stimulus : _stimuli) stimulus->seek(state.t);
+    _stats = state.stats;
+    _warmStart = state.warmStart;
+    if (_partitioned) _partitioned->setLatencyState(state.latency);
+    _setChordState(state.chord);
+    return _transient(resumed, onAccept, storeWaveforms, Waveforms());
+}
+
+Simulator::Waveforms Simulator::_transient(TransientState &state, const StepCallback &onAccept, bool storeWaveforms, Waveforms waves) {
+    // backward Euler, landing exactly on source breakpoints. the step is controlled by the
+    // truncation error estimate h^2/2 * x'' from the last three accepted points, which are the
+    // only ones kept unless storeWaveforms is set
+    auto &t = state.t, &tPrev = state.tPrev, &h = state.h;
+    auto &x = state.x, &xPrev = state.xPrev;
+    auto &history = state.history;
+    auto accept = [&](double time) {
+        if (storeWaveforms) {
+            waves.time.push_back(time);
+            waves.x.push_back(x);
+        }
+        if (onAccept) onAccept(time, x);
+    };
+
+    auto breakpoints = _getBreakpoints(state.tstop);
+    size_t nextBreak = size_t(state.nextBreak);
+    double hmax = state.tstep, hmin = state.tstop * 1e-12;
+    std::vector<double> xn;
+
+    // the deck's own breakpoints are fixed, stimulus edges are merged in as they are read
+    auto stimulusBreak = [&]() {
+        auto next = std::numeric_limits<double>::infinity();
+        for (auto stimulus : _stimuli) next = std::min(next, stimulus->nextBreakpoint());
+        return next;
+    };
+    while (nextBreak < breakpoints.size()) {
+        auto target = std::min(breakpoints[nextBreak], stimulusBreak());
+        if (target <= t + hmin) {
+            if (target == breakpoints[nextBreak]) nextBreak++;
+            for (auto stimulus : _stimuli) stimulus->advance(target);
+            continue;
+        }
+        bool hitBreak = false;
+        if (t + h >= target - hmin) {
+            h = target - t;
+            hitBreak = true;
+        } else if (t + 2 * h > target) {
+            h = (target - t) / 2;
+        }
+
+        xn = x;
+        if (!_solve(xn, &x, h, t + h, 1.0)) {
+            _stats.rejectedSteps++;
+            h /= 8;
+            if (h < hmin) throw std::runtime_error("timestep too small at t = " + std::to_string(t));
+            continue;
+        }
+
+        double ratio = 0.0;
+        int worst = -1;
+        if (history >= 2) {
+            auto h1 = t - tPrev;
+            for (int i = 0; i < _numNodes; i++) {
+                auto dd = ((xn[i] - x[i]) / h - (x[i] - xPrev[i]) / h1) / (h + h1);
+                auto tol = _options.trtol * (_options.reltol * std::max(std::abs(xn[i]), std::abs(x[i])) + _options.vntol);
+                auto r = h * h * std::abs(dd) / tol;
+                if (r > ratio) ratio = r, worst = i;
+            }
+        }
+        if (ratio > 1.0) {
+            _stats.rejectedSteps++;
+            if constexpr (DeviceStats::ENABLED) {
+                auto fet = _deviceStats.blame(worst + 1);
+                if (fet >= 0) _deviceStats[size_t(fet)].rejections++;
+            }
+            h *= std::max(0.25, 0.9 / std::sqrt(ratio));
+            if (h < hmin) throw std::runtime_error("timestep too small at t = " + std::to_string(t));
+            continue;
+        }
+
+        tPrev = t;
+        t = hitBreak ? target : t + h;
+        xPrev.swap(x);
+        x.swap(xn);
+        history++;
+        _stats.acceptedSteps++;
+        if (_partitioned && _options.multirate) _partitioned->accept(x, xPrev, h);
+        accept(t);
+        for (auto stimulus : _stimuli) stimulus->advance(t);
+
+        if (hitBreak) {
+            // the waveforms have a corner here, so restart the error estimate with a small step
+            if (t == breakpoints[nextBreak]) nextBreak++;
+            if (_partitioned && _options.multirate) _partitioned->wakeAll();
+            history = 1;
+            h = std::min(h, hmax / 10);
+        } else {
+            h *= (ratio > 0.0) ? std::min(2.0, 0.9 / std::sqrt(ratio)) : 2.0;
+        }
+        h = std::min(h, hmax);
+
+        // everything the next step depends on is settled here
+        if (_checkpoint && _checkpoint->due()) {
+            state.nextBreak = int(nextBreak);
+            state.warmStart = _warmStart;
+            state.latency = _partitioned ? _partitioned->getLatencyState() : std::vector<double>();
+            state.chord = _getChordState();
+            state.stats = _stats;
+            _checkpoint->capture(*this, state);
+        }
+    }
+    return waves;
+}
@@ -0,0 +1,320 @@
+#include "stimulus.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace {
+    const double NEVER = std::numeric_limits<double>::infinity();
+
+    bool space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    std::string lower(const char *begin, const char *end) {
+        std::string text(begin, end);
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+        return text;
+    }
+
+    // "1ns", "10 ps", ... as seconds
+    double parseTimescale(const std::string &text) {
+        size_t digits = 0;
+        while (digits < text.size() && std::isdigit(static_cast<unsigned char>(text[digits]))) digits++;
+        if (digits == 0) throw std::runtime_error("bad vcd timescale [ " + text + " ]");
+        auto unit = text.substr(digits);
+        double scale = 0.0;
+        if (unit == "s") scale = 1.0;
+        else if (unit == "ms") scale = 1e-3;
+        else if (unit == "us") scale = 1e-6;
+        else if (unit == "ns") scale = 1e-9;
+        else if (unit == "ps") scale = 1e-12;
+        else if (unit == "fs") scale = 1e-15;
+        else throw std::runtime_error("bad vcd timescale [ " + text + " ]");
+        return std::stod(text.substr(0, digits)) * scale;
+    }
+}
+
+Stimulus::Options Stimulus::parse(const std::vector<std::string> &args) {
+    Options options;
+    for (auto &arg : args) {
+        auto eq = arg.find('=');
+        if (eq == std::string::npos) throw std::runtime_error("stimulus: expected key=value [ " + arg + " ]");
+        auto key = arg.substr(0, eq), value = arg.substr(eq + 1);
+        if (key == "vlow") options.vlow = Netlist::parseValue(value);
+        else if (key == "vhigh") options.vhigh = Netlist::parseValue(value);
+        else if (key == "rise") options.rise = Netlist::parseValue(value);
+        else if (key == "fall") options.fall = Netlist::parseValue(value);
+        else if (key == "format" && value == "vcd") options.format = Options::Format::Vcd;
+        else if (key == "format" && value == "table") options.format = Options::Format::Table;
+        else throw std::runtime_error("stimulus: unknown option [ " + arg + " ]");
+    }
+    if (options.vhigh == options.vlow) throw std::runtime_error("stimulus: vlow and vhigh are the same");
+    if (options.rise < 0.0 || options.fall < 0.0) throw std::runtime_error("stimulus: negative ramp time");
+    return options;
+}
+
+Stimulus::Stimulus(const std::filesystem::path &path, const Options &options)
+    : _file(path.string()), _path(path), _options(options), _timescale(1e-9), _netlist(nullptr),
+      _body(0), _pos(0), _nextTime(NEVER), _lastTime(-NEVER), _edges(0)
+{
+    auto extension = path.extension().string();
+    extension = lower(extension.data(), extension.data() + extension.size());
+    _vcd = options.format == Options::Format::Vcd || (options.format == Options::Format::Auto && extension == ".vcd");
+    _readHeader();
+}
+
+bool Stimulus::_token(const char *&begin, const char *&end) {
+    auto data = _file.data(), stop = data + _file.size();
+    auto p = data + _pos;
+    while (p < stop && space(*p)) p++;
+    if (p == stop) {
+        _pos = _file.size();
+        return false;
+    }
+    begin = p;
+    while (p < stop && !space(*p)) p++;
+    end = p;
+    _pos = size_t(p - data);
+    return true;
+}
+
+bool Stimulus::_line() {
+    auto data = _file.data(), stop = data + _file.size();
+    while (_pos < _file.size()) {
+        auto p = data + _pos;
+        auto eol = std::find(p, stop, '\n');
+        _pos = size_t(eol - data) + (eol < stop ? 1 : 0);
+        _columns.clear();
+        while (p < eol) {
+            while (p < eol && space(*p)) p++;
+            if (p == eol) break;
+            auto begin = p;
+            while (p < eol && !space(*p)) p++;
+            _columns.emplace_back(begin, p);
+        }
+        if (_columns.empty()) continue;
+        auto first = *_columns[0].first;
+        if (first == '*' || first == '#' || first == ';') continue;
+        return true;
+    }
+    return false;
+}
+
+void Stimulus::_readHeader() {
+    if (!_vcd) {
+        // time <signal> ...
+        if (!_line() || _columns.size() < 2) throw std::runtime_error("stimulus table without signals [ " + _path.string() + " ]");
+        for (size_t j = 1; j < _columns.size(); j++) _signals.push_back({lower(_columns[j].first, _columns[j].second), 1, false, 0, 0, {}});
+        _body = _pos;
+        return;
+    }
+
+    const char *begin, *end;
+    auto next = [&]() -> std::string {
+        if (!_token(begin, end)) throw std::runtime_error("vcd header is not closed by $enddefinitions [ " + _path.string() + " ]");
+        return std::string(begin, end);
+    };
+    auto skipToEnd = [&]() { while (next() != "$end") {} };
+    while (true) {
+        auto keyword = next();
+        if (keyword == "$enddefinitions") {
+            skipToEnd();
+            break;
+        }
+        if (keyword == "$timescale") {
+            std::string text;
+            for (auto token = next(); token != "$end"; token = next()) text += token;
+            _timescale = parseTimescale(text);
+        } else if (keyword == "$var") {
+            // $var <type> <size> <code> <reference> [<range>] $end
+            next();
+            auto width = std::stoi(next());
+            auto code = next();
+            next();
+            auto reference = lower(begin, end);
+            std::string range;
+            for (auto token = next(); token != "$end"; token = next()) range += token;
+            Signal signal{reference, width, false, width - 1, 0, {}};
+            auto split = signal.name.find('[');
+            if (split != std::string::npos) {
+                range = signal.name.substr(split) + range;
+                signal.name.erase(split);
+            }
+            if (!range.empty()) {
+                // [msb:lsb] or [bit]
+                auto colon = range.find(':');
+                signal.ranged = true;
+                signal.msb = std::stoi(range.substr(1));
+                signal.lsb = colon == std::string::npos ? signal.msb : std::stoi(range.substr(colon + 1));
+                if (std::abs(signal.msb - signal.lsb) + 1 != width) throw std::runtime_error("vcd range does not match the width of [ " + signal.name + " ]");
+            }
+            _codes[code].push_back(int(_signals.size()));
+            _signals.push_back(signal);
+        } else if (keyword[0] == '$') {
+            skipToEnd();
+        }
+    }
+    _body = _pos;
+}
+
+int Stimulus::attach(Netlist &netlist) {
+    if (_netlist) throw std::runtime_error("stimulus is already attached [ " + _path.string() + " ]");
+    _netlist = &netlist;
+    std::unordered_set<int> sourced;
+    for (auto &v : netlist.getVSources()) sourced.insert({v.p, v.n});
+
+    // aliased signals and repeated names share the source of the first one
+    std::unordered_map<int, int> bound;
+    std::vector<std::string> names;
+    for (auto &signal : _signals) {
+        signal.driven.assign(size_t(signal.width), -1);
+        for (int i = 0; i < signal.width; i++) {
+            auto name = signal.name;
+            if (signal.ranged || signal.width > 1) name += "[" + std::to_string(signal.msb >= signal.lsb ? signal.lsb + i : signal.lsb - i) + "]";
+            auto node = netlist.findNode(name);
+            if (node <= Netlist::GROUND) continue;
+            auto known = bound.find(node);
+            if (known != bound.end()) {
+                signal.driven[size_t(i)] = known->second;
+                continue;
+            }
+            if (sourced.count(node)) throw std::runtime_error("stimulus node is already driven by a voltage source [ " + name + " ]");
+            bound[node] = signal.driven[size_t(i)] = int(names.size());
+            names.push_back("vstim_" + name);
+            netlist.addVSource(names.back(), name, "0", {Source::Shape::DC, {_options.vlow}});
+        }
+    }
+    for (auto &name : names) _sources.push_back(netlist.findVSource(name));
+    _levels.assign(_sources.size(), _options.vlow);
+    seek(0.0);
+    return int(_sources.size());
+}
+
+void Stimulus::seek(double time) {
+    if (!_netlist) throw std::runtime_error("stimulus is not attached [ " + _path.string() + " ]");
+    _pos = _body;
+    _lastTime = -NEVER;
+    _rampEnds = decltype(_rampEnds)();
+    for (size_t d = 0; d < _sources.size(); d++) {
+        _levels[d] = _options.vlow;
+        _netlist->getVSource(_sources[d]).wave = {Source::Shape::DC, {_options.vlow}};
+    }
+    _readAhead();
+    advance(time);
+}
+
+void Stimulus::advance(double time) {
+    while (_nextTime <= time) {
+        for (auto &[source, level] : _changes) _drive(source, level, _nextTime);
+        _readAhead();
+    }
+    while (!_rampEnds.empty() && _rampEnds.top() <= time) _rampEnds.pop();
+}
+
+double Stimulus::nextBreakpoint() const {
+    return _rampEnds.empty() ? _nextTime : std::min(_nextTime, _rampEnds.top());
+}
+
+void Stimulus::_readAhead() {
+    // time points that change no driven source (unbound signals, repeated values) cost no step
+    while (_parseTime()) {
+        if (!_changes.empty()) return;
+    }
+    _nextTime = NEVER;
+}
+
+bool Stimulus::_parseTime() {
+    _changes.clear();
+    if (!_vcd) {
+        if (!_line()) return false;
+        _nextTime = Netlist::parseValue(std::string(_columns[0].first, _columns[0].second));
+        if (_columns.size() != _signals.size() + 1) throw std::runtime_error("stimulus row at t = " + std::to_string(_nextTime) + " does not have a value per signal [ " + _path.string() + " ]");
+        for (size_t j = 0; j < _signals.size(); j++) _change(_signals[j], _columns[j + 1].first, _columns[j + 1].second);
+    } else {
+        // "#<time>" and its value changes, up to the next "#". changes before the first "#" are at 0
+        const char *begin, *end;
+        auto start = _pos;
+        if (!_token(begin, end)) return false;
+        if (*begin == '#') {
+            uint64_t ticks = 0;
+            if (std::from_chars(begin + 1, end, ticks).ptr != end) throw std::runtime_error("bad vcd time [ " + std::string(begin, end) + " ]");
+            _nextTime = double(ticks) * _timescale;
+        } else {
+            _nextTime = 0.0;
+            _pos = start;
+        }
+        while (true) {
+            start = _pos;
+            if (!_token(begin, end)) break;
+            auto kind = *begin;
+            if (kind == '#') {
+                _pos = start;
+                break;
+            }
+            if (kind == '$') {
+                // $dumpvars, $dumpoff, ... and their $end only bracket ordinary changes
+                if (std::string(begin, end) == "$comment") {
+                    while (_token(begin, end) && std::string(begin, end) != "$end") {}
+                }
+                continue;
+            }
+            auto value = begin + 1, valueEnd = end;
+            if (kind == 'b' || kind == 'B' || kind == 'r' || kind == 'R') {
+                if (!_token(begin, end)) throw std::runtime_error("vcd value without an identifier [ " + _path.string() + " ]");
+                if (kind == 'r' || kind == 'R') continue;
+            } else {
+                value = begin;
+                valueEnd = begin + 1;
+                begin++;
+            }
+            auto code = _codes.find(std::string(begin, end));
+            if (code == _codes.end()) throw std::runtime_error("unknown vcd identifier [ " + std::string(begin, end) + " ]");
+            for (auto signal : code->second) _change(_signals[size_t(signal)], value, valueEnd);
+        }
+    }
+    if (_nextTime < _lastTime) throw std::runtime_error("stimulus time goes backwards at t = " + std::to_string(_nextTime) + " [ " + _path.string() + " ]");
+    _lastTime = _nextTime;
+    return true;
+}
+
+void Stimulus::_change(const Signal &signal, const char *value, const char *end) {
+    // vcd vectors are msb first, shorter values are extended with 0 (or x/z if that leads)
+    auto length = end - value;
+    if (length <= 0) return;
+    auto pad = (*value == 'x' || *value == 'X' || *value == 'z' || *value == 'Z') ? *value : '0';
+    for (int i = 0; i < signal.width; i++) {
+        auto source = signal.driven[size_t(i)];
+        if (source < 0) continue;
+        auto bit = i < length ? value[length - 1 - i] : pad;
+        double level;
+        if (bit == '0') level = _options.vlow;
+        else if (bit == '1') level = _options.vhigh;
+        else continue;
+        if (level != _levels[size_t(source)]) _changes.emplace_back(source, level);
+    }
+}
+
+void Stimulus::_drive(int source, double level, double time) {
+    if (level == _levels[size_t(source)]) return;
+    _levels[size_t(source)] = level;
+    auto &wave = _netlist->getVSource(_sources[size_t(source)]).wave;
+    if (time <= 0.0) {
+        wave.shape = Source::Shape::DC;
+        wave.params.assign(1, level);
+        return;
+    }
+    // a ramp that starts before the last one ended starts where that one is, at the same slew
+    auto from = Source::getValue(wave, time);
+    auto ramp = (level > from ? _options.rise : _options.fall) * std::abs(level - from) / std::abs(_options.vhigh - _options.vlow);
+    wave.shape = Source::Shape::PWL;
+    wave.params.resize(4);
+    wave.params[0] = time;
+    wave.params[1] = from;
+    wave.params[2] = time + ramp;
+    wave.params[3] = level;
+    if (ramp > 0.0) _rampEnds.push(time + ramp);
+    _edges++;
+}
@@ -0,0 +1,233 @@
+#include "symbolic_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+
+#include "mapped_file.hpp"
+#include "memory.hpp"
+
+const uint32_t SymbolicCache::VERSION;
+
+namespace {
+    const char MAGIC[8] = {'c', 's', 'i', 'm', 's', 'y', 'm', '\0'};
+    const uint32_t ENDIAN_MARK = 0x01020304;
+
+    // hashes everything it writes, the hash closes the image
+    class Writer {
+    public:
+        explicit Writer(std::ofstream &file) : _file(file), _hash(hash_bytes(nullptr, 0)) {}
+
+        void write(const void *data, size_t size) {
+            _file.write(static_cast<const char *>(data), std::streamsize(size));
+            _hash = hash_bytes(data, size, _hash);
+        }
+
+        template <typename T> void put(const T &value) {
+            static_assert(std::is_trivially_copyable<T>::value, "only plain data can be written raw");
+            write(&value, sizeof(T));
+        }
+
+        void putArray(const std::vector<int> &values) {
+            put(uint64_t(values.size()));
+            write(values.data(), values.size() * sizeof(int));
+        }
+
+        uint64_t hash() const { return _hash; }
+
+    private:
+        std::ofstream &_file;
+        uint64_t _hash;
+    };
+
+    class Reader {
+    public:
+        Reader(const char *data, size_t size) : _pos(data), _end(data + size) {}
+
+        template <typename T> T get() {
+            static_assert(std::is_trivially_copyable<T>::value, "only plain data can be read raw");
+            T value;
+            _take(&value, sizeof(T));
+            return value;
+        }
+
+        void getArray(std::vector<int> &values) {
+            auto count = get<uint64_t>();
+            if (count > size_t(_end - _pos) / sizeof(int)) throw std::runtime_error("truncated symbolic cache entry");
+            values.resize(count);
+            _take(values.data(), count * sizeof(int));
+        }
+
+        bool done() const { return _pos == _end; }
+
+    private:
+        const char *_pos, *_end;
+
+        void _take(void *out, size_t size) {
+            if (size > size_t(_end - _pos)) throw std::runtime_error("truncated symbolic cache entry");
+            if (size) std::memcpy(out, _pos, size);
+            _pos += size;
+        }
+    };
+
+    // offsets into a table of `entries`: starts at 0, never decreases, ends at entries
+    bool isRange(const std::vector<int> &ptr, size_t count, size_t entries) {
+        if (ptr.size() != count + 1 || ptr.front() != 0 || size_t(ptr.back()) != entries) return false;
+        for (size_t i = 0; i < count; i++) if (ptr[i + 1] < ptr[i]) return false;
+        return true;
+    }
+
+    bool isBelow(const std::vector<int> &values, int limit) {
+        for (auto v : values) if (v < 0 || v >= limit) return false;
+        return true;
+    }
+}
+
+std::filesystem::path SymbolicCache::getPath(const std::filesystem::path &directory, uint64_t hash) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.sym", (unsigned long long)hash);
+    return directory / name;
+}
+
+void SymbolicCache::save(const std::filesystem::path &entry, uint64_t hash, const SparseMatrix &matrix) {
+    if (!matrix._finalized || matrix._stride) throw std::runtime_error("only a sparse finalized matrix can be cached");
+    bool fill = matrix._values.size() == matrix._colIdx.size();
+
+    // write next to the entry and rename. runs with the same pattern may save at the same time,
+    // in other processes or in partition groups, so the temporary name is per thread.
+    auto temp = entry;
+    temp += "." + std::to_string(getpid()) + "-" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) throw std::runtime_error("Failed to open file [ " + temp.string() + " ]");
+    Writer out(file);
+
+    out.write(MAGIC, sizeof(MAGIC));
+    out.put(VERSION);
+    out.put(ENDIAN_MARK);
+    out.put(uint32_t(sizeof(int)));
+    out.put(hash);
+    out.put(int32_t(matrix._size));
+    out.put(uint32_t(fill));
+    for (auto table : {&matrix._perm, &matrix._iperm, &matrix._rowPtr, &matrix._colIdx, &matrix._diag,
+                       &matrix._pivotPtr, &matrix._lower, &matrix._upper, &matrix._opPtr, &matrix._ops}) {
+        out.putArray(*table);
+    }
+    auto checksum = out.hash();
+    file.write(reinterpret_cast<const char *>(&checksum), sizeof(checksum));
+
+    file.close();
+    if (!file) {
+        std::error_code error;
+        std::filesystem::remove(temp, error);
+        throw std::runtime_error("Failed to write file [ " + temp.string() + " ]");
+    }
+    std::error_code error;
+    std::filesystem::rename(temp, entry, error);
+    if (error) {
+        std::filesystem::remove(temp, error);
+        throw std::runtime_error("Failed to write file [ " + entry.string() + " ]");
+    }
+}
+
+bool SymbolicCache::load(const std::filesystem::path &entry, uint64_t hash, SparseMatrix &matrix, bool fill) {
+    if (matrix._finalized) throw std::runtime_error("matrix is already finalized");
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(entry, error)) return false;
+
+    try {
+        MappedFile file(entry.string());
+        uint64_t checksum;
+        if (file.size() < sizeof(checksum)) return false;
+        auto body = file.size() - sizeof(checksum);
+        std::memcpy(&checksum, file.data() + body, sizeof(checksum));
+        if (hash_bytes(file.data(), body) != checksum) return false;
+
+        Reader in(file.data(), body);
+        char magic[sizeof(MAGIC)];
+        for (auto &c : magic) c = in.get<char>();
+        if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) return false;
+        if (in.get<uint32_t>() != VERSION || in.get<uint32_t>() != ENDIAN_MARK || in.get<uint32_t>() != sizeof(int)) return false;
+        if (in.get<uint64_t>() != hash || in.get<int32_t>() != matrix._size || in.get<uint32_t>() != uint32_t(fill)) return false;
+
+        SparseMatrix result(matrix._size);
+        for (auto table : {&result._perm, &result._iperm, &result._rowPtr, &result._colIdx, &result._diag,
+                           &result._pivotPtr, &result._lower, &result._upper, &result._opPtr, &result._ops}) {
+            in.getArray(*table);
+        }
+        if (!in.done() || !_validate(result, matrix, fill)) return false;
+
+        for (auto table : {&SparseMatrix::_perm, &SparseMatrix::_iperm, &SparseMatrix::_rowPtr, &SparseMatrix::_colIdx, &SparseMatrix::_diag,
+                           &SparseMatrix::_pivotPtr, &SparseMatrix::_lower, &SparseMatrix::_upper, &SparseMatrix::_opPtr, &SparseMatrix::_ops}) {
+            matrix.*table = std::move(result.*table);
+        }
+        auto reserved = MemoryReport::bytes(matrix._reserved);
+        matrix._reserved.clear();
+        matrix._reserved.shrink_to_fit();
+        matrix._values.assign(matrix._colIdx.size() + (fill ? 0 : 1), 0.0);
+        matrix._finalized = true;
+        matrix._symbolicPeak = reserved + matrix.getMemory();
+        return true;
+    } catch (std::runtime_error &) {
+        return false;
+    }
+}
+
+bool SymbolicCache::_validate(const SparseMatrix &result, const SparseMatrix &matrix, bool fill) {
+    // everything SparseLU and getSlot() index with must stay in bounds, whatever the file holds
+    auto n = result._size;
+    if (result._perm.size() != size_t(n) || result._iperm.size() != size_t(n) || result._diag.size() != size_t(n)) return false;
+    if (!isBelow(result._perm, n) || !isBelow(result._iperm, n)) return false;
+    for (int k = 0; k < n; k++) if (result._iperm[result._perm[k]] != k) return false;
+
+    auto &colIdx = result._colIdx;
+    if (colIdx.size() >= size_t(std::numeric_limits<int>::max()) || !isRange(result._rowPtr, size_t(n), colIdx.size())) return false;
+    if (!isBelow(colIdx, n)) return false;
+    for (int i = 0; i < n; i++) {
+        auto first = result._rowPtr[i], last = result._rowPtr[i + 1];
+        for (auto p = first + 1; p < last; p++) if (colIdx[p - 1] >= colIdx[p]) return false;
+        auto d = result._diag[i];
+        if (d < first || d >= last || colIdx[d] != i) return false;
+    }
+
+    auto nnz = int(colIdx.size());
+    if (result._lower.size() != result._upper.size() || !isRange(result._pivotPtr, size_t(n), result._lower.size())) return false;
+    if (!isBelow(result._lower, nnz) || !isBelow(result._upper, nnz) || !isBelow(result._ops, fill ? nnz : nnz + 1)) return false;
+    if (!isRange(result._opPtr, size_t(n), result._ops.size())) return false;
+    for (int k = 0; k < n; k++) {
+        auto width = long(result._pivotPtr[k + 1] - result._pivotPtr[k]);
+        if (result._opPtr[k + 1] - result._opPtr[k] != width * width) return false;
+    }
+
+    // the pattern must cover every entry the circuit stamps
+    for (int i = 0; i < n; i++) {
+        for (auto j : matrix._reserved[i]) {
+            if (result._search(result._iperm[i], result._iperm[j]) == nnz) return false;
+        }
+    }
+    return true;
+}
+
+void SymbolicCache::finalize(const std::filesystem::path &directory, SparseMatrix &matrix, bool fill, bool *hit, std::string *error) {
+    auto hash = matrix.getPatternHash(fill);
+    auto entry = getPath(directory, hash);
+    auto loaded = load(entry, hash, matrix, fill);
+    if (hit) *hit = loaded;
+    if (error) error->clear();
+    if (loaded) return;
+    matrix.finalize(fill);
+
+    // a directory that is read-only or full only costs the next run its ordering
+    try {
+        std::filesystem::create_directories(directory);
+        save(entry, hash, matrix);
+    } catch (std::exception &e) {
+        if (error) *error = e.what();
+    }
+}
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "argparse.hpp"
+#include "logger.hpp"
+#include "helpers.hpp"
+
+#include "curves.hpp"
+#include "netlist.hpp"
+
+namespace po = boost::program_options;
+namespace fs = std::filesystem;
+
+static logger Log;
+
+argparse getArgs(int argc, char** argv) {
+    std::stringstream description;
+    description << cform::green << "csim-curves" << cform::end;
+    description << " sweeps the PlanarFET model over Vgs/Vds/W grids for model inspection and fitting QA.";
+
+    std::stringstream epilog;
+    epilog << "Grids are <start>:<stop>:<step> or a comma separated list, with spice suffixes (e.g. 0:1.8:10m, 1u,2u,4u).";
+
+    argparse ap(description.str(), epilog.str());
+
+    std::string args_header = cform::underline + "Arguments" + cform::end;
+    po::options_description* arg = ap.add_argument_group(args_header);
+    arg->add_options()
+        (
+            "techfile,t",
+            po::value<std::vector<fs::path>>()
+                ->value_name("path")
+                ->composing(),
+            "Technology file of .model cards, may be repeated (t180nm and t065nm are built in)."
+        )
+        (
+            "tech,T",
+            po::value<std::vector<std::string>>()
+                ->value_name("name")
+                ->composing(),
+            "Technology to sweep, may be repeated (default: every known technology)."
+        )
+        (
+            "type",
+            po::value<std::string>()
+                ->value_name("n|p|np")
+                ->default_value("np"),
+            "Device polarities to sweep."
+        )
+        (
+            "vgs",
+            po::value<std::string>()
+                ->value_name("grid")
+                ->default_value("0:1.8:10m"),
+            "Gate-source voltage grid."
+        )
+        (
+            "vds",
+            po::value<std::string>()
+                ->value_name("grid")
+                ->default_value("0:1.8:10m"),
+            "Drain-source voltage grid."
+        )
+        (
+            "w",
+            po::value<std::string>()
+                ->value_name("grid")
+                ->default_value("1u"),
+            "Device width grid."
+        )
+        (
+            "output,o",
+            po::value<fs::path>()
+                ->value_name("path"),
+            "Write the surfaces to this file instead of stdout."
+        )
+        (
+            "format,f",
+            po::value<std::string>()
+                ->value_name("csv|binary")
+                ->default_value("csv"),
+            "Output format."
+        )
+        (
+            "threads,j",
+            po::value<int>()
+                ->value_name("count")
+                ->default_value(0),
+            "Worker threads, 0 uses every core."
+        );
+
+    std::string flags_header = cform::underline + "Flags" + cform::end;
+    po::options_description* flg = ap.add_argument_group(flags_header);
+    flg->add_options()
+        ("numeric-gm", "Use the numeric (finite difference) Gm model instead of the analytic one.")
+        ("verbose,V", "Run in verbose mode.")
+        ("help,h", "Print this help messagem and exit");
+
+    po::variables_map vm = ap.parse_args(argc, argv);
+    return ap;
+}
+
+std::string lower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    return text;
+}
+
+int run(argparse args) {
+    Netlist netlist;
+    if (args.flag("techfile")) for (auto &techfile : args.get<std::vector<fs::path>>("techfile")) netlist.readTechfile(techfile);
+    std::vector<int> techs;
+    if (args.flag("tech")) {
+        for (auto &name : args.get<std::vector<std::string>>("tech")) {
+            auto tech = netlist.findTech(lower(name));
+            if (tech < 0) throw std::runtime_error("unknown technology [ " + name + " ]");
+            techs.push_back(tech);
+        }
+    } else {
+        for (int t = 0; t < netlist.getTechCount(); t++) techs.push_back(t);
+    }
+
+    std::vector<ModelUtils::DevType> types;
+    for (auto c : lower(args.get<std::string>("type"))) {
+        if (c == 'n') types.push_back(ModelUtils::DevType::N);
+        else if (c == 'p') types.push_back(ModelUtils::DevType::P);
+        else throw std::runtime_error("device type is n, p or np [ " + args.get<std::string>("type") + " ]");
+    }
+    CurveSweep::Grid grid;
+    grid.techs = techs;
+    grid.types = types;
+    grid.widths = CurveSweep::parseGrid(args.get<std::string>("w"));
+    grid.vgs = CurveSweep::parseGrid(args.get<std::string>("vgs"));
+    grid.vds = CurveSweep::parseGrid(args.get<std::string>("vds"));
+    grid.analyticGm = !args.flag("numeric-gm");
+    auto format = args.get<std::string>("format");
+    if (format != "csv" && format != "binary") throw std::runtime_error("unknown output format [ " + format + " ]");
+    auto binary = format == "binary";
+
+    std::ofstream file;
+    if (args.flag("output")) {
+        file.open(args.get<fs::path>("output"), binary ? std::ios::binary : std::ios::out);
+        if (!file.is_open()) throw std::runtime_error("Failed to open file [ " + args.get<fs::path>("output").string() + " ]");
+    } else if (binary) {
+        throw std::runtime_error("binary output needs --output");
+    }
+    std::ostream &out = args.flag("output") ? file : std::cout;
+
+    CurveSweep sweep(netlist, grid, args.get<int>("threads"));
+    auto started = std::chrono::steady_clock::now();
+    sweep.write(out, binary);
+
+    // logs go to stdout, so only when the curves do not
+    if (args.flag("output")) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        Log.info(std::to_string(sweep.getPoints()) + " points on " + std::to_string(sweep.getThreads()) + " threads in " + std::to_string(elapsed.count()) + " s");
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    try {
+        argparse args = getArgs(argc, argv);
+        Log = logger(fs::path(__FILE__).stem(), args.flag("verbose"));
+        return run(args);
+    } catch (peaceful_exception &e) {
+        return 0;
+    } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0xFF;
+}
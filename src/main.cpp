@@ -1,19 +1,43 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
 
 #include "argparse.hpp"
 #include "logger.hpp"
 #include "helpers.hpp"
 
+#include "accuracy.hpp"
+#include "characterize.hpp"
+#include "checkpoint.hpp"
+#include "dcsweep.hpp"
+#include "kernel_profile.hpp"
+#include "memory.hpp"
+#include "measure.hpp"
 #include "models.hpp"
+#include "netlist.hpp"
+#include "netlist_cache.hpp"
+#include "probe.hpp"
+#include "reduction.hpp"
+#include "sensitivity.hpp"
+#include "simulator.hpp"
+#include "stimulus.hpp"
 
 namespace po = boost::program_options;
 namespace fs = std::filesystem;
 
 static logger Log;
 
+// set by SIGUSR1 under --memory, the report is logged at the next accepted transient point
+static volatile std::sig_atomic_t memoryRequested = 0;
+
 argparse getArgs(int argc, char** argv) {
     std::stringstream description;
     description << cform::green << "C++ Circuit Simulator (CCS)" << cform::end;
@@ -34,15 +58,99 @@ argparse getArgs(int argc, char** argv) {
         )
         (
             "techfile,t",
-            po::value<fs::path>()
+            po::value<std::vector<fs::path>>()
                 ->value_name("path")
-                ->default_value("../src/models.hpp"),
-            "Path to device models file."
+                ->composing(),
+            "Technology file of .model cards, may be repeated (t180nm and t065nm are built in)."
+        )
+        (
+            "output,o",
+            po::value<fs::path>()
+                ->value_name("path"),
+            "Write transient waveforms to this csv file."
+        )
+        (
+            "cache,c",
+            po::value<fs::path>()
+                ->value_name("path"),
+            "Binary netlist image, reused while the design and its includes are unchanged."
+        )
+        (
+            "symbolic-cache",
+            po::value<fs::path>()
+                ->value_name("dir"),
+            "Directory of matrix orderings keyed by sparsity pattern, reused by circuits with the same structure."
+        )
+        (
+            "reduce,r",
+            po::value<std::string>()
+                ->value_name("tau"),
+            "Eliminate RC nodes with a time constant below tau (e.g. 1p) before simulating."
+        )
+        (
+            "liberty,l",
+            po::value<fs::path>()
+                ->value_name("path"),
+            "Write the timing tables of .char cards to this Liberty file instead of stdout."
+        )
+        (
+            "device-stats",
+            po::value<fs::path>()
+                ->value_name("path"),
+            "Write per-FET convergence counters to this csv file and log the worst devices (needs a CSIM_DEVICE_STATS build)."
+        )
+        (
+            "chord-log",
+            po::value<fs::path>()
+                ->value_name("path"),
+            "Write every --chord Newton iteration, whether it refactored and why, to this csv file."
+        )
+        (
+            "perf-counters",
+            po::value<fs::path>()
+                ->value_name("path"),
+            "Count cycles, instructions, cache and branch misses per Newton phase, log IPC and misses per device or matrix entry and write them to this csv file."
+        )
+        (
+            "checkpoint",
+            po::value<fs::path>()
+                ->value_name("path"),
+            "Snapshot long transients to this file so they can be continued with --resume."
+        )
+        (
+            "checkpoint-interval",
+            po::value<double>()
+                ->value_name("seconds")
+                ->default_value(600),
+            "Wall time between checkpoints."
+        )
+        (
+            "threads,j",
+            po::value<int>()
+                ->value_name("count")
+                ->default_value(0),
+            "Worker threads for partitioned solves, 0 uses every core."
+        )
+        (
+            "solver,s",
+            po::value<std::string>()
+                ->value_name("kind")
+                ->default_value("auto"),
+            "Linear solver: direct, iterative or auto (iterative for large circuits)."
         );
 
     std::string flags_header = cform::underline + "Flags" + cform::end;
     po::options_description* flg = ap.add_argument_group(flags_header);
     flg->add_options()
+        ("partition,p", "Solve channel-connected blocks separately with relaxation.")
+        ("multirate,m", "Freeze latent blocks during transients (implies --partition).")
+        ("mixed-precision", "Factor the Jacobian in single precision and refine solutions in double.")
+        ("chord", "Keep LU factors across Newton iterations and timesteps while Newton still converges fast.")
+        ("switch-level", "Replace FETs by piecewise-linear switch models for fast functional and power runs.")
+        ("switch-check", "Rerun every --switch-level transient on the full model and report the error.")
+        ("resume", "Continue the transient saved in --checkpoint instead of starting over.")
+        ("memory", "Log current and peak memory per subsystem at the end, and at the next transient point after SIGUSR1.")
+        ("dry-run", "Parse the design and set up its matrices, print the projected peak memory as csv and exit without simulating.")
         ("verbose,V", "Run in verbose mode.")
         ("quiet,Q", "Run in quiet mode.")
         ("help,h", "Print this help messagem and exit");
@@ -51,8 +159,499 @@ argparse getArgs(int argc, char** argv) {
     return ap;
 }
 
+void writeWaveforms(std::ostream &file, const Simulator &sim, const Simulator::Waveforms &waves, const std::string &axis = "time") {
+    file << axis;
+    for (int i = 0; i < sim.getSize(); i++) file << "," << sim.getName(i);
+    file << std::endl;
+    for (size_t n = 0; n < waves.time.size(); n++) {
+        file << waves.time[n];
+        for (auto value : waves.x[n]) file << "," << value;
+        file << std::endl;
+    }
+}
+
+void writeWaveforms(const fs::path &path, const Simulator &sim, const Simulator::Waveforms &waves, const std::string &axis = "time") {
+    std::ofstream file(path);
+    if (!file.is_open()) throw std::runtime_error("Failed to open file [ " + path.string() + " ]");
+    writeWaveforms(file, sim, waves, axis);
+}
+
+void printGradient(const Netlist &netlist, const std::string &title, const Sensitivity::Gradient &grad) {
+    std::cout << title << " = " << grad.value << std::endl;
+    std::set<int> techs;
+    for (size_t k = 0; k < netlist.getFets().size(); k++) {
+        std::cout << "  d/dW(" << netlist.getFetName(int(k)) << ") = " << grad.W[k] << std::endl;
+        techs.insert(netlist.getFets()[k].tech);
+    }
+    for (auto t : techs) {
+        auto &g = grad.tech[t];
+        auto &name = netlist.getTechName(t);
+        std::cout << "  d/dL(" << name << ") = " << g.L << std::endl;
+        std::cout << "  d/dTox(" << name << ") = " << g.Tox << std::endl;
+        std::cout << "  d/dLovl(" << name << ") = " << g.Lovl << std::endl;
+        std::cout << "  d/dVt(" << name << ") = " << g.Vt << std::endl;
+        std::cout << "  d/dMUn(" << name << ") = " << g.MUn << std::endl;
+        std::cout << "  d/dMUp(" << name << ") = " << g.MUp << std::endl;
+        std::cout << "  d/dLAMBDA(" << name << ") = " << g.LAMBDA << std::endl;
+        std::cout << "  d/dBETA(" << name << ") = " << g.BETA << std::endl;
+    }
+}
+
+// reruns a switch-level transient on the full model and logs how far the fast run was off
+void checkSwitchLevel(const Netlist &netlist, const Simulator &sim, const Simulator::Waveforms &waves, const MeasureEngine &measures,
+                      const std::vector<std::vector<std::string>> &measureCards, double tstep, double tstop, double seconds) {
+    auto fullOptions = sim.getOptions();
+    fullOptions.switchLevel = false;
+    Simulator full(netlist, fullOptions);
+    for (auto stimulus : sim.getStimuli()) full.addStimulus(stimulus);
+    MeasureEngine fullMeasures(full);
+    for (auto &card : measureCards) fullMeasures.add(card);
+    Simulator::StepCallback onAccept = nullptr;
+    if (!fullMeasures.empty()) onAccept = [&](double time, const std::vector<double> &x) { fullMeasures.accept(time, x); };
+    auto started = std::chrono::steady_clock::now();
+    auto reference = full.solveTransient(tstep, tstop, onAccept);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+
+    auto report = Accuracy::compare(sim, waves, reference);
+    std::ostringstream line;
+    line << "switch level vs full model: max error " << report.maxError * 1e3 << " mV";
+    if (!report.nodes.empty()) line << " on " << sim.getName(report.nodes[0].index) << " at " << report.nodes[0].time << " s";
+    line << ", rms " << report.rmsError * 1e3 << " mV, " << full.getStatistics().newtonIterations << " -> " << sim.getStatistics().newtonIterations
+         << " newton iterations, " << elapsed.count() / std::max(seconds, 1e-9) << "x faster";
+    Log.info(line.str());
+    for (size_t i = 1; i < std::min<size_t>(report.nodes.size(), 5); i++) {
+        std::ostringstream node;
+        node << "  " << sim.getName(report.nodes[i].index) << ": max " << report.nodes[i].maxError * 1e3 << " mV at " << report.nodes[i].time << " s, rms " << report.nodes[i].rmsError * 1e3 << " mV";
+        Log.verbose(node.str());
+    }
+    auto fast = measures.getResults(), exact = fullMeasures.getResults();
+    for (size_t i = 0; i < fast.size(); i++) {
+        std::ostringstream measure;
+        measure << "  " << fast[i].name << ": ";
+        if (fast[i].valid && exact[i].valid) {
+            measure << fast[i].value << " vs " << exact[i].value;
+            if (exact[i].value != 0.0) measure << " (" << 100.0 * (fast[i].value - exact[i].value) / std::abs(exact[i].value) << "%)";
+        } else {
+            measure << (fast[i].valid ? "ok" : "failed") << " vs " << (exact[i].valid ? "ok" : "failed");
+        }
+        Log.info(measure.str());
+    }
+}
+
+// the devices that cost the most Newton iterations and timestep cuts, and the full table as csv
+void reportDeviceStats(const fs::path &path, const Netlist &netlist, const DeviceStats &stats) {
+    const size_t shown = 10;
+    for (auto key : {DeviceStats::Key::Rejections, DeviceStats::Key::WorstResidual, DeviceStats::Key::Limited, DeviceStats::Key::Evaluations}) {
+        auto top = stats.top(key, shown);
+        if (top.empty()) continue;
+        std::stringstream line;
+        line << "most " << DeviceStats::getName(key) << ":";
+        for (auto fet : top) {
+            auto &c = stats.get()[size_t(fet)];
+            auto count = key == DeviceStats::Key::Rejections ? c.rejections : key == DeviceStats::Key::WorstResidual ? c.worstResidual : key == DeviceStats::Key::Limited ? c.limited : c.evaluations;
+            line << " " << netlist.getFetName(fet) << " (" << count << ")";
+        }
+        Log.info(line.str());
+    }
+    std::ofstream file(path);
+    if (!file.is_open()) throw std::runtime_error("Failed to open file [ " + path.string() + " ]");
+    stats.write(file, netlist);
+    if (!file) throw std::runtime_error("Failed to write file [ " + path.string() + " ]");
+}
+
+// per phase: time per unit, then IPC and misses per unit where the counters exist
+void reportKernelProfile(const fs::path &path, const KernelProfile &profile) {
+    for (auto phase : {KernelProfile::Phase::Devices, KernelProfile::Phase::Load, KernelProfile::Phase::Factor, KernelProfile::Phase::Solve}) {
+        auto &totals = profile.get(phase);
+        if (!totals.calls) continue;
+        auto unit = phase == KernelProfile::Phase::Devices ? "device" : "entry";
+        std::stringstream line;
+        line << KernelProfile::getName(phase) << ": " << totals.calls << " calls, " << totals.seconds << " s, " << totals.seconds / totals.units * 1e9 << " ns/" << unit;
+        if (profile.hasEvent(PerfCounters::Cycles) && profile.hasEvent(PerfCounters::Instructions)) line << ", IPC " << profile.getIpc(phase);
+        if (profile.hasEvent(PerfCounters::CacheMisses)) line << ", " << profile.getPerUnit(phase, PerfCounters::CacheMisses) << " cache misses/" << unit;
+        if (profile.hasEvent(PerfCounters::BranchMisses)) line << ", " << profile.getPerUnit(phase, PerfCounters::BranchMisses) << " branch misses/" << unit;
+        Log.info(line.str());
+    }
+    std::ofstream file(path);
+    if (!file.is_open()) throw std::runtime_error("Failed to open file [ " + path.string() + " ]");
+    profile.write(file);
+    if (!file) throw std::runtime_error("Failed to write file [ " + path.string() + " ]");
+}
+
+// current and peak bytes per subsystem, then the totals and the resident peak the OS saw
+void reportMemory(const MemoryReport &memory) {
+    std::stringstream line;
+    line << "memory:";
+    for (size_t s = 0; s < MemoryReport::SUBSYSTEMS; s++) {
+        auto subsystem = MemoryReport::Subsystem(s);
+        line << (s ? ", " : " ") << MemoryReport::getName(subsystem) << " " << MemoryReport::format(memory.getCurrent()[subsystem]);
+        line << " (peak " << MemoryReport::format(memory.getPeak()[subsystem]) << ")";
+    }
+    Log.info(line.str());
+    auto process = MemoryReport::getProcessPeak();
+    Log.info("memory: total " + MemoryReport::format(memory.getCurrent().getTotal()) + ", peak " + MemoryReport::format(memory.getPeakTotal()) +
+             (process ? ", process peak rss " + MemoryReport::format(process) : ""));
+}
+
+Simulator::LinearSolver parseSolver(const std::string &name) {
+    if (name == "auto") return Simulator::LinearSolver::Auto;
+    if (name == "direct") return Simulator::LinearSolver::Direct;
+    if (name == "iterative") return Simulator::LinearSolver::Iterative;
+    throw std::runtime_error("unknown linear solver [ " + name + " ]");
+}
+
 int run(argparse args) {
+    if (!args.flag("design")) Log.fatal("no design given, see --help", 1);
+    auto design = args.get<fs::path>("design");
+    std::vector<fs::path> techfiles;
+    if (args.flag("techfile")) techfiles = args.get<std::vector<fs::path>>("techfile");
+    Netlist netlist;
+    if (args.flag("cache")) {
+        bool hit;
+        std::string error;
+        netlist = NetlistCache::read(design, techfiles, args.get<fs::path>("cache"), &hit, &error);
+        if (!error.empty()) Log.warning("netlist not cached: " + error);
+        else Log.verbose(hit ? "netlist loaded from cache" : "netlist cache refreshed");
+    } else {
+        netlist = Netlist::read(design, techfiles);
+    }
+    if (args.flag("reduce")) {
+        RCReduction::Options reduction;
+        reduction.tau = Netlist::parseValue(args.get<std::string>("reduce"));
+        RCReduction::Report report;
+        netlist = RCReduction::reduce(netlist, reduction, &report);
+        Log.verbose("rc reduction: " + std::to_string(report.nodesBefore) + " -> " + std::to_string(report.nodesAfter) + " nodes, " +
+                    std::to_string(report.resistorsBefore + report.capacitorsBefore) + " -> " +
+                    std::to_string(report.resistorsAfter + report.capacitorsAfter) + " rc elements");
+    }
+
+    // stimulus files add their sources before any simulator is built on the netlist
+    std::vector<std::unique_ptr<Stimulus>> stimuli;
+    for (auto &analysis : netlist.getAnalyses()) {
+        if (analysis.type != "stimulus") continue;
+        auto stimulus = std::make_unique<Stimulus>(analysis.args[0], Stimulus::parse(std::vector<std::string>(analysis.args.begin() + 1, analysis.args.end())));
+        auto driven = stimulus->attach(netlist);
+        Log.verbose("stimulus " + analysis.args[0] + ": " + std::to_string(driven) + " inputs driven by " + std::to_string(stimulus->getSignals()) + " signals");
+        stimuli.push_back(std::move(stimulus));
+    }
+
+    // cell characterization runs on harnesses of its own, the deck is only a cell library
+    Characterizer characterizer(netlist, args.get<int>("threads"));
+    bool simulate = false;
+    for (auto &analysis : netlist.getAnalyses()) {
+        if (analysis.type == "char" || analysis.type == "chartable" || analysis.type == "corner") characterizer.add(analysis);
+        else if (analysis.type != "measure" && analysis.type != "stimulus") simulate = true;
+    }
+    if (!characterizer.empty() && args.flag("dry-run")) {
+        Log.warning("--dry-run does not project the harnesses of .char cards");
+    } else if (!characterizer.empty()) {
+        auto timings = characterizer.run();
+        Log.info("characterization: " + std::to_string(characterizer.getTransientCount()) + " transients");
+        if (args.flag("liberty")) {
+            std::ofstream file(args.get<fs::path>("liberty"));
+            if (!file.is_open()) throw std::runtime_error("Failed to open file [ " + args.get<fs::path>("liberty").string() + " ]");
+            characterizer.writeLiberty(file, timings);
+        } else {
+            characterizer.writeLiberty(std::cout, timings);
+        }
+        if (!simulate) return 0;
+    }
+
+    Simulator::Options options;
+    options.partition = args.flag("partition");
+    options.multirate = args.flag("multirate");
+    options.threads = args.get<int>("threads");
+    options.linearSolver = parseSolver(args.get<std::string>("solver"));
+    options.mixedPrecision = args.flag("mixed-precision");
+    options.switchLevel = args.flag("switch-level");
+    options.chord = args.flag("chord");
+    if (args.flag("symbolic-cache")) options.symbolicCache = args.get<fs::path>("symbolic-cache").string();
+    if (args.flag("device-stats") && !DeviceStats::ENABLED) Log.fatal("--device-stats needs a build configured with -DCSIM_DEVICE_STATS=ON", 1);
+    Simulator sim(netlist, options);
+    for (auto &stimulus : stimuli) sim.addStimulus(stimulus.get());
+
+    // the netlist does not change from here on, the simulators are measured whenever sampled.
+    // the first sample is the matrix setup, which may hold more than the run that follows.
+    MemoryReport memory;
+    MemoryReport::Usage netlistUsage;
+    auto trackMemory = args.flag("memory") || args.flag("dry-run");
+    if (trackMemory) {
+        netlist.getMemory(netlistUsage);
+        auto setup = netlistUsage;
+        setup[MemoryReport::Subsystem::Matrix] += sim.getSymbolicPeak();
+        memory.record(setup);
+    }
+    if (args.flag("memory")) std::signal(SIGUSR1, [](int) { memoryRequested = 1; });
+    Log.verbose(std::string("linear solver: ") + (sim.isIterative() ? "ILU(0) preconditioned GMRES" : "sparse LU"));
+    if (!sim.getSymbolicCacheError().empty()) Log.warning("matrix ordering not cached: " + sim.getSymbolicCacheError());
+    else if (!options.symbolicCache.empty()) Log.verbose(sim.isSymbolicCached() ? "matrix ordering loaded from cache" : "matrix ordering cached");
+    if (options.partition || options.multirate) Log.verbose("partitioned into " + std::to_string(sim.getBlockGroups()) + " block groups");
+    std::ofstream chordLog;
+    if (args.flag("chord-log")) {
+        if (!options.chord) Log.warning("--chord-log has no effect without --chord");
+        chordLog.open(args.get<fs::path>("chord-log"));
+        if (!chordLog.is_open()) throw std::runtime_error("Failed to open file [ " + args.get<fs::path>("chord-log").string() + " ]");
+        sim.setChordLog(&chordLog);
+    }
+    std::unique_ptr<KernelProfile> profile;
+    if (args.flag("perf-counters")) {
+        profile = std::make_unique<KernelProfile>();
+        if (!profile->hasCounters()) Log.warning("hardware counters unavailable (" + profile->getError() + "), --perf-counters reports calls and time only");
+        sim.setKernelProfile(profile.get());
+    }
+    Simulator::Waveforms waves;
+
+    // measurements are evaluated and --output is written while the transient runs, so waveforms
+    // are only kept in memory when something downstream needs all of them
+    MeasureEngine measures(sim);
+    ProbeWriter probes(sim);
+    std::vector<std::vector<std::string>> measureCards;
+    auto switchCheck = options.switchLevel && args.flag("switch-check");
+    bool keepWaveforms = switchCheck;
+    for (auto &analysis : netlist.getAnalyses()) {
+        if (analysis.type == "measure") {
+            measures.add(analysis.args);
+            measureCards.push_back(analysis.args);
+        }
+        if (analysis.type == "probe") probes.add(analysis.args);
+        if (analysis.type == "sens" && !analysis.args.empty() && analysis.args[0] == "tran") keepWaveforms = true;
+    }
+    if (!probes.empty()) {
+        if (args.flag("output")) Log.verbose("probes: " + std::to_string(probes.getSignalCount()) + " signals");
+        else Log.warning(".probe selects what --output writes and has no effect without it");
+    }
+
+    // .op and .tran may pick their own linear solver with a trailing solver=<kind>. the matrix
+    // pattern depends on it, so that analysis runs on a simulator of its own.
+    std::map<Simulator::LinearSolver, std::unique_ptr<Simulator>> others;
+    auto simulatorFor = [&](Simulator::LinearSolver kind) -> Simulator & {
+        if (kind == options.linearSolver) return sim;
+        if (kind != Simulator::LinearSolver::Auto && sim.isIterative() == (kind == Simulator::LinearSolver::Iterative)) return sim;
+        auto &other = others[kind];
+        if (!other) {
+            auto otherOptions = options;
+            otherOptions.linearSolver = kind;
+            other = std::make_unique<Simulator>(netlist, otherOptions);
+            for (auto &stimulus : stimuli) other->addStimulus(stimulus.get());
+            other->setKernelProfile(profile.get());
+        }
+        return *other;
+    };
+
+    // waveforms: in-flight rows of the running transient plus the ones held from the last
+    size_t transientRows = 0;
+    auto sampleMemory = [&](bool projected) {
+        auto usage = netlistUsage;
+        sim.getMemory(usage, projected);
+        for (auto &other : others) other.second->getMemory(usage, projected);
+        usage[MemoryReport::Subsystem::Waveforms] += MemoryReport::waveformBytes(transientRows + waves.time.size(), size_t(sim.getSize()));
+        memory.record(usage);
+        if (memoryRequested) {
+            memoryRequested = 0;
+            reportMemory(memory);
+        }
+    };
+
+    // --dry-run builds every simulator the analyses will use, which includes their symbolic
+    // analysis, and projects what they hold once factored. transients whose points are kept
+    // count with their fewest points; the largest two count, as a transient's waveforms are
+    // replaced only once the next one has finished.
+    if (args.flag("dry-run")) {
+        std::vector<size_t> kept;
+        for (auto &analysis : netlist.getAnalyses()) {
+            auto argv = analysis.args;
+            auto solver = options.linearSolver;
+            if (!argv.empty() && argv.back().rfind("solver=", 0) == 0) {
+                solver = parseSolver(argv.back().substr(7));
+                argv.pop_back();
+            }
+            if (analysis.type == "sens") simulatorFor(Simulator::LinearSolver::Direct);
+            if (analysis.type != "op" && analysis.type != "dc" && analysis.type != "tran") continue;
+            auto &target = simulatorFor(solver);
+            if (analysis.type == "tran" && keepWaveforms && argv.size() >= 2) {
+                kept.push_back(target.getMinimumPoints(Netlist::parseValue(argv[0]), Netlist::parseValue(argv[1])));
+            }
+        }
+        std::sort(kept.rbegin(), kept.rend());
+        for (size_t k = 0; k < std::min<size_t>(kept.size(), 2); k++) transientRows += kept[k];
+        sampleMemory(true);
+        memory.write(std::cout);
+        Log.info("projected peak memory: " + MemoryReport::format(memory.getPeakTotal()));
+        return 0;
+    }
+
+    // a resumed run skips the transients finished before the snapshot was taken
+    if (args.flag("resume") && !args.flag("checkpoint")) Log.fatal("--resume needs --checkpoint", 1);
+    auto resumeCard = args.flag("resume") ? Checkpoint::getAnalysis(args.get<fs::path>("checkpoint")) : -1;
+
+    auto &analyses = netlist.getAnalyses();
+    for (size_t card = 0; card < analyses.size(); card++) {
+        if (trackMemory) sampleMemory(false);
+        auto &analysis = analyses[card];
+        auto argv = analysis.args;
+        auto solver = options.linearSolver;
+        if (!argv.empty() && argv.back().rfind("solver=", 0) == 0) {
+            solver = parseSolver(argv.back().substr(7));
+            argv.pop_back();
+        }
+        if (analysis.type == "op") {
+            auto &sim = simulatorFor(solver);
+            auto x = sim.solveOperatingPoint();
+            for (int i = 0; i < sim.getSize(); i++) std::cout << sim.getName(i) << " = " << x[i] << std::endl;
+
+        } else if (analysis.type == "dc") {
+            // the sweep goes to --output when given (a later .tran overwrites it), else stdout
+            auto &sim = simulatorFor(solver);
+            DCSweep sweep(netlist, DCSweep::parse(netlist, argv), sim.getOptions());
+            auto curves = sweep.run();
+            auto &stats = sweep.getStatistics();
+            Log.info("dc sweep: " + std::to_string(stats.points) + " points, " + std::to_string(stats.newtonIterations) + " newton iterations");
+            Log.verbose("continuation: " + std::to_string(stats.segments) + " segments, " + std::to_string(stats.substeps) + " substeps, " + std::to_string(stats.coldStarts) + " cold starts");
+            if (args.flag("output")) writeWaveforms(args.get<fs::path>("output"), sim, curves, argv[0]);
+            else writeWaveforms(std::cout, sim, curves, argv[0]);
+
+        } else if (analysis.type == "tran") {
+            if (argv.size() < 2) Log.fatal(".tran expects <tstep> <tstop>", 1);
+            if (int(card) < resumeCard) continue;
+            auto resuming = int(card) == resumeCard;
+            if (resuming && keepWaveforms) Log.fatal(".sens tran and --switch-check need the whole transient and cannot follow a resumed one", 1);
+            auto &sim = simulatorFor(solver);
 
+            // the csv is flushed with every snapshot and cut back to that length on resume
+            std::ofstream stream;
+            uintmax_t streamed = 0;
+            std::unique_ptr<Checkpoint> checkpoint;
+            Simulator::TransientState state;
+            if (args.flag("checkpoint")) {
+                checkpoint = std::make_unique<Checkpoint>(args.get<fs::path>("checkpoint"), args.get<double>("checkpoint-interval"));
+                checkpoint->setAnalysis(int(card));
+                checkpoint->addClient({[&]() { return measures.getState(); }, [&](const std::vector<double> &s) { measures.setState(s); }});
+                checkpoint->addClient({[&]() { stream.flush(); return std::vector<double>{stream.is_open() ? double(stream.tellp()) : 0.0}; },
+                                       [&](const std::vector<double> &s) { streamed = s.empty() ? 0 : uintmax_t(s[0]); }});
+                checkpoint->addClient({[&]() { return probes.getState(); }, [&](const std::vector<double> &s) { probes.setState(s); }});
+                if (resuming) {
+                    checkpoint->restore(sim, state);
+                    Log.info("resuming transient at t = " + std::to_string(state.t));
+                }
+                sim.setCheckpoint(checkpoint.get());
+            }
+            if (args.flag("output")) {
+                auto path = args.get<fs::path>("output");
+                if (resuming) {
+                    fs::resize_file(path, streamed);
+                    stream.open(path, std::ios::app);
+                } else {
+                    stream.open(path);
+                }
+                if (!stream.is_open()) throw std::runtime_error("Failed to open file [ " + path.string() + " ]");
+                if (!resuming && !probes.empty()) {
+                    ProbeWriter::writeHeader(stream);
+                } else if (!resuming) {
+                    stream << "time";
+                    for (int i = 0; i < sim.getSize(); i++) stream << "," << sim.getName(i);
+                    stream << '\n';
+                }
+            }
+            // each card measures its own run, a resumed one gets its partial values from the snapshot
+            if (!resuming) {
+                measures.reset();
+                probes.reset();
+            }
+
+            Simulator::StepCallback onAccept = nullptr;
+            if (!measures.empty() || stream.is_open() || trackMemory) onAccept = [&](double time, const std::vector<double> &x) {
+                if (trackMemory) {
+                    if (keepWaveforms) transientRows++;
+                    sampleMemory(false);
+                }
+                if (!measures.empty()) measures.accept(time, x);
+                if (!stream.is_open()) return;
+                if (!probes.empty()) {
+                    probes.accept(time, x, stream);
+                    return;
+                }
+                stream << time;
+                for (auto value : x) stream << "," << value;
+                stream << '\n';
+            };
+            auto tstep = Netlist::parseValue(argv[0]), tstop = Netlist::parseValue(argv[1]);
+            auto started = std::chrono::steady_clock::now();
+            if (resuming) waves = sim.resumeTransient(state, onAccept, keepWaveforms);
+            else waves = sim.solveTransient(tstep, tstop, onAccept, keepWaveforms);
+            transientRows = 0;
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+            if (checkpoint) {
+                sim.setCheckpoint(nullptr);
+                checkpoint->flush();
+                Log.verbose("checkpoint: " + std::to_string(checkpoint->getWritten()) + " snapshots written");
+            }
+            if (stream.is_open() && !probes.empty()) {
+                probes.finish(stream);
+                Log.verbose("probes: " + std::to_string(probes.getStored()) + " of " + std::to_string(probes.getSamples()) + " points stored");
+            }
+            stream.close();
+            if (args.flag("output") && !stream) throw std::runtime_error("Failed to write file [ " + args.get<fs::path>("output").string() + " ]");
+            auto &stats = sim.getStatistics();
+            Log.info("transient: " + std::to_string(stats.acceptedSteps) + " accepted / " + std::to_string(stats.rejectedSteps) + " rejected steps");
+            if (options.partition || options.multirate) Log.verbose("relaxation: " + std::to_string(stats.relaxationSweeps) + " sweeps, " + std::to_string(stats.partitionFallbacks) + " full-matrix fallbacks");
+            if (options.multirate) Log.verbose("multirate: " + std::to_string(stats.latentSkips) + " latent block solves skipped");
+            if (sim.isIterative()) Log.verbose("gmres: " + std::to_string(stats.krylovIterations) + " iterations");
+            if (options.mixedPrecision) Log.verbose("mixed precision: " + std::to_string(stats.refinementSteps) + " refinement steps");
+            for (auto &stimulus : stimuli) Log.verbose("stimulus: " + std::to_string(stimulus->getEdges()) + " edges applied");
+            if (options.chord) {
+                std::string reasons;
+                for (auto reason : {Simulator::Refactor::Fresh, Simulator::Refactor::Timestep, Simulator::Refactor::Region, Simulator::Refactor::Contraction, Simulator::Refactor::Limited}) {
+                    reasons += (reasons.empty() ? "" : ", ") + std::to_string(stats.refactors[size_t(reason)]) + " " + Simulator::getName(reason);
+                }
+                Log.verbose("chord: " + std::to_string(stats.newtonIterations) + " Newton iterations, " + std::to_string(stats.factorizations) + " factorizations (" + reasons + "), " + std::to_string(stats.reusedFactorizations) + " reused");
+            }
+            if (options.switchLevel) Log.verbose("switch level: " + std::to_string(stats.regionChanges) + " region changes, " + std::to_string(stats.factorizations) + " factorizations, " + std::to_string(stats.reusedFactorizations) + " reused");
+            for (auto &result : measures.getResults()) {
+                std::cout << result.name << " = ";
+                if (result.valid) std::cout << result.value << std::endl;
+                else std::cout << "failed" << std::endl;
+            }
+            if (switchCheck) checkSwitchLevel(netlist, sim, waves, measures, measureCards, tstep, tstop, elapsed.count());
+
+        } else if (analysis.type == "sens") {
+            // .sens dc <output> | .sens tran <output> [final|integral|cross=<value>]
+            if (argv.size() < 2) Log.fatal(".sens expects <dc|tran> <output>", 1);
+            // the adjoint needs exact transposed solves
+            auto &sim = simulatorFor(Simulator::LinearSolver::Direct);
+            auto output = sim.getIndex(argv[1]);
+            Sensitivity sens(sim);
+            if (argv[0] == "dc") {
+                printGradient(netlist, argv[1], sens.solveOperatingPoint(output, sim.solveOperatingPoint()));
+            } else if (argv[0] == "tran") {
+                if (waves.time.empty()) Log.fatal(".sens tran requires a preceding .tran card", 1);
+                auto mode = argv.size() > 2 ? argv[2] : "final";
+                if (mode == "integral") {
+                    printGradient(netlist, "integral of " + argv[1], sens.solveTransient(output, Sensitivity::Measure::Integral, waves));
+                } else if (mode.rfind("cross=", 0) == 0) {
+                    auto threshold = Netlist::parseValue(mode.substr(6));
+                    printGradient(netlist, "crossing of " + argv[1] + " through " + mode.substr(6), sens.solveTransient(output, Sensitivity::Measure::Crossing, waves, threshold));
+                } else if (mode == "final") {
+                    printGradient(netlist, "final " + argv[1], sens.solveTransient(output, Sensitivity::Measure::Final, waves));
+                } else {
+                    Log.fatal("unknown .sens tran objective [ " + mode + " ]", 1);
+                }
+            } else {
+                Log.fatal("unknown .sens mode [ " + argv[0] + " ]", 1);
+            }
+        }
+    }
+
+    // partitioned blocks keep counters of their own, these cover the full-matrix solves
+    if (args.flag("device-stats")) {
+        auto stats = sim.getDeviceStats();
+        for (auto &other : others) stats.add(other.second->getDeviceStats());
+        reportDeviceStats(args.get<fs::path>("device-stats"), netlist, stats);
+    }
+    if (profile) reportKernelProfile(args.get<fs::path>("perf-counters"), *profile);
+    if (args.flag("memory")) {
+        sampleMemory(false);
+        reportMemory(memory);
+    }
     return 0;
 }
 
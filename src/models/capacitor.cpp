@@ -0,0 +1,9 @@
+#include "capacitor.hpp"
+
+double Capacitor::getCharge(double C, double V) {
+    return C * V;
+}
+
+double Capacitor::getTransientCurrent(double C, double dV_dt) {
+    return C * dV_dt;
+}
@@ -1,10 +1,17 @@
 #include "models.hpp"
 
 double ModelUtils::sigmoid(double beta, double gamma) {
-    gamma = gamma + 0.04;
+    gamma = gamma + GAMMA_OFFSET;
     return 1.0 / (1.0 + std::exp(-beta * gamma));
 }
 
+std::pair<double, double> ModelUtils::sigmoid_partials(double beta, double gamma) {
+    // returns (d/d_beta, d/d_gamma) of sigmoid(beta, gamma)
+    auto alpha = sigmoid(beta, gamma);
+    auto slope = alpha * (1.0 - alpha);
+    return std::make_pair((gamma + GAMMA_OFFSET) * slope, beta * slope);
+}
+
 double ModelUtils::fx_smooth(double beta, double gamma, double fx1, double fx2) {
     auto alpha = sigmoid(beta, gamma);
     return alpha * fx1 + (1 - alpha) * fx2;
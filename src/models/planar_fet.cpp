@@ -3,6 +3,26 @@
 const PlanarFET::Tech PlanarFET::t180nm = {180e-9, 5e-9, 15e-9, 0.4, 35e-3, 15e-3, 0.015, 100};
 const PlanarFET::Tech PlanarFET::t065nm = {65e-9, 2.5e-9, 10e-9, 0.25, 45e-3, 25e-3, 0.02, 200};
 
+void PlanarFET::Tech::update() {
+    Cox = SiConstants::EPSox / Tox;
+    Covl = SiConstants::EPSox * Lovl / Tox;
+    KPn = MUn * Cox / L;
+    KPp = MUp * Cox / L;
+    CoxL = Cox * L;
+    BETAoffset = BETA * ModelUtils::GAMMA_OFFSET;
+}
+
+double PlanarFET::_getAlpha(const Tech &tech, double gamma) {
+    // ModelUtils::sigmoid with the constant part of the exponent taken from the tech
+    return 1.0 / (1.0 + std::exp(-(tech.BETA * gamma + tech.BETAoffset)));
+}
+
+double PlanarFET::_smooth(const Tech &tech, double gamma, double fx1, double fx2) {
+    // ModelUtils::fx_smooth using the precomputed sigmoid constants
+    auto alpha = _getAlpha(tech, gamma);
+    return alpha * fx1 + (1 - alpha) * fx2;
+}
+
 double PlanarFET::_getGamma(const Tech &tech, double Vgs, double Vds, ModelUtils::DevType devType) {
     // sigmoid(x) value
     return (Vds - Vgs + tech.Vt);
@@ -29,25 +49,23 @@ bool PlanarFET::_inSaturation(const Tech &tech, double Vgs, double Vds, ModelUti
 double PlanarFET::_getId_lin(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType) {
     // get current through device in linear mode
     // assumes Vgs and Vds values are pre-negated for p-type devices
-    auto mu = (devType == ModelUtils::DevType::N) ? tech.MUn : tech.MUp;
-    return _isConducting(tech, Vgs, devType) ? mu * tech.Cox * (W/tech.L) * ((Vgs - tech.Vt) * Vds - (std::pow(Vds, 2) / 2)) * (1 + tech.LAMBDA * Vds) : 0.0;
+    return _isConducting(tech, Vgs, devType) ? _getKP(tech, devType) * W * ((Vgs - tech.Vt) * Vds - (Vds * Vds / 2)) * (1 + tech.LAMBDA * Vds) : 0.0;
 }
 
 double PlanarFET::_getId_sat(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType) {
     // get current through device in saturation mode
     // assumes Vgs and Vds values are pre-negated for p-type devices
-    auto mu = (devType == ModelUtils::DevType::N) ? tech.MUn : tech.MUp;
-    return _isConducting(tech, Vgs, devType) ? 0.5 * mu * tech.Cox * (W/tech.L) * std::pow(Vgs - tech.Vt, 2) * (1 + tech.LAMBDA * Vds) : 0.0;
+    auto Vov = Vgs - tech.Vt;
+    return _isConducting(tech, Vgs, devType) ? 0.5 * _getKP(tech, devType) * W * Vov * Vov * (1 + tech.LAMBDA * Vds) : 0.0;
 }
 
 double PlanarFET::_getGm_lin(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType, bool useAnalyticModel) {
     // get transconductance of device in linear mode
     // assumes Vgs and Vds values are pre-negated for p-type devices
-    auto mu = (devType == ModelUtils::DevType::N) ? tech.MUn : tech.MUp;
     double Gm = 0.0;
     if (_isConducting(tech, Vgs, devType)) {
         if (useAnalyticModel) {
-            Gm = mu * tech.Cox * (W/tech.L) * Vds;
+            Gm = _getKP(tech, devType) * W * Vds;
         } else {
             double Vgs_delta = std::max(0.01 * tech.Vt, 1e-3);
             auto Id_0 = _getId_lin(tech, W, Vgs, Vds, devType);
@@ -61,11 +79,10 @@ double PlanarFET::_getGm_lin(const Tech &tech, double W, double Vgs, double Vds,
 double PlanarFET::_getGm_sat(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType, bool useAnalyticModel) {
     // get transconductance of device in saturation mode
     // assumes Vgs and Vds values are pre-negated for p-type devices
-    auto mu = (devType == ModelUtils::DevType::N) ? tech.MUn : tech.MUp;
     double Gm = 0.0;
     if (_isConducting(tech, Vgs, devType)) {
         if (useAnalyticModel) {
-            Gm = mu * tech.Cox * (W/tech.L) * (Vgs - tech.Vt);
+            Gm = _getKP(tech, devType) * W * (Vgs - tech.Vt);
         } else {
             double Vgs_delta = std::max(0.01 * tech.Vt, 1e-3);
             auto Id_0 = _getId_sat(tech, W, Vgs, Vds, devType);
@@ -79,25 +96,25 @@ double PlanarFET::_getGm_sat(const Tech &tech, double W, double Vgs, double Vds,
 double PlanarFET::_getCgs_lin(const Tech &tech, double W) {
     // get channel cap value between gate and source in linear mode
     // assumes Vgs and Vds values are pre-negated for p-type devices
-    return 0.5 * tech.Cox * W * tech.L;
+    return 0.5 * tech.CoxL * W;
 }
 
 double PlanarFET::_getCgs_sat(const Tech &tech, double W) {
     // get channel cap value between gate and source in saturation mode
     // assumes Vgs and Vds values are pre-negated for p-type devices
-    return (2.0 / 3.0) * tech.Cox * W * tech.L;
+    return (2.0 / 3.0) * tech.CoxL * W;
 }
 
 double PlanarFET::_getCgd_lin(const Tech &tech, double W) {
     // get channel cap value between gate and drain in linear mode
     // assumes Vgs and Vds values are pre-negated for p-type devices
-    return 0.5 * tech.Cox * W * tech.L;
+    return 0.5 * tech.CoxL * W;
 }
 
 double PlanarFET::_getCgd_sat(const Tech &tech, double W) {
     // get channel cap value between gate and drain in saturation mode
     // assumes Vgs and Vds values are pre-negated for p-type devices
-    return (1.0 / 3.0) * tech.Cox * W * tech.L;
+    return (1.0 / 3.0) * tech.CoxL * W;
 }
 
 double PlanarFET::getId(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType) {
@@ -107,7 +124,7 @@ double PlanarFET::getId(const Tech &tech, double W, double Vgs, double Vds, Mode
     auto Id_lin = _getId_lin(tech, W, normVgs, normVds, devType);
     auto Id_sat = _getId_sat(tech, W, normVgs, normVds, devType);
     auto gamma = _getGamma(tech, normVgs, normVds, devType);
-    return ModelUtils::fx_smooth(tech.BETA, gamma, Id_sat, Id_lin);
+    return _smooth(tech, gamma, Id_sat, Id_lin);
 }
 
 double PlanarFET::getGm(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType, bool useAnalyticModel) {
@@ -120,7 +137,7 @@ double PlanarFET::getGm(const Tech &tech, double W, double Vgs, double Vds, Mode
             auto gm_lin = _getGm_lin(tech, W, normVgs, normVds, devType);
             auto gm_sat = _getGm_sat(tech, W, normVgs, normVds, devType);
             auto gamma = _getGamma(tech, normVgs, normVds, devType);
-            Gm = ModelUtils::fx_smooth(tech.BETA, gamma, gm_sat, gm_lin);
+            Gm = _smooth(tech, gamma, gm_sat, gm_lin);
         } else {
             // dynamically choosing Vgs so that smaller devices are not over impacted
             // choosing a minimum value of 100nV to maintain numerical stability
@@ -143,7 +160,7 @@ double PlanarFET::getCgs(const Tech &tech, double W, double Vgs, double Vds, Mod
         auto Cgs_lin = _getCgs_lin(tech, (W - tech.Lovl)) + tech.Covl;
         auto Cgs_sat = _getCgs_sat(tech, (W - tech.Lovl)) + tech.Covl;
         auto gamma = _getGamma(tech, normVgs, normVds, devType);
-        Cgs = ModelUtils::fx_smooth(tech.BETA, gamma, Cgs_sat, Cgs_lin);
+        Cgs = _smooth(tech, gamma, Cgs_sat, Cgs_lin);
     }
     return Cgs;
 }
@@ -157,18 +174,17 @@ double PlanarFET::getCgd(const Tech &tech, double W, double Vgs, double Vds, Mod
         auto Cgd_lin = _getCgd_lin(tech, (W - tech.Lovl)) + tech.Covl;
         auto Cgd_sat = _getCgd_sat(tech, (W - tech.Lovl)) + tech.Covl;
         auto gamma = _getGamma(tech, normVgs, normVds, devType);
-        Cgd = ModelUtils::fx_smooth(tech.BETA, gamma, Cgd_sat, Cgd_lin);
+        Cgd = _smooth(tech, gamma, Cgd_sat, Cgd_lin);
     }
     return Cgd;
 }
 
 double PlanarFET::getTransientCurrent(const Tech &tech, double W, double Vgs, double Vds, double dVgs_dt, double dVds_dt, ModelUtils::DevType devType) {
-    // get instantaneous current
+    // get current into the drain terminal, channel current plus dQd/dt
     // values perform p-type negation as needed
     auto Id = getId(tech, W, Vgs, Vds, devType);
-    auto Cgs = getCgs(tech, W, Vgs, Vds, devType);
-    auto Cgd = getCgd(tech, W, Vgs, Vds, devType);
-    return Id + Cgs * dVgs_dt + Cgd * dVds_dt;
+    auto Qd = getCharges(tech, W, Vgs, Vds, devType).Qd;
+    return Id + Qd.dVgs * dVgs_dt + Qd.dVds * dVds_dt;
 }
 
 double PlanarFET::getInstantaneousPower(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType) {
@@ -176,3 +192,148 @@ double PlanarFET::getInstantaneousPower(const Tech &tech, double W, double Vgs,
     // getId() handles p-type negation
     return (devType == ModelUtils::DevType::N ? Vds : -Vds) * getId(tech, W, Vgs, Vds, devType);
 }
+
+PlanarFET::Derivatives PlanarFET::getIdDerivatives(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType) {
+    // get current through device along with its analytic partial derivatives
+    // mirrors getId(); voltage partials are w.r.t. the un-normalized Vgs and Vds
+    Derivatives Id = {};
+    auto [normVgs, normVds] = _normalizeVoltages(Vgs, Vds, devType);
+    if (!_isConducting(tech, normVgs, devType)) return Id;
+
+    auto sign = (devType == ModelUtils::DevType::N) ? 1.0 : -1.0;
+    auto mu = (devType == ModelUtils::DevType::N) ? tech.MUn : tech.MUp;
+    auto k = _getKP(tech, devType) * W;
+    auto Vov = normVgs - tech.Vt;
+    auto clm = 1 + tech.LAMBDA * normVds;
+    auto shape = Vov * normVds - (normVds * normVds / 2);
+    auto Id_lin = k * shape * clm;
+    auto Id_sat = 0.5 * k * Vov * Vov * clm;
+
+    auto gamma = _getGamma(tech, normVgs, normVds, devType);
+    auto alpha = _getAlpha(tech, gamma);
+    auto slope = alpha * (1.0 - alpha);
+    auto dAlpha_dBeta = (gamma + ModelUtils::GAMMA_OFFSET) * slope, dAlpha_dGamma = tech.BETA * slope;
+    auto blend = [&](double dLin, double dSat, double dGamma) {
+        return alpha * dSat + (1 - alpha) * dLin + (Id_sat - Id_lin) * dAlpha_dGamma * dGamma;
+    };
+
+    Id.value = alpha * Id_sat + (1 - alpha) * Id_lin;
+    Id.dVgs = sign * blend(k * normVds * clm, k * Vov * clm, -1.0);
+    Id.dVds = sign * blend(k * (Vov - normVds) * clm + k * shape * tech.LAMBDA, 0.5 * k * Vov * Vov * tech.LAMBDA, 1.0);
+    Id.dVt = blend(-k * normVds * clm, -k * Vov * clm, 1.0);
+    Id.dLAMBDA = blend(k * shape * normVds, 0.5 * k * Vov * Vov * normVds, 0.0);
+    Id.dBETA = (Id_sat - Id_lin) * dAlpha_dBeta;
+
+    // both branches scale with mu*Cox*W/L, and Cox scales with 1/Tox
+    Id.dW = Id.value / W;
+    Id.dMU = Id.value / mu;
+    Id.dL = -Id.value / tech.L;
+    Id.dTox = -Id.value / tech.Tox;
+    return Id;
+}
+
+PlanarFET::Derivatives PlanarFET::_getCapDerivatives(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType, double linFactor, double satFactor) {
+    // shared implementation of getCgs/getCgd derivatives, linFactor/satFactor being the
+    // fraction of the channel charge assigned to the terminal in each region
+    Derivatives C = {};
+    C.value = tech.Covl;
+    C.dTox = -tech.Covl / tech.Tox;
+    C.dLovl = tech.Cox;
+    if (!_isConducting(tech, Vgs, devType)) return C;
+
+    auto [normVgs, normVds] = _normalizeVoltages(Vgs, Vds, devType);
+    auto sign = (devType == ModelUtils::DevType::N) ? 1.0 : -1.0;
+    auto Weff = W - tech.Lovl;
+    auto C_lin = linFactor * tech.CoxL * Weff + tech.Covl;
+    auto C_sat = satFactor * tech.CoxL * Weff + tech.Covl;
+
+    auto gamma = _getGamma(tech, normVgs, normVds, devType);
+    auto alpha = _getAlpha(tech, gamma);
+    auto slope = alpha * (1.0 - alpha);
+    auto dAlpha_dBeta = (gamma + ModelUtils::GAMMA_OFFSET) * slope, dAlpha_dGamma = tech.BETA * slope;
+    auto factor = alpha * satFactor + (1 - alpha) * linFactor;
+
+    C.value = alpha * C_sat + (1 - alpha) * C_lin;
+    C.dVgs = -sign * (C_sat - C_lin) * dAlpha_dGamma;
+    C.dVds = sign * (C_sat - C_lin) * dAlpha_dGamma;
+    C.dVt = (C_sat - C_lin) * dAlpha_dGamma;
+    C.dBETA = (C_sat - C_lin) * dAlpha_dBeta;
+    C.dW = factor * tech.CoxL;
+    C.dL = factor * tech.Cox * Weff;
+    C.dLovl = -factor * tech.CoxL + tech.Cox;
+    C.dTox = -C.value / tech.Tox;
+    return C;
+}
+
+PlanarFET::Derivatives PlanarFET::getCgsDerivatives(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType) {
+    // get gate-source cap along with its analytic partial derivatives, mirrors getCgs()
+    return _getCapDerivatives(tech, W, Vgs, Vds, devType, 0.5, 2.0 / 3.0);
+}
+
+PlanarFET::Derivatives PlanarFET::getCgdDerivatives(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType) {
+    // get gate-drain cap along with its analytic partial derivatives, mirrors getCgd()
+    return _getCapDerivatives(tech, W, Vgs, Vds, devType, 0.5, 1.0 / 3.0);
+}
+
+PlanarFET::Region PlanarFET::getRegion(const Tech &tech, double Vgs, double Vds, ModelUtils::DevType devType) {
+    // both checks take n-type voltages, so p-type ones are normalized first
+    auto [normVgs, normVds] = _normalizeVoltages(Vgs, Vds, devType);
+    if (!_isConducting(tech, normVgs, ModelUtils::DevType::N)) return Region::Off;
+    return _inSaturation(tech, normVgs, normVds, ModelUtils::DevType::N) ? Region::Saturation : Region::Linear;
+}
+
+PlanarFET::Charges PlanarFET::getCharges(const Tech &tech, double W, double Vgs, double Vds, ModelUtils::DevType devType) {
+    // get terminal charges along with their analytic partial derivatives
+    // the channel holds CoxL * (W - Lovl) * Vov, with Vov a softplus of Vgs - Vt whose corner is
+    // 1/BETA wide so the gate capacitance turns on smoothly. drain and source take half of it
+    // each in every region: a share that moves from 1/2 to 1/3 with the getId() sigmoid dumps
+    // Qch/6 onto the drain within a few BETA of the saturation edge, which the timestep control
+    // then has to resolve. the overlaps are linear caps to source and drain.
+    auto [normVgs, normVds] = _normalizeVoltages(Vgs, Vds, devType);
+    auto sign = (devType == ModelUtils::DevType::N) ? 1.0 : -1.0;
+    auto Weff = W - tech.Lovl;
+    auto Vgd = normVgs - normVds;
+
+    auto x = tech.BETA * (normVgs - tech.Vt);
+    auto on = 1.0 / (1.0 + std::exp(-x));
+    auto Vov = (x > 0.0 ? x + std::log1p(std::exp(-x)) : std::log1p(std::exp(x))) / tech.BETA;
+    auto Qch = tech.CoxL * Weff * Vov;
+    auto Cch = tech.CoxL * Weff * on;
+    auto dVov_dBeta = ((normVgs - tech.Vt) * on - Vov) / tech.BETA;
+    constexpr double share = 0.5;
+
+    // n-type charges and partials, p-type ones are mirrored below
+    Charges Q = {};
+    auto &Qg = Q.Qg, &Qd = Q.Qd, &Qs = Q.Qs;
+    Qg.value = Qch + tech.Covl * (normVgs + Vgd);
+    Qg.dVgs = Cch + 2.0 * tech.Covl;
+    Qg.dVds = -tech.Covl;
+    Qg.dW = tech.CoxL * Vov;
+    Qg.dL = tech.Cox * Weff * Vov;
+    Qg.dTox = -Qg.value / tech.Tox;
+    Qg.dLovl = -tech.CoxL * Vov + tech.Cox * (normVgs + Vgd);
+    Qg.dVt = -Cch;
+    Qg.dBETA = tech.CoxL * Weff * dVov_dBeta;
+
+    Qd.value = -share * Qch - tech.Covl * Vgd;
+    Qd.dVgs = -share * Cch - tech.Covl;
+    Qd.dVds = tech.Covl;
+    Qd.dW = -share * Qg.dW;
+    Qd.dL = -share * Qg.dL;
+    Qd.dTox = -Qd.value / tech.Tox;
+    Qd.dLovl = share * tech.CoxL * Vov - tech.Cox * Vgd;
+    Qd.dVt = share * Cch;
+    Qd.dBETA = -share * Qg.dBETA;
+
+    for (auto field : {&Derivatives::value, &Derivatives::dVgs, &Derivatives::dVds, &Derivatives::dW, &Derivatives::dL,
+                       &Derivatives::dTox, &Derivatives::dLovl, &Derivatives::dVt, &Derivatives::dMU, &Derivatives::dLAMBDA, &Derivatives::dBETA}) {
+        Qs.*field = -(Qg.*field + Qd.*field);
+        // charges change sign with the polarity, voltage partials keep theirs
+        if (field != &Derivatives::dVgs && field != &Derivatives::dVds) {
+            Qg.*field *= sign;
+            Qd.*field *= sign;
+            Qs.*field *= sign;
+        }
+    }
+    return Q;
+}
@@ -0,0 +1,57 @@
+#include "pwl_fet.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+PwlFET::Table PwlFET::build(const PlanarFET::Tech &tech, ModelUtils::DevType devType, double step, double range) {
+    // the current has a kink at the threshold, which a grid line keeps out of every triangle
+    Table table;
+    table.devType = devType;
+    table.step = step;
+    auto first = std::floor((-range - tech.Vt) / step), last = std::ceil((range - tech.Vt) / step);
+    table.vgs0 = tech.Vt + first * step;
+    table.gsLines = int(last - first) + 1;
+    table.vds0 = std::floor(-range / step) * step;
+    table.dsLines = int(std::ceil(range / step) - std::floor(-range / step)) + 1;
+
+    table.id.resize(size_t(table.gsLines) * size_t(table.dsLines));
+    for (int i = 0; i < table.gsLines; i++) {
+        for (int j = 0; j < table.dsLines; j++) {
+            auto Vgs = table.vgs0 + i * step, Vds = table.vds0 + j * step;
+            table.id[size_t(i) * table.dsLines + j] = PlanarFET::getIdDerivatives(tech, 1.0, Vgs, Vds, devType).value;
+        }
+    }
+    return table;
+}
+
+int PwlFET::locate(const Table &table, double Vgs, double Vds) {
+    auto u = (Vgs - table.vgs0) / table.step, v = (Vds - table.vds0) / table.step;
+    auto i = int(std::clamp(std::floor(u), 0.0, double(table.gsLines - 2)));
+    auto j = int(std::clamp(std::floor(v), 0.0, double(table.dsLines - 2)));
+    auto upper = (u - i) + (v - j) > 1.0;
+    return 2 * (i * (table.dsLines - 1) + j) + int(upper);
+}
+
+PwlFET::Plane PwlFET::getPlane(const Table &table, int region) {
+    // lower triangle (0,0) (1,0) (0,1), upper triangle (1,1) (1,0) (0,1) in grid steps
+    auto cell = region / 2;
+    auto i = cell / (table.dsLines - 1), j = cell % (table.dsLines - 1);
+    auto at = [&](int di, int dj) { return table.id[size_t(i + di) * table.dsLines + j + dj]; };
+    auto h = table.step, vgs = table.vgs0 + i * h, vds = table.vds0 + j * h;
+
+    Plane plane;
+    if (region % 2 == 0) {
+        plane.gm = (at(1, 0) - at(0, 0)) / h;
+        plane.gds = (at(0, 1) - at(0, 0)) / h;
+        plane.i0 = at(0, 0) - plane.gm * vgs - plane.gds * vds;
+        plane.vgs = vgs + h / 3;
+        plane.vds = vds + h / 3;
+    } else {
+        plane.gm = (at(1, 1) - at(0, 1)) / h;
+        plane.gds = (at(1, 1) - at(1, 0)) / h;
+        plane.i0 = at(1, 1) - plane.gm * (vgs + h) - plane.gds * (vds + h);
+        plane.vgs = vgs + 2 * h / 3;
+        plane.vds = vds + 2 * h / 3;
+    }
+    return plane;
+}
@@ -0,0 +1,13 @@
+#include "resistor.hpp"
+
+double Resistor::getConductance(double R) {
+    return 1.0 / R;
+}
+
+double Resistor::getCurrent(double R, double V) {
+    return V / R;
+}
+
+double Resistor::getInstantaneousPower(double R, double V) {
+    return V * V / R;
+}
@@ -0,0 +1,67 @@
+#include "source.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+double Source::getValue(const Waveform &wave, double time) {
+    // evaluate the source waveform at the given time
+    auto &p = wave.params;
+    switch (wave.shape) {
+    case Shape::DC:
+        return p[0];
+
+    case Shape::PULSE: {
+        auto [V1, V2, TD, TR, TF, PW, PER] = std::make_tuple(p[0], p[1], p[2], p[3], p[4], p[5], p[6]);
+        if (time <= TD) return V1;
+        auto t = time - TD;
+        if (PER > 0) t = std::fmod(t, PER);
+        if (t < TR) return V1 + (V2 - V1) * t / TR;
+        t -= TR;
+        if (t <= PW || (PW == 0 && PER == 0)) return V2;
+        t -= PW;
+        if (t < TF) return V2 + (V1 - V2) * t / TF;
+        return V1;
+    }
+
+    case Shape::PWL: {
+        if (time <= p[0]) return p[1];
+        for (size_t i = 2; i < p.size(); i += 2) {
+            if (time <= p[i]) {
+                auto span = p[i] - p[i - 2];
+                return span > 0 ? p[i - 1] + (p[i + 1] - p[i - 1]) * (time - p[i - 2]) / span : p[i + 1];
+            }
+        }
+        return p[p.size() - 1];
+    }
+    }
+    return 0.0;
+}
+
+std::vector<double> Source::getBreakpoints(const Waveform &wave, double tstop) {
+    // corners of the waveform in (0, tstop], which the timestep controller has to land on
+    std::vector<double> points;
+    auto &p = wave.params;
+    switch (wave.shape) {
+    case Shape::DC:
+        break;
+
+    case Shape::PULSE: {
+        auto [TD, TR, TF, PW, PER] = std::make_tuple(p[2], p[3], p[4], p[5], p[6]);
+        for (double start = TD; start <= tstop; start += PER) {
+            for (auto t : {start, start + TR, start + TR + PW, start + TR + PW + TF}) points.push_back(t);
+            if (PER <= 0) break;
+        }
+        break;
+    }
+
+    case Shape::PWL:
+        for (size_t i = 0; i < p.size(); i += 2) points.push_back(p[i]);
+        break;
+    }
+
+    points.erase(std::remove_if(points.begin(), points.end(), [tstop](double t) { return t <= 0 || t > tstop; }), points.end());
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+    return points;
+}
@@ -0,0 +1,243 @@
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <istream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "argparse.hpp"
+#include "logger.hpp"
+#include "helpers.hpp"
+
+#include "server.hpp"
+
+namespace po = boost::program_options;
+namespace fs = std::filesystem;
+
+static logger Log;
+
+argparse getArgs(int argc, char** argv) {
+    std::stringstream description;
+    description << cform::green << "csim-server" << cform::end;
+    description << " keeps designs loaded and answers simulation requests on a Unix socket.";
+
+    std::stringstream epilog;
+    epilog << "Requests are text lines, e.g. \"load inv inv.sp\", \"set inv w(mn1) 2u\", \"tran inv 1p 2n out\". "
+           << "See include/core/server.hpp for the full protocol, or try it with: socat - UNIX-CONNECT:<socket>";
+
+    argparse ap(description.str(), epilog.str());
+
+    std::string args_header = cform::underline + "Arguments" + cform::end;
+    po::options_description* arg = ap.add_argument_group(args_header);
+    arg->add_options()
+        (
+            "socket,S",
+            po::value<fs::path>()
+                ->value_name("path")
+                ->default_value("csim.sock"),
+            "Unix socket to listen on."
+        )
+        (
+            "techfile,t",
+            po::value<std::vector<fs::path>>()
+                ->value_name("path")
+                ->composing(),
+            "Technology file read once at startup for every design, may be repeated."
+        )
+        (
+            "solver,s",
+            po::value<std::string>()
+                ->value_name("kind")
+                ->default_value("auto"),
+            "Linear solver: direct, iterative or auto (iterative for large circuits)."
+        );
+
+    std::string flags_header = cform::underline + "Flags" + cform::end;
+    po::options_description* flg = ap.add_argument_group(flags_header);
+    flg->add_options()
+        ("mixed-precision", "Factor the Jacobian in single precision and refine solutions in double.")
+        ("switch-level", "Replace FETs by piecewise-linear switch models for fast functional and power runs.")
+        ("verbose,V", "Run in verbose mode.")
+        ("help,h", "Print this help messagem and exit");
+
+    po::variables_map vm = ap.parse_args(argc, argv);
+    return ap;
+}
+
+Simulator::LinearSolver parseSolver(const std::string &name) {
+    if (name == "auto") return Simulator::LinearSolver::Auto;
+    if (name == "direct") return Simulator::LinearSolver::Direct;
+    if (name == "iterative") return Simulator::LinearSolver::Iterative;
+    throw std::runtime_error("unknown linear solver [ " + name + " ]");
+}
+
+// stream over a connected socket, so requests can be parsed with getline
+class SocketBuffer : public std::streambuf {
+public:
+    explicit SocketBuffer(int fd) : _fd(fd) {
+        setg(_in, _in, _in);
+        setp(_out, _out + sizeof(_out));
+    }
+    ~SocketBuffer() override { sync(); }
+
+protected:
+    int_type underflow() override {
+        ssize_t count;
+        do count = ::recv(_fd, _in, sizeof(_in), 0);
+        while (count < 0 && errno == EINTR);
+        if (count <= 0) return traits_type::eof();
+        setg(_in, _in, _in + count);
+        return traits_type::to_int_type(_in[0]);
+    }
+
+    int_type overflow(int_type c) override {
+        if (sync() != 0) return traits_type::eof();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override {
+        // a client that went away must not take the server down with SIGPIPE
+        auto data = pbase();
+        while (data < pptr()) {
+            auto count = ::send(_fd, data, size_t(pptr() - data), MSG_NOSIGNAL);
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) {
+                setp(_out, _out + sizeof(_out));
+                return -1;
+            }
+            data += count;
+        }
+        setp(_out, _out + sizeof(_out));
+        return 0;
+    }
+
+private:
+    int _fd;
+    char _in[1 << 16];
+    char _out[1 << 16];
+};
+
+int run(argparse args) {
+    Simulator::Options options;
+    options.linearSolver = parseSolver(args.get<std::string>("solver"));
+    options.mixedPrecision = args.flag("mixed-precision");
+    options.switchLevel = args.flag("switch-level");
+    std::vector<fs::path> techfiles;
+    if (args.flag("techfile")) techfiles = args.get<std::vector<fs::path>>("techfile");
+    SimulationServer server(options, techfiles);
+    std::atomic<bool> stopping(false);
+
+    auto path = args.get<fs::path>("socket");
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.string().size() >= sizeof(address.sun_path)) throw std::runtime_error("socket path too long [ " + path.string() + " ]");
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+    // a socket file left behind by a killed server would make bind fail, but one that still
+    // accepts connections belongs to a running server
+    std::error_code error;
+    if (fs::is_socket(path, error)) {
+        int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        auto live = probe >= 0 && ::connect(probe, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+        if (probe >= 0) ::close(probe);
+        if (live) {
+            ::close(listener);
+            throw std::runtime_error("another server is listening on [ " + path.string() + " ]");
+        }
+        ::unlink(path.c_str());
+    }
+    if (::bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || ::listen(listener, 16) != 0) {
+        auto message = std::string(std::strerror(errno));
+        ::close(listener);
+        throw std::runtime_error("Failed to listen on [ " + path.string() + " ]: " + message);
+    }
+    Log.info("listening on " + path.string());
+
+    // one thread per connection, a long transient on one design does not block the others.
+    // the socket stays open until its thread is joined, so shutting it down never hits a reused fd
+    struct Connection {
+        std::thread thread;
+        int client;
+        std::unique_ptr<std::atomic<bool>> done;
+    };
+    std::vector<Connection> connections;
+    auto reap = [&](bool all) {
+        for (auto it = connections.begin(); it != connections.end();) {
+            if (!all && !*it->done) {
+                ++it;
+                continue;
+            }
+            it->thread.join();
+            ::close(it->client);
+            it = connections.erase(it);
+        }
+    };
+
+    std::string failure;
+    while (!stopping) {
+        int client = ::accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            if (!stopping) failure = std::string("accept: ") + std::strerror(errno);
+            break;
+        }
+        Log.verbose("client connected");
+        reap(false);
+        auto done = std::make_unique<std::atomic<bool>>(false);
+        auto flag = done.get();
+        std::thread thread([&server, &stopping, client, listener, flag]() {
+            bool keepRunning;
+            {
+                SocketBuffer buffer(client);
+                std::iostream stream(&buffer);
+                keepRunning = server.serve(stream, stream);
+            }
+            Log.verbose("client disconnected");
+            if (!keepRunning) {
+                stopping = true;
+                ::shutdown(listener, SHUT_RDWR);
+            }
+            *flag = true;
+        });
+        connections.push_back({std::move(thread), client, std::move(done)});
+    }
+
+    // idle clients see end of input, busy ones finish their request first
+    for (auto &connection : connections) ::shutdown(connection.client, SHUT_RD);
+    reap(true);
+    ::close(listener);
+    ::unlink(path.c_str());
+    if (!failure.empty()) throw std::runtime_error(failure);
+    Log.info("shut down");
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    try {
+        argparse args = getArgs(argc, argv);
+        Log = logger(fs::path(__FILE__).stem(), args.flag("verbose"));
+        return run(args);
+    } catch (peaceful_exception &e) {
+        return 0;
+    } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0xFF;
+}
@@ -0,0 +1,46 @@
+#include "mapped_file.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+MappedFile::MappedFile(const std::string &path) : data_(nullptr), size_(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Failed to open file [ " + path + " ]: " + std::strerror(errno));
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to stat file [ " + path + " ]: " + std::strerror(errno));
+    }
+    size_ = size_t(info.st_size);
+    if (size_ > 0) {
+        auto mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Failed to map file [ " + path + " ]: " + std::strerror(errno));
+        }
+        madvise(mapped, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char *>(mapped);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) munmap(const_cast<char *>(data_), size_);
+}
+
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed) {
+    auto bytes = static_cast<const unsigned char *>(data);
+    auto hash = seed;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
@@ -0,0 +1,78 @@
+#include "perf_counters.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+
+PerfCounters::PerfCounters() : leader_(-1), members_(0) {
+    fds_.fill(-1);
+    slot_.fill(-1);
+#ifdef __linux__
+    const uint64_t configs[EVENTS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for (int e = 0; e < EVENTS; e++) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[e];
+        attr.disabled = leader_ < 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // this thread on any cpu. the first event that opens leads the group
+        auto fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, leader_, 0));
+        if (fd < 0) {
+            if (error_.empty()) error_ = std::string(event_name(Event(e))) + ": " + std::strerror(errno);
+            continue;
+        }
+        if (leader_ < 0) leader_ = fd;
+        fds_[e] = fd;
+        slot_[e] = members_++;
+    }
+    if (leader_ >= 0) {
+        ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#else
+    error_ = "hardware counters need Linux perf_event_open";
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+    for (auto fd : fds_) if (fd >= 0) close(fd);
+}
+
+PerfCounters::Sample PerfCounters::read() const {
+    Sample sample;
+    sample.counts.fill(0.0);
+    sample.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (leader_ < 0) return sample;
+
+    // nr, time enabled, time running, then one value per member in the order they were opened
+    uint64_t data[3 + EVENTS];
+    auto size = ::read(leader_, data, sizeof(data));
+    if (size < ssize_t(3 * sizeof(uint64_t)) || data[0] != uint64_t(members_) || data[2] == 0) return sample;
+    auto scale = double(data[1]) / double(data[2]);
+    for (int e = 0; e < EVENTS; e++) {
+        if (slot_[e] >= 0) sample.counts[e] = double(data[3 + slot_[e]]) * scale;
+    }
+    return sample;
+}
+
+const char *PerfCounters::event_name(Event event) {
+    switch (event) {
+    case Cycles: return "cycles";
+    case Instructions: return "instructions";
+    case CacheMisses: return "cache_misses";
+    case BranchMisses: return "branch_misses";
+    default: return "";
+    }
+}
@@ -0,0 +1,89 @@
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+
+ThreadPool::ThreadPool(unsigned threads) : pending_(0), stop_(false) {
+    if (threads == 0) threads = default_threads();
+    for (unsigned i = 0; i < threads; i++) workers_.emplace_back([this]() { worker_loop_(); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_) worker.join();
+}
+
+unsigned ThreadPool::default_threads() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push(std::move(job));
+        pending_++;
+    }
+    wake_.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this]() { return pending_ == 0; });
+    if (error_) {
+        auto error = error_;
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)> &body, size_t grain) {
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+    auto chunks = (count + grain - 1) / grain;
+    if (chunks == 1 || workers_.size() == 1) {
+        for (size_t i = 0; i < count; i++) body(i);
+        return;
+    }
+
+    // a shared counter instead of one job per chunk keeps queue traffic independent of count
+    auto next = std::make_shared<std::atomic<size_t>>(0);
+    auto jobs = std::min<size_t>(chunks, workers_.size());
+    for (size_t j = 0; j < jobs; j++) {
+        submit([next, count, grain, &body]() {
+            for (size_t first = next->fetch_add(grain); first < count; first = next->fetch_add(grain)) {
+                auto last = std::min(count, first + grain);
+                for (size_t i = first; i < last; i++) body(i);
+            }
+        });
+    }
+    wait();
+}
+
+void ThreadPool::worker_loop_() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this]() { return stop_ || !jobs_.empty(); });
+            if (stop_ && jobs_.empty()) return;
+            job = std::move(jobs_.front());
+            jobs_.pop();
+        }
+
+        try {
+            job();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) error_ = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--pending_ == 0) idle_.notify_all();
+    }
+}
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "curves.hpp"
+#include "netlist.hpp"
+
+namespace {
+    class CurvesTest : public ::testing::Test {
+    protected:
+        Netlist netlist;
+        CurveSweep::Grid grid;
+
+        void SetUp() override {
+            grid.techs = {netlist.findTech("t180nm")};
+            grid.types = {ModelUtils::DevType::N, ModelUtils::DevType::P};
+            grid.widths = CurveSweep::parseGrid("1u,2u");
+            grid.vgs = CurveSweep::parseGrid("0:1.8:300m");
+            grid.vds = CurveSweep::parseGrid("0:1.8:100m");
+        }
+
+        // strtod, unlike stod, takes the subnormal currents of an off device
+        static double number(const std::string &text) {
+            return std::strtod(text.c_str(), nullptr);
+        }
+
+        static std::vector<std::string> fields(const std::string &line) {
+            std::vector<std::string> out;
+            std::istringstream stream(line);
+            std::string field;
+            while (std::getline(stream, field, ',')) out.push_back(field);
+            return out;
+        }
+    };
+
+    TEST_F(CurvesTest, Grid_Parsing) {
+        EXPECT_EQ(CurveSweep::parseGrid("1u,2u,4u"), (std::vector<double>{1e-6, 2e-6, 4e-6}));
+        EXPECT_EQ(CurveSweep::parseGrid("0:1:250m").size(), 5u);
+        EXPECT_THROW(CurveSweep::parseGrid("0:1"), std::runtime_error);
+        EXPECT_THROW(CurveSweep::parseGrid(""), std::runtime_error);
+    }
+
+    TEST_F(CurvesTest, Csv_Rows_And_Id_Vds_Shape) {
+        CurveSweep sweep(netlist, grid, 2);
+        std::stringstream out;
+        sweep.write(out, false);
+
+        std::string line;
+        ASSERT_TRUE(std::getline(out, line));
+        EXPECT_EQ(line, "tech,type,w,vgs,vds,id,gm,cgs,cgd");
+
+        // (vds, id) per (type, w, vgs) curve, vds fastest
+        struct Curve {
+            std::string type;
+            double w, vgs;
+            std::vector<std::pair<double, double>> points;
+        };
+        std::vector<Curve> curves;
+        std::string key;
+        size_t rows = 0;
+        while (std::getline(out, line)) {
+            auto f = fields(line);
+            ASSERT_EQ(f.size(), 9u) << line;
+            EXPECT_EQ(f[0], "t180nm");
+            if (f[1] + "," + f[2] + "," + f[3] != key) {
+                key = f[1] + "," + f[2] + "," + f[3];
+                curves.push_back({f[1], number(f[2]), number(f[3]), {}});
+            }
+            curves.back().points.push_back({number(f[4]), number(f[5])});
+            rows++;
+        }
+        EXPECT_EQ(rows, sweep.getPoints());
+        EXPECT_EQ(rows, 2u * 2u * 7u * 19u);
+        ASSERT_EQ(curves.size(), 2u * 2u * 7u);
+
+        for (auto &curve : curves) {
+            auto &p = curve.points;
+            ASSERT_EQ(p.size(), grid.vds.size()) << curve.type << " " << curve.w << " " << curve.vgs;
+            for (size_t k = 1; k < p.size(); k++) EXPECT_GT(p[k].first, p[k - 1].first);
+            if (curve.type != "n") continue;
+            // the drain current never falls as vds grows and is down to leakage at vds = 0
+            for (size_t k = 1; k < p.size(); k++) EXPECT_GE(p[k].second, p[k - 1].second) << curve.w << " " << curve.vgs << " " << p[k].first;
+            EXPECT_LE(p.front().second, 1e-6 * p.back().second + 1e-11) << curve.w << " " << curve.vgs;
+        }
+
+        auto find = [&](double w, double vgs) -> const std::vector<std::pair<double, double>> & {
+            for (auto &curve : curves) {
+                if (curve.type == "n" && std::abs(curve.w - w) < 1e-12 && std::abs(curve.vgs - vgs) < 1e-9) return curve.points;
+            }
+            throw std::runtime_error("no curve");
+        };
+        auto &narrow = find(1e-6, 1.8), &wide = find(2e-6, 1.8);
+        auto n = narrow.size();
+        EXPECT_GT(narrow.back().second, 0.0);
+        // steep in triode, flat in saturation
+        EXPECT_GT(narrow[3].second - narrow[0].second, 10 * (narrow[n - 1].second - narrow[n - 4].second));
+        EXPECT_NEAR(wide.back().second, 2 * narrow.back().second, 1e-3 * narrow.back().second);
+        EXPECT_LT(find(1e-6, 0.9).back().second, narrow.back().second);
+        EXPECT_LT(find(1e-6, 0.0).back().second, 1e-9);
+    }
+
+    TEST_F(CurvesTest, Binary_Matches_Csv) {
+        CurveSweep sweep(netlist, grid, 1);
+        std::stringstream csv, binary;
+        sweep.write(csv, false);
+        sweep.write(binary, true);
+        auto bytes = binary.str();
+
+        // magic, version, quantities, five counts, the tech name, two types and the three grids
+        size_t header = 8 + 4 + 4 + 5 * 8 + (4 + 6) + 2 + (grid.widths.size() + grid.vgs.size() + grid.vds.size()) * 8;
+        ASSERT_EQ(bytes.size(), header + sweep.getPoints() * CurveSweep::QUANTITIES * 8);
+        EXPECT_EQ(bytes.compare(0, 8, "csimcurv"), 0);
+
+        std::string line;
+        std::getline(csv, line);
+        for (size_t point = 0; std::getline(csv, line); point++) {
+            auto f = fields(line);
+            for (uint32_t q = 0; q < CurveSweep::QUANTITIES; q++) {
+                double value;
+                std::memcpy(&value, bytes.data() + header + (point * CurveSweep::QUANTITIES + q) * 8, sizeof(value));
+                ASSERT_EQ(value, number(f[5 + q])) << line;
+            }
+        }
+    }
+}
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <sstream>
+#include <string>
+
+#include "measure.hpp"
+#include "netlist.hpp"
+#include "reduction.hpp"
+#include "simulator.hpp"
+
+namespace {
+    class MeasureTest : public ::testing::Test {
+    protected:
+        Netlist netlist;
+        double R, C, tau;
+
+        void SetUp() override {
+            R = 1e3;
+            C = 1e-12;
+            tau = R * C;
+            std::istringstream deck(
+                "vin in 0 pulse(0 1 1n 1p 1p 5n 10n)\n"
+                "r1 in out 1k\n"
+                "c1 out 0 1p\n");
+            netlist.parse(deck);
+        }
+
+        static std::vector<std::string> split(const std::string &card) {
+            std::istringstream stream(card);
+            std::vector<std::string> tokens;
+            std::string token;
+            while (stream >> token) tokens.push_back(token);
+            return tokens;
+        }
+
+        std::vector<MeasureEngine::Result> run(const std::vector<std::string> &cards, bool storeWaveforms = false) {
+            Simulator sim(netlist);
+            MeasureEngine engine(sim);
+            for (auto &card : cards) engine.add(split(card));
+            auto waves = sim.solveTransient(5e-12, 10e-9, [&](double time, const std::vector<double> &x) { engine.accept(time, x); }, storeWaveforms);
+            if (!storeWaveforms) {
+                EXPECT_TRUE(waves.time.empty());
+            }
+            return engine.getResults();
+        }
+    };
+
+    TEST_F(MeasureTest, Delay_And_Slew) {
+        auto results = run({
+            "tran tpd trig v(in) val=0.5 rise=1 targ v(out) val=0.5 rise=1",
+            "tran trise trig v(out) val=0.1 rise=1 targ v(out) val=0.9 rise=1",
+            "tran tfall trig v(out) val=0.9 fall=1 targ v(out) val=0.1 fall=1",
+        });
+
+        ASSERT_EQ(results.size(), 3u);
+        for (auto &r : results) EXPECT_TRUE(r.valid) << r.name;
+        EXPECT_NEAR(results[0].value, std::log(2.0) * tau, 0.02 * tau);
+        EXPECT_NEAR(results[1].value, std::log(9.0) * tau, 0.02 * tau);
+        EXPECT_NEAR(results[2].value, std::log(9.0) * tau, 0.02 * tau);
+    }
+
+    TEST_F(MeasureTest, Energy_And_Aggregates) {
+        auto results = run({
+            "tran ein integ p(vin) from=0 to=6n",
+            "tran vpk max v(out)",
+            "tran vfind find v(out) at=2n",
+            "tran never when v(out)=2",
+        });
+
+        // charging C to (almost) 1V through R draws C*V^2 from the source
+        EXPECT_NEAR(results[0].value, C * (1 - std::exp(-10.0)), 0.02 * C);
+        EXPECT_NEAR(results[1].value, 1.0 - std::exp(-5.0), 0.01);
+        EXPECT_NEAR(results[2].value, 1.0 - std::exp(-1.0), 0.01);
+        EXPECT_FALSE(results[3].valid);
+    }
+
+    TEST_F(MeasureTest, Second_Run_Measures_On_Its_Own) {
+        // two .tran cards share one engine, reset between them as csim does
+        std::vector<std::string> cards = {
+            "tran tpd trig v(in) val=0.5 rise=1 targ v(out) val=0.5 rise=1",
+            "tran tat trig at=1n targ v(out) val=0.5 rise=1",
+            "tran ein integ p(vin)",
+            "tran vmax max v(out)",
+        };
+        Simulator sim(netlist);
+        MeasureEngine engine(sim);
+        for (auto &card : cards) engine.add(split(card));
+        auto accept = [&](double time, const std::vector<double> &x) { engine.accept(time, x); };
+        sim.solveTransient(5e-12, 10e-9, accept, false);
+        engine.reset();
+        sim.solveTransient(5e-12, 3e-9, accept, false);
+        auto second = engine.getResults();
+
+        Simulator freshSim(netlist);
+        MeasureEngine fresh(freshSim);
+        for (auto &card : cards) fresh.add(split(card));
+        freshSim.solveTransient(5e-12, 3e-9, [&](double time, const std::vector<double> &x) { fresh.accept(time, x); }, false);
+        auto expected = fresh.getResults();
+
+        ASSERT_EQ(second.size(), expected.size());
+        for (size_t i = 0; i < second.size(); i++) {
+            EXPECT_TRUE(second[i].valid) << second[i].name;
+            EXPECT_DOUBLE_EQ(second[i].value, expected[i].value) << second[i].name;
+        }
+        // the first run charged to 1 - e^-5, the second stops 2 ns into the pulse
+        EXPECT_NEAR(second[3].value, 1.0 - std::exp(-2.0), 0.01);
+    }
+
+    TEST_F(MeasureTest, Instance_Power_Survives_Reduction) {
+        // the wire between the cells is fast enough for reduction to flatten it away
+        Netlist hierarchical;
+        std::istringstream deck(
+            ".model fast planar l=180n tox=5n lovl=1p vt=0.4 mun=35m mup=15m lambda=0.015 beta=100\n"
+            ".subckt inv a y vdd\nr1 vdd y 20k\nm1 y a 0 0 nmos w=1u tech=fast\n.ends\n"
+            "vdd vdd 0 1.8\nvin in 0 pwl(0 0 0.1n 0 0.15n 1.8)\n"
+            "x1 in m vdd inv\nr1 m q 10\nc1 q 0 0.1f\nr2 q n 10\nx2 n out vdd inv\nc2 out 0 5f\n");
+        hierarchical.parse(deck);
+        RCReduction::Options options;
+        options.tau = 1e-12;
+        RCReduction::Report report;
+        auto reduced = RCReduction::reduce(hierarchical, options, &report);
+        ASSERT_LT(report.nodesAfter, report.nodesBefore);
+
+        auto energy = [&](Netlist &n) {
+            Simulator sim(n);
+            MeasureEngine engine(sim);
+            engine.add(split("tran e1 integ p(x1)"));
+            engine.add(split("tran e2 integ p(x2)"));
+            sim.solveTransient(5e-12, 1e-9, [&](double time, const std::vector<double> &x) { engine.accept(time, x); }, false);
+            return engine.getResults();
+        };
+        auto expected = energy(hierarchical), results = energy(reduced);
+        ASSERT_EQ(results.size(), 2u);
+        for (size_t i = 0; i < results.size(); i++) {
+            ASSERT_TRUE(results[i].valid) << results[i].name;
+            EXPECT_GT(expected[i].value, 0.0) << results[i].name;
+            EXPECT_NEAR(results[i].value, expected[i].value, 1e-3 * expected[i].value) << results[i].name;
+        }
+    }
+
+    TEST_F(MeasureTest, Rejects_Bad_Statements) {
+        Simulator sim(netlist);
+        MeasureEngine engine(sim);
+        EXPECT_THROW(engine.add(split("tran bad trig v(in) val=0.5")), std::runtime_error);
+        EXPECT_THROW(engine.add(split("tran bad avg v(nowhere)")), std::runtime_error);
+        EXPECT_THROW(engine.add(split("tran bad find v(out)")), std::runtime_error);
+    }
+}
@@ -0,0 +1,1407 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+#include "accuracy.hpp"
+#include "characterize.hpp"
+#include "checkpoint.hpp"
+#include "dcsweep.hpp"
+#include "device_stats.hpp"
+#include "kernel_profile.hpp"
+#include "measure.hpp"
+#include "memory.hpp"
+#include "netlist.hpp"
+#include "netlist_cache.hpp"
+#include "partition.hpp"
+#include "probe.hpp"
+#include "pwl_fet.hpp"
+#include "reduction.hpp"
+#include "sensitivity.hpp"
+#include "server.hpp"
+#include "simulator.hpp"
+#include "stimulus.hpp"
+#include "symbolic_cache.hpp"
+
+namespace {
+    class SimulatorTest : public ::testing::Test {
+    protected:
+        Simulator::Options opts;
+
+        void SetUp() override {
+            // tight Newton tolerances so finite differences are not swamped by solver noise,
+            // and a loose truncation tolerance so perturbed runs take the same timesteps
+            opts.reltol = 1e-10;
+            opts.vntol = 1e-12;
+            opts.abstol = 1e-15;
+            opts.trtol = 1e12;
+        }
+
+        static Netlist parse(const std::string &deck) {
+            Netlist netlist;
+            std::istringstream stream(deck);
+            netlist.parse(stream);
+            return netlist;
+        }
+
+        static Netlist commonSource() {
+            return parse(
+                "vdd vdd 0 1.8\n"
+                "vin in 0 pwl(0 0.6 0.1n 0.6 0.3n 1.2)\n"
+                "r1 vdd out 20k\n"
+                "c1 out 0 5f\n"
+                "m1 out in 0 0 nmos w=1u\n"
+                "m2 out in 0 nmos w=0.5u tech=t065nm\n");
+        }
+
+        static void rebuildTech(Netlist &netlist, int tech, const std::string &param, double delta) {
+            auto t = netlist.getTech(tech);
+            if (param == "L") t.L += delta;
+            if (param == "Tox") t.Tox += delta;
+            if (param == "Vt") t.Vt += delta;
+            if (param == "MUn") t.MUn += delta;
+            if (param == "LAMBDA") t.LAMBDA += delta;
+            if (param == "BETA") t.BETA += delta;
+            netlist.getTech(tech) = PlanarFET::Tech(t.L, t.Tox, t.Lovl, t.Vt, t.MUn, t.MUp, t.LAMBDA, t.BETA);
+        }
+
+        static double techGradient(const Sensitivity::TechGradient &g, const std::string &param) {
+            if (param == "L") return g.L;
+            if (param == "Tox") return g.Tox;
+            if (param == "Vt") return g.Vt;
+            if (param == "MUn") return g.MUn;
+            if (param == "LAMBDA") return g.LAMBDA;
+            return g.BETA;
+        }
+    };
+
+    TEST_F(SimulatorTest, OperatingPoint_Divider) {
+        auto netlist = parse("v1 in 0 1.8\nr1 in out 1k\nr2 out 0 2k\n");
+        Simulator sim(netlist, opts);
+        auto x = sim.solveOperatingPoint();
+
+        EXPECT_NEAR(x[sim.getIndex("v(out)")], 1.2, 1e-9);
+        EXPECT_NEAR(x[sim.getIndex("i(v1)")], -1.8 / 3e3, 1e-10);
+    }
+
+    TEST_F(SimulatorTest, Subckt_FlattensWithHierarchicalNames) {
+        auto netlist = parse(
+            "v1 in 0 1.8\n"
+            "x1 in out half\n"
+            "x2 out 0 half\n"
+            ".subckt half a b\n"
+            "r1 a mid 1k\n"
+            "r2 mid b 1k\n"
+            ".ends\n"
+            ".subckt buf a y vdd\n"
+            "xa a m vdd inv\n"
+            "xb m y vdd inv\n"
+            ".ends\n"
+            ".subckt inv a y vdd\n"
+            "mp y a vdd pmos w=2u\n"
+            "mn y a 0 nmos w=1u\n"
+            ".ends\n"
+            "xbuf out z in buf\n");
+        EXPECT_EQ(netlist.getSubcktCount(), 3);
+        EXPECT_EQ(netlist.getInstanceCount(), 5);
+        ASSERT_EQ(netlist.getFets().size(), 4u);
+        ASSERT_EQ(netlist.getResistors().size(), 4u);
+
+        EXPECT_EQ(netlist.getFetName(3), "xbuf.xb.mn");
+        EXPECT_EQ(netlist.getResistorName(2), "x2.r1");
+        EXPECT_EQ(netlist.findFet("xbuf.xa.mp"), 0);
+        EXPECT_EQ(netlist.findFet("xbuf.xc.mp"), -1);
+        auto &fet = netlist.getFets()[3];
+        EXPECT_EQ(netlist.getNodeName(fet.d), "z");
+        EXPECT_EQ(netlist.getNodeName(fet.g), "xbuf.m");
+        EXPECT_EQ(fet.s, Netlist::GROUND);
+        EXPECT_EQ(netlist.findNode("xbuf.vdd"), netlist.findNode("in"));
+
+        Netlist::Block block;
+        ASSERT_TRUE(netlist.findInstance("xbuf.xb", block));
+        EXPECT_EQ(block.first.fets, 2);
+        EXPECT_EQ(block.size.fets, 2);
+
+        Simulator sim(netlist, opts);
+        auto x = sim.solveOperatingPoint();
+        EXPECT_NEAR(x[sim.getIndex("v(out)")], 0.9, 1e-6);
+        EXPECT_NEAR(x[sim.getIndex("v(x1.mid)")], 1.35, 1e-6);
+        EXPECT_EQ(sim.getName(sim.getIndex("v(x2.mid)")), "v(x2.mid)");
+    }
+
+    TEST_F(SimulatorTest, Subckt_LargeHierarchyFlattensInParallel) {
+        // enough elements to take the threaded expansion path
+        const int segments = 3000;
+        std::ostringstream deck;
+        deck << ".subckt seg a b\n";
+        for (int k = 0; k < 10; k++) deck << "r" << k << " " << (k ? "n" + std::to_string(k) : "a") << " " << (k < 9 ? "n" + std::to_string(k + 1) : "b") << " 1\n";
+        deck << ".ends\n";
+        for (int i = 0; i < segments; i++) deck << "x" << i << " s" << i << " s" << i + 1 << " seg\n";
+        auto netlist = parse(deck.str());
+
+        auto &resistors = netlist.getResistors();
+        ASSERT_EQ(resistors.size(), size_t(segments * 10));
+        EXPECT_EQ(netlist.getNodeCount(), 1 + (segments + 1) + segments * 9);
+        for (size_t k = 1; k < resistors.size(); k++) ASSERT_EQ(resistors[k].a, resistors[k - 1].b) << k;
+        EXPECT_EQ(netlist.getNodeName(resistors.back().b), "s" + std::to_string(segments));
+        EXPECT_EQ(netlist.getResistorName(12345), "x1234.r5");
+        EXPECT_EQ(netlist.getNodeName(resistors[12345].a), "x1234.n5");
+        EXPECT_EQ(netlist.findNode("x1234.n5"), resistors[12345].a);
+    }
+
+    TEST_F(SimulatorTest, NetlistCache_ReusedUntilAnIncludeChanges) {
+        namespace fs = std::filesystem;
+        auto dir = fs::temp_directory_path() / ("csim_cache_" + std::to_string(::getpid()));
+        fs::create_directories(dir);
+        auto write = [&](const std::string &file, const std::string &text) { std::ofstream(dir / file) << text; };
+        write("cells.inc", ".subckt half a b\nr1 a mid 1k\nr2 mid b 1k\n.ends\n");
+        write("top.sp", "v1 in 0 pwl(0 0 1n 1.8)\n.include cells.inc\nx1 in out half\nx2 out 0 half\nm1 out in 0 nmos w=1u\n.op\n");
+        auto design = dir / "top.sp", image = dir / "top.img";
+
+        bool hit = true;
+        auto parsed = NetlistCache::read(design, {}, image, &hit);
+        EXPECT_FALSE(hit);
+        auto cached = NetlistCache::read(design, {}, image, &hit);
+        EXPECT_TRUE(hit);
+        EXPECT_EQ(cached.getSources().size(), 2u);
+        EXPECT_EQ(cached.getNodeCount(), parsed.getNodeCount());
+        EXPECT_EQ(cached.getResistorName(3), "x2.r2");
+        EXPECT_EQ(cached.findNode("x2.mid"), parsed.findNode("x2.mid"));
+        EXPECT_EQ(cached.getFets()[0].W, 1e-6);
+        EXPECT_EQ(cached.getVSources()[0].wave.params, parsed.getVSources()[0].wave.params);
+        ASSERT_EQ(cached.getAnalyses().size(), 1u);
+        EXPECT_EQ(cached.getAnalyses()[0].type, "op");
+
+        write("cells.inc", ".subckt half a b\nr1 a mid 2k\nr2 mid b 1k\n.ends\n");
+        auto edited = NetlistCache::read(design, {}, image, &hit);
+        EXPECT_FALSE(hit);
+        EXPECT_EQ(edited.getResistors()[0].R, 2e3);
+
+        // a damaged image is a miss, never an error
+        auto size = fs::file_size(image);
+        {
+            std::fstream file(image, std::ios::in | std::ios::out | std::ios::binary);
+            file.seekp(std::streamoff(size / 2));
+            file.put('\x7f');
+        }
+        EXPECT_NO_THROW(NetlistCache::read(design, {}, image, &hit));
+        EXPECT_FALSE(hit);
+        fs::resize_file(image, size / 2);
+        EXPECT_NO_THROW(NetlistCache::read(design, {}, image, &hit));
+        EXPECT_FALSE(hit);
+        NetlistCache::read(design, {}, image, &hit);
+        EXPECT_TRUE(hit);
+
+        // an image that cannot be written still returns the parsed netlist
+        std::string error;
+        auto unwritable = NetlistCache::read(design, {}, dir / "missing" / "top.img", &hit, &error);
+        EXPECT_FALSE(hit);
+        EXPECT_FALSE(error.empty());
+        EXPECT_EQ(unwritable.getNodeCount(), parsed.getNodeCount());
+        NetlistCache::read(design, {}, image, &hit, &error);
+        EXPECT_TRUE(error.empty());
+        fs::remove_all(dir);
+    }
+
+    TEST_F(SimulatorTest, ModelCards_PrecomputeDerivedParameters) {
+        auto netlist = parse(
+            ".model lowvt planar l=180n tox=5n lovl=15n vt=0.3 mun=35m mup=15m lambda=0.015 beta=100\n"
+            ".model copy planar L=180n Tox=5n Lovl=15n Vt=0.4\n"
+            "+ MUn=35m MUp=15m LAMBDA=0.015 BETA=100\n"
+            "m1 d g 0 nmos w=1u tech=lowvt\n"
+            "m2 d g 0 nmos w=1u tech=t065nm\n");
+        auto lowvt = netlist.findTech("lowvt");
+        ASSERT_GE(lowvt, 0);
+        EXPECT_EQ(netlist.getFets()[0].tech, lowvt);
+
+        auto &tech = netlist.getTech(lowvt);
+        EXPECT_DOUBLE_EQ(tech.Vt, 0.3);
+        EXPECT_DOUBLE_EQ(tech.KPn, tech.MUn * tech.Cox / tech.L);
+        EXPECT_DOUBLE_EQ(tech.KPp, tech.MUp * tech.Cox / tech.L);
+        EXPECT_DOUBLE_EQ(tech.CoxL, tech.Cox * tech.L);
+        EXPECT_DOUBLE_EQ(tech.BETAoffset, tech.BETA * ModelUtils::GAMMA_OFFSET);
+
+        auto &copy = netlist.getTech(netlist.findTech("copy"));
+        auto N = ModelUtils::DevType::N;
+        EXPECT_DOUBLE_EQ(PlanarFET::getId(copy, 1e-6, 1.2, 0.8, N), PlanarFET::getId(PlanarFET::t180nm, 1e-6, 1.2, 0.8, N));
+        EXPECT_DOUBLE_EQ(PlanarFET::getCgs(copy, 1e-6, 1.2, 0.8, N), PlanarFET::getCgs(PlanarFET::t180nm, 1e-6, 1.2, 0.8, N));
+
+        EXPECT_THROW(parse(".model bad planar l=180n tox=5n\n"), std::runtime_error);
+        EXPECT_THROW(parse(".model bad bsim4 l=180n\n"), std::runtime_error);
+    }
+
+    TEST_F(SimulatorTest, Partition_MatchesFullMatrix) {
+        std::ostringstream deck;
+        deck << "vdd vdd 0 1.8\nvin s0 0 pwl(0 0 0.2n 0 0.4n 1.8)\n";
+        for (int i = 0; i < 6; i++) {
+            deck << "r" << i << " vdd s" << i + 1 << " 20k\n";
+            deck << "m" << i << " s" << i + 1 << " s" << i << " 0 nmos w=1u\n";
+            deck << "c" << i << " s" << i + 1 << " 0 5f\n";
+        }
+        auto netlist = parse(deck.str());
+
+        Partition partition(netlist);
+        EXPECT_EQ(partition.getBlocks().size(), 6u);  // one block per stage, vdd and s0 are rails
+        EXPECT_EQ(partition.getRails().size(), 2u);
+        EXPECT_EQ(partition.getBlockOf(netlist.findNode("vdd")), -1);
+        EXPECT_EQ(partition.getLevelCount(), 6);
+        EXPECT_EQ(partition.getBlocks()[partition.getBlockOf(netlist.findNode("s6"))].level, 5);
+
+        Simulator::Options partOpts;
+        partOpts.partition = true;
+        partOpts.threads = 2;
+        Simulator full(netlist), parted(netlist, partOpts);
+        EXPECT_GT(parted.getBlockGroups(), 1);
+
+        auto out = full.getIndex("v(s6)"), supply = full.getIndex("i(vdd)");
+        auto a = full.solveOperatingPoint(), b = parted.solveOperatingPoint();
+        EXPECT_NEAR(a[out], b[out], 1e-5);
+        EXPECT_NEAR(a[supply], b[supply], 1e-9);
+
+        auto wa = full.solveTransient(10e-12, 1e-9), wb = parted.solveTransient(10e-12, 1e-9);
+        ASSERT_EQ(wa.time.size(), wb.time.size());
+        for (size_t n = 0; n < wa.time.size(); n++) {
+            ASSERT_NEAR(wa.x[n][out], wb.x[n][out], 1e-3) << wa.time[n];
+            ASSERT_NEAR(wa.x[n][supply], wb.x[n][supply], 1e-7) << wa.time[n];
+        }
+        EXPECT_GT(parted.getStatistics().relaxationSweeps, 0);
+        EXPECT_EQ(parted.getStatistics().partitionFallbacks, 0);
+    }
+
+    TEST_F(SimulatorTest, Partition_RailsAreBoundary) {
+        // vhi hangs from vdd, listed ahead of it, vf floats between two stage nodes and m3 draws
+        // from vhi with its gate and drain in two different blocks
+        std::string cells =
+            "r1 vhi s1 20k\nm1 s1 s0 0 nmos w=1u\nc1 s1 0 5f\n"
+            "r2 vdd s2 20k\nm2 s2 s1 0 nmos w=1u\nvf s2 t2 0.2\nc2 t2 0 5f\n"
+            "m3 s2 s1 vhi nmos w=1u\ncd vdd 0 10f\nrh vhi vdd 100k\n";
+        std::string rails = "vx vhi vdd 0.6\nvdd vdd 0 1.8\nvin s0 0 pwl(0 0 0.2n 0 0.4n 1.8)\n";
+        auto netlist = parse(rails + cells);
+        auto reordered = parse(cells + "vdd vdd 0 1.8\nvin s0 0 pwl(0 0 0.2n 0 0.4n 1.8)\nvx vhi vdd 0.6\n");
+
+        // the rails are the same whatever order the sources come in, and join no block
+        Partition partition(netlist), other(reordered);
+        ASSERT_EQ(partition.getRails().size(), 3u);
+        ASSERT_EQ(partition.getBlocks().size(), 2u);
+        ASSERT_EQ(other.getBlocks().size(), 2u);
+        for (auto name : {"vdd", "vhi", "s0"}) EXPECT_EQ(partition.getBlockOf(netlist.findNode(name)), -1) << name;
+        EXPECT_EQ(partition.getBlockOf(netlist.findNode("s2")), partition.getBlockOf(netlist.findNode("t2")));
+        EXPECT_EQ(partition.getBlocks()[partition.getBlockOf(netlist.findNode("s2"))].vsources.size(), 1u);
+
+        Simulator::Options partOpts;
+        partOpts.partition = true;
+        Simulator full(netlist), parted(netlist, partOpts);
+        auto wa = full.solveTransient(10e-12, 1e-9), wb = parted.solveTransient(10e-12, 1e-9);
+        ASSERT_EQ(wa.time.size(), wb.time.size());
+        auto voltage = full.getIndex("v(s2)");
+        for (size_t n = 0; n < wa.time.size(); n++) {
+            ASSERT_NEAR(wa.x[n][voltage], wb.x[n][voltage], 1e-4) << wa.time[n];
+            // every source current, each to the Newton reltol
+            for (auto name : {"i(vdd)", "i(vx)", "i(vf)"}) {
+                auto k = full.getIndex(name);
+                ASSERT_NEAR(wa.x[n][k], wb.x[n][k], 1e-3 * std::abs(wa.x[n][k]) + 1e-9) << name << " " << wa.time[n];
+            }
+        }
+        EXPECT_EQ(parted.getStatistics().partitionFallbacks, 0);
+    }
+
+    TEST_F(SimulatorTest, Multirate_FreezesSettledStages) {
+        // the input switches once, after which the chain settles and its stages go latent
+        std::ostringstream deck;
+        deck << "vdd vdd 0 1.8\nvin s0 0 pwl(0 0 0.1n 0 0.2n 1.8)\n";
+        for (int i = 0; i < 4; i++) {
+            deck << "r" << i << " vdd s" << i + 1 << " 20k\n";
+            deck << "m" << i << " s" << i + 1 << " s" << i << " 0 nmos w=1u\n";
+            deck << "c" << i << " s" << i + 1 << " 0 5f\n";
+        }
+        auto netlist = parse(deck.str());
+
+        Simulator::Options multiOpts;
+        multiOpts.multirate = true;
+        Simulator full(netlist), multi(netlist, multiOpts);
+        auto out = full.getIndex("v(s4)");
+        auto wa = full.solveTransient(20e-12, 4e-9), wb = multi.solveTransient(20e-12, 4e-9);
+        EXPECT_NEAR(wa.x.back()[out], wb.x.back()[out], 1e-3);
+        for (size_t n = 0; n < wb.time.size(); n++) {
+            auto k = std::lower_bound(wa.time.begin(), wa.time.end(), wb.time[n]) - wa.time.begin();
+            if (k < long(wa.time.size()) && wa.time[k] == wb.time[n]) {
+                ASSERT_NEAR(wa.x[k][out], wb.x[n][out], 2e-2) << wb.time[n];
+            }
+        }
+        EXPECT_GT(multi.getStatistics().latentSkips, 0);
+        EXPECT_EQ(multi.getStatistics().partitionFallbacks, 0);
+    }
+
+    TEST_F(SimulatorTest, Multirate_SecondTransientStartsAwake) {
+        std::ostringstream deck;
+        deck << "vdd vdd 0 1.8\nvin s0 0 pwl(0 0 0.1n 0 0.2n 1.8)\n";
+        for (int i = 0; i < 4; i++) {
+            deck << "r" << i << " vdd s" << i + 1 << " 20k\n";
+            deck << "m" << i << " s" << i + 1 << " s" << i << " 0 nmos w=1u\n";
+            deck << "c" << i << " s" << i + 1 << " 0 5f\n";
+        }
+        auto netlist = parse(deck.str());
+
+        Simulator::Options multiOpts;
+        multiOpts.multirate = true;
+        Simulator reference(netlist, multiOpts);
+        auto expected = reference.solveTransient(20e-12, 1e-9);
+
+        // a run abandoned before the edge leaves its stages frozen at the operating point
+        Simulator multi(netlist, multiOpts);
+        EXPECT_THROW(multi.solveTransient(20e-12, 1e-9, [&](double time, const std::vector<double> &) {
+            if (time > 0.08e-9) throw std::runtime_error("abandoned");
+        }), std::runtime_error);
+        EXPECT_GT(multi.getStatistics().latentSkips, 0);
+
+        // the next one starts awake and takes exactly the steps and skips of a new simulator
+        auto waves = multi.solveTransient(20e-12, 1e-9);
+        ASSERT_EQ(waves.time, expected.time);
+        for (size_t n = 0; n < waves.time.size(); n++) ASSERT_EQ(waves.x[n], expected.x[n]) << waves.time[n];
+        EXPECT_EQ(multi.getStatistics().latentSkips, reference.getStatistics().latentSkips);
+    }
+
+    TEST_F(SimulatorTest, Krylov_MatchesDirectOnRCMesh) {
+        // resistive grid fed at one corner, with a FET load so the matrix is not symmetric
+        const int n = 20;
+        std::ostringstream deck;
+        deck << "vin g0_0 0 pwl(0 0 0.2n 1.8)\nm1 out g" << n - 1 << "_" << n - 1 << " 0 nmos w=1u\nrl g0_0 out 10k\n";
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                if (i + 1 < n) deck << "rv" << i << "_" << j << " g" << i << "_" << j << " g" << i + 1 << "_" << j << " 50\n";
+                if (j + 1 < n) deck << "rh" << i << "_" << j << " g" << i << "_" << j << " g" << i << "_" << j + 1 << " 50\n";
+                deck << "c" << i << "_" << j << " g" << i << "_" << j << " 0 2f\n";
+            }
+        }
+        auto netlist = parse(deck.str());
+
+        Simulator::Options iterOpts;
+        iterOpts.linearSolver = Simulator::LinearSolver::Iterative;
+        Simulator direct(netlist), iterative(netlist, iterOpts);
+        EXPECT_FALSE(direct.isIterative());
+        EXPECT_TRUE(iterative.isIterative());
+
+        auto out = direct.getIndex("v(out)"), corner = direct.getIndex("v(g19_19)");
+        auto wa = direct.solveTransient(20e-12, 1e-9), wb = iterative.solveTransient(20e-12, 1e-9);
+        ASSERT_EQ(wa.time.size(), wb.time.size());
+        for (size_t k = 0; k < wa.time.size(); k++) {
+            ASSERT_NEAR(wa.x[k][out], wb.x[k][out], 1e-6) << wa.time[k];
+            ASSERT_NEAR(wa.x[k][corner], wb.x[k][corner], 1e-6) << wa.time[k];
+        }
+        EXPECT_GT(iterative.getStatistics().krylovIterations, 0);
+        EXPECT_THROW(Sensitivity(iterative).solveOperatingPoint(out, wb.x[0]), std::runtime_error);
+    }
+
+    TEST_F(SimulatorTest, Reduction_KeepsDelayThroughRCLine) {
+        // a driver resistance into a finely segmented wire with a load at the far end
+        std::ostringstream deck;
+        deck << "vin in 0 pwl(0 0 0.1n 0 0.15n 1.8)\nr0 in w0 1k\ncl w60 0 20f\n";
+        for (int i = 0; i < 60; i++) {
+            deck << "rw" << i << " w" << i << " w" << i + 1 << " 5\n";
+            deck << "cw" << i << " w" << i + 1 << " 0 0.2f\n";
+        }
+        deck << ".measure tran tw when v(w30)=0.9\n";
+        auto netlist = parse(deck.str());
+
+        RCReduction::Options options;
+        options.tau = 1e-12;
+        RCReduction::Report report;
+        auto reduced = RCReduction::reduce(netlist, options, &report);
+        EXPECT_EQ(report.nodesBefore, 62);
+        EXPECT_LT(report.nodesAfter * 5, report.nodesBefore);
+        EXPECT_GE(reduced.findNode("w30"), 0);              // probed by the .measure
+        EXPECT_GE(reduced.findNode("in"), 0);               // source terminal
+        EXPECT_LT(reduced.findNode("w10"), 0);
+
+        double total = 0.0, reducedTotal = 0.0;
+        for (auto &c : netlist.getCapacitors()) total += c.C;
+        for (auto &c : reduced.getCapacitors()) reducedTotal += c.C;
+        EXPECT_NEAR(total, reducedTotal, 1e-20);
+
+        Simulator full(netlist), small(reduced);
+        auto delay = [](Simulator &sim, const std::string &node) {
+            auto index = sim.getIndex("v(" + node + ")");
+            auto waves = sim.solveTransient(2e-12, 1e-9);
+            for (size_t n = 1; n < waves.time.size(); n++) {
+                if (waves.x[n][index] > 0.9) return waves.time[n] - 0.125e-9;
+            }
+            return -1.0;
+        };
+        auto a = delay(full, "w60"), b = delay(small, "w60");
+        ASSERT_GT(a, 0.0);
+        EXPECT_NEAR(a, b, 0.03 * a);
+        a = delay(full, "w30");
+        b = delay(small, "w30");
+        EXPECT_NEAR(a, b, 0.03 * a);
+    }
+
+    TEST_F(SimulatorTest, Dense_MatchesSparseOnSmallCircuits) {
+        // a five stage chain (12 unknowns) runs the 16 wide kernel
+        std::ostringstream deck;
+        deck << "vdd vdd 0 1.8\nvin s0 0 pwl(0 0 0.1n 0 0.3n 1.8)\n";
+        for (int i = 0; i < 5; i++) {
+            deck << "r" << i << " vdd s" << i + 1 << " 20k\n";
+            deck << "m" << i << " s" << i + 1 << " s" << i << " 0 nmos w=1u\n";
+        }
+        auto netlist = parse(deck.str());
+
+        Simulator::Options denseOpts;
+        denseOpts.denseFill = 0.0;
+        Simulator dense(netlist, denseOpts), sparse(netlist);
+        EXPECT_TRUE(dense.isDense());
+        EXPECT_FALSE(sparse.isDense());                     // a chain factors with little fill
+
+        auto mesh = parse("v1 a 0 1\nra a b 1k\nrb a c 1k\nrc a d 1k\nrd b c 1k\nre b d 1k\nrf c d 1k\n");
+        EXPECT_TRUE(Simulator(mesh).isDense());
+
+        auto a = dense.solveOperatingPoint(), b = sparse.solveOperatingPoint();
+        for (size_t i = 0; i < a.size(); i++) EXPECT_NEAR(a[i], b[i], 1e-12) << dense.getName(int(i));
+        auto wa = dense.solveTransient(20e-12, 1e-9), wb = sparse.solveTransient(20e-12, 1e-9);
+        ASSERT_EQ(wa.time.size(), wb.time.size());
+        auto out = dense.getIndex("v(s5)");
+        for (size_t n = 0; n < wa.time.size(); n++) ASSERT_NEAR(wa.x[n][out], wb.x[n][out], 1e-9) << wa.time[n];
+    }
+
+    TEST_F(SimulatorTest, Characterize_TablesAndLiberty) {
+        // small overlap capacitance so the gate does not swamp the loads
+        auto library = parse(
+            ".model fast planar l=180n tox=5n lovl=1p vt=0.4 mun=35m mup=15m lambda=0.015 beta=100\n"
+            ".subckt inv a y vdd\nr1 vdd y 20k\nm1 y a 0 0 nmos w=1u tech=fast\n.ends\n"
+            ".char inv a y\n.chartable slews=20p,100p loads=5f,10f,20f settle=2n\n"
+            ".corner tt vdd=1.8\n.corner slow vdd=1.6 dvt=0.05 mu=0.9\n");
+        auto characterize = [&](int threads, std::ostream *liberty) {
+            Characterizer characterizer(library, threads);
+            for (auto &card : library.getAnalyses()) characterizer.add(card);
+            auto timings = characterizer.run();
+            EXPECT_EQ(characterizer.getTransientCount(), 2 * 2 * 2 * 3);
+            if (liberty) characterizer.writeLiberty(*liberty, timings);
+            return timings;
+        };
+        std::ostringstream liberty;
+        auto serial = characterize(1, &liberty), parallel = characterize(4, nullptr);
+
+        ASSERT_EQ(serial.size(), 4u);                       // corners x edges
+        for (size_t t = 0; t < serial.size(); t++) {
+            auto &timing = serial[t];
+            EXPECT_NE(timing.inputRise, timing.outputRise);  // inverting
+            ASSERT_EQ(timing.delay.size(), 6u);
+            for (size_t p = 0; p < 6; p++) {
+                EXPECT_TRUE(std::isfinite(timing.delay[p]) && timing.delay[p] > 0.0);
+                EXPECT_TRUE(std::isfinite(timing.transition[p]) && timing.transition[p] > 0.0);
+                EXPECT_DOUBLE_EQ(timing.delay[p], parallel[t].delay[p]);
+                EXPECT_DOUBLE_EQ(timing.energy[p], parallel[t].energy[p]);
+            }
+            for (size_t s = 0; s < 2; s++) {
+                EXPECT_LT(timing.delay[s * 3], timing.delay[s * 3 + 1]);
+                EXPECT_LT(timing.delay[s * 3 + 1], timing.delay[s * 3 + 2]);
+            }
+        }
+        // the slow corner pulls down later
+        EXPECT_GT(serial[2].delay[0], serial[0].delay[0]);
+
+        auto text = liberty.str();
+        EXPECT_NE(text.find("library (slow)"), std::string::npos);
+        EXPECT_NE(text.find("cell_rise (delay_template_2x3)"), std::string::npos);
+        EXPECT_NE(text.find("timing_sense : negative_unate"), std::string::npos);
+    }
+
+    TEST_F(SimulatorTest, DCSweep_ContinuationMatchesColdSolves) {
+        auto netlist = parse(
+            "vdd vdd 0 1.8\nvin in 0 0\n"
+            "r1 vdd out 20k\nm1 out in 0 0 nmos w=1u\n"
+            "r2 vdd out2 20k\nm2 out2 out 0 0 nmos w=1u\n");
+        for (auto card : {"vin 0 1.8 10m", "vt(t180nm) 0.2 0.8 5m", "w(m1) 0.5u 2u 10n"}) {
+            std::istringstream tokens(card);
+            std::vector<std::string> args{std::istream_iterator<std::string>(tokens), {}};
+            auto sweep = DCSweep::parse(netlist, args);
+
+            DCSweep::Options serialOpts, parallelOpts;
+            serialOpts.segments = 1;
+            parallelOpts.segments = 4;
+            DCSweep serial(netlist, sweep, opts, serialOpts), parallel(netlist, sweep, opts, parallelOpts);
+            auto a = serial.run(), b = parallel.run();
+            ASSERT_EQ(a.x.size(), sweep.values.size());
+            EXPECT_EQ(parallel.getStatistics().segments, 4);
+            // a couple of Newton iterations per point even at the fixture's tight tolerances
+            EXPECT_LT(serial.getStatistics().newtonIterations, 3 * serial.getStatistics().points) << card;
+
+            for (size_t i = 0; i < a.x.size(); i += 7) {
+                auto copy = netlist;
+                if (sweep.kind == DCSweep::Sweep::Kind::Source) copy.getVSource(sweep.index).wave = {Source::Shape::DC, {sweep.values[i]}};
+                if (sweep.kind == DCSweep::Sweep::Kind::Width) copy.getFet(sweep.index).W = sweep.values[i];
+                if (sweep.kind == DCSweep::Sweep::Kind::Tech) {
+                    copy.getTech(sweep.index).Vt = sweep.values[i];
+                    copy.getTech(sweep.index).update();
+                }
+                auto cold = Simulator(copy, opts).solveOperatingPoint();
+                for (size_t k = 0; k < cold.size(); k++) {
+                    EXPECT_NEAR(a.x[i][k], cold[k], 1e-6 * std::max(1.0, std::abs(cold[k]))) << card << " point " << i;
+                    EXPECT_NEAR(b.x[i][k], cold[k], 1e-6 * std::max(1.0, std::abs(cold[k]))) << card << " point " << i;
+                }
+            }
+        }
+        EXPECT_THROW(DCSweep::parse(netlist, {"foo(t180nm)", "0", "1", "0.1"}), std::runtime_error);
+        EXPECT_THROW(DCSweep::parse(netlist, {"vin", "0", "1", "-0.1"}), std::runtime_error);
+    }
+
+    TEST_F(SimulatorTest, MixedPrecision_RefinesToDoubleAccuracy) {
+        const int n = 20;
+        std::ostringstream deck;
+        deck << "vin g0_0 0 pwl(0 0 0.2n 1.8)\nm1 out g" << n - 1 << "_" << n - 1 << " 0 nmos w=1u\nrl g0_0 out 10k\n";
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                if (i + 1 < n) deck << "rv" << i << "_" << j << " g" << i << "_" << j << " g" << i + 1 << "_" << j << " 50\n";
+                if (j + 1 < n) deck << "rh" << i << "_" << j << " g" << i << "_" << j << " g" << i << "_" << j + 1 << " 50\n";
+                deck << "c" << i << "_" << j << " g" << i << "_" << j << " 0 2f\n";
+            }
+        }
+        auto netlist = parse(deck.str());
+
+        auto mixedOpts = opts;
+        mixedOpts.mixedPrecision = true;
+        Simulator full(netlist, opts), mixed(netlist, mixedOpts);
+        auto wa = full.solveTransient(20e-12, 1e-9), wb = mixed.solveTransient(20e-12, 1e-9);
+        ASSERT_EQ(wa.time.size(), wb.time.size());
+        for (size_t k = 0; k < wa.time.size(); k++) {
+            for (size_t i = 0; i < wa.x[k].size(); i++) ASSERT_NEAR(wa.x[k][i], wb.x[k][i], 1e-9) << full.getName(int(i)) << " at " << wa.time[k];
+        }
+        EXPECT_GT(mixed.getStatistics().refinementSteps, 0);
+        EXPECT_EQ(full.getStatistics().refinementSteps, 0);
+
+        // transposed solves are refined as well
+        auto out = full.getIndex("v(out)");
+        auto ga = Sensitivity(full).solveOperatingPoint(out, full.solveOperatingPoint());
+        auto gb = Sensitivity(mixed).solveOperatingPoint(out, mixed.solveOperatingPoint());
+        EXPECT_NEAR(ga.W[0], gb.W[0], 1e-9 * std::abs(ga.W[0]));
+    }
+
+    TEST_F(SimulatorTest, Checkpoint_ResumeMatchesUninterruptedRun) {
+        namespace fs = std::filesystem;
+        std::ostringstream deck;
+        deck << ".model fast planar l=180n tox=5n lovl=1p vt=0.4 mun=35m mup=15m lambda=0.015 beta=100\n";
+        deck << "vdd vdd 0 1.8\nvin s0 0 pwl(0 0 0.1n 0 0.2n 1.8 2n 1.8 2.1n 0)\n";
+        for (int i = 0; i < 4; i++) {
+            deck << "r" << i << " vdd s" << i + 1 << " 20k\n";
+            deck << "m" << i << " s" << i + 1 << " s" << i << " 0 nmos w=1u tech=fast\n";
+            deck << "c" << i << " s" << i + 1 << " 0 5f\n";
+        }
+        auto netlist = parse(deck.str());
+        std::vector<std::vector<std::string>> statements = {
+            {"tran", "delay", "trig", "v(s0)", "val=0.9", "fall=1", "targ", "v(s4)", "val=0.9", "fall=1"},
+            {"tran", "energy", "integ", "p(vdd)"},
+            {"tran", "peak", "max", "i(vdd)"}};
+        auto path = fs::temp_directory_path() / ("csim_checkpoint_" + std::to_string(::getpid()));
+        opts.multirate = true;
+
+        Simulator reference(netlist, opts);
+        MeasureEngine expected(reference);
+        for (auto &statement : statements) expected.add(statement);
+        auto full = reference.solveTransient(20e-12, 4e-9, [&](double time, const std::vector<double> &x) { expected.accept(time, x); });
+
+        // snapshot after every point and kill the run in the middle of the second pulse edge
+        {
+            Simulator sim(netlist, opts);
+            MeasureEngine measures(sim);
+            for (auto &statement : statements) measures.add(statement);
+            Checkpoint checkpoint(path, 0.0);
+            checkpoint.setAnalysis(3);
+            checkpoint.addClient({[&]() { return measures.getState(); }, [&](const std::vector<double> &s) { measures.setState(s); }});
+            sim.setCheckpoint(&checkpoint);
+            EXPECT_THROW(sim.solveTransient(20e-12, 4e-9, [&](double time, const std::vector<double> &x) {
+                if (time > 2.05e-9) throw std::runtime_error("killed");
+                measures.accept(time, x);
+            }), std::runtime_error);
+            checkpoint.flush();
+            EXPECT_GT(checkpoint.getWritten(), 0);
+        }
+        EXPECT_EQ(Checkpoint::getAnalysis(path), 3);
+
+        Simulator sim(netlist, opts);
+        MeasureEngine measures(sim);
+        for (auto &statement : statements) measures.add(statement);
+        Checkpoint checkpoint(path, 1e9);
+        checkpoint.addClient({[&]() { return measures.getState(); }, [&](const std::vector<double> &s) { measures.setState(s); }});
+        Simulator::TransientState state;
+        EXPECT_EQ(checkpoint.restore(sim, state), 3);
+        EXPECT_LE(state.t, 2.05e-9);
+        EXPECT_GT(state.t, 2e-9);
+        auto tail = sim.resumeTransient(state, [&](double time, const std::vector<double> &x) { measures.accept(time, x); });
+
+        // the resumed run takes exactly the steps the uninterrupted one took after the snapshot
+        ASSERT_FALSE(tail.time.empty());
+        auto k = std::find(full.time.begin(), full.time.end(), tail.time.front()) - full.time.begin();
+        ASSERT_EQ(full.time.size() - size_t(k), tail.time.size());
+        for (size_t n = 0; n < tail.time.size(); n++) {
+            ASSERT_EQ(full.time[k + n], tail.time[n]);
+            ASSERT_EQ(full.x[k + n], tail.x[n]) << tail.time[n];
+        }
+        EXPECT_EQ(sim.getStatistics().acceptedSteps, reference.getStatistics().acceptedSteps);
+        EXPECT_EQ(sim.getStatistics().latentSkips, reference.getStatistics().latentSkips);
+        auto a = expected.getResults(), b = measures.getResults();
+        ASSERT_EQ(a.size(), b.size());
+        for (size_t i = 0; i < a.size(); i++) {
+            EXPECT_TRUE(a[i].valid && b[i].valid) << a[i].name;
+            EXPECT_EQ(a[i].value, b[i].value) << a[i].name;
+        }
+
+        // a snapshot of another circuit is refused
+        auto other = parse(deck.str() + "r9 s4 0 1meg\nc9 s4 0 1f\n");
+        Simulator otherSim(other, opts);
+        EXPECT_THROW(checkpoint.restore(otherSim, state), std::runtime_error);
+        fs::remove(path);
+    }
+
+    TEST_F(SimulatorTest, SwitchLevel_TracksFullModel) {
+        // the planes interpolate the model on the grid and agree along every triangle edge
+        auto tech = PlanarFET::t180nm;
+        auto table = PwlFET::build(tech, ModelUtils::DevType::N, 0.05, 2.0);
+        for (double Vgs : {0.2, 0.6, 0.9, 1.8}) {
+            for (double Vds : {-0.3, 0.0, 0.45, 1.8}) {
+                auto exact = PlanarFET::getIdDerivatives(tech, 1.0, Vgs, Vds, ModelUtils::DevType::N).value;
+                auto plane = PwlFET::getPlane(table, PwlFET::locate(table, Vgs, Vds));
+                EXPECT_NEAR(plane.i0 + plane.gm * Vgs + plane.gds * Vds, exact, 1e-9 * std::abs(exact) + 1e-12) << Vgs << " " << Vds;
+            }
+        }
+        auto below = PwlFET::getPlane(table, PwlFET::locate(table, 0.9, 0.5249)), above = PwlFET::getPlane(table, PwlFET::locate(table, 0.9, 0.5251));
+        EXPECT_NEAR(below.i0 + below.gm * 0.9 + below.gds * 0.525, above.i0 + above.gm * 0.9 + above.gds * 0.525, 1e-9);
+
+        std::ostringstream deck;
+        deck << ".model fast planar l=180n tox=5n lovl=1p vt=0.4 mun=35m mup=15m lambda=0.015 beta=100\n";
+        deck << "vdd vdd 0 1.8\nvin s0 0 pwl(0 0 0.2n 0 0.3n 1.8 2n 1.8 2.1n 0)\n";
+        for (int i = 0; i < 6; i++) {
+            deck << "r" << i << " vdd s" << i + 1 << " 20k\n";
+            deck << "m" << i << " s" << i + 1 << " s" << i << " 0 nmos w=1u tech=fast\n";
+            deck << "c" << i << " s" << i + 1 << " 0 2f\n";
+        }
+        auto netlist = parse(deck.str());
+        Simulator::Options switchOpts;
+        switchOpts.switchLevel = true;
+        Simulator full(netlist), fast(netlist, switchOpts);
+        auto reference = full.solveTransient(10e-12, 4e-9), approximate = fast.solveTransient(10e-12, 4e-9);
+
+        auto report = Accuracy::compare(fast, approximate, reference);
+        ASSERT_EQ(report.nodes.size(), size_t(fast.getNodeUnknowns()));
+        EXPECT_LT(report.maxError, 0.03);
+        EXPECT_LT(report.rmsError, 0.005);
+        EXPECT_GE(report.nodes.front().maxError, report.nodes.back().maxError);
+        EXPECT_LT(Accuracy::compare(full, reference, reference).maxError, 1e-12);
+
+        // linear between region changes: factors are reused and most steps take one iteration
+        auto &stats = fast.getStatistics();
+        EXPECT_GT(stats.regionChanges, 0);
+        EXPECT_GT(stats.reusedFactorizations, 0);
+        EXPECT_LT(stats.newtonIterations, full.getStatistics().newtonIterations);
+        EXPECT_LT(stats.factorizations, stats.newtonIterations);
+        EXPECT_THROW(Sensitivity sens(fast), std::runtime_error);
+    }
+
+    TEST_F(SimulatorTest, Server_KeepsDesignsBetweenRequests) {
+        SimulationServer server(opts, {});
+        std::ostringstream requests;
+        requests << "deck inv\n";
+        requests << ".model fast planar l=180n tox=5n lovl=1p vt=0.4 mun=35m mup=15m lambda=0.015 beta=100\n";
+        requests << "vdd vdd 0 1.8\nvin in 0 pwl(0 0 0.1n 0 0.2n 1.8)\n";
+        requests << "r1 vdd out 20k\nm1 out in 0 nmos w=1u tech=fast\nc1 out 0 5f\n.end\n";
+        requests << "measure inv tran fall trig v(in) val=0.9 rise=1 targ v(out) val=0.9 fall=1\n";
+        requests << "tran inv 10p 1n v(out)\n";
+        requests << "set inv w(m1) 4u\ntran inv 10p 1n v(out)\n";
+        requests << "source inv vin dc 0\nop inv\n";
+        requests << "corner inv vdd=1.2 dvt=0.1\nop inv\n";
+        requests << "reset inv\ntran inv 10p 1n v(out)\n";
+        requests << "set inv w(m9) 1u\nbogus\nlist\nquit\nlist\n";
+        std::istringstream in(requests.str());
+        std::ostringstream out;
+        EXPECT_TRUE(server.serve(in, out));
+
+        std::vector<std::vector<std::string>> lines;
+        std::istringstream response(out.str());
+        for (std::string line; std::getline(response, line);) {
+            std::istringstream words(line);
+            lines.emplace_back(std::istream_iterator<std::string>(words), std::istream_iterator<std::string>());
+        }
+        auto collect = [&](const std::string &kind) {
+            std::vector<std::vector<std::string>> found;
+            for (auto &line : lines) {
+                if (!line.empty() && line[0] == kind) found.push_back(line);
+            }
+            return found;
+        };
+        auto oks = collect("ok"), errors = collect("error"), measures = collect("measure"), ops = collect("x");
+        EXPECT_EQ(oks.size(), size_t(13));
+        ASSERT_EQ(errors.size(), size_t(2));
+        ASSERT_EQ(measures.size(), size_t(3));
+        EXPECT_EQ(collect("columns").front(), (std::vector<std::string>{"columns", "time", "v(out)"}));
+        EXPECT_FALSE(collect("t").empty());
+        EXPECT_EQ(collect("design").size(), size_t(1));
+        EXPECT_EQ(lines.back(), std::vector<std::string>{"ok"});
+
+        // a wider pull-down falls faster, and reset brings back the deck as it was read
+        auto fall = [&](int i) { return std::stod(measures[size_t(i)][2]); };
+        EXPECT_LT(fall(1), fall(0));
+        EXPECT_EQ(fall(2), fall(0));
+
+        // with the input low the output sits at the supply, which the corner lowered
+        auto output = [&](double vdd) {
+            for (auto &line : ops) {
+                if (line[1] == "v(out)" && std::abs(std::stod(line[2]) - vdd) < 1e-6) return true;
+            }
+            return false;
+        };
+        EXPECT_TRUE(output(1.8));
+        EXPECT_TRUE(output(1.2));
+
+        std::istringstream stop("shutdown\n");
+        std::ostringstream ack;
+        EXPECT_FALSE(server.serve(stop, ack));
+        EXPECT_EQ(ack.str(), "ok\n");
+    }
+
+    TEST_F(SimulatorTest, Stimulus_StreamsVectorsIntoRampedSources) {
+        namespace fs = std::filesystem;
+        auto dir = fs::temp_directory_path() / ("csim_stimulus_" + std::to_string(::getpid()));
+        fs::create_directories(dir);
+        {
+            std::ofstream vcd(dir / "tb.vcd");
+            vcd << "$timescale 1ps $end\n$scope module tb $end\n";
+            vcd << "$var wire 1 ! in $end\n$var wire 2 \" bus [1:0] $end\n$var wire 1 # unused $end\n";
+            vcd << "$upscope $end\n$enddefinitions $end\n";
+            vcd << "#0\n$dumpvars\n0!\nb01 \"\n1# $end\n#500\n1!\n0#\n#600\n1#\n#800\nb10 \"\n#1500\n0!\nb1 \"\n";
+            vcd << "#1700\nx!\n#2400\n0!\n#2500\n1!\n#2520\n0!\n";
+            std::ofstream table(dir / "tb.vec");
+            table << "time in bus[0] bus[1]\n* the same edges up to 2n\n0 0 1 0\n500p 1 1 0\n800p 1 0 1\n1500p 0 1 0\n";
+        }
+        std::string circuit =
+            ".model fast planar l=180n tox=5n lovl=1p vt=0.4 mun=35m mup=15m lambda=0.015 beta=100\n"
+            "vdd vdd 0 1.8\nr1 vdd out 20k\nm1 out in 0 nmos w=1u tech=fast\nc1 out 0 5f\n"
+            "rb0 bus[0] mid 10k\nrb1 bus[1] mid 10k\ncm mid 0 10f\n";
+        auto reference = parse(circuit +
+            "vin in 0 pwl(0 0 500p 0 550p 1.8 1500p 1.8 1550p 0)\n"
+            "vb0 bus[0] 0 pwl(0 1.8 800p 1.8 850p 0 1500p 0 1550p 1.8)\n"
+            "vb1 bus[1] 0 pwl(0 0 800p 0 850p 1.8 1500p 1.8 1550p 0)\n");
+        Simulator expectedSim(reference, opts);
+        auto expected = expectedSim.solveTransient(10e-12, 2e-9);
+        auto sample = [](const Simulator::Waveforms &waves, int index, double time) {
+            auto k = size_t(std::lower_bound(waves.time.begin(), waves.time.end(), time) - waves.time.begin());
+            if (k == 0) return waves.x[0][size_t(index)];
+            auto f = (time - waves.time[k - 1]) / (waves.time[k] - waves.time[k - 1]);
+            return waves.x[k - 1][size_t(index)] + f * (waves.x[k][size_t(index)] - waves.x[k - 1][size_t(index)]);
+        };
+
+        for (auto file : {"tb.vcd", "tb.vec"}) {
+            auto netlist = parse(circuit + ".stimulus " + (dir / file).string() + " vhigh=1.8 rise=50p fall=50p\n");
+            ASSERT_EQ(netlist.getAnalyses().size(), size_t(1));
+            auto &card = netlist.getAnalyses()[0].args;
+            Stimulus stimulus(card[0], Stimulus::parse(std::vector<std::string>(card.begin() + 1, card.end())));
+            EXPECT_EQ(stimulus.attach(netlist), 3) << file;
+            EXPECT_GE(netlist.findVSource("vstim_bus[1]"), 0);
+            Simulator sim(netlist, opts);
+            sim.addStimulus(&stimulus);
+            auto waves = sim.solveTransient(10e-12, 2e-9);
+
+            // every edge and ramp end is landed on, and the run follows the equivalent pwl deck
+            for (auto edge : {500e-12, 550e-12, 800e-12, 850e-12, 1500e-12, 1550e-12}) {
+                auto k = std::lower_bound(waves.time.begin(), waves.time.end(), edge * (1 - 1e-12)) - waves.time.begin();
+                EXPECT_NEAR(waves.time[size_t(k)], edge, 1e-21) << file;
+            }
+            for (auto output : {"v(in)", "v(bus[0])", "v(mid)", "v(out)"}) {
+                double worst = 0.0;
+                for (int n = 0; n <= 200; n++) {
+                    auto time = 2e-9 * n / 200;
+                    worst = std::max(worst, std::abs(sample(waves, sim.getIndex(output), time) - sample(expected, expectedSim.getIndex(output), time)));
+                }
+                EXPECT_LT(worst, 2e-3) << file << " " << output;
+            }
+            EXPECT_EQ(stimulus.getEdges(), 6);
+        }
+
+        // a glitch turns around mid ramp at the same slew. x holds the level and a change to the
+        // level a source already has is not a breakpoint
+        auto netlist = parse(circuit);
+        Stimulus stimulus(dir / "tb.vcd", Stimulus::Options());
+        EXPECT_EQ(stimulus.attach(netlist), 3);
+        auto vin = netlist.findVSource("vstim_in");
+        stimulus.seek(1800e-12);
+        EXPECT_DOUBLE_EQ(Source::getValue(netlist.getVSource(vin).wave, 1800e-12), 0.0);
+        EXPECT_DOUBLE_EQ(stimulus.nextBreakpoint(), 2500e-12);
+        stimulus.seek(2530e-12);
+        EXPECT_NEAR(Source::getValue(netlist.getVSource(vin).wave, 2530e-12), 0.36, 1e-9);
+        EXPECT_NEAR(stimulus.nextBreakpoint(), 2540e-12, 1e-21);
+        stimulus.advance(3e-9);
+        EXPECT_TRUE(std::isinf(stimulus.nextBreakpoint()));
+
+        Simulator::Options partitioned;
+        partitioned.partition = true;
+        Simulator blocks(netlist, partitioned);
+        EXPECT_THROW(blocks.addStimulus(&stimulus), std::runtime_error);
+        fs::remove_all(dir);
+    }
+
+    TEST_F(SimulatorTest, DeviceStats_BlamesDevicesForNewtonAndTimestepEffort) {
+        std::ostringstream deck;
+        deck << ".model fast planar l=180n tox=5n lovl=1p vt=0.4 mun=35m mup=15m lambda=0.015 beta=100\n";
+        deck << "vdd vdd 0 1.8\nvin s0 0 pwl(0 0 0.2n 0 0.25n 1.8)\n";
+        for (int i = 0; i < 4; i++) {
+            deck << "r" << i << " vdd s" << i + 1 << " 20k\n";
+            deck << "m" << i << " s" << i + 1 << " s" << i << " 0 nmos w=" << (i == 2 ? "8u" : "1u") << " tech=fast\n";
+            deck << "c" << i << " s" << i + 1 << " 0 5f\n";
+        }
+        auto netlist = parse(deck.str());
+        Simulator sim(netlist, opts);
+        sim.solveTransient(10e-12, 2e-9);
+        auto &stats = sim.getDeviceStats();
+        auto &totals = sim.getStatistics();
+        if (!DeviceStats::ENABLED) {
+            EXPECT_TRUE(stats.get().empty());
+        } else {
+            ASSERT_EQ(stats.get().size(), size_t(4));
+            long worst = 0, rejections = 0;
+            for (auto &c : stats.get()) {
+                EXPECT_EQ(c.evaluations, totals.newtonIterations);
+                worst += c.worstResidual;
+                rejections += c.rejections;
+            }
+            EXPECT_GT(worst, 0);
+            EXPECT_LE(worst, totals.newtonIterations);
+            EXPECT_LE(rejections, totals.rejectedSteps);
+        }
+
+        // attribution and reports do not depend on the build
+        DeviceStats manual;
+        manual.attach(netlist);
+        manual[0].rejections = 7;
+        manual[2].rejections = 5;
+        manual[1].limited = 1;
+        EXPECT_EQ(manual.top(DeviceStats::Key::Rejections, 1), std::vector<int>{0});
+        EXPECT_EQ(manual.top(DeviceStats::Key::Rejections, 5), (std::vector<int>{0, 2}));
+        EXPECT_TRUE(manual.top(DeviceStats::Key::WorstResidual, 5).empty());
+        // s(i+1) is the drain of mi and the gate of m(i+1), the larger current is blamed
+        manual.setCurrent(1, 1e-5);
+        manual.setCurrent(2, 4e-5);
+        EXPECT_EQ(manual.blame(netlist.findNode("s1")), 1);
+        EXPECT_EQ(manual.blame(netlist.findNode("s2")), 2);
+        EXPECT_EQ(manual.blame(netlist.findNode("vdd")), -1);
+        std::ostringstream csv;
+        manual.write(csv, netlist);
+        EXPECT_EQ(csv.str(), "fet,evaluations,bypassed,limited,worst_residual,rejections\nm0,0,0,0,0,7\nm1,0,0,1,0,0\nm2,0,0,0,0,5\n");
+        DeviceStats twice = manual;
+        twice.add(manual);
+        EXPECT_EQ(twice.get()[0].rejections, 14);
+    }
+
+    TEST_F(SimulatorTest, Probe_DecimatesSelectedSignalsWithinTolerance) {
+        EXPECT_TRUE(ProbeWriter::match("x1.*", "x1.mid"));
+        EXPECT_FALSE(ProbeWriter::match("x1.*", "x1.x2.mid"));
+        EXPECT_TRUE(ProbeWriter::match("x1.**", "x1.x2.mid"));
+        EXPECT_TRUE(ProbeWriter::match("x?.m*", "x2.m1"));
+        EXPECT_FALSE(ProbeWriter::match("x?.m*", "x12.m1"));
+
+        auto netlist = parse(
+            ".model fast planar l=180n tox=5n lovl=1p vt=0.4 mun=35m mup=15m lambda=0.015 beta=100\n"
+            ".subckt stage in out vdd\n"
+            "r1 vdd mid 10k\nr2 mid out 10k\nc2 mid 0 1f\n"
+            "m1 out in 0 nmos w=1u tech=fast\nc1 out 0 5f\n"
+            ".ends\n"
+            "vdd vdd 0 1.8\nvin s0 0 pwl(0 0 0.5n 0 0.6n 1.8 2n 1.8 2.1n 0)\n"
+            "x1 s0 s1 vdd stage\nx2 s1 s2 vdd stage\nx3 s2 s3 vdd stage\n");
+        Simulator sim(netlist, opts);
+        std::vector<std::vector<std::string>> cards = {{"tol=1m", "v(x*.mid)", "v(s3)"}, {"step=100p", "i(x2.*)", "p(vdd)"}, {"v(s3)", "i(vdd)"}};
+        auto make = [&]() {
+            auto probes = std::make_unique<ProbeWriter>(sim);
+            for (auto &card : cards) probes->add(card);
+            return probes;
+        };
+        auto probes = make();
+        ASSERT_EQ(probes->getSignalCount(), 9u);       // v(s3) is kept once, with tol=1m
+        EXPECT_EQ(probes->getName(0), "v(x1.mid)");
+        EXPECT_THROW(probes->add({"v(x9.*)"}), std::runtime_error);
+        EXPECT_THROW(probes->add({"tol=1m"}), std::runtime_error);
+
+        std::ostringstream out;
+        ProbeWriter::writeHeader(out);
+        auto waves = sim.solveTransient(5e-12, 4e-9, [&](double time, const std::vector<double> &x) { probes->accept(time, x, out); }, true);
+        probes->finish(out);
+
+        std::map<std::string, std::vector<std::pair<double, double>>> stored;
+        std::istringstream rows(out.str());
+        std::string line;
+        std::getline(rows, line);
+        EXPECT_EQ(line, "signal,time,value");
+        while (std::getline(rows, line)) {
+            auto a = line.find(','), b = line.find(',', a + 1);
+            stored[line.substr(0, a)].emplace_back(std::stod(line.substr(a + 1, b - a - 1)), std::stod(line.substr(b + 1)));
+        }
+        ASSERT_EQ(stored.size(), 9u);
+        long count = 0;
+        for (auto &signal : stored) count += long(signal.second.size());
+        EXPECT_EQ(probes->getStored(), count);
+        EXPECT_EQ(probes->getSamples(), long(9 * waves.time.size()));
+
+        // lines between the stored points stay within tol of every accepted point, edges included
+        auto n = waves.time.size();
+        for (auto name : {"v(x1.mid)", "v(x3.mid)", "v(s3)"}) {
+            auto &points = stored[name];
+            EXPECT_LT(points.size() * 10, n) << name;
+            EXPECT_EQ(points.front().first, 0.0);
+            EXPECT_EQ(points.back().first, waves.time.back());
+            auto index = sim.getIndex(name);
+            size_t k = 0;
+            for (size_t i = 0; i < n; i++) {
+                auto t = waves.time[i];
+                while (k + 2 < points.size() && points[k + 1].first < t) k++;
+                auto &p0 = points[k], &p1 = points[k + 1];
+                auto v = p0.second + (p1.second - p0.second) * (t - p0.first) / (p1.first - p0.first);
+                ASSERT_NEAR(v, waves.x[i][index], 1e-3 * (1 + 1e-6)) << name << " at " << t;
+            }
+        }
+        // the grid has a point every step, the plain probe every accepted point
+        EXPECT_EQ(stored["p(vdd)"].size(), 41u);
+        EXPECT_EQ(stored["i(x2.m1)"].size(), 41u);
+        EXPECT_NEAR(stored["p(vdd)"][20].first, 2e-9, 1e-18);
+        EXPECT_EQ(stored["i(vdd)"].size(), n);
+        EXPECT_GT(stored["p(vdd)"].back().second, 0.0);
+
+        // a run continued from a snapshot of the open segments writes the same rows
+        std::ostringstream resumed;
+        ProbeWriter::writeHeader(resumed);
+        auto first = make();
+        for (size_t i = 0; i < n / 2; i++) first->accept(waves.time[i], waves.x[i], resumed);
+        auto second = make();
+        second->setState(first->getState());
+        for (size_t i = n / 2; i < n; i++) second->accept(waves.time[i], waves.x[i], resumed);
+        second->finish(resumed);
+        EXPECT_EQ(resumed.str(), out.str());
+        EXPECT_EQ(second->getStored(), probes->getStored());
+    }
+
+    TEST_F(SimulatorTest, Chord_ReusesFactorsWhileNewtonContracts) {
+        // inverters loading a resistive supply mesh, whose factors are the expensive part
+        std::ostringstream deck;
+        deck << ".model thin planar l=180n tox=5n lovl=1p vt=0.4 mun=35m mup=15m lambda=0.015 beta=100\n";
+        deck << "vdd vdd 0 1.8\nvin in 0 pulse(0 1.8 0.2n 50p 50p 1n 2n)\n";
+        for (int i = 0; i < 8; i++) {
+            for (int j = 0; j < 8; j++) {
+                if (i < 7) deck << "rh" << i << j << " g" << i << j << " g" << i + 1 << j << " 2\n";
+                if (j < 7) deck << "rv" << i << j << " g" << i << j << " g" << i << j + 1 << " 2\n";
+                deck << "c" << i << j << " g" << i << j << " 0 20f\n";
+            }
+        }
+        deck << "rs vdd g00 0.1\n";
+        for (int k = 0; k < 4; k++) {
+            deck << "rl" << k << " g" << 2 * k + 1 << 6 << " o" << k << " 5k\n";
+            deck << "cl" << k << " o" << k << " 0 5f\n";
+            deck << "m" << k << " o" << k << " in 0 nmos w=2u tech=thin\n";
+        }
+        auto netlist = parse(deck.str());
+        Simulator::Options chordOpts;
+        chordOpts.chord = true;
+        Simulator full(netlist), chord(netlist, chordOpts);
+        std::ostringstream log;
+        chord.setChordLog(&log);
+        auto reference = full.solveTransient(10e-12, 4e-9), waves = chord.solveTransient(10e-12, 4e-9);
+
+        // the same solution as full Newton, well within its tolerance
+        EXPECT_LT(Accuracy::compare(chord, waves, reference).maxError, 1e-4);
+
+        auto &stats = chord.getStatistics();
+        EXPECT_LT(stats.factorizations * 2, full.getStatistics().factorizations);
+        EXPECT_GT(stats.reusedFactorizations, 0);
+        EXPECT_EQ(stats.refactors[size_t(Simulator::Refactor::Fresh)], 1);
+        EXPECT_GT(stats.refactors[size_t(Simulator::Refactor::Region)], 0);
+
+        // one row per transient Newton iteration, each factorization with its reason
+        std::istringstream rows(log.str());
+        std::string row;
+        std::getline(rows, row);
+        EXPECT_EQ(row, "time,h,iteration,factored,reason,contraction");
+        long factored = 0, reused = 0;
+        while (std::getline(rows, row)) {
+            std::istringstream fields(row);
+            std::string field;
+            for (int column = 0; column < 4; column++) std::getline(fields, field, ',');
+            if (field == "1") factored++;
+            else reused++;
+        }
+        long refactors = 0;
+        for (auto count : stats.refactors) refactors += count;
+        EXPECT_EQ(factored, refactors);
+        EXPECT_EQ(reused, stats.reusedFactorizations);
+    }
+
+    TEST_F(SimulatorTest, Chord_CarriedThroughCheckpointsNotAcrossTransients) {
+        namespace fs = std::filesystem;
+        std::ostringstream deck;
+        deck << ".model fast planar l=180n tox=5n lovl=1p vt=0.4 mun=35m mup=15m lambda=0.015 beta=100\n";
+        deck << "vdd vdd 0 1.8\nvin s0 0 pwl(0 0 0.1n 0 0.2n 1.8 2n 1.8 2.1n 0)\n";
+        for (int i = 0; i < 4; i++) {
+            deck << "r" << i << " vdd s" << i + 1 << " 20k\n";
+            deck << "m" << i << " s" << i + 1 << " s" << i << " 0 nmos w=1u tech=fast\n";
+            deck << "c" << i << " s" << i + 1 << " 0 5f\n";
+        }
+        auto netlist = parse(deck.str());
+        auto path = fs::temp_directory_path() / ("csim_chord_checkpoint_" + std::to_string(::getpid()));
+
+        // dense, sparse and per partition group factors
+        for (int config = 0; config < 3; config++) {
+            auto options = opts;
+            options.chord = true;
+            if (config == 1) options.denseThreshold = 0;
+            if (config == 2) options.multirate = true;
+
+            Simulator reference(netlist, options);
+            auto full = reference.solveTransient(20e-12, 4e-9);
+            EXPECT_GT(reference.getStatistics().reusedFactorizations, 0) << config;
+            {
+                Simulator sim(netlist, options);
+                Checkpoint checkpoint(path, 0.0);
+                sim.setCheckpoint(&checkpoint);
+                EXPECT_THROW(sim.solveTransient(20e-12, 4e-9, [&](double time, const std::vector<double> &) {
+                    if (time > 2.05e-9) throw std::runtime_error("killed");
+                }), std::runtime_error);
+                checkpoint.flush();
+            }
+
+            // the resumed run continues on the factors the uninterrupted one held at the snapshot
+            Simulator sim(netlist, options);
+            Checkpoint checkpoint(path, 1e9);
+            Simulator::TransientState state;
+            checkpoint.restore(sim, state);
+            EXPECT_FALSE(state.chord.empty()) << config;
+            auto tail = sim.resumeTransient(state);
+            ASSERT_FALSE(tail.time.empty());
+            auto k = std::find(full.time.begin(), full.time.end(), tail.time.front()) - full.time.begin();
+            ASSERT_EQ(full.time.size() - size_t(k), tail.time.size()) << config;
+            for (size_t n = 0; n < tail.time.size(); n++) ASSERT_EQ(full.x[k + n], tail.x[n]) << config << " " << tail.time[n];
+            EXPECT_EQ(sim.getStatistics().reusedFactorizations, reference.getStatistics().reusedFactorizations) << config;
+        }
+        fs::remove(path);
+
+        // a second transient after a load edited in place starts from fresh factors, like a new simulator
+        Simulator::Options options;
+        options.chord = true;
+        Simulator reused(netlist, options);
+        reused.solveTransient(20e-12, 4e-9);
+        netlist.getCapacitor(3).C = 20e-15;
+        Simulator fresh(netlist, options);
+        auto a = reused.solveTransient(20e-12, 4e-9), b = fresh.solveTransient(20e-12, 4e-9);
+        ASSERT_EQ(a.time, b.time);
+        EXPECT_EQ(a.x, b.x);
+    }
+
+    TEST_F(SimulatorTest, SymbolicCache_ReusedForTheSameSparsityPattern) {
+        namespace fs = std::filesystem;
+        auto dir = fs::temp_directory_path() / ("csim_symbolic_" + std::to_string(::getpid()));
+        fs::remove_all(dir);
+        auto mesh = [&](const std::string &r, bool extra) {
+            std::ostringstream deck;
+            deck << "vin g0_0 0 pwl(0 0 0.2n 1.8)\nm1 out g5_5 0 nmos w=1u\nrl g0_0 out 10k\n";
+            for (int i = 0; i < 6; i++) {
+                for (int j = 0; j < 6; j++) {
+                    if (i < 5) deck << "rv" << i << j << " g" << i << "_" << j << " g" << i + 1 << "_" << j << " " << r << "\n";
+                    if (j < 5) deck << "rh" << i << j << " g" << i << "_" << j << " g" << i << "_" << j + 1 << " " << r << "\n";
+                    deck << "c" << i << j << " g" << i << "_" << j << " 0 2f\n";
+                }
+            }
+            if (extra) deck << "rx g0_5 g5_0 1k\n";
+            return parse(deck.str());
+        };
+        auto entries = [&]() { return std::distance(fs::directory_iterator(dir), fs::directory_iterator()); };
+        Simulator::Options cacheOpts;
+        cacheOpts.denseThreshold = 0;
+        cacheOpts.symbolicCache = dir.string();
+
+        auto netlist = mesh("50", false);
+        Simulator plain(netlist), cold(netlist, cacheOpts), warm(netlist, cacheOpts);
+        EXPECT_FALSE(cold.isSymbolicCached());
+        EXPECT_TRUE(warm.isSymbolicCached());
+        EXPECT_EQ(entries(), 1);
+        // the same order and schedule, so bit for bit the same waveforms
+        auto reference = plain.solveTransient(20e-12, 1e-9);
+        EXPECT_EQ(warm.solveTransient(20e-12, 1e-9).x, reference.x);
+
+        // values do not matter, structure and solver kind do
+        auto other = mesh("80", false), changed = mesh("50", true);
+        EXPECT_TRUE(Simulator(other, cacheOpts).isSymbolicCached());
+        EXPECT_FALSE(Simulator(changed, cacheOpts).isSymbolicCached());
+        auto iterOpts = cacheOpts;
+        iterOpts.linearSolver = Simulator::LinearSolver::Iterative;
+        EXPECT_FALSE(Simulator(netlist, iterOpts).isSymbolicCached());
+        EXPECT_TRUE(Simulator(netlist, iterOpts).isSymbolicCached());
+        EXPECT_EQ(entries(), 3);
+
+        // a damaged entry is a miss and gets rewritten
+        SparseMatrix pattern(3);
+        for (int i = 0; i < 3; i++) pattern.reserve(i, i);
+        pattern.reserve(0, 2);
+        auto entry = SymbolicCache::getPath(dir, pattern.getPatternHash());
+        bool hit = true;
+        SymbolicCache::finalize(dir, pattern, true, &hit);
+        EXPECT_FALSE(hit);
+        auto size = fs::file_size(entry);
+        for (auto offset : {size / 2, size - 1}) {
+            {
+                std::fstream file(entry, std::ios::in | std::ios::out | std::ios::binary);
+                file.seekp(std::streamoff(offset));
+                file.put('\x7f');
+            }
+            SparseMatrix again(3);
+            for (int i = 0; i < 3; i++) again.reserve(i, i);
+            again.reserve(0, 2);
+            SymbolicCache::finalize(dir, again, true, &hit);
+            EXPECT_FALSE(hit) << offset;
+            EXPECT_EQ(again.getSlot(2, 0), pattern.getSlot(2, 0));
+        }
+
+        // a cache that cannot be written is skipped, the ordering is still computed
+        auto blocked = cacheOpts;
+        blocked.symbolicCache = (dir / "not_a_directory").string();
+        std::ofstream(blocked.symbolicCache) << "x";
+        std::unique_ptr<Simulator> uncached;
+        ASSERT_NO_THROW(uncached = std::make_unique<Simulator>(netlist, blocked));
+        EXPECT_FALSE(uncached->isSymbolicCached());
+        EXPECT_FALSE(uncached->getSymbolicCacheError().empty());
+        EXPECT_EQ(uncached->solveTransient(20e-12, 1e-9).x, reference.x);
+        EXPECT_TRUE(cold.getSymbolicCacheError().empty());
+        fs::remove_all(dir);
+    }
+
+    TEST_F(SimulatorTest, KernelProfile_CountsNewtonPhases) {
+        auto netlist = commonSource();
+        Simulator sim(netlist);
+        KernelProfile profile;
+        sim.setKernelProfile(&profile);
+        sim.solveTransient(10e-12, 1e-9);
+
+        // every Newton iteration loads, evaluates the FETs and solves once
+        using Phase = KernelProfile::Phase;
+        auto &stats = sim.getStatistics();
+        EXPECT_EQ(profile.get(Phase::Load).calls, stats.newtonIterations);
+        EXPECT_EQ(profile.get(Phase::Devices).calls, stats.newtonIterations);
+        EXPECT_EQ(profile.get(Phase::Solve).calls, stats.newtonIterations);
+        EXPECT_EQ(profile.get(Phase::Factor).calls, stats.factorizations);
+        EXPECT_EQ(profile.get(Phase::Devices).units, 2.0 * stats.newtonIterations);
+        for (auto phase : {Phase::Devices, Phase::Load, Phase::Factor, Phase::Solve}) EXPECT_GT(profile.get(phase).seconds, 0.0);
+
+        std::ostringstream csv;
+        profile.write(csv);
+        auto text = csv.str();
+        EXPECT_EQ(std::count(text.begin(), text.end(), '\n'), 5);
+        EXPECT_EQ(text.rfind("phase,calls,units,seconds,ns_per_unit,cycles,", 0), 0u);
+
+        // counters depend on the machine and on perf_event_paranoid, times do not
+        if (!profile.hasCounters()) {
+            EXPECT_FALSE(profile.getError().empty());
+            EXPECT_EQ(profile.getIpc(Phase::Factor), 0.0);
+            return;
+        }
+        if (profile.hasEvent(PerfCounters::Instructions)) {
+            EXPECT_GT(profile.get(Phase::Devices).counts[PerfCounters::Instructions], 0.0);
+        }
+        if (profile.hasEvent(PerfCounters::Cycles) && profile.hasEvent(PerfCounters::Instructions)) {
+            EXPECT_GT(profile.getIpc(Phase::Devices), 0.0);
+        }
+    }
+
+    TEST_F(SimulatorTest, MemoryReport_ProjectsFactorsBeforeTheFirstSolve) {
+        using Subsystem = MemoryReport::Subsystem;
+        std::ostringstream deck;
+        deck << "vin g0_0 0 pwl(0 0 0.2n 1.8)\nm1 out g9_9 0 nmos w=1u\nrl g0_0 out 10k\n";
+        for (int i = 0; i < 10; i++) {
+            for (int j = 0; j < 10; j++) {
+                if (i < 9) deck << "rv" << i << j << " g" << i << "_" << j << " g" << i + 1 << "_" << j << " 50\n";
+                if (j < 9) deck << "rh" << i << j << " g" << i << "_" << j << " g" << i << "_" << j + 1 << " 50\n";
+                deck << "c" << i << j << " g" << i << "_" << j << " 0 2f\n";
+            }
+        }
+        auto netlist = parse(deck.str());
+        Simulator::Options sparse;
+        sparse.denseThreshold = 0;
+        Simulator sim(netlist, sparse);
+
+        MemoryReport::Usage before, projected, after;
+        netlist.getMemory(before);
+        EXPECT_GT(before[Subsystem::Elements], 0u);
+        EXPECT_GT(before[Subsystem::Nodes], 0u);
+        sim.getMemory(before);
+        sim.getMemory(projected, true);
+        EXPECT_GT(projected[Subsystem::Factors], before[Subsystem::Factors]);
+        // the ordering's adjacency sets are gone once the pattern is fixed
+        EXPECT_GT(sim.getSymbolicPeak(), before[Subsystem::Matrix]);
+
+        sim.solveTransient(20e-12, 0.2e-9);
+        sim.getMemory(after);
+        EXPECT_EQ(after[Subsystem::Factors], projected[Subsystem::Factors]);
+        EXPECT_EQ(after[Subsystem::Matrix], projected[Subsystem::Matrix]);
+        EXPECT_EQ(after[Subsystem::Models], projected[Subsystem::Models]);
+
+        // peaks per subsystem and of the total are kept apart
+        MemoryReport report;
+        MemoryReport::Usage a, b;
+        a[Subsystem::Matrix] = 100;
+        a[Subsystem::Factors] = 10;
+        b[Subsystem::Factors] = 50;
+        report.record(a);
+        report.record(b);
+        EXPECT_EQ(report.getCurrent().getTotal(), 50u);
+        EXPECT_EQ(report.getPeak()[Subsystem::Matrix], 100u);
+        EXPECT_EQ(report.getPeak()[Subsystem::Factors], 50u);
+        EXPECT_EQ(report.getPeakTotal(), 110u);
+        EXPECT_EQ(MemoryReport::bytes(std::string("gnd")), 0u);
+        EXPECT_GT(MemoryReport::bytes(std::string(100, 'x')), 100u);
+        EXPECT_EQ(MemoryReport::format(3u << 20), "3.0 MB");
+    }
+
+    TEST_F(SimulatorTest, ChargeModel_ConservesFloatingGateCharge) {
+        // a gate only reachable through a coupling cap: every input pulse and drain swing has to
+        // give back exactly the charge it put on the gate, so v(g) returns to 0 after each cycle.
+        // small overlaps so the channel charge dominates the gate
+        auto netlist = parse(
+            ".model thin planar l=180n tox=5n lovl=1p vt=0.4 mun=35m mup=15m lambda=0.015 beta=100\n"
+            "vin in 0 pwl(0 0 1n 0 1.2n 1.8 3n 1.8 3.2n 0 5n 0 5.2n 1.8 7n 1.8 7.2n 0 9n 0 9.2n 1.8 11n 1.8 11.2n 0)\n"
+            "vd d 0 pwl(0 1.8 2n 1.8 2.2n 0.1 2.6n 0.1 2.8n 1.8 6n 1.8 6.2n 0.1 6.6n 0.1 6.8n 1.8 10n 1.8 10.2n 0.1 10.6n 0.1 10.8n 1.8)\n"
+            "cc in g 5f\n"
+            "m1 d g 0 nmos w=4u tech=thin\n");
+        Simulator::Options tranOpts;
+        Simulator sim(netlist, tranOpts);
+        auto waves = sim.solveTransient(10e-12, 13e-9);
+        auto g = sim.getIndex("v(g)");
+
+        auto at = [&](double t) {
+            auto n = size_t(std::lower_bound(waves.time.begin(), waves.time.end(), t) - waves.time.begin());
+            return waves.x[n][g];
+        };
+        // the gate is pushed past threshold in between
+        EXPECT_GT(at(2e-9), 0.4);
+        for (auto t : {4.9e-9, 8.9e-9, 12.9e-9}) EXPECT_NEAR(at(t), 0.0, 1e-5);
+    }
+
+    TEST_F(SimulatorTest, Transient_RCCharge) {
+        auto netlist = parse("v1 in 0 pulse(0 1 0 1p 1p 1 2)\nr1 in out 1k\nc1 out 0 1p\n");
+        Simulator::Options tranOpts;
+        Simulator sim(netlist, tranOpts);
+        auto waves = sim.solveTransient(50e-12, 5e-9);
+        auto out = sim.getIndex("v(out)");
+
+        EXPECT_DOUBLE_EQ(waves.time.back(), 5e-9);
+        EXPECT_NEAR(waves.x.back()[out], 1.0 - std::exp(-5.0), 1e-2);
+
+        // statistics count one transient at a time
+        auto steps = sim.getStatistics().acceptedSteps;
+        sim.solveTransient(50e-12, 5e-9);
+        EXPECT_EQ(sim.getStatistics().acceptedSteps, steps);
+    }
+
+    TEST_F(SimulatorTest, Sensitivity_OperatingPoint_MatchesFiniteDifference) {
+        auto netlist = commonSource();
+        Simulator sim(netlist, opts);
+        auto out = sim.getIndex("v(out)");
+        auto grad = Sensitivity(sim).solveOperatingPoint(out, sim.solveOperatingPoint());
+
+        auto solve = [&](Netlist &n) { Simulator s(n, opts); return s.solveOperatingPoint()[out]; };
+        for (int k = 0; k < 2; k++) {
+            double dW = 1e-6 * netlist.getFets()[k].W;
+            auto up = commonSource(), down = commonSource();
+            up.getFet(k).W += dW;
+            down.getFet(k).W -= dW;
+            auto fd = (solve(up) - solve(down)) / (2 * dW);
+            EXPECT_NEAR(grad.W[k], fd, 1e-4 * std::abs(fd) + 1e-6);
+        }
+
+        for (std::string param : {"L", "Tox", "Vt", "MUn", "LAMBDA", "BETA"}) {
+            auto tech = netlist.findTech("t180nm");
+            auto base = techGradient(grad.tech[tech], param);
+            auto up = commonSource(), down = commonSource();
+            double value = param == "L" ? 180e-9 : param == "Tox" ? 5e-9 : param == "Vt" ? 0.4 : param == "MUn" ? 35e-3 : param == "LAMBDA" ? 0.015 : 100;
+            double delta = 1e-6 * value;
+            rebuildTech(up, tech, param, delta);
+            rebuildTech(down, tech, param, -delta);
+            auto fd = (solve(up) - solve(down)) / (2 * delta);
+            EXPECT_NEAR(base, fd, 1e-4 * std::abs(fd) + 1e-9) << param;
+        }
+    }
+
+    TEST_F(SimulatorTest, Sensitivity_Transient_MatchesFiniteDifference) {
+        auto netlist = commonSource();
+        Simulator sim(netlist, opts);
+        auto out = sim.getIndex("v(out)");
+        auto supply = sim.getIndex("i(vdd)");
+        auto waves = sim.solveTransient(10e-12, 0.4e-9);
+        auto final = Sensitivity(sim).solveTransient(out, Sensitivity::Measure::Final, waves);
+        auto charge = Sensitivity(sim).solveTransient(supply, Sensitivity::Measure::Integral, waves);
+
+        auto run = [&](Netlist &n, int index, bool integral) {
+            Simulator s(n, opts);
+            auto w = s.solveTransient(10e-12, 0.4e-9);
+            if (!integral) return w.x.back()[index];
+            double total = 0.0;
+            for (size_t i = 1; i < w.time.size(); i++) total += (w.time[i] - w.time[i - 1]) * w.x[i][index];
+            return total;
+        };
+
+        EXPECT_NEAR(final.value, waves.x.back()[out], 1e-12);
+        for (int k = 0; k < 2; k++) {
+            double dW = 1e-6 * netlist.getFets()[k].W;
+            auto up = commonSource(), down = commonSource();
+            up.getFet(k).W += dW;
+            down.getFet(k).W -= dW;
+            auto fdFinal = (run(up, out, false) - run(down, out, false)) / (2 * dW);
+            auto fdCharge = (run(up, supply, true) - run(down, supply, true)) / (2 * dW);
+            EXPECT_NEAR(final.W[k], fdFinal, 1e-4 * std::abs(fdFinal) + 1e-6);
+            EXPECT_NEAR(charge.W[k], fdCharge, 1e-4 * std::abs(fdCharge) + 1e-12);
+        }
+
+        auto tech = netlist.findTech("t180nm");
+        auto up = commonSource(), down = commonSource();
+        rebuildTech(up, tech, "Vt", 1e-6);
+        rebuildTech(down, tech, "Vt", -1e-6);
+        auto fdVt = (run(up, out, false) - run(down, out, false)) / 2e-6;
+        EXPECT_NEAR(final.tech[tech].Vt, fdVt, 1e-4 * std::abs(fdVt) + 1e-9);
+    }
+
+    TEST_F(SimulatorTest, Sensitivity_CrossingTime_MatchesFiniteDifference) {
+        auto netlist = commonSource();
+        Simulator sim(netlist, opts);
+        auto out = sim.getIndex("v(out)");
+        auto waves = sim.solveTransient(10e-12, 0.4e-9);
+        // halfway down the output's fall
+        auto threshold = 0.5 * (waves.x.front()[out] + waves.x.back()[out]);
+        auto grad = Sensitivity(sim).solveTransient(out, Sensitivity::Measure::Crossing, waves, threshold);
+
+        auto crossing = [&](Netlist &n) {
+            Simulator s(n, opts);
+            auto w = s.solveTransient(10e-12, 0.4e-9);
+            for (size_t i = 1; i < w.time.size(); i++) {
+                auto a = w.x[i - 1][out], b = w.x[i][out];
+                if ((a < threshold) != (b < threshold)) return w.time[i - 1] + (w.time[i] - w.time[i - 1]) * (threshold - a) / (b - a);
+            }
+            return -1.0;
+        };
+
+        EXPECT_NEAR(grad.value, crossing(netlist), 1e-18);
+        EXPECT_GT(grad.value, 0.1e-9);
+        for (int k = 0; k < 2; k++) {
+            double dW = 1e-6 * netlist.getFets()[k].W;
+            auto up = commonSource(), down = commonSource();
+            up.getFet(k).W += dW;
+            down.getFet(k).W -= dW;
+            auto fd = (crossing(up) - crossing(down)) / (2 * dW);
+            EXPECT_NE(grad.W[k], 0.0);
+            EXPECT_NEAR(grad.W[k], fd, 1e-4 * std::abs(fd) + 1e-12);
+        }
+
+        auto tech = netlist.findTech("t180nm");
+        auto up = commonSource(), down = commonSource();
+        rebuildTech(up, tech, "Vt", 1e-6);
+        rebuildTech(down, tech, "Vt", -1e-6);
+        auto fdVt = (crossing(up) - crossing(down)) / 2e-6;
+        EXPECT_NEAR(grad.tech[tech].Vt, fdVt, 1e-4 * std::abs(fdVt) + 1e-15);
+
+        EXPECT_THROW(Sensitivity(sim).solveTransient(out, Sensitivity::Measure::Crossing, waves, 5.0), std::runtime_error);
+    }
+}